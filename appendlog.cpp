@@ -0,0 +1,96 @@
+#include "appendlog.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QDebug>
+
+namespace {
+
+// Superseded records tolerated on top of the live ones before a rewrite
+const int CompactionSlack = 100;
+
+void writeRecord(QTextStream& out, const QStringList& record)
+{
+    out << record.join('\t') << '\n';
+}
+
+} // namespace
+
+AppendLog::AppendLog()
+    : m_lines(0)
+{
+}
+
+bool AppendLog::load(const QString& filePath, int fieldCount, const std::function<void(const QStringList&)>& handler)
+{
+    m_filePath = filePath;
+    m_lines = 0;
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    
+    QTextStream in(&file);
+    in.setEncoding(QStringConverter::Utf8);
+    
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        m_lines++;
+        
+        // The last field takes the rest of the line, tabs and all
+        QStringList fields = line.split('\t');
+        if (fields.size() > fieldCount) {
+            QString last = fields.mid(fieldCount - 1).join('\t');
+            fields.erase(fields.begin() + fieldCount - 1, fields.end());
+            fields.append(last);
+        }
+        handler(fields);
+    }
+    
+    return true;
+}
+
+void AppendLog::append(const QStringList& record, int liveCount, const std::function<QList<QStringList>()>& liveRecords)
+{
+    // Mostly superseded records, write the live ones only
+    if (m_lines > 2 * liveCount + CompactionSlack) {
+        compact(liveRecords());
+        return;
+    }
+    
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qDebug() << "AppendLog: Failed to open" << m_filePath << "for writing:" << file.errorString();
+        return;
+    }
+    
+    QTextStream out(&file);
+    out.setEncoding(QStringConverter::Utf8);
+    writeRecord(out, record);
+    m_lines++;
+}
+
+void AppendLog::compact(const QList<QStringList>& records)
+{
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qDebug() << "AppendLog: Failed to rewrite" << m_filePath << ":" << file.errorString();
+        return;
+    }
+    
+    QTextStream out(&file);
+    out.setEncoding(QStringConverter::Utf8);
+    
+    for (const QStringList& record : records) {
+        writeRecord(out, record);
+    }
+    
+    out.flush();
+    if (file.commit()) {
+        m_lines = static_cast<int>(records.size());
+    }
+}
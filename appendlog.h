@@ -0,0 +1,41 @@
+#ifndef APPENDLOG_H
+#define APPENDLOG_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <functional>
+
+/**
+ * @class AppendLog
+ * @brief Append-only index file of tab-separated records, compacted when mostly stale
+ *
+ * Each line is one record; later records replace or cancel earlier ones, as
+ * their owner decides when loading. The last field may itself contain tabs
+ * (a path), so records are split into at most the given number of fields.
+ * Once the file holds more than twice the live records (plus some slack), the
+ * next append rewrites it with the live records only.
+ *
+ * Used by the caches under savedstates/, which lock around every call.
+ */
+class AppendLog
+{
+public:
+    AppendLog();
+    
+    // Opens the log at filePath and hands every record to handler, oldest first;
+    // false if there is no log yet
+    bool load(const QString& filePath, int fieldCount, const std::function<void(const QStringList&)>& handler);
+    
+    // Appends record, or rewrites the log from liveRecords (record included) when
+    // it holds more than twice liveCount records
+    void append(const QStringList& record, int liveCount, const std::function<QList<QStringList>()>& liveRecords);
+
+private:
+    void compact(const QList<QStringList>& records);
+    
+    QString m_filePath;
+    int m_lines;  // Records in the file, live or superseded
+};
+
+#endif // APPENDLOG_H
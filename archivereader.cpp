@@ -0,0 +1,923 @@
+#include "archivereader.h"
+#include "filefingerprint.h"
+#include "perftracer.h"
+#include <vlc/vlc.h>
+#include <QCollator>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QtEndian>
+#include <QDebug>
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// End of central directory: 22 bytes plus a comment of up to 64 KiB
+const qint64 ZipTailSize = 22 + 65535;
+const qint64 TarBlockSize = 512;
+
+// Checkpoints are at least this far apart, and no more than ~1024 per entry
+const qint64 MinCheckpointSpacing = 4 * 1024 * 1024;
+const int MaxCheckpoints = 1024;
+
+// Indexes kept for entries no reader has open (each up to MaxCheckpoints 32 KiB windows)
+const int MaxIdleIndexes = 8;
+
+// Compressed bytes read per file access
+const qint64 InflateInputSize = 64 * 1024;
+
+quint16 le16(const uchar* p) { return qFromLittleEndian<quint16>(p); }
+quint32 le32(const uchar* p) { return qFromLittleEndian<quint32>(p); }
+quint64 le64(const uchar* p) { return qFromLittleEndian<quint64>(p); }
+
+// Parsed directory of an archive, valid while its size and modification time are unchanged
+struct Directory {
+    qint64 size = 0;
+    qint64 modifiedMs = 0;
+    QVector<ArchiveReader::Entry> entries;
+    QHash<QString, int> byName;
+};
+
+QMutex s_directoriesMutex;
+QHash<QString, std::shared_ptr<const Directory>> s_directories;  // Absolute archive path -> directory
+
+bool readZipDirectory(QFile& file, QVector<ArchiveReader::Entry>& entries)
+{
+    const qint64 fileSize = file.size();
+    const qint64 tailSize = qMin(fileSize, ZipTailSize);
+    if (tailSize < 22 || !file.seek(fileSize - tailSize)) {
+        return false;
+    }
+    
+    QByteArray tail = file.read(tailSize);
+    const uchar* tailData = reinterpret_cast<const uchar*>(tail.constData());
+    
+    int eocd = -1;
+    for (int i = tail.size() - 22; i >= 0; i--) {
+        if (le32(tailData + i) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    
+    if (eocd < 0) {
+        return false;
+    }
+    
+    const uchar* end = tailData + eocd;
+    quint64 count = le16(end + 10);
+    quint64 directorySize = le32(end + 12);
+    quint64 directoryOffset = le32(end + 16);
+    
+    // Zip64, the locator sits right before the end record and points at the real one
+    if (eocd >= 20 && le32(end - 20) == 0x07064b50) {
+        if (file.seek(static_cast<qint64>(le64(end - 20 + 8)))) {
+            QByteArray zip64 = file.read(56);
+            const uchar* z = reinterpret_cast<const uchar*>(zip64.constData());
+            if (zip64.size() == 56 && le32(z) == 0x06064b50) {
+                count = le64(z + 32);
+                directorySize = le64(z + 40);
+                directoryOffset = le64(z + 48);
+            }
+        }
+    }
+    
+    if (directoryOffset + directorySize > static_cast<quint64>(fileSize) || !file.seek(static_cast<qint64>(directoryOffset))) {
+        return false;
+    }
+    
+    QByteArray directory = file.read(static_cast<qint64>(directorySize));
+    if (directory.size() != static_cast<qint64>(directorySize)) {
+        return false;
+    }
+    
+    const uchar* data = reinterpret_cast<const uchar*>(directory.constData());
+    qint64 pos = 0;
+    
+    for (quint64 i = 0; i < count && pos + 46 <= directory.size(); i++) {
+        const uchar* header = data + pos;
+        if (le32(header) != 0x02014b50) {
+            break;
+        }
+        
+        const quint16 flags = le16(header + 8);
+        const quint16 method = le16(header + 10);
+        const int nameLength = le16(header + 28);
+        const int extraLength = le16(header + 30);
+        const int commentLength = le16(header + 32);
+        
+        if (pos + 46 + nameLength + extraLength + commentLength > directory.size()) {
+            break;
+        }
+        
+        quint64 compressedSize = le32(header + 20);
+        quint64 size = le32(header + 24);
+        quint64 headerOffset = le32(header + 42);
+        
+        // Zip64 extra field, holds the values that did not fit, in this order
+        const uchar* extra = header + 46 + nameLength;
+        for (int x = 0; x + 4 <= extraLength; ) {
+            const int id = le16(extra + x);
+            const int length = le16(extra + x + 2);
+            if (id == 0x0001) {
+                const uchar* field = extra + x + 4;
+                int f = 0;
+                if (size == 0xFFFFFFFF && f + 8 <= length) { size = le64(field + f); f += 8; }
+                if (compressedSize == 0xFFFFFFFF && f + 8 <= length) { compressedSize = le64(field + f); f += 8; }
+                if (headerOffset == 0xFFFFFFFF && f + 8 <= length) { headerOffset = le64(field + f); f += 8; }
+            }
+            x += 4 + length;
+        }
+        
+        QByteArray rawName(reinterpret_cast<const char*>(header + 46), nameLength);
+        pos += 46 + nameLength + extraLength + commentLength;
+        
+        // Encrypted, unsupported methods and directories can not be played
+        if ((flags & 0x0001) || (method != 0 && method != 8) || rawName.endsWith('/')) {
+            continue;
+        }
+        
+        ArchiveReader::Entry entry;
+        entry.name = (flags & 0x0800) ? QString::fromUtf8(rawName) : QString::fromLocal8Bit(rawName);
+        entry.headerOffset = static_cast<qint64>(headerOffset);
+        entry.compressedSize = static_cast<qint64>(compressedSize);
+        entry.size = static_cast<qint64>(size);
+        entry.crc32 = le32(header + 16);
+        entry.deflated = method == 8;
+        entries << entry;
+    }
+    
+    return true;
+}
+
+// Octal, or base-256 (GNU) for sizes of 8 GiB and up
+qint64 tarNumber(const char* field, int length)
+{
+    if (static_cast<uchar>(field[0]) & 0x80) {
+        qint64 value = static_cast<uchar>(field[0]) & 0x7f;
+        for (int i = 1; i < length; i++) {
+            value = (value << 8) | static_cast<uchar>(field[i]);
+        }
+        return value;
+    }
+    
+    qint64 value = 0;
+    for (int i = 0; i < length && field[i]; i++) {
+        if (field[i] >= '0' && field[i] <= '7') {
+            value = value * 8 + (field[i] - '0');
+        }
+    }
+    return value;
+}
+
+QString tarString(const char* field, int length)
+{
+    return QString::fromUtf8(field, static_cast<int>(qstrnlen(field, length)));
+}
+
+bool tarChecksumValid(const char* header)
+{
+    qint64 sum = 0;
+    for (int i = 0; i < TarBlockSize; i++) {
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<uchar>(header[i]);
+    }
+    return sum == tarNumber(header + 148, 8);
+}
+
+bool readTarDirectory(QFile& file, QVector<ArchiveReader::Entry>& entries)
+{
+    const qint64 fileSize = file.size();
+    QString pendingName;  // Long name from a GNU 'L' or pax header, applies to the next entry
+    qint64 offset = 0;
+    
+    while (offset + TarBlockSize <= fileSize && file.seek(offset)) {
+        QByteArray block = file.read(TarBlockSize);
+        if (block.size() < TarBlockSize || block.count('\0') == TarBlockSize) {
+            break;  // End of archive
+        }
+        
+        const char* header = block.constData();
+        if (!tarChecksumValid(header)) {
+            if (offset == 0) {
+                return false;
+            }
+            qDebug() << "ArchiveReader: Corrupt tar header at" << offset << "in" << file.fileName();
+            break;
+        }
+        
+        const qint64 size = tarNumber(header + 124, 12);
+        const char type = header[156];
+        const qint64 dataOffset = offset + TarBlockSize;
+        
+        if (type == 'L' || type == 'x') {
+            QByteArray data;
+            if (size < 1024 * 1024 && file.seek(dataOffset)) {
+                data = file.read(size);
+            }
+            
+            if (type == 'L') {
+                pendingName = QString::fromUtf8(data.constData(), static_cast<int>(qstrnlen(data.constData(), data.size())));
+            } else {
+                // Records of "<length> <key>=<value>\n"
+                for (int pos = 0; pos < data.size(); ) {
+                    int space = data.indexOf(' ', pos);
+                    int length = space > pos ? data.mid(pos, space - pos).toInt() : 0;
+                    if (length <= 0 || pos + length > data.size()) {
+                        break;
+                    }
+                    
+                    QByteArray record = data.mid(space + 1, pos + length - space - 2);
+                    if (record.startsWith("path=")) {
+                        pendingName = QString::fromUtf8(record.mid(5));
+                    }
+                    pos += length;
+                }
+            }
+        } else if (type == '0' || type == '\0' || type == '7') {
+            QString name = pendingName;
+            if (name.isEmpty()) {
+                name = tarString(header, 100);
+                QString prefix = std::memcmp(header + 257, "ustar", 5) == 0 ? tarString(header + 345, 155) : QString();
+                if (!prefix.isEmpty()) {
+                    name = prefix + "/" + name;
+                }
+            }
+            
+            if (name.startsWith("./")) {
+                name = name.mid(2);
+            }
+            
+            ArchiveReader::Entry entry;
+            entry.name = name;
+            entry.headerOffset = dataOffset;
+            entry.dataOffset = dataOffset;
+            entry.compressedSize = size;
+            entry.size = size;
+            entries << entry;
+            pendingName.clear();
+        } else {
+            pendingName.clear();
+        }
+        
+        offset = dataOffset + ((size + TarBlockSize - 1) / TarBlockSize) * TarBlockSize;
+    }
+    
+    return true;
+}
+
+std::shared_ptr<const Directory> directoryOf(const QString& archivePath)
+{
+    QFileInfo fileInfo(archivePath);
+    if (!fileInfo.isFile()) {
+        return nullptr;
+    }
+    
+    const QString absolutePath = fileInfo.absoluteFilePath();
+    const qint64 size = fileInfo.size();
+    const qint64 modifiedMs = fileInfo.lastModified().toMSecsSinceEpoch();
+    
+    {
+        QMutexLocker locker(&s_directoriesMutex);
+        std::shared_ptr<const Directory> cached = s_directories.value(absolutePath);
+        if (cached && cached->size == size && cached->modifiedMs == modifiedMs) {
+            return cached;
+        }
+    }
+    
+    PERF_TRACE_SCOPE("archiveDirectoryLoad");
+    
+    QFile file(absolutePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "ArchiveReader: Failed to open" << absolutePath << ":" << file.errorString();
+        return nullptr;
+    }
+    
+    auto directory = std::make_shared<Directory>();
+    directory->size = size;
+    directory->modifiedMs = modifiedMs;
+    
+    bool isZip = fileInfo.suffix().compare("zip", Qt::CaseInsensitive) == 0;
+    bool ok = isZip ? readZipDirectory(file, directory->entries) : readTarDirectory(file, directory->entries);
+    if (!ok) {
+        qDebug() << "ArchiveReader: Not a readable" << (isZip ? "zip" : "tar") << "archive:" << absolutePath;
+        return nullptr;
+    }
+    
+    for (int i = 0; i < directory->entries.size(); i++) {
+        directory->byName.insert(directory->entries.at(i).name, i);
+    }
+    
+    qDebug() << "ArchiveReader: Read" << directory->entries.size() << "entries of" << absolutePath;
+    
+    QMutexLocker locker(&s_directoriesMutex);
+    s_directories.insert(absolutePath, directory);
+    return directory;
+}
+
+// Inflate state at a deflate block boundary: resuming from it needs the
+// input position (bits of the byte before it still unread) and the window
+struct Checkpoint {
+    qint64 in = 0;
+    int bits = 0;
+    qint64 out = 0;
+    QByteArray window;
+};
+
+// Checkpoints of one deflated entry, shared by every reader of it
+struct InflateIndex {
+    QMutex mutex;
+    QVector<Checkpoint> checkpoints;  // Ordered by out, the first is the start of the entry
+    qint64 spacing = MinCheckpointSpacing;
+    bool complete = false;  // Checkpoints cover the whole entry
+    bool building = false;  // A reader is completing it in the background
+};
+
+QMutex s_indexesMutex;
+QHash<QString, std::shared_ptr<InflateIndex>> s_indexes;  // Archive path, entry and mtime -> index
+QStringList s_indexOrder;  // Keys of s_indexes, least recently opened first
+
+std::shared_ptr<InflateIndex> indexOf(const QString& archivePath, const ArchiveReader::Entry& entry)
+{
+    const QString key = QFileInfo(archivePath).absoluteFilePath() + "!/" + entry.name + "\t" +
+                        QString::number(QFileInfo(archivePath).lastModified().toMSecsSinceEpoch());
+    
+    QMutexLocker locker(&s_indexesMutex);
+    std::shared_ptr<InflateIndex> index = s_indexes.value(key);
+    if (!index) {
+        index = std::make_shared<InflateIndex>();
+        index->spacing = qMax(MinCheckpointSpacing, entry.size / MaxCheckpoints);
+        index->checkpoints << Checkpoint();
+        s_indexes.insert(key, index);
+    }
+    s_indexOrder.removeOne(key);
+    s_indexOrder.append(key);
+    
+    // Drop the least recently opened indexes no reader holds (an open reader, or its
+    // background completion, keeps its own)
+    auto isIdle = [](const QString& cachedKey) {
+        return s_indexes.constFind(cachedKey)->use_count() == 1;
+    };
+    int idle = static_cast<int>(std::count_if(s_indexOrder.cbegin(), s_indexOrder.cend(), isIdle));
+    for (int i = 0; i < s_indexOrder.size() && idle > MaxIdleIndexes;) {
+        const QString oldKey = s_indexOrder.at(i);
+        if (isIdle(oldKey)) {
+            qDebug() << "ArchiveReader: Dropping the inflate index of" << oldKey.section('\t', 0, 0);
+            s_indexes.remove(oldKey);
+            s_indexOrder.removeAt(i);
+            idle--;
+        } else {
+            i++;
+        }
+    }
+    
+    return index;
+}
+
+} // namespace
+
+// An archive entry opened through callbacks, one per path for the lifetime of
+// the process (libvlc may open the media at any time while it is alive)
+struct ArchiveReader::Source {
+    QString path;
+};
+
+// Raw inflate of one entry, resumable at any checkpoint
+struct ArchiveReader::InflateState {
+    QFile file;
+    z_stream stream;
+    bool initialized = false;
+    bool ended = false;
+    qint64 dataOffset = 0;
+    qint64 compressedSize = 0;
+    qint64 fileIn = 0;  // Compressed bytes handed to zlib
+    qint64 out = 0;  // Uncompressed bytes produced
+    std::shared_ptr<InflateIndex> index;
+    QByteArray input;
+    
+    ~InflateState()
+    {
+        if (initialized) {
+            inflateEnd(&stream);
+        }
+    }
+    
+    bool restart(const Checkpoint& checkpoint)
+    {
+        if (initialized) {
+            inflateEnd(&stream);
+        }
+        
+        std::memset(&stream, 0, sizeof(stream));
+        initialized = inflateInit2(&stream, -MAX_WBITS) == Z_OK;
+        if (!initialized) {
+            return false;
+        }
+        
+        // A checkpoint in the middle of a byte resumes with its remaining bits
+        fileIn = checkpoint.in - (checkpoint.bits ? 1 : 0);
+        if (!file.seek(dataOffset + fileIn)) {
+            return false;
+        }
+        
+        if (checkpoint.bits) {
+            char byte;
+            if (!file.getChar(&byte)) {
+                return false;
+            }
+            fileIn++;
+            inflatePrime(&stream, checkpoint.bits, static_cast<uchar>(byte) >> (8 - checkpoint.bits));
+        }
+        
+        if (!checkpoint.window.isEmpty()) {
+            inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(checkpoint.window.constData()),
+                                 static_cast<uInt>(checkpoint.window.size()));
+        }
+        
+        out = checkpoint.out;
+        ended = false;
+        return true;
+    }
+    
+    void addCheckpoint()
+    {
+        Checkpoint checkpoint;
+        checkpoint.in = fileIn - stream.avail_in;
+        checkpoint.bits = stream.data_type & 7;
+        checkpoint.out = out;
+        
+        checkpoint.window.resize(32768);
+        uInt windowLength = 0;
+        inflateGetDictionary(&stream, reinterpret_cast<Bytef*>(checkpoint.window.data()), &windowLength);
+        checkpoint.window.resize(static_cast<int>(windowLength));
+        
+        QMutexLocker locker(&index->mutex);
+        auto it = std::lower_bound(index->checkpoints.begin(), index->checkpoints.end(), out,
+                                   [](const Checkpoint& c, qint64 value) { return c.out < value; });
+        
+        // Another reader may have been here already
+        bool nearNext = it != index->checkpoints.end() && it->out - out < index->spacing;
+        bool nearPrevious = it != index->checkpoints.begin() && out - (it - 1)->out < index->spacing;
+        if (!nearNext && !nearPrevious) {
+            index->checkpoints.insert(it, checkpoint);
+        }
+    }
+    
+    bool dueForCheckpoint()
+    {
+        // Only between deflate blocks, and never within spacing of the last one
+        if (!(stream.data_type & 128) || (stream.data_type & 64)) {
+            return false;
+        }
+        
+        QMutexLocker locker(&index->mutex);
+        if (index->complete) {
+            return false;
+        }
+        
+        auto it = std::upper_bound(index->checkpoints.begin(), index->checkpoints.end(), out,
+                                   [](qint64 value, const Checkpoint& c) { return value < c.out; });
+        return it == index->checkpoints.begin() || out - (it - 1)->out >= index->spacing;
+    }
+    
+    // Bytes produced, 0 at end of entry, -1 on error
+    qint64 inflateInto(char* buffer, qint64 length)
+    {
+        if (ended) {
+            return 0;
+        }
+        
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = static_cast<uInt>(qMin<qint64>(length, 1 << 30));
+        const qint64 requested = stream.avail_out;
+        
+        while (stream.avail_out > 0) {
+            if (stream.avail_in == 0) {
+                qint64 remaining = compressedSize - fileIn;
+                if (remaining <= 0) {
+                    ended = true;
+                    break;
+                }
+                
+                input.resize(static_cast<int>(InflateInputSize));
+                qint64 bytesRead = file.read(input.data(), qMin(remaining, InflateInputSize));
+                if (bytesRead <= 0) {
+                    return -1;
+                }
+                
+                stream.next_in = reinterpret_cast<Bytef*>(input.data());
+                stream.avail_in = static_cast<uInt>(bytesRead);
+                fileIn += bytesRead;
+            }
+            
+            uInt availableBefore = stream.avail_out;
+            int result = inflate(&stream, Z_BLOCK);
+            out += availableBefore - stream.avail_out;
+            
+            if (result == Z_STREAM_END) {
+                ended = true;
+                break;
+            }
+            
+            if (result != Z_OK && result != Z_BUF_ERROR) {
+                qDebug() << "ArchiveReader: Inflate failed at" << out << ":" << (stream.msg ? stream.msg : "");
+                return -1;
+            }
+            
+            if (dueForCheckpoint()) {
+                addCheckpoint();
+            }
+        }
+        
+        return requested - stream.avail_out;
+    }
+    
+    // Move to target, restarting from the nearest checkpoint unless inflating through is shorter
+    bool seekTo(qint64 target, const std::atomic<bool>* stop = nullptr)
+    {
+        Checkpoint nearest;
+        {
+            QMutexLocker locker(&index->mutex);
+            auto it = std::upper_bound(index->checkpoints.begin(), index->checkpoints.end(), target,
+                                       [](qint64 value, const Checkpoint& c) { return value < c.out; });
+            nearest = *(it - 1);  // The first checkpoint is at 0
+        }
+        
+        if (!initialized || target < out || nearest.out > out) {
+            if (!restart(nearest)) {
+                return false;
+            }
+        }
+        
+        QByteArray scratch(static_cast<int>(InflateInputSize), Qt::Uninitialized);
+        while (out < target) {
+            if (stop && *stop) {
+                return false;
+            }
+            
+            if (inflateInto(scratch.data(), qMin<qint64>(target - out, scratch.size())) <= 0) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+};
+
+struct ArchiveReaderCallbacks {
+    static QMutex s_sourcesMutex;
+    static QHash<QString, ArchiveReader::Source*> s_sources;
+    
+    static int open(void* opaque, void** data, uint64_t* size)
+    {
+        ArchiveReader* reader = new ArchiveReader(static_cast<ArchiveReader::Source*>(opaque));
+        if (!reader->open()) {
+            delete reader;
+            *data = nullptr;
+            return -1;
+        }
+        
+        *data = reader;
+        *size = static_cast<uint64_t>(reader->size());
+        return 0;
+    }
+    
+    static ssize_t read(void* data, unsigned char* buffer, size_t length)
+    {
+        return static_cast<ssize_t>(static_cast<ArchiveReader*>(data)->read(reinterpret_cast<char*>(buffer), static_cast<qint64>(length)));
+    }
+    
+    static int seek(void* data, uint64_t offset)
+    {
+        return static_cast<ArchiveReader*>(data)->seek(static_cast<qint64>(offset)) ? 0 : -1;
+    }
+    
+    static void close(void* data)
+    {
+        delete static_cast<ArchiveReader*>(data);
+    }
+};
+
+QMutex ArchiveReaderCallbacks::s_sourcesMutex;
+QHash<QString, ArchiveReader::Source*> ArchiveReaderCallbacks::s_sources;
+
+bool ArchiveReader::splitPath(const QString& path, QString* archivePath, QString* entryName)
+{
+    // The first "!/" that follows an archive name, entries may contain "!/" themselves
+    for (int i = path.indexOf("!/"); i >= 0; i = path.indexOf("!/", i + 2)) {
+        QString archive = path.left(i);
+        if (isArchive(archive)) {
+            if (archivePath) {
+                *archivePath = archive;
+            }
+            if (entryName) {
+                *entryName = path.mid(i + 2);
+            }
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+bool ArchiveReader::isArchive(const QString& filePath)
+{
+    return filePath.endsWith(".zip", Qt::CaseInsensitive) || filePath.endsWith(".tar", Qt::CaseInsensitive);
+}
+
+bool ArchiveReader::exists(const QString& path)
+{
+    if (!splitPath(path, nullptr, nullptr)) {
+        return QFile::exists(path);
+    }
+    
+    return findEntry(path, nullptr);
+}
+
+QStringList ArchiveReader::entryPaths(const QString& archivePath, const QStringList& nameFilters,
+                                      const QString& directory, bool recursive)
+{
+    std::shared_ptr<const Directory> archive = directoryOf(archivePath);
+    if (!archive) {
+        return QStringList();
+    }
+    
+    const QString absolutePath = QFileInfo(archivePath).absoluteFilePath();
+    const QString prefix = directory.isEmpty() ? QString() : directory + "/";
+    
+    QStringList paths;
+    for (const Entry& entry : archive->entries) {
+        if (!entry.name.startsWith(prefix)) {
+            continue;
+        }
+        
+        const QString relativeName = entry.name.mid(prefix.size());
+        if (!recursive && relativeName.contains('/')) {
+            continue;
+        }
+        
+        if (QDir::match(nameFilters, relativeName.section('/', -1))) {
+            paths << absolutePath + "!/" + entry.name;
+        }
+    }
+    
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::sort(paths.begin(), paths.end(), [&collator](const QString& a, const QString& b) {
+        return collator.compare(a, b) < 0;
+    });
+    
+    return paths;
+}
+
+bool ArchiveReader::findEntry(const QString& path, Entry* entry)
+{
+    QString archivePath;
+    QString entryName;
+    if (!splitPath(path, &archivePath, &entryName)) {
+        return false;
+    }
+    
+    std::shared_ptr<const Directory> archive = directoryOf(archivePath);
+    if (!archive) {
+        return false;
+    }
+    
+    auto it = archive->byName.constFind(entryName);
+    if (it == archive->byName.constEnd()) {
+        return false;
+    }
+    
+    if (!entry) {
+        return true;
+    }
+    
+    *entry = archive->entries.at(*it);
+    if (entry->dataOffset >= 0) {
+        return true;
+    }
+    
+    // Zip: the data follows the local header, whose extra field may differ from the directory's
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(entry->headerOffset)) {
+        return false;
+    }
+    
+    QByteArray localHeader = file.read(30);
+    const uchar* header = reinterpret_cast<const uchar*>(localHeader.constData());
+    if (localHeader.size() != 30 || le32(header) != 0x04034b50) {
+        qDebug() << "ArchiveReader: Bad local header for" << path;
+        return false;
+    }
+    
+    entry->dataOffset = entry->headerOffset + 30 + le16(header + 26) + le16(header + 28);
+    return entry->dataOffset + entry->compressedSize <= file.size();
+}
+
+QByteArray ArchiveReader::entryFingerprint(const QString& path)
+{
+    Entry entry;
+    if (!findEntry(path, &entry)) {
+        return QByteArray();
+    }
+    
+    // Stored bytes are the file itself, sample them like an extracted copy would be
+    if (!entry.deflated) {
+        QString archivePath;
+        splitPath(path, &archivePath, nullptr);
+        return FileFingerprint::computeRange(archivePath, entry.dataOffset, entry.size);
+    }
+    
+    // Sampling a deflated entry would mean inflating it, the CRC-32 covers every byte anyway
+    QByteArray identity(16, '\0');
+    qToLittleEndian<quint32>(entry.crc32, identity.data());
+    qToLittleEndian<qint64>(entry.compressedSize, identity.data() + 4);
+    
+    QByteArray fingerprint(8, '\0');
+    qToLittleEndian<qint64>(entry.size, fingerprint.data());
+    fingerprint += QCryptographicHash::hash(identity, QCryptographicHash::Sha1).left(8);
+    return fingerprint;
+}
+
+ArchiveReader::Source* ArchiveReader::sourceOf(const QString& path)
+{
+    QString archivePath;
+    QString entryName;
+    splitPath(path, &archivePath, &entryName);
+    const QString absolutePath = QFileInfo(archivePath).absoluteFilePath() + "!/" + entryName;
+    
+    QMutexLocker locker(&ArchiveReaderCallbacks::s_sourcesMutex);
+    Source* source = ArchiveReaderCallbacks::s_sources.value(absolutePath);
+    if (!source) {
+        source = new Source;
+        source->path = absolutePath;
+        ArchiveReaderCallbacks::s_sources.insert(absolutePath, source);
+    }
+    return source;
+}
+
+libvlc_media_t* ArchiveReader::createMedia(libvlc_instance_t* instance, const QString& path)
+{
+    return libvlc_media_new_callbacks(instance, ArchiveReaderCallbacks::open, ArchiveReaderCallbacks::read,
+                                      ArchiveReaderCallbacks::seek, ArchiveReaderCallbacks::close, sourceOf(path));
+}
+
+std::unique_ptr<ArchiveReader> ArchiveReader::openEntry(const QString& path)
+{
+    std::unique_ptr<ArchiveReader> reader(new ArchiveReader(sourceOf(path)));
+    if (!reader->open()) {
+        return nullptr;
+    }
+    return reader;
+}
+
+ArchiveReader::ArchiveReader(Source* source)
+    : m_source(source)
+    , m_position(0)
+    , m_stopping(false)
+{
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    if (m_indexThread) {
+        m_stopping = true;
+        m_indexThread->wait();
+    }
+}
+
+bool ArchiveReader::open()
+{
+    if (!findEntry(m_source->path, &m_entry)) {
+        qDebug() << "ArchiveReader: No such entry" << m_source->path;
+        return false;
+    }
+    
+    splitPath(m_source->path, &m_archivePath, nullptr);
+    
+    if (!m_entry.deflated) {
+        m_file.setFileName(m_archivePath);
+        if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            qDebug() << "ArchiveReader: Failed to open" << m_archivePath << ":" << m_file.errorString();
+            return false;
+        }
+        return true;
+    }
+    
+    m_inflate.reset(new InflateState);
+    m_inflate->file.setFileName(m_archivePath);
+    if (!m_inflate->file.open(QIODevice::ReadOnly)) {
+        qDebug() << "ArchiveReader: Failed to open" << m_archivePath << ":" << m_inflate->file.errorString();
+        return false;
+    }
+    
+    m_inflate->dataOffset = m_entry.dataOffset;
+    m_inflate->compressedSize = m_entry.compressedSize;
+    m_inflate->index = indexOf(m_archivePath, m_entry);
+    
+    std::shared_ptr<InflateIndex> index = m_inflate->index;
+    {
+        QMutexLocker locker(&index->mutex);
+        if (index->complete || index->building) {
+            return true;
+        }
+        index->building = true;
+    }
+    
+    // Inflate the rest of the entry once, so later seeks anywhere restart close by
+    QString archivePath = m_archivePath;
+    Entry entry = m_entry;
+    m_indexThread.reset(QThread::create([this, archivePath, entry, index]() {
+        PERF_TRACE_SCOPE("archiveIndexBuild");
+        
+        InflateState builder;
+        builder.file.setFileName(archivePath);
+        builder.dataOffset = entry.dataOffset;
+        builder.compressedSize = entry.compressedSize;
+        builder.index = index;
+        
+        Checkpoint last;
+        {
+            QMutexLocker locker(&index->mutex);
+            last = index->checkpoints.last();
+        }
+        
+        bool complete = builder.file.open(QIODevice::ReadOnly) && builder.restart(last);
+        QByteArray scratch(static_cast<int>(InflateInputSize), Qt::Uninitialized);
+        
+        while (complete && !m_stopping) {
+            qint64 produced = builder.inflateInto(scratch.data(), scratch.size());
+            if (produced < 0) {
+                complete = false;
+            } else if (produced == 0) {
+                break;
+            }
+        }
+        
+        QMutexLocker locker(&index->mutex);
+        index->building = false;
+        index->complete = complete && !m_stopping;
+        
+        if (index->complete) {
+            qDebug() << "ArchiveReader: Indexed" << entry.name << "with" << index->checkpoints.size() << "checkpoints";
+        }
+    }));
+    m_indexThread->setObjectName("archiveIndex");
+    m_indexThread->start(QThread::LowestPriority);
+    
+    return true;
+}
+
+qint64 ArchiveReader::read(char* buffer, qint64 length)
+{
+    length = qMin(length, m_entry.size - m_position);
+    if (length <= 0) {
+        return 0;
+    }
+    
+    qint64 bytesRead = m_entry.deflated ? readDeflated(buffer, length) : readStored(buffer, length);
+    if (bytesRead > 0) {
+        m_position += bytesRead;
+    }
+    return bytesRead;
+}
+
+bool ArchiveReader::seek(qint64 offset)
+{
+    if (offset < 0 || offset > m_entry.size) {
+        return false;
+    }
+    
+    // Deflated entries move lazily, a seek right before a close costs nothing
+    m_position = offset;
+    return true;
+}
+
+qint64 ArchiveReader::readStored(char* buffer, qint64 length)
+{
+    if (!m_file.seek(m_entry.dataOffset + m_position)) {
+        return -1;
+    }
+    
+    return m_file.read(buffer, length);
+}
+
+qint64 ArchiveReader::readDeflated(char* buffer, qint64 length)
+{
+    if (m_inflate->out != m_position || !m_inflate->initialized) {
+        PERF_TRACE_SCOPE("archiveSeek");
+        
+        if (!m_inflate->seekTo(m_position)) {
+            qDebug() << "ArchiveReader: Failed to seek to" << m_position << "in" << m_source->path;
+            return -1;
+        }
+    }
+    
+    return m_inflate->inflateInto(buffer, length);
+}
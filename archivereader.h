@@ -0,0 +1,103 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFile>
+#include <QThread>
+#include <atomic>
+#include <memory>
+
+struct libvlc_instance_t;
+struct libvlc_media_t;
+
+/**
+ * @class ArchiveReader
+ * @brief Plays videos inside zip and tar archives without extracting them
+ *
+ * An entry is addressed as "archive.zip!/folder/video.mp4". Stored entries
+ * (all tar entries, uncompressed zip entries) are read at their offset in the
+ * archive, so seeking is free. Deflated zip entries are inflated on the fly;
+ * while an entry is decoded, a checkpoint (position plus 32 KiB of history) is
+ * kept every few MiB, so a seek restarts from the nearest checkpoint instead
+ * of the start of the entry. Archive directories and checkpoints are shared by
+ * all readers of the process.
+ *
+ * One reader exists per open of a media, created and destroyed by libvlc
+ * through the callbacks installed by createMedia().
+ */
+class ArchiveReader
+{
+public:
+    struct Entry {
+        QString name;  // Path inside the archive
+        qint64 headerOffset = 0;  // Local header (zip) or data (tar) offset
+        qint64 dataOffset = -1;  // Start of the data, -1 until the local header was read
+        qint64 compressedSize = 0;
+        qint64 size = 0;
+        quint32 crc32 = 0;
+        bool deflated = false;
+    };
+    
+    // Split "archive.zip!/folder/video.mp4", false for a plain path
+    static bool splitPath(const QString& path, QString* archivePath, QString* entryName);
+    
+    // Zip or tar file, by extension
+    static bool isArchive(const QString& filePath);
+    
+    // True for an existing file or archive entry
+    static bool exists(const QString& path);
+    
+    // Entries in directory ("" is the archive root) matching nameFilters, as
+    // archive paths, naturally sorted; recursive includes subdirectories
+    static QStringList entryPaths(const QString& archivePath, const QStringList& nameFilters,
+                                  const QString& directory = QString(), bool recursive = true);
+    
+    static bool findEntry(const QString& path, Entry* entry);
+    
+    // Content identity of an entry: sampled-block hash for stored entries (the
+    // same as the extracted file's), size and CRC-32 for deflated ones
+    static QByteArray entryFingerprint(const QString& path);
+    
+    // Media read from an archive entry (libvlc_media_new_callbacks)
+    static libvlc_media_t* createMedia(libvlc_instance_t* instance, const QString& path);
+    
+    // Reader of an entry outside libvlc, nullptr if it can not be opened
+    static std::unique_ptr<ArchiveReader> openEntry(const QString& path);
+    
+    ~ArchiveReader();
+    
+    qint64 size() const { return m_entry.size; }
+    
+    // Bytes read, 0 at end of entry, -1 on error
+    qint64 read(char* buffer, qint64 length);
+    bool seek(qint64 offset);
+
+private:
+    struct Source;
+    struct InflateState;
+    friend struct ArchiveReaderCallbacks;  // libvlc callbacks, defined with libvlc's types
+    
+    explicit ArchiveReader(Source* source);
+    
+    // Source of an archive path, created on first use and kept for the process
+    static Source* sourceOf(const QString& path);
+    
+    bool open();
+    qint64 readStored(char* buffer, qint64 length);
+    qint64 readDeflated(char* buffer, qint64 length);
+    
+    Source* m_source;
+    QString m_archivePath;
+    Entry m_entry;
+    QFile m_file;
+    qint64 m_position;
+    
+    // Deflated entries only
+    std::unique_ptr<InflateState> m_inflate;
+    std::unique_ptr<QThread> m_indexThread;  // Completes the checkpoint index in the background
+    std::atomic<bool> m_stopping;
+};
+
+#endif // ARCHIVEREADER_H
@@ -0,0 +1,443 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPixmap>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "vp_vlcplayer.h"
+#include "mediareader.h"
+#include "chunkcache.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct BenchOptions {
+    int seekCount;
+    int captureCount;
+    int skimSeconds;
+    float skimRate;
+    int timeoutMs;
+    quint32 seed;
+    int loopCount;
+};
+
+// User plus system CPU time of the whole process (VLC's decoder and I/O threads included)
+double processCpuMs()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0.0;
+    }
+    
+    auto toMs = [](const FILETIME& time) {
+        return ((static_cast<quint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e4;
+    };
+    return toMs(kernelTime) + toMs(userTime);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    
+    auto toMs = [](const struct timeval& time) {
+        return time.tv_sec * 1e3 + time.tv_usec / 1e3;
+    };
+    return toMs(usage.ru_utime) + toMs(usage.ru_stime);
+#endif
+}
+
+// Run action, then spin the event loop until signal fires or the timeout expires.
+// Returns the elapsed time in milliseconds, or -1 on timeout.
+template <typename Signal>
+double measureUntilSignal(VP_VLCPlayer* player, Signal signal, const std::function<void()>& action, int timeoutMs)
+{
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    bool fired = false;
+    
+    QObject::connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
+    QMetaObject::Connection connection = QObject::connect(player, signal, &loop, [&fired, &loop]() {
+        fired = true;
+        loop.quit();
+    });
+    
+    QElapsedTimer elapsed;
+    elapsed.start();
+    action();
+    
+    if (!fired) {
+        timer.start(timeoutMs);
+        loop.exec();
+    }
+    
+    QObject::disconnect(connection);
+    return fired ? elapsed.nsecsElapsed() / 1e6 : -1.0;
+}
+
+// Keep the event loop running for a fixed time so queued VLC events are delivered
+void spinEventLoop(int milliseconds)
+{
+    QEventLoop loop;
+    QTimer::singleShot(milliseconds, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+QJsonObject summarizeLatencies(std::vector<double> samples, int timeouts)
+{
+    QJsonObject result;
+    result["count"] = static_cast<int>(samples.size());
+    result["timeouts"] = timeouts;
+    
+    if (samples.empty()) {
+        return result;
+    }
+    
+    std::sort(samples.begin(), samples.end());
+    
+    // Nearest-rank percentile
+    auto percentile = [&samples](double p) {
+        size_t rank = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+        return samples[std::min(rank, samples.size() - 1)];
+    };
+    
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    
+    result["meanMs"] = sum / samples.size();
+    result["p50Ms"] = percentile(0.50);
+    result["p90Ms"] = percentile(0.90);
+    result["p99Ms"] = percentile(0.99);
+    result["maxMs"] = samples.back();
+    return result;
+}
+
+QStringList collectMediaFiles(const QStringList& inputs)
+{
+    const QStringList videoFilters = {"*.mp4", "*.avi", "*.mkv", "*.mov", "*.wmv", "*.flv", "*.webm"};
+    QStringList files;
+    
+    for (const QString& input : inputs) {
+        QFileInfo info(input);
+        
+        if (VP_VLCPlayer::isUrl(input)) {
+            files << input;
+        } else if (info.isDir()) {
+            QDir dir(input);
+            const QFileInfoList entries = dir.entryInfoList(videoFilters, QDir::Files, QDir::Name);
+            for (const QFileInfo& entry : entries) {
+                files << entry.absoluteFilePath();
+            }
+        } else if (info.isFile()) {
+            files << info.absoluteFilePath();
+        } else {
+            qWarning() << "mmsvp_bench: Skipping missing input:" << input;
+        }
+    }
+    
+    return files;
+}
+
+QJsonObject benchmarkFile(const QString& filePath, const BenchOptions& options, QRandomGenerator& random)
+{
+    QJsonObject result;
+    result["file"] = filePath;
+    
+    // Instance startup (libvlc_new plugin scan plus media player creation)
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+    std::unique_ptr<VP_VLCPlayer> player = std::make_unique<VP_VLCPlayer>();
+    bool initialized = player->initialize();
+    result["startupMs"] = startupTimer.nsecsElapsed() / 1e6;
+    
+    if (!initialized) {
+        result["error"] = player->lastError();
+        return result;
+    }
+    
+    // loadMedia to first frame
+    double firstFrameMs = measureUntilSignal(player.get(), &VP_VLCPlayer::firstFrameRendered, [&player, &filePath]() {
+        if (player->loadMedia(filePath)) {
+            player->play();
+        }
+    }, options.timeoutMs);
+    
+    result["firstFrameMs"] = firstFrameMs;
+    
+    if (firstFrameMs < 0) {
+        result["error"] = player->lastError().isEmpty() ? QString("Timed out waiting for first frame") : player->lastError();
+        return result;
+    }
+    
+    // Give VLC a moment to report the final duration
+    spinEventLoop(200);
+    qint64 duration = player->duration();
+    result["durationMs"] = duration;
+    
+    if (duration <= 0) {
+        result["error"] = QString("Media has no duration");
+        return result;
+    }
+    
+    // Random seeks (request to first new frame)
+    std::vector<double> seekSamples;
+    int seekTimeouts = 0;
+    
+    for (int i = 0; i < options.seekCount; i++) {
+        qint64 target = static_cast<qint64>(random.bounded(static_cast<double>(duration)));
+        double elapsed = measureUntilSignal(player.get(), &VP_VLCPlayer::seekCompleted, [&player, target]() {
+            player->setPosition(target);
+        }, options.timeoutMs);
+        
+        if (elapsed >= 0) {
+            seekSamples.push_back(elapsed);
+        } else {
+            seekTimeouts++;
+        }
+    }
+    
+    result["seek"] = summarizeLatencies(seekSamples, seekTimeouts);
+    
+    // Frame capture latency
+    std::vector<double> captureSamples;
+    int captureFailures = 0;
+    
+    for (int i = 0; i < options.captureCount; i++) {
+        qint64 target = static_cast<qint64>(random.bounded(static_cast<double>(duration)));
+        
+        QElapsedTimer captureTimer;
+        captureTimer.start();
+        QPixmap frame = player->captureFrameAtPosition(target);
+        double elapsed = captureTimer.nsecsElapsed() / 1e6;
+        
+        if (frame.isNull()) {
+            captureFailures++;
+        } else {
+            captureSamples.push_back(elapsed);
+        }
+    }
+    
+    result["capture"] = summarizeLatencies(captureSamples, captureFailures);
+    
+    // Repeated passes over a short segment, the first pass is cold
+    const qint64 segmentMs = 2000;
+    if (options.loopCount > 0 && duration > segmentMs) {
+        qint64 segmentStart = static_cast<qint64>(random.bounded(static_cast<double>(duration - segmentMs)));
+        std::vector<double> repeatSamples;
+        double firstSeekMs = -1.0;
+        int loopTimeouts = 0;
+        
+        double cpuBefore = processCpuMs();
+        
+        for (int i = 0; i < options.loopCount; i++) {
+            double elapsed = measureUntilSignal(player.get(), &VP_VLCPlayer::seekCompleted, [&player, segmentStart]() {
+                player->setPosition(segmentStart);
+            }, options.timeoutMs);
+            
+            if (elapsed < 0) {
+                loopTimeouts++;
+            } else if (i == 0) {
+                firstSeekMs = elapsed;
+            } else {
+                repeatSamples.push_back(elapsed);
+            }
+            
+            spinEventLoop(static_cast<int>(segmentMs));
+        }
+        
+        QJsonObject loop;
+        loop["segmentMs"] = segmentMs;
+        loop["firstSeekMs"] = firstSeekMs;
+        loop["repeatSeek"] = summarizeLatencies(repeatSamples, loopTimeouts);
+        loop["cpuMsPerPlayedSecond"] = (processCpuMs() - cpuBefore) / (options.loopCount * segmentMs / 1000.0);
+        result["loop"] = loop;
+    }
+    
+    // Sustained fast playback drop rate (above 4x the player skims)
+    player->setPlaybackRate(options.skimRate);
+    measureUntilSignal(player.get(), &VP_VLCPlayer::seekCompleted, [&player]() {
+        player->setPosition(0);
+    }, options.timeoutMs);
+    
+    VP_VLCPlayer::PlaybackStatistics before;
+    VP_VLCPlayer::PlaybackStatistics after;
+    bool hasStats = player->playbackStatistics(before);
+    double skimCpuBefore = processCpuMs();
+    
+    spinEventLoop(options.skimSeconds * 1000);
+    
+    double skimCpuMs = processCpuMs() - skimCpuBefore;
+    qint64 skimmedMs = player->position();
+    player->setPlaybackRate(1.0f);
+    
+    hasStats = hasStats && player->playbackStatistics(after);
+    
+    QJsonObject skim;
+    skim["seconds"] = options.skimSeconds;
+    skim["rate"] = options.skimRate;
+    skim["positionMs"] = skimmedMs;
+    skim["cpuMsPerPlayedSecond"] = skimCpuMs / (options.skimSeconds * options.skimRate);
+    
+    if (hasStats) {
+        int displayed = after.displayedPictures - before.displayedPictures;
+        int lost = after.lostPictures - before.lostPictures;
+        int total = displayed + lost;
+        
+        skim["decoded"] = after.decodedVideo - before.decodedVideo;
+        skim["displayed"] = displayed;
+        skim["lost"] = lost;
+        skim["dropRate"] = total > 0 ? static_cast<double>(lost) / total : 0.0;
+    } else {
+        skim["error"] = QString("Statistics unavailable");
+    }
+    
+    result["skim"] = skim;
+    
+    // Prebuffering over the whole session (startup, stalls outside of seeks)
+    VP_VLCPlayer::StreamMetrics metrics = player->streamMetrics();
+    QJsonObject stream;
+    stream["startupDelayMs"] = metrics.startupDelayMs;
+    stream["rebufferCount"] = metrics.rebufferCount;
+    stream["rebufferMs"] = metrics.rebufferMs;
+    stream["chunkCache"] = VP_VLCPlayer::usesChunkCache(filePath);
+    result["stream"] = stream;
+    
+    player->stop();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("mmsvp_bench");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless VP_VLCPlayer benchmark. Writes results as JSON.");
+    parser.addHelpOption();
+    
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write JSON results to <file> instead of stdout.", "file");
+    QCommandLineOption seeksOption("seeks", "Number of random seeks per file (default 50).", "count", "50");
+    QCommandLineOption capturesOption("captures", "Number of frame captures per file (default 5).", "count", "5");
+    QCommandLineOption skimOption("skim-seconds", "Duration of the sustained fast playback test (default 10).", "seconds", "10");
+    QCommandLineOption skimRateOption("skim-rate", "Rate of the fast playback test, skims above 4 (default 4, up to 32).", "rate", "4");
+    QCommandLineOption timeoutOption("timeout", "Timeout for a single operation in ms (default 10000).", "ms", "10000");
+    QCommandLineOption seedOption("seed", "Random seed for seek positions (default 1).", "seed", "1");
+    QCommandLineOption ioOption("io", "How files are read: vlc (default), buffered, mmap or auto.", "mode", "vlc");
+    QCommandLineOption readAheadOption("read-ahead", "Read-ahead window of buffered and mmap reads in MiB (default 8).", "MiB", "8");
+    QCommandLineOption networkCachingOption("network-caching", "Prebuffer of stream URLs in ms (default 1000).", "ms", "1000");
+    QCommandLineOption streamCacheOption("stream-cache", "Disk chunk cache of stream URLs in MiB, 0 disables it (default 2048).", "MiB", "2048");
+    QCommandLineOption loopsOption("loops", "Number of passes over a short segment in the loop test (default 5).", "count", "5");
+    QCommandLineOption vlcArgOption("vlc-arg", "Extra libvlc argument, may be repeated (e.g. --vlc-arg=--file-caching=1000).", "arg");
+    
+    parser.addOption(outputOption);
+    parser.addOption(seeksOption);
+    parser.addOption(capturesOption);
+    parser.addOption(skimOption);
+    parser.addOption(skimRateOption);
+    parser.addOption(timeoutOption);
+    parser.addOption(seedOption);
+    parser.addOption(ioOption);
+    parser.addOption(readAheadOption);
+    parser.addOption(networkCachingOption);
+    parser.addOption(streamCacheOption);
+    parser.addOption(loopsOption);
+    parser.addOption(vlcArgOption);
+    parser.addPositionalArgument("media", "Media files, directories or stream URLs to benchmark.", "<media...>");
+    parser.process(app);
+    
+    QStringList files = collectMediaFiles(parser.positionalArguments());
+    if (files.isEmpty()) {
+        qWarning() << "mmsvp_bench: No media files given";
+        parser.showHelp(1);
+    }
+    
+    BenchOptions options;
+    options.seekCount = qMax(0, parser.value(seeksOption).toInt());
+    options.captureCount = qMax(0, parser.value(capturesOption).toInt());
+    options.skimSeconds = qMax(1, parser.value(skimOption).toInt());
+    options.skimRate = qBound(0.25f, parser.value(skimRateOption).toFloat(), VP_VLCPlayer::MaxSkimRate);
+    options.timeoutMs = qMax(100, parser.value(timeoutOption).toInt());
+    options.seed = parser.value(seedOption).toUInt();
+    options.loopCount = qMax(0, parser.value(loopsOption).toInt());
+    
+    // Statistics are needed for the drop rate, the profile's own arguments come after
+    QStringList vlcArguments = QStringList() << "--stats" << parser.values(vlcArgOption);
+    VP_VLCPlayer::setExtraArguments(vlcArguments);
+    
+    VP_VLCPlayer::IoMode ioMode;
+    if (!VP_VLCPlayer::ioModeFromName(parser.value(ioOption), &ioMode)) {
+        qWarning() << "mmsvp_bench: Unknown --io mode:" << parser.value(ioOption);
+        parser.showHelp(1);
+    }
+    VP_VLCPlayer::setIoMode(ioMode);
+    
+    MediaReader::Options ioOptions;
+    ioOptions.readAheadBlocks = parser.value(readAheadOption).toInt();
+    MediaReader::setOptions(ioOptions);
+    
+    VP_VLCPlayer::setNetworkCaching(parser.value(networkCachingOption).toInt());
+    ChunkCache::instance().setBudget(parser.value(streamCacheOption).toLongLong() * 1024 * 1024);
+    QRandomGenerator random(options.seed);
+    QJsonArray fileResults;
+    
+    for (const QString& file : files) {
+        qDebug() << "mmsvp_bench: Benchmarking" << file;
+        fileResults.append(benchmarkFile(file, options, random));
+    }
+    
+    QJsonObject root;
+    root["tool"] = QString("mmsvp_bench");
+    root["seed"] = static_cast<qint64>(options.seed);
+    root["vlcArguments"] = QJsonArray::fromStringList(vlcArguments);
+    root["io"] = VP_VLCPlayer::ioModeName(ioMode);
+    root["networkCachingMs"] = VP_VLCPlayer::networkCaching();
+    
+    ChunkCache::Counters cache = ChunkCache::instance().counters();
+    QJsonObject chunkCache;
+    chunkCache["hits"] = static_cast<qint64>(cache.hits);
+    chunkCache["misses"] = static_cast<qint64>(cache.misses);
+    chunkCache["bytes"] = cache.bytes;
+    chunkCache["budget"] = cache.budget;
+    root["chunkCache"] = chunkCache;
+    root["files"] = fileResults;
+    
+    QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    
+    QString outputPath = parser.value(outputOption);
+    if (outputPath.isEmpty()) {
+        QTextStream(stdout) << json;
+    } else {
+        QFile outputFile(outputPath);
+        if (!outputFile.open(QIODevice::WriteOnly)) {
+            qWarning() << "mmsvp_bench: Failed to open output file:" << outputPath;
+            return 1;
+        }
+        outputFile.write(json);
+    }
+    
+    return 0;
+}
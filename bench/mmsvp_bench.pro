@@ -0,0 +1,15 @@
+# Headless benchmark for VP_VLCPlayer
+# Runs without a window (VLC uses --vout=dummy) and writes results as JSON
+
+QT       += core gui widgets network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = mmsvp_bench
+
+SOURCES += \
+    mmsvp_bench.cpp
+
+# VP_VLCPlayer and what it reads through (pulls in libvlc.pri and zlib.pri)
+include(../vlcplayer.pri)
@@ -0,0 +1,327 @@
+#include <QtTest>
+#include <QFile>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QPixmap>
+#include <QTemporaryDir>
+#include <QDebug>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include "lightweightvideoplayer.h"
+#include "keybindmanager.h"
+#include "vp_simulatedplayer.h"
+#include "filefingerprint.h"
+#include "statestorage.h"
+
+namespace {
+
+// Exposes the protected hot paths of the player to the benchmarks
+class BenchPlayer : public LightweightVideoPlayer
+{
+public:
+    using LightweightVideoPlayer::LightweightVideoPlayer;
+    using LightweightVideoPlayer::formatTime;
+    using LightweightVideoPlayer::keyPressEvent;
+    using LightweightVideoPlayer::updatePosition;
+
+    void setLoopAll() { m_loopMode = LoopMode::LoopAll; }
+};
+
+// Realistic 100x75 state thumbnail
+QPixmap createThumbnail(int seed)
+{
+    QPixmap pixmap(100, 75);
+    pixmap.fill(QColor::fromHsv((seed * 29) % 360, 160, 200));
+    
+    QPainter painter(&pixmap);
+    for (int y = 0; y < 75; y += 5) {
+        painter.setPen(QColor::fromHsv((seed * 29 + y * 3) % 360, 200, 120 + y));
+        painter.drawLine(0, y, 100, 75 - y);
+    }
+    return pixmap;
+}
+
+void sendKey(BenchPlayer& player, Qt::Key key, Qt::KeyboardModifiers modifiers = Qt::NoModifier)
+{
+    QKeyEvent event(QEvent::KeyPress, key, modifiers);
+    player.keyPressEvent(&event);
+}
+
+} // namespace
+
+/**
+ * Micro-benchmarks for the player's state, keybind and formatting hot paths
+ *
+ * The player runs on VP_SimulatedPlayer and keeps its states, keybinds and
+ * indexes in a temporary directory, so no media or video output is needed and
+ * nothing is left next to the executable. Results are reported by QtTest
+ * (-o results.xml,xml, -o results.csv,csv, ...).
+ */
+class MicroBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    
+    // State group persistence
+    void saveStateGroup();
+    void loadStateGroupFromFile();
+    void stateGroupRoundTrip();
+    
+    // File identity: a cache hit is a stat, a miss hashes the sampled blocks
+    void fingerprintCached();
+    void fingerprintCompute();
+    
+    // State file lookup through the in-memory index
+    void groupFilePath();
+
+    // Keybind persistence
+    void saveKeybinds();
+    void loadKeybinds();
+    
+    void formatTime();
+    void keyPressUnboundKey();
+    void keyPressToggleLoadSpeed();
+    void checkLoopPointLoopAll();
+    
+    // Loop accuracy under LoopAll for a simulated hour, per seek latency and time granularity
+    void simulateLoopAll_data();
+    void simulateLoopAll();
+
+private:
+    std::unique_ptr<QTemporaryDir> m_dataDir;
+    QString m_mediaPath;
+    VP_VirtualClock m_clock;
+    VP_SimulatedPlayer* m_backend = nullptr;
+    std::unique_ptr<BenchPlayer> m_player;
+    std::unique_ptr<KeybindManager> m_keybinds;
+};
+
+void MicroBenchmarks::initTestCase()
+{
+    m_dataDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_dataDir->isValid());
+    
+    // Before anything loads an index or the keybinds
+    StateStorage::setRootPath(m_dataDir->filePath("savedstates"));
+    KeybindManager::setKeybindsFilePath(m_dataDir->filePath("keybinds.txt"));
+    
+    // The state and loop benchmarks need a current video, its content does not matter
+    m_mediaPath = m_dataDir->filePath("mmsvp_microbench_media.mp4");
+    QFile placeholder(m_mediaPath);
+    QVERIFY(placeholder.open(QIODevice::WriteOnly));
+    placeholder.write(QByteArray(4096, '\0'));
+    placeholder.close();
+    
+    // The clock only moves in simulateLoopAll()
+    auto backend = std::make_unique<VP_SimulatedPlayer>(&m_clock);
+    m_backend = backend.get();
+    m_backend->addMedia(m_mediaPath, 2 * 3600 * 1000);
+    
+    m_player = std::make_unique<BenchPlayer>(std::move(backend));
+    QVERIFY(m_player->loadVideo(m_mediaPath));
+    
+    // Twelve states with thumbnails and loop ends, as in a fully used group
+    for (int i = 0; i < 12; i++) {
+        LightweightVideoPlayer::PlaybackState state(i * 60000 + 1000, 1.0 + 0.1 * (i % 5));
+        state.endPosition = state.startPosition + 15000;
+        state.hasEndPosition = true;
+        state.previewImage = createThumbnail(i);
+        m_player->setPlaybackState(i, state);
+    }
+    
+    m_keybinds = std::make_unique<KeybindManager>();
+    m_keybinds->resetToDefaults();
+}
+
+void MicroBenchmarks::cleanupTestCase()
+{
+    m_player.reset();
+    m_keybinds.reset();
+    m_dataDir.reset();
+}
+
+void MicroBenchmarks::saveStateGroup()
+{
+    QBENCHMARK {
+        m_player->saveStateGroup(0);
+    }
+}
+
+void MicroBenchmarks::loadStateGroupFromFile()
+{
+    m_player->saveStateGroup(0);
+    
+    QBENCHMARK {
+        m_player->loadStateGroupFromFile(0);
+    }
+    
+    QVERIFY(m_player->getPlaybackState(11).isValid);
+}
+
+void MicroBenchmarks::stateGroupRoundTrip()
+{
+    QBENCHMARK {
+        m_player->saveStateGroup(0);
+        m_player->loadStateGroupFromFile(0);
+    }
+}
+
+void MicroBenchmarks::fingerprintCached()
+{
+    QBENCHMARK {
+        QByteArray fingerprint = FileFingerprint::instance().fingerprint(m_mediaPath);
+        Q_UNUSED(fingerprint)
+    }
+}
+
+void MicroBenchmarks::fingerprintCompute()
+{
+    QBENCHMARK {
+        QByteArray fingerprint = FileFingerprint::compute(m_mediaPath);
+        Q_UNUSED(fingerprint)
+    }
+}
+
+void MicroBenchmarks::groupFilePath()
+{
+    QBENCHMARK {
+        QString filePath = StateStorage::instance().groupFilePath(m_mediaPath, 0);
+        Q_UNUSED(filePath)
+    }
+}
+
+void MicroBenchmarks::saveKeybinds()
+{
+    QBENCHMARK {
+        m_keybinds->saveKeybinds();
+    }
+}
+
+void MicroBenchmarks::loadKeybinds()
+{
+    // initialize() parses the file written by saveKeybinds()
+    m_keybinds->saveKeybinds();
+    
+    QBENCHMARK {
+        m_keybinds->initialize();
+    }
+}
+
+void MicroBenchmarks::formatTime()
+{
+    // Covers both the mm:ss and hh:mm:ss branches
+    qint64 formatInput = 0;
+    QBENCHMARK {
+        QString text = m_player->formatTime(formatInput);
+        formatInput = (formatInput + 7919) % 10800000;
+        Q_UNUSED(text)
+    }
+}
+
+void MicroBenchmarks::keyPressUnboundKey()
+{
+    // An unbound key (F24 has no default binding) walks every action before falling through
+    QBENCHMARK {
+        sendKey(*m_player, Qt::Key_F24);
+    }
+}
+
+void MicroBenchmarks::keyPressToggleLoadSpeed()
+{
+    // A bound action near the end of the list (pressed twice per iteration to keep the flag unchanged)
+    QList<QKeySequence> toggleKeys = m_keybinds->getKeybinds(KeybindManager::Action::ToggleLoadSpeed);
+    if (toggleKeys.isEmpty()) {
+        QSKIP("ToggleLoadSpeed is unbound");
+    }
+    
+    QKeyCombination combination = toggleKeys.first()[0];
+    QBENCHMARK {
+        sendKey(*m_player, combination.key(), combination.keyboardModifiers());
+        sendKey(*m_player, combination.key(), combination.keyboardModifiers());
+    }
+}
+
+void MicroBenchmarks::checkLoopPointLoopAll()
+{
+    m_player->setLoopAll();
+    
+    QBENCHMARK {
+        m_player->updatePosition(m_player->position());
+    }
+}
+
+void MicroBenchmarks::simulateLoopAll_data()
+{
+    QTest::addColumn<int>("seekLatency");
+    QTest::addColumn<int>("timeUpdateInterval");
+    
+    QTest::newRow("latency80/update250") << 80 << 250;
+    QTest::newRow("latency30/update50") << 30 << 50;
+    QTest::newRow("latency250/update250") << 250 << 250;
+}
+
+void MicroBenchmarks::simulateLoopAll()
+{
+    QFETCH(int, seekLatency);
+    QFETCH(int, timeUpdateInterval);
+    
+    VP_SimulatedPlayer::SimulationSettings settings = m_backend->simulationSettings();
+    settings.seekLatency = seekLatency;
+    settings.timeUpdateInterval = timeUpdateInterval;
+    m_backend->setSimulationSettings(settings);
+    
+    m_player->setLoopAll();
+    m_backend->clearSeekHistory();
+    
+    // Wall time of an hour of playback, slider and label updates interleaved as in real playback
+    const qint64 virtualMs = 3600 * 1000;
+    QBENCHMARK_ONCE {
+        m_player->play();
+        for (qint64 elapsed = 0; elapsed < virtualMs; elapsed += 1000) {
+            m_clock.advance(1000);
+        }
+        m_player->pause();
+    }
+    
+    // Each seek leaves one state; its overshoot is the exact media time past that state's end
+    const QVector<VP_SimulatedPlayer::SeekRecord>& seeks = m_backend->seekHistory();
+    std::vector<qint64> overshoots;
+    int supersededSeeks = 0;
+    
+    for (int i = 0; i < seeks.size(); i++) {
+        const VP_SimulatedPlayer::SeekRecord& seek = seeks[i];
+        
+        // A seek issued while the previous one was still pending is a wasted transition
+        if (i > 0 && seek.clockTime - seeks[i - 1].clockTime < settings.seekLatency) {
+            supersededSeeks++;
+        }
+        
+        for (int stateIndex = 0; stateIndex < 12; stateIndex++) {
+            const LightweightVideoPlayer::PlaybackState& state = m_player->getPlaybackState(stateIndex);
+            if (state.isValid && state.hasEndPosition &&
+                seek.fromPosition >= state.startPosition && seek.fromPosition < state.endPosition + 5000) {
+                overshoots.push_back(seek.fromPosition - state.endPosition);
+                break;
+            }
+        }
+    }
+    
+    QVERIFY(!seeks.isEmpty());
+    QVERIFY(!overshoots.empty());
+    
+    std::sort(overshoots.begin(), overshoots.end());
+    qint64 sum = 0;
+    for (qint64 overshoot : overshoots) {
+        sum += overshoot;
+    }
+    
+    qDebug() << "mmsvp_microbench:" << seeks.size() << "seeks," << supersededSeeks << "superseded, overshoot"
+             << overshoots.front() << "-" << overshoots.back() << "ms, mean" << sum / static_cast<qint64>(overshoots.size()) << "ms";
+}
+
+QTEST_MAIN(MicroBenchmarks)
+#include "mmsvp_microbench.moc"
@@ -0,0 +1,17 @@
+# Micro-benchmarks for the player's state, keybind and formatting hot paths
+# A QtTest target of QBENCHMARK cases, results are written with QtTest's -o option
+# The player runs on VP_SimulatedPlayer, so no media or video output is needed
+
+QT       += core gui widgets network testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = mmsvp_microbench
+
+SOURCES += \
+    mmsvp_microbench.cpp
+
+# The player on the simulated backend; it still links VP_VLCPlayer, its default backend
+include(../player.pri)
+include(../simulatedplayer.pri)
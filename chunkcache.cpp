@@ -0,0 +1,286 @@
+#include "chunkcache.h"
+#include "perftracer.h"
+#include "statestorage.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#endif
+
+namespace {
+
+const qint64 DefaultBudget = 2LL * 1024 * 1024 * 1024;
+
+// New data files are sparse, chunks that were never fetched take no space
+void makeSparse(QFile& file)
+{
+#ifdef _WIN32
+    DWORD bytesReturned = 0;
+    DeviceIoControl(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle())), FSCTL_SET_SPARSE,
+                    nullptr, 0, nullptr, 0, &bytesReturned, nullptr);
+#else
+    Q_UNUSED(file);  // Unwritten ranges of a resized file are holes already
+#endif
+}
+
+// Give the space of an evicted chunk back to the file system, where it can
+bool punchHole(QFile& file, qint64 offset, qint64 length)
+{
+#ifdef _WIN32
+    FILE_ZERO_DATA_INFORMATION range;
+    range.FileOffset.QuadPart = offset;
+    range.BeyondFinalZero.QuadPart = offset + length;
+    DWORD bytesReturned = 0;
+    return DeviceIoControl(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle())), FSCTL_SET_ZERO_DATA,
+                           &range, sizeof(range), nullptr, 0, &bytesReturned, nullptr);
+#elif defined(FALLOC_FL_PUNCH_HOLE)
+    return fallocate(file.handle(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0;
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+    return false;
+#endif
+}
+
+} // namespace
+
+ChunkCache& ChunkCache::instance()
+{
+    static ChunkCache cache;
+    return cache;
+}
+
+ChunkCache::ChunkCache()
+    : m_loaded(false)
+    , m_budget(DefaultBudget)
+{
+}
+
+void ChunkCache::setBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_budget = qMax<qint64>(0, bytes);
+    
+    if (m_loaded) {
+        evictOverBudget(ChunkKey());
+    }
+}
+
+qint64 ChunkCache::budget()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_budget;
+}
+
+QByteArray ChunkCache::resourceKey(const QString& url, const QByteArray& validator, qint64 totalSize)
+{
+    QByteArray identity = url.toUtf8() + '\n' + validator + '\n' + QByteArray::number(totalSize);
+    return QCryptographicHash::hash(identity, QCryptographicHash::Sha1).toHex();
+}
+
+QString ChunkCache::dataPath(const QByteArray& resourceKey) const
+{
+    return m_directory + "/" + QString::fromLatin1(resourceKey) + ".chunks";
+}
+
+qint64 ChunkCache::chunkLength(qint64 totalSize, qint64 index)
+{
+    return qBound<qint64>(0, totalSize - index * ChunkSize, ChunkSize);
+}
+
+void ChunkCache::touch(const ChunkKey& key)
+{
+    auto it = m_lruPositions.find(key);
+    if (it != m_lruPositions.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it.value());
+    } else {
+        m_lru.push_front(key);
+        m_lruPositions.insert(key, m_lru.begin());
+    }
+}
+
+bool ChunkCache::read(const QByteArray& resourceKey, qint64 index, QByteArray& data)
+{
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    
+    auto resource = m_resources.constFind(resourceKey);
+    if (resource == m_resources.constEnd() || !resource->chunks.contains(index)) {
+        m_counters.misses++;
+        return false;
+    }
+    
+    // Under the lock, an eviction must not punch a hole into a chunk being read
+    QFile file(dataPath(resourceKey));
+    qint64 length = chunkLength(resource->totalSize, index);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(index * ChunkSize) ||
+        (data = file.read(length)).size() != length) {
+        qDebug() << "ChunkCache: Failed to read chunk" << index << "of" << resourceKey;
+        m_counters.misses++;
+        return false;
+    }
+    
+    m_counters.hits++;
+    touch(qMakePair(resourceKey, index));
+    return true;
+}
+
+void ChunkCache::store(const QByteArray& resourceKey, qint64 totalSize, qint64 index, const QByteArray& data)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_budget <= 0 || data.size() != chunkLength(totalSize, index)) {
+        return;
+    }
+    
+    ensureLoaded();
+    
+    Resource& resource = m_resources[resourceKey];
+    if (resource.chunks.contains(index)) {
+        return;
+    }
+    
+    QFile file(dataPath(resourceKey));
+    bool created = !file.exists();
+    if (!file.open(QIODevice::ReadWrite)) {
+        qDebug() << "ChunkCache: Failed to open" << file.fileName() << ":" << file.errorString();
+        return;
+    }
+    
+    if (created) {
+        makeSparse(file);
+        file.resize(totalSize);
+    }
+    resource.totalSize = totalSize;
+    
+    if (!file.seek(index * ChunkSize) || file.write(data) != data.size()) {
+        qDebug() << "ChunkCache: Failed to write chunk" << index << "of" << resourceKey << ":" << file.errorString();
+        return;
+    }
+    
+    file.close();
+    
+    resource.chunks.insert(index);
+    m_counters.bytes += data.size();
+    touch(qMakePair(resourceKey, index));
+    appendToIndex(QStringList() << "C" << QString::fromLatin1(resourceKey) << QString::number(totalSize)
+                                << QString::number(index));
+    
+    evictOverBudget(qMakePair(resourceKey, index));
+}
+
+void ChunkCache::evictOverBudget(const ChunkKey& keep)
+{
+    while (m_counters.bytes > m_budget && !m_lru.empty() && m_lru.back() != keep) {
+        ChunkKey key = m_lru.back();
+        m_lru.pop_back();
+        m_lruPositions.remove(key);
+        
+        auto resource = m_resources.find(key.first);
+        if (resource == m_resources.end()) {
+            continue;
+        }
+        
+        resource->chunks.remove(key.second);
+        m_counters.bytes -= chunkLength(resource->totalSize, key.second);
+        appendToIndex(QStringList() << "E" << QString::fromLatin1(key.first) << QString::number(key.second));
+        
+        // The last chunk of a resource takes its file along
+        if (resource->chunks.isEmpty()) {
+            QFile::remove(dataPath(key.first));
+            m_resources.erase(resource);
+            continue;
+        }
+        
+        QFile file(dataPath(key.first));
+        if (file.open(QIODevice::ReadWrite)) {
+            punchHole(file, key.second * ChunkSize, chunkLength(resource->totalSize, key.second));
+        }
+    }
+}
+
+ChunkCache::Counters ChunkCache::counters()
+{
+    QMutexLocker locker(&m_mutex);
+    Counters counters = m_counters;
+    counters.budget = m_budget;
+    return counters;
+}
+
+void ChunkCache::ensureLoaded()
+{
+    if (m_loaded) {
+        return;
+    }
+    
+    m_loaded = true;
+    m_directory = StateStorage::rootPath() + "/streamcache";
+    QDir().mkpath(m_directory);
+    
+    PERF_TRACE_SCOPE("chunkCacheLoad");
+    
+    // Records: C, key, size, index (stored) or E, key, index (evicted), oldest first
+    m_index.load(m_directory + "/chunks.idx", 4, [this](const QStringList& parts) {
+        if (parts.size() == 4 && parts[0] == "C") {
+            QByteArray resourceKey = parts[1].toLatin1();
+            Resource& resource = m_resources[resourceKey];
+            resource.totalSize = parts[2].toLongLong();
+            resource.chunks.insert(parts[3].toLongLong());
+            touch(qMakePair(resourceKey, parts[3].toLongLong()));
+        } else if (parts.size() == 3 && parts[0] == "E") {
+            ChunkKey key = qMakePair(parts[1].toLatin1(), parts[2].toLongLong());
+            auto position = m_lruPositions.find(key);
+            if (position != m_lruPositions.end()) {
+                m_lru.erase(position.value());
+                m_lruPositions.erase(position);
+            }
+            m_resources[key.first].chunks.remove(key.second);
+        }
+    });
+    
+    // Data files deleted behind the cache's back take their chunks along
+    for (auto it = m_resources.begin(); it != m_resources.end(); ) {
+        if (it->chunks.isEmpty() || !QFile::exists(dataPath(it.key()))) {
+            for (qint64 index : std::as_const(it->chunks)) {
+                auto position = m_lruPositions.find(qMakePair(it.key(), index));
+                if (position != m_lruPositions.end()) {
+                    m_lru.erase(position.value());
+                    m_lruPositions.erase(position);
+                }
+            }
+            it = m_resources.erase(it);
+            continue;
+        }
+        
+        for (qint64 index : std::as_const(it->chunks)) {
+            m_counters.bytes += chunkLength(it->totalSize, index);
+        }
+        ++it;
+    }
+    
+    qDebug() << "ChunkCache: Loaded" << m_lru.size() << "chunks of" << m_resources.size() << "resources,"
+             << m_counters.bytes / (1024 * 1024) << "MiB";
+    
+    evictOverBudget(ChunkKey());
+}
+
+void ChunkCache::appendToIndex(const QStringList& record)
+{
+    m_index.append(record, static_cast<int>(m_lru.size()), [this]() {
+        // Least recently used first, so reloading the log restores the order
+        QList<QStringList> records;
+        for (auto it = m_lru.rbegin(); it != m_lru.rend(); ++it) {
+            records << (QStringList() << "C" << QString::fromLatin1(it->first)
+                                      << QString::number(m_resources.value(it->first).totalSize)
+                                      << QString::number(it->second));
+        }
+        return records;
+    });
+}
@@ -0,0 +1,82 @@
+#ifndef CHUNKCACHE_H
+#define CHUNKCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QMutex>
+#include <list>
+#include "appendlog.h"
+
+/**
+ * @class ChunkCache
+ * @brief Disk cache of fixed-size chunks of remote media
+ *
+ * Chunks are keyed by resource (URL, validator such as the ETag, and size)
+ * and chunk index. Each resource is one sparse file in
+ * savedstates/streamcache/ holding its chunks at their own offsets, so a
+ * cached chunk is read back with a single positioned read. Chunks over the
+ * byte budget are evicted least recently used first; where the file system
+ * supports it, their space is released by punching a hole into the file.
+ *
+ * Which chunks exist is logged to savedstates/streamcache/chunks.idx, so the
+ * cache survives restarts. All functions are thread-safe.
+ */
+class ChunkCache
+{
+public:
+    static constexpr qint64 ChunkSize = 1024 * 1024;
+    
+    struct Counters {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        qint64 bytes = 0;  // Cached chunk bytes
+        qint64 budget = 0;
+    };
+    
+    static ChunkCache& instance();
+    
+    // Bytes all chunks may take, 0 disables the cache (default 2 GiB)
+    void setBudget(qint64 bytes);
+    qint64 budget();
+    
+    // Key of a remote resource, changes when the server's validator or the size does
+    static QByteArray resourceKey(const QString& url, const QByteArray& validator, qint64 totalSize);
+    
+    // Chunk index of a resource, counted as a hit or a miss
+    bool read(const QByteArray& resourceKey, qint64 index, QByteArray& data);
+    void store(const QByteArray& resourceKey, qint64 totalSize, qint64 index, const QByteArray& data);
+    
+    Counters counters();
+
+private:
+    ChunkCache();
+    
+    typedef QPair<QByteArray, qint64> ChunkKey;  // Resource key, chunk index
+    
+    struct Resource {
+        qint64 totalSize = 0;
+        QSet<qint64> chunks;
+    };
+    
+    void ensureLoaded();
+    QString dataPath(const QByteArray& resourceKey) const;
+    static qint64 chunkLength(qint64 totalSize, qint64 index);
+    void touch(const ChunkKey& key);
+    void evictOverBudget(const ChunkKey& keep);
+    void appendToIndex(const QStringList& record);
+    
+    QMutex m_mutex;
+    bool m_loaded;
+    QString m_directory;
+    AppendLog m_index;
+    qint64 m_budget;
+    Counters m_counters;
+    QHash<QByteArray, Resource> m_resources;
+    std::list<ChunkKey> m_lru;  // Most recently used first
+    QHash<ChunkKey, std::list<ChunkKey>::iterator> m_lruPositions;
+};
+
+#endif // CHUNKCACHE_H
@@ -0,0 +1,213 @@
+#include "filefingerprint.h"
+#include "perftracer.h"
+#include "archivereader.h"
+#include "statestorage.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <QDebug>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Head and tail hold the container headers and index, interior chunks tell re-encodes apart
+const qint64 EdgeSampleSize = 64 * 1024;
+const qint64 InteriorSampleSize = 16 * 1024;
+const int InteriorSamples = 3;
+
+} // namespace
+
+FileFingerprint& FileFingerprint::instance()
+{
+    static FileFingerprint fingerprint;
+    return fingerprint;
+}
+
+FileFingerprint::FileFingerprint()
+    : m_loaded(false)
+{
+}
+
+QByteArray FileFingerprint::compute(const QString& filePath)
+{
+    return computeRange(filePath, 0, QFileInfo(filePath).size());
+}
+
+QByteArray FileFingerprint::computeRange(const QString& filePath, qint64 offset, qint64 size)
+{
+    PERF_TRACE_SCOPE("fingerprintCompute");
+    
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "FileFingerprint: Failed to open" << filePath << ":" << file.errorString();
+        return QByteArray();
+    }
+    
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    
+    auto addSample = [&file, &hash, offset](qint64 sampleOffset, qint64 length) {
+        if (file.seek(offset + sampleOffset)) {
+            hash.addData(file.read(length));
+        }
+    };
+    
+    if (size <= 2 * EdgeSampleSize + InteriorSamples * InteriorSampleSize) {
+        // Small file, the samples would cover it anyway
+        addSample(0, size);
+    } else {
+        addSample(0, EdgeSampleSize);
+        
+        for (int i = 1; i <= InteriorSamples; i++) {
+            addSample(size * i / (InteriorSamples + 1), InteriorSampleSize);
+        }
+        
+        addSample(size - EdgeSampleSize, EdgeSampleSize);
+    }
+    
+    QByteArray fingerprint(8, '\0');
+    qToLittleEndian<qint64>(size, fingerprint.data());
+    fingerprint += hash.result().left(8);
+    return fingerprint;
+}
+
+quint64 FileFingerprint::fileId(const QString& filePath)
+{
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(filePath).utf16()), 0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    
+    quint64 id = 0;
+    BY_HANDLE_FILE_INFORMATION info;
+    if (GetFileInformationByHandle(handle, &info)) {
+        id = (static_cast<quint64>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    }
+    
+    CloseHandle(handle);
+    return id;
+#else
+    struct stat st;
+    if (::stat(QFile::encodeName(filePath).constData(), &st) != 0) {
+        return 0;
+    }
+    
+    return static_cast<quint64>(st.st_ino);
+#endif
+}
+
+QByteArray FileFingerprint::fingerprint(const QString& filePath)
+{
+    // An archive entry is cached by the archive file's size, time and inode
+    QString archivePath;
+    QString entryName;
+    bool isArchiveEntry = ArchiveReader::splitPath(filePath, &archivePath, &entryName);
+    
+    QFileInfo fileInfo(isArchiveEntry ? archivePath : filePath);
+    if (!fileInfo.exists()) {
+        return QByteArray();
+    }
+    
+    const QString absolutePath = isArchiveEntry ? fileInfo.absoluteFilePath() + "!/" + entryName
+                                                : fileInfo.absoluteFilePath();
+    
+    CacheEntry current;
+    current.size = fileInfo.size();
+    current.modifiedMs = fileInfo.lastModified().toMSecsSinceEpoch();
+    current.fileId = fileId(fileInfo.absoluteFilePath());
+    
+    {
+        QMutexLocker locker(&m_mutex);
+        ensureLoaded();
+        
+        auto it = m_entries.constFind(absolutePath);
+        if (it != m_entries.constEnd() && it->size == current.size &&
+            it->modifiedMs == current.modifiedMs && it->fileId == current.fileId) {
+            return it->fingerprint;
+        }
+    }
+    
+    // Hash outside the lock, another thread may fingerprint a different file meanwhile
+    current.fingerprint = isArchiveEntry ? ArchiveReader::entryFingerprint(absolutePath) : compute(absolutePath);
+    if (current.fingerprint.isEmpty()) {
+        return QByteArray();
+    }
+    
+    QMutexLocker locker(&m_mutex);
+    
+    // A known fingerprint at a path that is gone is a renamed or moved file
+    QString previousPath = m_paths.value(current.fingerprint);
+    if (!previousPath.isEmpty() && previousPath != absolutePath && !ArchiveReader::exists(previousPath)) {
+        qDebug() << "FileFingerprint: Detected rename:" << previousPath << "->" << absolutePath;
+        m_entries.remove(previousPath);
+    }
+    
+    m_entries.insert(absolutePath, current);
+    m_paths.insert(current.fingerprint, absolutePath);
+    m_index.append(encodeRecord(absolutePath, current), static_cast<int>(m_entries.size()), [this]() {
+        QList<QStringList> records;
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+            records << encodeRecord(it.key(), it.value());
+        }
+        return records;
+    });
+    
+    return current.fingerprint;
+}
+
+QString FileFingerprint::lastKnownPath(const QByteArray& fingerprint)
+{
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    return m_paths.value(fingerprint);
+}
+
+void FileFingerprint::ensureLoaded()
+{
+    if (m_loaded) {
+        return;
+    }
+    
+    m_loaded = true;
+    
+    PERF_TRACE_SCOPE("fingerprintIndexLoad");
+    
+    // Record: fingerprint, size, mtime, inode, path (later records replace earlier ones)
+    m_index.load(StateStorage::rootPath() + "/fingerprints.idx", 5, [this](const QStringList& parts) {
+        if (parts.size() < 5) {
+            return;
+        }
+        
+        CacheEntry entry;
+        entry.fingerprint = QByteArray::fromHex(parts[0].toLatin1());
+        entry.size = parts[1].toLongLong();
+        entry.modifiedMs = parts[2].toLongLong();
+        entry.fileId = parts[3].toULongLong();
+        
+        const QString& path = parts[4];
+        if (entry.fingerprint.size() != 16 || path.isEmpty()) {
+            return;
+        }
+        
+        m_entries.insert(path, entry);
+        m_paths.insert(entry.fingerprint, path);
+    });
+    
+    qDebug() << "FileFingerprint: Loaded" << m_entries.size() << "cached fingerprints";
+}
+
+QStringList FileFingerprint::encodeRecord(const QString& filePath, const CacheEntry& entry)
+{
+    return QStringList() << QString::fromLatin1(entry.fingerprint.toHex()) << QString::number(entry.size)
+                         << QString::number(entry.modifiedMs) << QString::number(entry.fileId) << filePath;
+}
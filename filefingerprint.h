@@ -0,0 +1,62 @@
+#ifndef FILEFINGERPRINT_H
+#define FILEFINGERPRINT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include "appendlog.h"
+
+/**
+ * @class FileFingerprint
+ * @brief Identifies video files by content so saved data follows a file across folders and renames
+ *
+ * A fingerprint is the file size plus a hash of a few sampled blocks (head,
+ * tail and three interior chunks), so even multi-GB files cost five small
+ * reads. Results are cached by path, modification time and inode in
+ * savedstates/fingerprints.idx, reopening a known file does not read it at all.
+ * Archive entries ("archive.zip!/video.mp4") are fingerprinted by their content
+ * and cached by the archive's modification time and inode.
+ * All functions are thread-safe.
+ */
+class FileFingerprint
+{
+public:
+    static FileFingerprint& instance();
+    
+    // 16 bytes (8 bytes size, 8 bytes sampled-block hash), empty if the file can not be read
+    QByteArray fingerprint(const QString& filePath);
+    
+    // Path the fingerprint was last seen at (empty if unknown)
+    QString lastKnownPath(const QByteArray& fingerprint);
+    
+    // Uncached computation
+    static QByteArray compute(const QString& filePath);
+    
+    // Same, over the bytes [offset, offset + size) of a file (a stored archive entry)
+    static QByteArray computeRange(const QString& filePath, qint64 offset, qint64 size);
+    
+    // Inode (file index on Windows), 0 if unavailable
+    static quint64 fileId(const QString& filePath);
+
+private:
+    FileFingerprint();
+    
+    struct CacheEntry {
+        QByteArray fingerprint;
+        qint64 size = 0;
+        qint64 modifiedMs = 0;
+        quint64 fileId = 0;
+    };
+    
+    void ensureLoaded();
+    static QStringList encodeRecord(const QString& filePath, const CacheEntry& entry);
+    
+    QMutex m_mutex;
+    bool m_loaded;
+    AppendLog m_index;
+    QHash<QString, CacheEntry> m_entries;  // Absolute path -> entry
+    QHash<QByteArray, QString> m_paths;  // Fingerprint -> last known path
+};
+
+#endif // FILEFINGERPRINT_H
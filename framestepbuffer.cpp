@@ -0,0 +1,321 @@
+#include "framestepbuffer.h"
+#include "perftracer.h"
+#include <vlc/vlc.h>
+#include <QSemaphore>
+#include <QThread>
+#include <QDebug>
+#include <cmath>
+#include <deque>
+
+namespace {
+
+const int DefaultBudgetMegabytes = 256;
+const qint64 FillSpanMs = 2000;  // About a GOP of most files
+const int FirstFrameWaitMs = 500;
+const int FrameTimeoutMs = 2000;
+
+// Frames from vmem, each decoded into an image of its own
+struct FrameCapture {
+    QSize size;
+    QMutex mutex;
+    QImage decoding;
+    std::deque<QImage> decoded;
+    QSemaphore ready;
+};
+
+void* lockFrame(void* opaque, void** planes)
+{
+    FrameCapture* capture = static_cast<FrameCapture*>(opaque);
+    QMutexLocker locker(&capture->mutex);
+    capture->decoding = QImage(capture->size, QImage::Format_RGB32);
+    planes[0] = capture->decoding.bits();
+    return nullptr;
+}
+
+void displayFrame(void* opaque, void*)
+{
+    FrameCapture* capture = static_cast<FrameCapture*>(opaque);
+    QMutexLocker locker(&capture->mutex);
+    capture->decoded.push_back(capture->decoding);
+    capture->decoding = QImage();
+    capture->ready.release();
+}
+
+// Hidden player of media (released) opened paused at from, frames go to capture;
+// nullptr if it could not be started
+libvlc_media_player_t* startPaused(libvlc_media_t* media, qint64 from, FrameCapture* capture)
+{
+    libvlc_media_add_option(media, QString(":start-time=%1").arg(from / 1000.0, 0, 'f', 3).toUtf8().constData());
+    libvlc_media_add_option(media, ":start-paused");
+    libvlc_media_add_option(media, ":no-audio");
+    
+    libvlc_media_player_t* player = libvlc_media_player_new_from_media(media);
+    libvlc_media_release(media);
+    if (!player) {
+        return nullptr;
+    }
+    
+    // RV32 is BGRA in memory, the layout of QImage::Format_RGB32
+    QSize size = capture->size;
+    libvlc_video_set_callbacks(player, lockFrame, nullptr, displayFrame, capture);
+    libvlc_video_set_format(player, "RV32", size.width(), size.height(), size.width() * 4);
+    
+    if (libvlc_media_player_play(player) != 0) {
+        libvlc_media_player_release(player);
+        return nullptr;
+    }
+    return player;
+}
+
+// Started paused, the first frame is shown by some demuxers only; a step brings it otherwise
+bool waitForFirstFrame(libvlc_media_player_t* player, FrameCapture* capture)
+{
+    if (capture->ready.tryAcquire(1, FirstFrameWaitMs)) {
+        return true;
+    }
+    libvlc_media_player_next_frame(player);
+    return capture->ready.tryAcquire(1, FrameTimeoutMs);
+}
+
+QImage takeFrame(FrameCapture* capture)
+{
+    QMutexLocker locker(&capture->mutex);
+    QImage frame = capture->decoded.front();
+    capture->decoded.pop_front();
+    return frame;
+}
+
+// Stopping joins the video output, no callback touches the capture after this
+void stopPlayer(libvlc_media_player_t* player)
+{
+    libvlc_media_player_stop(player);
+    libvlc_media_player_release(player);
+}
+
+} // namespace
+
+QImage FrameStepBuffer::decodeFrame(libvlc_media_t* media, qint64 time, const QSize& size)
+{
+    PERF_TRACE_SCOPE("decodeFrame");
+    
+    FrameCapture capture;
+    capture.size = size;
+    
+    libvlc_media_player_t* player = startPaused(media, time, &capture);
+    if (!player) {
+        return QImage();
+    }
+    
+    QImage frame;
+    if (waitForFirstFrame(player, &capture)) {
+        frame = takeFrame(&capture);
+    }
+    stopPlayer(player);
+    return frame;
+}
+
+int FrameStepBuffer::s_budgetMegabytes = DefaultBudgetMegabytes;
+
+void FrameStepBuffer::setBudget(int megabytes)
+{
+    s_budgetMegabytes = qMax(16, megabytes);
+}
+
+int FrameStepBuffer::budget()
+{
+    return s_budgetMegabytes;
+}
+
+FrameStepBuffer::FrameStepBuffer(double frameIntervalMs, const QSize& frameSize)
+    : m_frameIntervalMs(frameIntervalMs)
+    , m_frameSize(frameSize)
+    , m_fillFrames(1)
+    , m_shared(std::make_shared<Shared>())
+{
+    m_shared->frameIntervalMs = frameIntervalMs;
+    m_shared->frameSize = frameSize;
+    m_shared->frameBytes = static_cast<qint64>(frameSize.width()) * frameSize.height() * 4;
+    m_shared->budget = s_budgetMegabytes * 1024LL * 1024;
+    
+    int budgetFrames = static_cast<int>(qMax<qint64>(2, m_shared->budget / qMax<qint64>(1, m_shared->frameBytes)));
+    m_fillFrames = qBound(1, static_cast<int>(std::ceil(FillSpanMs / m_frameIntervalMs)), budgetFrames / 2);
+    
+    qDebug() << "FrameStepBuffer: Buffering" << budgetFrames << "frames of" << m_frameSize << ","
+             << m_fillFrames << "per fill";
+}
+
+FrameStepBuffer::~FrameStepBuffer()
+{
+    // Not joined: a frame can take seconds and this runs on the GUI thread when the
+    // file changes. The decoder sees the flag after its current frame and finishes,
+    // its owner waits for it before libvlc goes
+    QMutexLocker locker(&m_shared->mutex);
+    m_shared->cancelled = true;
+    
+    if (m_shared->pending.media) {
+        libvlc_media_release(m_shared->pending.media);
+    }
+    m_shared->pending = Request();
+    m_shared->frames.clear();
+    m_shared->bytes = 0;
+}
+
+QImage FrameStepBuffer::frameAt(qint64 time, qint64* frameTime)
+{
+    QMutexLocker locker(&m_shared->mutex);
+    m_shared->focus = time;
+    
+    const std::map<qint64, QImage>& frames = m_shared->frames;
+    qint64 tolerance = static_cast<qint64>(m_frameIntervalMs / 2);
+    auto it = frames.lower_bound(time - tolerance);
+    if (it != frames.end() && it->first <= time + tolerance) {
+        if (frameTime) {
+            *frameTime = it->first;
+        }
+        return it->second;
+    }
+    return QImage();
+}
+
+qint64 FrameStepBuffer::bufferedFrom(qint64 time)
+{
+    QMutexLocker locker(&m_shared->mutex);
+    
+    const std::map<qint64, QImage>& frames = m_shared->frames;
+    qint64 tolerance = static_cast<qint64>(m_frameIntervalMs / 2);
+    auto it = frames.lower_bound(time - tolerance);
+    if (it == frames.end() || it->first > time + tolerance) {
+        return -1;
+    }
+    
+    // Back through the frames while none is missing in between
+    while (it != frames.begin()) {
+        auto previous = std::prev(it);
+        if (it->first - previous->first > m_frameIntervalMs * 1.5) {
+            break;
+        }
+        it = previous;
+    }
+    return it->first;
+}
+
+QThread* FrameStepBuffer::fill(const std::function<libvlc_media_t*()>& createMedia, qint64 from, qint64 to)
+{
+    QMutexLocker locker(&m_shared->mutex);
+    m_shared->focus = to;
+    
+    const Request& current = m_shared->running;
+    Request& pending = m_shared->pending;
+    bool running = current.to >= 0 && from >= current.from && to <= current.to;
+    bool queued = pending.to >= 0 && from >= pending.from && to <= pending.to;
+    if (running || queued) {
+        return nullptr;
+    }
+    
+    libvlc_media_t* media = createMedia();
+    if (!media) {
+        return nullptr;
+    }
+    
+    // Only the newest request matters, the user has moved on from older ones
+    if (pending.media) {
+        libvlc_media_release(pending.media);
+    }
+    pending.media = media;
+    pending.from = from;
+    pending.to = to;
+    
+    // A running decoder takes it next
+    if (m_shared->decoding) {
+        return nullptr;
+    }
+    m_shared->decoding = true;
+    
+    std::shared_ptr<Shared> shared = m_shared;
+    QThread* decoder = QThread::create([shared]() {
+        decodeLoop(shared);
+    });
+    decoder->setObjectName("frameStepDecoder");
+    QObject::connect(decoder, &QThread::finished, decoder, &QObject::deleteLater);
+    decoder->start();
+    return decoder;
+}
+
+void FrameStepBuffer::decodeLoop(const std::shared_ptr<Shared>& shared)
+{
+    for (;;) {
+        Request request;
+        {
+            QMutexLocker locker(&shared->mutex);
+            if (shared->cancelled || shared->pending.to < 0) {
+                shared->running = Request();
+                shared->decoding = false;
+                return;
+            }
+            
+            request = shared->pending;
+            shared->pending = Request();
+            shared->running = request;
+        }
+        
+        decode(shared.get(), request);
+    }
+}
+
+void FrameStepBuffer::decode(Shared* shared, const Request& request)
+{
+    PERF_TRACE_SCOPE("frameStepDecode");
+    
+    FrameCapture capture;
+    capture.size = shared->frameSize;
+    
+    libvlc_media_player_t* player = startPaused(request.media, request.from, &capture);
+    if (!player) {
+        return;
+    }
+    
+    // One frame per step, as fast as the decoder goes
+    const double frameMs = shared->frameIntervalMs;
+    int count = 0;
+    bool shown = waitForFirstFrame(player, &capture);
+    while (shown && !shared->cancelled) {
+        qint64 time = request.from + static_cast<qint64>(std::llround(count * frameMs));
+        store(shared, time, takeFrame(&capture));
+        count++;
+        
+        if (time + frameMs > request.to + frameMs / 2) {
+            break;
+        }
+        
+        libvlc_media_player_next_frame(player);
+        shown = capture.ready.tryAcquire(1, FrameTimeoutMs);  // Not at the end of the media
+    }
+    
+    stopPlayer(player);
+    
+    qDebug() << "FrameStepBuffer: Decoded" << count << "frames from" << request.from << "ms";
+}
+
+void FrameStepBuffer::store(Shared* shared, qint64 time, const QImage& frame)
+{
+    QMutexLocker locker(&shared->mutex);
+    
+    // The buffer is gone, nobody looks at the frame
+    if (shared->cancelled) {
+        return;
+    }
+    
+    std::map<qint64, QImage>& frames = shared->frames;
+    auto inserted = frames.insert_or_assign(time, frame);
+    if (inserted.second) {
+        shared->bytes += shared->frameBytes;
+    }
+    
+    // Over the budget, the frames farthest from where the user is go first
+    while (shared->bytes > shared->budget && frames.size() > 1) {
+        auto first = frames.begin();
+        auto last = std::prev(frames.end());
+        frames.erase(shared->focus - first->first > last->first - shared->focus ? first : last);
+        shared->bytes -= shared->frameBytes;
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef FRAMESTEPBUFFER_H
+#define FRAMESTEPBUFFER_H
+
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+
+struct libvlc_media_t;
+class QThread;
+
+/**
+ * @class FrameStepBuffer
+ * @brief Bounded buffer of decoded frames before the paused position, for stepping back
+ *
+ * Stepping back one frame in a long-GOP file means seeking to the previous
+ * keyframe and decoding forward, hundreds of ms for every press. Instead, a
+ * decoder thread plays a span before the position on a hidden libvlc player
+ * with video callbacks, paused and advanced one frame at a time, and keeps the
+ * frames at display size. Steps within the buffer are instant; the span before
+ * it is decoded in the background while the user steps through it.
+ *
+ * Frames are kept up to a memory budget; the ones farthest from the last
+ * requested time are dropped first.
+ *
+ * As with StateFrameCache, the decoder thread shares the buffer's state and is
+ * not joined: destroying the buffer only cancels it, and fill() hands the
+ * thread to the caller, who waits for it before releasing the libvlc instance.
+ */
+class FrameStepBuffer
+{
+public:
+    // Memory all buffered frames may take, for buffers created afterwards (default 256)
+    static void setBudget(int megabytes);
+    static int budget();
+    
+    // The frame at time on a hidden player of media (taken over), blocking; null if
+    // none is shown in time
+    static QImage decodeFrame(libvlc_media_t* media, qint64 time, const QSize& size);
+    
+    FrameStepBuffer(double frameIntervalMs, const QSize& frameSize);
+    ~FrameStepBuffer();
+    
+    QSize frameSize() const { return m_frameSize; }
+    
+    // Frames one fill decodes, about a GOP and at most half the budget
+    int fillFrames() const { return m_fillFrames; }
+    
+    // Buffered frame within half a frame of time and its own time, null if there is none
+    QImage frameAt(qint64 time, qint64* frameTime = nullptr);
+    
+    // Earliest time of the unbroken run of frames that reaches back from time, -1 if
+    // time itself is not buffered
+    qint64 bufferedFrom(qint64 time);
+    
+    // Decode the frames of [from, to] in the background from a media made by createMedia;
+    // a range already running or queued is not requested again (nor a media created).
+    // Returns the decoder thread it started, nullptr if none; the thread deletes itself when finished
+    QThread* fill(const std::function<libvlc_media_t*()>& createMedia, qint64 from, qint64 to);
+
+private:
+    struct Request {
+        libvlc_media_t* media = nullptr;
+        qint64 from = 0;
+        qint64 to = -1;
+    };
+    
+    // Everything the decoder thread touches, kept alive by it after the buffer is gone
+    struct Shared {
+        double frameIntervalMs = 0;
+        QSize frameSize;
+        qint64 frameBytes = 0;
+        qint64 budget = 0;
+        
+        QMutex mutex;
+        std::map<qint64, QImage> frames;  // By time
+        qint64 bytes = 0;
+        qint64 focus = 0;  // Time last asked for, eviction keeps what is near it
+        Request running;  // Range being decoded (to -1 while idle)
+        Request pending;  // Next range, replaced by newer requests
+        bool decoding = false;  // A decoder thread is running
+        std::atomic<bool> cancelled{false};
+    };
+    
+    static void decodeLoop(const std::shared_ptr<Shared>& shared);
+    static void decode(Shared* shared, const Request& request);
+    static void store(Shared* shared, qint64 time, const QImage& frame);
+    
+    double m_frameIntervalMs;
+    QSize m_frameSize;
+    int m_fillFrames;
+    std::shared_ptr<Shared> m_shared;
+    
+    static int s_budgetMegabytes;
+};
+
+#endif // FRAMESTEPBUFFER_H
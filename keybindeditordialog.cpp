@@ -169,6 +169,16 @@ void KeybindEditorDialog::populateTable()
         KeybindManager::Action::ToggleLoadSpeed,
         KeybindManager::Action::CycleLoopMode,
         KeybindManager::Action::ReturnToLastPosition,
+        KeybindManager::Action::NextFile,
+        KeybindManager::Action::PreviousFile,
+        KeybindManager::Action::OpenLibrary,
+        KeybindManager::Action::OpenUrl,
+        KeybindManager::Action::PerfOverlay,
+        KeybindManager::Action::Timeshift,
+        KeybindManager::Action::FrameForward,
+        KeybindManager::Action::FrameBackward,
+        KeybindManager::Action::Reverse,
+        KeybindManager::Action::ToggleKeyframeSnap,
         KeybindManager::Action::StateGroup1,
         KeybindManager::Action::StateGroup2,
         KeybindManager::Action::StateGroup3,
@@ -724,6 +734,16 @@ void KeybindEditorDialog::onResetToDefaultsClicked()
             KeybindManager::Action::ToggleLoadSpeed,
             KeybindManager::Action::CycleLoopMode,
             KeybindManager::Action::ReturnToLastPosition,
+            KeybindManager::Action::NextFile,
+            KeybindManager::Action::PreviousFile,
+            KeybindManager::Action::OpenLibrary,
+            KeybindManager::Action::OpenUrl,
+            KeybindManager::Action::PerfOverlay,
+            KeybindManager::Action::Timeshift,
+            KeybindManager::Action::FrameForward,
+            KeybindManager::Action::FrameBackward,
+            KeybindManager::Action::Reverse,
+            KeybindManager::Action::ToggleKeyframeSnap,
                 KeybindManager::Action::StateGroup1,
             KeybindManager::Action::StateGroup2,
             KeybindManager::Action::StateGroup3,
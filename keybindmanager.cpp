@@ -181,6 +181,26 @@ QString KeybindManager::actionToString(Action action)
             return "Save State Group (Ctrl+F1-F4)";
         case Action::DeleteStateGroup:
             return "Delete State Group (Alt+F1-F4)";
+        case Action::NextFile:
+            return "Next File";
+        case Action::PreviousFile:
+            return "Previous File";
+        case Action::OpenLibrary:
+            return "Open Library";
+        case Action::OpenUrl:
+            return "Open URL";
+        case Action::PerfOverlay:
+            return "Perf Overlay";
+        case Action::Timeshift:
+            return "Timeshift";
+        case Action::FrameForward:
+            return "Frame Forward";
+        case Action::FrameBackward:
+            return "Frame Backward";
+        case Action::Reverse:
+            return "Reverse";
+        case Action::ToggleKeyframeSnap:
+            return "Toggle Keyframe Snap";
         default:
             return "Unknown";
     }
@@ -276,6 +296,36 @@ QList<QKeySequence> KeybindManager::getDefaultKeybinds(Action action)
         case Action::DeleteStateGroup:
             defaults << QKeySequence(Qt::ALT | Qt::Key_F1);   // Example, user uses Alt+F1-F4
             break;
+        case Action::NextFile:
+            defaults << QKeySequence(Qt::Key_PageDown);
+            break;
+        case Action::PreviousFile:
+            defaults << QKeySequence(Qt::Key_PageUp);
+            break;
+        case Action::OpenLibrary:
+            defaults << QKeySequence(Qt::CTRL | Qt::Key_L);
+            break;
+        case Action::OpenUrl:
+            defaults << QKeySequence(Qt::CTRL | Qt::Key_U);
+            break;
+        case Action::PerfOverlay:
+            defaults << QKeySequence(Qt::Key_F12);
+            break;
+        case Action::Timeshift:
+            defaults << QKeySequence(Qt::CTRL | Qt::Key_T);
+            break;
+        case Action::FrameForward:
+            defaults << QKeySequence(Qt::Key_Period);
+            break;
+        case Action::FrameBackward:
+            defaults << QKeySequence(Qt::Key_Comma);
+            break;
+        case Action::Reverse:
+            defaults << QKeySequence(Qt::Key_R);
+            break;
+        case Action::ToggleKeyframeSnap:
+            defaults << QKeySequence(Qt::Key_K);
+            break;
     }
     
     return defaults;
@@ -309,6 +359,16 @@ void KeybindManager::resetToDefaults()
     m_keybinds[Action::StateGroup4] = getDefaultKeybinds(Action::StateGroup4);
     m_keybinds[Action::SaveStateGroup] = getDefaultKeybinds(Action::SaveStateGroup);
     m_keybinds[Action::DeleteStateGroup] = getDefaultKeybinds(Action::DeleteStateGroup);
+    m_keybinds[Action::NextFile] = getDefaultKeybinds(Action::NextFile);
+    m_keybinds[Action::PreviousFile] = getDefaultKeybinds(Action::PreviousFile);
+    m_keybinds[Action::OpenLibrary] = getDefaultKeybinds(Action::OpenLibrary);
+    m_keybinds[Action::OpenUrl] = getDefaultKeybinds(Action::OpenUrl);
+    m_keybinds[Action::PerfOverlay] = getDefaultKeybinds(Action::PerfOverlay);
+    m_keybinds[Action::Timeshift] = getDefaultKeybinds(Action::Timeshift);
+    m_keybinds[Action::FrameForward] = getDefaultKeybinds(Action::FrameForward);
+    m_keybinds[Action::FrameBackward] = getDefaultKeybinds(Action::FrameBackward);
+    m_keybinds[Action::Reverse] = getDefaultKeybinds(Action::Reverse);
+    m_keybinds[Action::ToggleKeyframeSnap] = getDefaultKeybinds(Action::ToggleKeyframeSnap);
     
     emit keybindsChanged();
 }
@@ -350,8 +410,22 @@ bool KeybindManager::saveKeybinds()
         Action::CycleLoopMode,
         Action::ReturnToLastPosition,
         Action::StateKeys,
+        Action::StateGroup1,
+        Action::StateGroup2,
+        Action::StateGroup3,
+        Action::StateGroup4,
         Action::SaveStateGroup,
-        Action::DeleteStateGroup
+        Action::DeleteStateGroup,
+        Action::NextFile,
+        Action::PreviousFile,
+        Action::OpenLibrary,
+        Action::OpenUrl,
+        Action::PerfOverlay,
+        Action::Timeshift,
+        Action::FrameForward,
+        Action::FrameBackward,
+        Action::Reverse,
+        Action::ToggleKeyframeSnap
     };
     
     for (Action action : actions) {
@@ -411,6 +485,16 @@ bool KeybindManager::loadKeybinds()
     actionMap["StateGroup4"] = Action::StateGroup4;
     actionMap["SaveStateGroup(Ctrl+F1-F4)"] = Action::SaveStateGroup;
     actionMap["DeleteStateGroup(Alt+F1-F4)"] = Action::DeleteStateGroup;
+    actionMap["NextFile"] = Action::NextFile;
+    actionMap["PreviousFile"] = Action::PreviousFile;
+    actionMap["OpenLibrary"] = Action::OpenLibrary;
+    actionMap["OpenURL"] = Action::OpenUrl;
+    actionMap["PerfOverlay"] = Action::PerfOverlay;
+    actionMap["Timeshift"] = Action::Timeshift;
+    actionMap["FrameForward"] = Action::FrameForward;
+    actionMap["FrameBackward"] = Action::FrameBackward;
+    actionMap["Reverse"] = Action::Reverse;
+    actionMap["ToggleKeyframeSnap"] = Action::ToggleKeyframeSnap;
     
     int lineNumber = 0;
     while (!in.atEnd()) {
@@ -464,8 +548,27 @@ bool KeybindManager::loadKeybinds()
     
     file.close();
     
+    // Actions added after a keybinds file was written start with their defaults
+    const QList<Action> addedActions = {
+        Action::NextFile,
+        Action::PreviousFile,
+        Action::OpenLibrary,
+        Action::OpenUrl,
+        Action::PerfOverlay,
+        Action::Timeshift,
+        Action::FrameForward,
+        Action::FrameBackward,
+        Action::Reverse,
+        Action::ToggleKeyframeSnap
+    };
+    for (Action action : addedActions) {
+        if (!m_keybinds.contains(action)) {
+            m_keybinds[action] = getDefaultKeybinds(action);
+        }
+    }
+    
     // Verify that all actions have been loaded
-    if (m_keybinds.size() != 21) {
+    if (m_keybinds.size() != 31) {
         qWarning() << "KeybindManager: Not all actions were loaded from file";
         return false;
     }
@@ -480,8 +583,18 @@ bool KeybindManager::createDefaultKeybindsFile()
     return saveKeybinds();
 }
 
+QString KeybindManager::s_keybindsFilePath;
+
+void KeybindManager::setKeybindsFilePath(const QString& filePath)
+{
+    s_keybindsFilePath = filePath;
+}
+
 QString KeybindManager::getKeybindsFilePath() const
 {
+    if (!s_keybindsFilePath.isEmpty()) {
+        return s_keybindsFilePath;
+    }
     QString appDir = QCoreApplication::applicationDirPath();
     return QDir::cleanPath(appDir + "/keybinds.txt");
 }
@@ -41,7 +41,17 @@ public:
         StateGroup3,        // F3 (switch to state group 3)
         StateGroup4,        // F4 (switch to state group 4)
         SaveStateGroup,     // Ctrl + F1-F4 (saves state group to file) - DISPLAY ONLY
-        DeleteStateGroup    // Alt + F1-F4 (deletes state group) - DISPLAY ONLY
+        DeleteStateGroup,   // Alt + F1-F4 (deletes state group) - DISPLAY ONLY
+        NextFile,           // PageDown (opens the next file in the playlist)
+        PreviousFile,       // PageUp (opens the previous file in the playlist)
+        OpenLibrary,        // Ctrl+L (opens the library browser)
+        OpenUrl,            // Open a network stream
+        PerfOverlay,        // Show I/O and cache counters
+        Timeshift,          // Record streams for pause and rewind
+        FrameForward,       // . (steps one frame forward, pauses)
+        FrameBackward,      // , (steps one frame back)
+        Reverse,            // R (toggles playing backwards)
+        ToggleKeyframeSnap  // K (states without their own setting start at the keyframe before them)
     };
 
     explicit KeybindManager(QObject *parent = nullptr);
@@ -79,6 +89,9 @@ public:
     
     // Save keybinds to file
     bool saveKeybinds();
+    
+    // Read and write keybinds at another path than keybinds.txt next to the executable
+    static void setKeybindsFilePath(const QString& filePath);
 
 signals:
     void keybindsChanged();
@@ -93,6 +106,8 @@ private:
     // Get the keybinds file path
     QString getKeybindsFilePath() const;
     
+    static QString s_keybindsFilePath;
+    
     // Validate a key sequence (check for forbidden keys)
     bool isKeySequenceValid(const QKeySequence& keySequence) const;
     
@@ -0,0 +1,720 @@
+#include "keyframeindex.h"
+#include "filefingerprint.h"
+#include "statestorage.h"
+#include "perftracer.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const char Magic[4] = {'M', 'K', 'F', 'I'};
+const quint32 Version = 2;  // 2: times shifted by the edit list
+const quint32 AllFramesFlag = 1;
+
+const qint64 MaxMoovSize = 256LL * 1024 * 1024;
+const qint64 MaxCuesSize = 64LL * 1024 * 1024;
+const qint64 MaxHeaderElementSize = 4 * 1024 * 1024;  // SeekHead, Info, Tracks
+const quint32 MaxSamples = 50000000;
+
+// File layout: header, count entries, keyframeCount entry indexes
+struct IndexHeader {
+    char magic[4];
+    quint32 version;
+    qint64 fileSize;
+    quint32 count;
+    quint32 keyframeCount;
+    quint32 flags;
+    quint32 reserved;
+};
+
+typedef KeyframeIndex::Entry Entry;
+
+// ---- MP4 ----
+
+struct Box {
+    const uchar* data = nullptr;  // Payload
+    qint64 size = 0;
+};
+
+// Next box of a payload, false at its end or on a damaged size
+bool nextBox(const uchar*& p, const uchar* end, QByteArray* type, Box* box)
+{
+    if (end - p < 8) {
+        return false;
+    }
+    
+    quint64 size = qFromBigEndian<quint32>(p);
+    qint64 header = 8;
+    if (size == 1) {
+        if (end - p < 16) {
+            return false;
+        }
+        size = qFromBigEndian<quint64>(p + 8);
+        header = 16;
+    } else if (size == 0) {
+        size = end - p;
+    }
+    
+    if (size < static_cast<quint64>(header) || size > static_cast<quint64>(end - p)) {
+        return false;
+    }
+    
+    *type = QByteArray(reinterpret_cast<const char*>(p + 4), 4);
+    box->data = p + header;
+    box->size = static_cast<qint64>(size) - header;
+    p += size;
+    return true;
+}
+
+bool findBox(const Box& parent, const char* wanted, Box* found)
+{
+    const uchar* p = parent.data;
+    const uchar* end = parent.data + parent.size;
+    QByteArray type;
+    Box box;
+    while (nextBox(p, end, &type, &box)) {
+        if (type == wanted) {
+            *found = box;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Full box with a count after version and flags, false if its entries do not fit
+bool tableEntries(const Box& box, int headerSize, int entrySize, quint32* count)
+{
+    if (box.size < headerSize) {
+        return false;
+    }
+    *count = qFromBigEndian<quint32>(box.data + headerSize - 4);
+    return static_cast<qint64>(*count) * entrySize <= box.size - headerSize;
+}
+
+// Media time the presentation starts at, from the first edit that is not empty
+// (a delay, media time -1). 0 without an edit list
+qint64 editListStart(const Box& trak)
+{
+    Box edts, elst;
+    quint32 count = 0;
+    if (!findBox(trak, "edts", &edts) || !findBox(edts, "elst", &elst) || elst.size < 8) {
+        return 0;
+    }
+    
+    // Version 1 has a 64-bit duration and media time, both have a 32-bit rate
+    bool wide = elst.data[0] == 1;
+    int entrySize = wide ? 20 : 12;
+    if (!tableEntries(elst, 8, entrySize, &count)) {
+        return 0;
+    }
+    
+    for (quint32 i = 0; i < count; i++) {
+        const uchar* entry = elst.data + 8 + i * entrySize;
+        qint64 mediaTime = wide ? qFromBigEndian<qint64>(entry + 8) : qFromBigEndian<qint32>(entry + 4);
+        if (mediaTime >= 0) {
+            return mediaTime;
+        }
+    }
+    return 0;
+}
+
+bool parseVideoTrack(const Box& trak, std::vector<Entry>& entries)
+{
+    Box mdia, hdlr, mdhd, minf, stbl;
+    if (!findBox(trak, "mdia", &mdia) || !findBox(mdia, "hdlr", &hdlr) || hdlr.size < 12 ||
+        memcmp(hdlr.data + 8, "vide", 4) != 0) {
+        return false;
+    }
+    if (!findBox(mdia, "mdhd", &mdhd) || !findBox(mdia, "minf", &minf) || !findBox(minf, "stbl", &stbl)) {
+        return false;
+    }
+    
+    // Version 1 has 64-bit creation and modification times before the timescale
+    int timescaleOffset = mdhd.size > 0 && mdhd.data[0] == 1 ? 20 : 12;
+    if (mdhd.size < timescaleOffset + 4) {
+        return false;
+    }
+    quint32 timescale = qFromBigEndian<quint32>(mdhd.data + timescaleOffset);
+    if (timescale == 0) {
+        return false;
+    }
+    
+    Box stts, stsz, stsc, stco, stss, ctts;
+    bool wideOffsets = false;
+    if (!findBox(stbl, "stco", &stco)) {
+        if (!findBox(stbl, "co64", &stco)) {
+            return false;
+        }
+        wideOffsets = true;
+    }
+    if (!findBox(stbl, "stts", &stts) || !findBox(stbl, "stsz", &stsz) || !findBox(stbl, "stsc", &stsc)) {
+        return false;
+    }
+    bool hasSyncTable = findBox(stbl, "stss", &stss);
+    bool hasCompositionOffsets = findBox(stbl, "ctts", &ctts);
+    
+    // Sample sizes (one size for all, or one each)
+    if (stsz.size < 12) {
+        return false;
+    }
+    quint32 fixedSize = qFromBigEndian<quint32>(stsz.data + 4);
+    quint32 sampleCount = qFromBigEndian<quint32>(stsz.data + 8);
+    if (sampleCount == 0 || sampleCount > MaxSamples ||
+        (fixedSize == 0 && static_cast<qint64>(sampleCount) * 4 > stsz.size - 12)) {
+        return false;
+    }
+    
+    entries.assign(sampleCount, Entry{0, 0, 0, 0});
+    
+    // Decode times
+    quint32 sttsCount = 0;
+    if (!tableEntries(stts, 8, 8, &sttsCount)) {
+        return false;
+    }
+    quint32 sample = 0;
+    qint64 decodeTime = 0;
+    for (quint32 i = 0; i < sttsCount && sample < sampleCount; i++) {
+        quint32 run = qFromBigEndian<quint32>(stts.data + 8 + i * 8);
+        quint32 delta = qFromBigEndian<quint32>(stts.data + 12 + i * 8);
+        for (quint32 j = 0; j < run && sample < sampleCount; j++, sample++) {
+            entries[sample].timeUs = decodeTime;
+            decodeTime += delta;
+        }
+    }
+    
+    // Presentation times are later than decode times where frames are reordered
+    quint32 cttsCount = 0;
+    if (hasCompositionOffsets && tableEntries(ctts, 8, 8, &cttsCount)) {
+        bool signedOffsets = ctts.data[0] == 1;
+        sample = 0;
+        for (quint32 i = 0; i < cttsCount && sample < sampleCount; i++) {
+            quint32 run = qFromBigEndian<quint32>(ctts.data + 8 + i * 8);
+            quint32 value = qFromBigEndian<quint32>(ctts.data + 12 + i * 8);
+            qint64 offset = signedOffsets ? static_cast<qint32>(value) : static_cast<qint64>(value);
+            for (quint32 j = 0; j < run && sample < sampleCount; j++, sample++) {
+                entries[sample].timeUs += offset;
+            }
+        }
+    }
+    
+    // Players show the media time of the first edit as 0, with B-frames that is the
+    // composition offset of the first frame (a frame or two)
+    qint64 editStart = editListStart(trak);
+    for (Entry& entry : entries) {
+        entry.timeUs = qMax<qint64>(0, entry.timeUs - editStart) * 1000000 / timescale;
+    }
+    
+    // Byte offsets: chunks hold runs of consecutive samples
+    quint32 stscCount = 0;
+    quint32 chunkCount = 0;
+    if (!tableEntries(stsc, 8, 12, &stscCount) || !tableEntries(stco, 8, wideOffsets ? 8 : 4, &chunkCount)) {
+        return false;
+    }
+    sample = 0;
+    for (quint32 i = 0; i < stscCount && sample < sampleCount; i++) {
+        quint32 firstChunk = qFromBigEndian<quint32>(stsc.data + 8 + i * 12);
+        quint32 samplesPerChunk = qFromBigEndian<quint32>(stsc.data + 12 + i * 12);
+        quint32 lastChunk = i + 1 < stscCount ? qFromBigEndian<quint32>(stsc.data + 20 + i * 12) - 1 : chunkCount;
+        
+        for (quint32 chunk = qMax(1u, firstChunk); chunk <= qMin(lastChunk, chunkCount) && sample < sampleCount; chunk++) {
+            qint64 offset = wideOffsets ? static_cast<qint64>(qFromBigEndian<quint64>(stco.data + 8 + (chunk - 1) * 8))
+                                        : static_cast<qint64>(qFromBigEndian<quint32>(stco.data + 8 + (chunk - 1) * 4));
+            for (quint32 j = 0; j < samplesPerChunk && sample < sampleCount; j++, sample++) {
+                entries[sample].offset = offset;
+                offset += fixedSize ? fixedSize : qFromBigEndian<quint32>(stsz.data + 12 + sample * 4);
+            }
+        }
+    }
+    
+    // Without a sync sample table every sample is a keyframe
+    quint32 stssCount = 0;
+    if (hasSyncTable && tableEntries(stss, 8, 4, &stssCount)) {
+        for (quint32 i = 0; i < stssCount; i++) {
+            quint32 number = qFromBigEndian<quint32>(stss.data + 8 + i * 4);
+            if (number >= 1 && number <= sampleCount) {
+                entries[number - 1].flags |= KeyframeIndex::KeyframeFlag;
+            }
+        }
+    } else {
+        for (Entry& entry : entries) {
+            entry.flags |= KeyframeIndex::KeyframeFlag;
+        }
+    }
+    
+    return true;
+}
+
+bool parseMp4(QFile& file, std::vector<Entry>& entries)
+{
+    // moov is at the start or (not optimized for streaming) after mdat, boxes are skipped by their size
+    qint64 fileSize = file.size();
+    qint64 position = 0;
+    QByteArray moov;
+    
+    while (position + 8 <= fileSize) {
+        uchar header[16];
+        if (!file.seek(position) || file.read(reinterpret_cast<char*>(header), 16) < 8) {
+            return false;
+        }
+        
+        quint64 size = qFromBigEndian<quint32>(header);
+        qint64 headerSize = 8;
+        if (size == 1) {
+            size = qFromBigEndian<quint64>(header + 8);
+            headerSize = 16;
+        } else if (size == 0) {
+            size = fileSize - position;
+        }
+        if (size < static_cast<quint64>(headerSize) || size > static_cast<quint64>(fileSize - position)) {
+            return false;
+        }
+        
+        if (memcmp(header + 4, "moov", 4) == 0) {
+            if (static_cast<qint64>(size) > MaxMoovSize) {
+                return false;
+            }
+            file.seek(position + headerSize);
+            moov = file.read(static_cast<qint64>(size) - headerSize);
+            break;
+        }
+        
+        position += static_cast<qint64>(size);
+    }
+    
+    if (moov.isEmpty()) {
+        return false;
+    }
+    
+    // First video track
+    Box root{reinterpret_cast<const uchar*>(moov.constData()), moov.size()};
+    const uchar* p = root.data;
+    const uchar* end = root.data + root.size;
+    QByteArray type;
+    Box box;
+    while (nextBox(p, end, &type, &box)) {
+        if (type == "trak" && parseVideoTrack(box, entries)) {
+            return true;
+        }
+    }
+    
+    entries.clear();
+    return false;
+}
+
+// ---- Matroska ----
+
+const quint32 EbmlId = 0x1A45DFA3;
+const quint32 SegmentId = 0x18538067;
+const quint32 SeekHeadId = 0x114D9B74;
+const quint32 SeekId = 0x4DBB;
+const quint32 SeekIdId = 0x53AB;
+const quint32 SeekPositionId = 0x53AC;
+const quint32 InfoId = 0x1549A966;
+const quint32 TimecodeScaleId = 0x2AD7B1;
+const quint32 TracksId = 0x1654AE6B;
+const quint32 TrackEntryId = 0xAE;
+const quint32 TrackNumberId = 0xD7;
+const quint32 TrackTypeId = 0x83;
+const quint32 ClusterId = 0x1F43B675;
+const quint32 CuesId = 0x1C53BB6B;
+const quint32 CuePointId = 0xBB;
+const quint32 CueTimeId = 0xB3;
+const quint32 CueTrackPositionsId = 0xB7;
+const quint32 CueTrackId = 0xF7;
+const quint32 CueClusterPositionId = 0xF1;
+
+// Variable length integer; an ID keeps its length marker, a size of all ones is unknown (-1)
+bool readVint(const uchar*& p, const uchar* end, bool isId, qint64* value)
+{
+    if (p >= end || *p == 0) {
+        return false;
+    }
+    
+    int length = 1;
+    while (!(*p & (0x80 >> (length - 1)))) {
+        length++;
+    }
+    if (length > (isId ? 4 : 8) || end - p < length) {
+        return false;
+    }
+    
+    quint64 result = isId ? *p : (*p & (0xFF >> length));
+    bool allOnes = result == static_cast<quint64>(0xFF >> length);
+    for (int i = 1; i < length; i++) {
+        result = (result << 8) | p[i];
+        allOnes = allOnes && p[i] == 0xFF;
+    }
+    p += length;
+    
+    *value = !isId && allOnes ? -1 : static_cast<qint64>(result);
+    return true;
+}
+
+bool nextElement(const uchar*& p, const uchar* end, quint32* id, const uchar** data, qint64* size)
+{
+    qint64 idValue = 0;
+    if (!readVint(p, end, true, &idValue) || !readVint(p, end, false, size) || *size < 0 || *size > end - p) {
+        return false;
+    }
+    *id = static_cast<quint32>(idValue);
+    *data = p;
+    p += *size;
+    return true;
+}
+
+quint64 readUnsigned(const uchar* data, qint64 size)
+{
+    quint64 value = 0;
+    for (qint64 i = 0; i < size && i < 8; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+// Header of an element in the file: ID, payload size (-1 unknown) and header length
+bool readElementHeader(QFile& file, qint64 position, quint32* id, qint64* size, qint64* headerSize)
+{
+    uchar header[12];
+    if (!file.seek(position)) {
+        return false;
+    }
+    qint64 got = file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (got < 2) {
+        return false;
+    }
+    
+    const uchar* p = header;
+    qint64 idValue = 0;
+    if (!readVint(p, header + got, true, &idValue) || !readVint(p, header + got, false, size)) {
+        return false;
+    }
+    *id = static_cast<quint32>(idValue);
+    *headerSize = p - header;
+    return true;
+}
+
+bool parseMatroska(QFile& file, std::vector<Entry>& entries)
+{
+    quint32 id = 0;
+    qint64 size = 0;
+    qint64 headerSize = 0;
+    qint64 fileSize = file.size();
+    
+    if (!readElementHeader(file, 0, &id, &size, &headerSize) || id != EbmlId || size < 0) {
+        return false;
+    }
+    qint64 position = headerSize + size;
+    if (!readElementHeader(file, position, &id, &size, &headerSize) || id != SegmentId) {
+        return false;
+    }
+    
+    // Positions in the segment are relative to its payload
+    qint64 segmentStart = position + headerSize;
+    qint64 segmentEnd = size < 0 ? fileSize : qMin(fileSize, segmentStart + size);
+    
+    qint64 cuesPosition = -1;
+    quint64 timecodeScale = 1000000;
+    quint64 videoTrack = 0;
+    
+    // Top level elements up to the first cluster, then straight to the Cues the SeekHead points at
+    position = segmentStart;
+    while (position < segmentEnd && readElementHeader(file, position, &id, &size, &headerSize)) {
+        if (id == CuesId) {
+            cuesPosition = position;
+            break;
+        }
+        if (id == ClusterId && cuesPosition >= 0) {
+            break;
+        }
+        
+        if ((id == SeekHeadId || id == InfoId || id == TracksId) && size >= 0 && size <= MaxHeaderElementSize) {
+            file.seek(position + headerSize);
+            QByteArray payload = file.read(size);
+            const uchar* p = reinterpret_cast<const uchar*>(payload.constData());
+            const uchar* end = p + payload.size();
+            quint32 childId = 0;
+            const uchar* data = nullptr;
+            qint64 childSize = 0;
+            
+            while (nextElement(p, end, &childId, &data, &childSize)) {
+                if (id == InfoId && childId == TimecodeScaleId) {
+                    timecodeScale = readUnsigned(data, childSize);
+                } else if ((id == SeekHeadId && childId == SeekId) || (id == TracksId && childId == TrackEntryId)) {
+                    const uchar* q = data;
+                    quint32 fieldId = 0;
+                    const uchar* field = nullptr;
+                    qint64 fieldSize = 0;
+                    QByteArray seekId;
+                    quint64 seekPosition = 0;
+                    quint64 trackNumber = 0;
+                    quint64 trackType = 0;
+                    
+                    while (nextElement(q, data + childSize, &fieldId, &field, &fieldSize)) {
+                        if (fieldId == SeekIdId) {
+                            seekId = QByteArray(reinterpret_cast<const char*>(field), static_cast<int>(fieldSize));
+                        } else if (fieldId == SeekPositionId) {
+                            seekPosition = readUnsigned(field, fieldSize);
+                        } else if (fieldId == TrackNumberId) {
+                            trackNumber = readUnsigned(field, fieldSize);
+                        } else if (fieldId == TrackTypeId) {
+                            trackType = readUnsigned(field, fieldSize);
+                        }
+                    }
+                    
+                    if (seekId == QByteArray::fromHex("1C53BB6B")) {
+                        cuesPosition = segmentStart + static_cast<qint64>(seekPosition);
+                    }
+                    if (trackType == 1 && videoTrack == 0) {
+                        videoTrack = trackNumber;
+                    }
+                }
+            }
+        }
+        
+        // A live-written cluster of unknown size can not be skipped
+        if (size < 0) {
+            break;
+        }
+        position += headerSize + size;
+    }
+    
+    if (cuesPosition < 0 || !readElementHeader(file, cuesPosition, &id, &size, &headerSize) || id != CuesId ||
+        size < 0 || size > MaxCuesSize || timecodeScale == 0) {
+        return false;
+    }
+    
+    file.seek(cuesPosition + headerSize);
+    QByteArray cues = file.read(size);
+    const uchar* p = reinterpret_cast<const uchar*>(cues.constData());
+    const uchar* end = p + cues.size();
+    quint32 pointId = 0;
+    const uchar* point = nullptr;
+    qint64 pointSize = 0;
+    
+    while (nextElement(p, end, &pointId, &point, &pointSize)) {
+        if (pointId != CuePointId) {
+            continue;
+        }
+        
+        const uchar* q = point;
+        quint32 fieldId = 0;
+        const uchar* field = nullptr;
+        qint64 fieldSize = 0;
+        quint64 cueTime = 0;
+        std::vector<std::pair<quint64, quint64>> positions;  // Track, cluster position
+        
+        while (nextElement(q, point + pointSize, &fieldId, &field, &fieldSize)) {
+            if (fieldId == CueTimeId) {
+                cueTime = readUnsigned(field, fieldSize);
+            } else if (fieldId == CueTrackPositionsId) {
+                const uchar* r = field;
+                quint32 positionId = 0;
+                const uchar* value = nullptr;
+                qint64 valueSize = 0;
+                std::pair<quint64, quint64> trackPosition(0, 0);
+                while (nextElement(r, field + fieldSize, &positionId, &value, &valueSize)) {
+                    if (positionId == CueTrackId) {
+                        trackPosition.first = readUnsigned(value, valueSize);
+                    } else if (positionId == CueClusterPositionId) {
+                        trackPosition.second = readUnsigned(value, valueSize);
+                    }
+                }
+                positions.push_back(trackPosition);
+            }
+        }
+        
+        // Cues point at keyframes of the video track (of every track where no video track is known)
+        for (const auto& trackPosition : positions) {
+            if (videoTrack == 0 || trackPosition.first == videoTrack) {
+                qint64 timeUs = static_cast<qint64>(cueTime * timecodeScale / 1000);
+                entries.push_back(Entry{timeUs, segmentStart + static_cast<qint64>(trackPosition.second),
+                                        KeyframeIndex::KeyframeFlag, 0});
+                break;
+            }
+        }
+    }
+    
+    return !entries.empty();
+}
+
+} // namespace
+
+bool KeyframeIndex::isSupported(const QString& filePath)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    return suffix == "mp4" || suffix == "m4v" || suffix == "mov" || suffix == "mkv" || suffix == "webm";
+}
+
+QString KeyframeIndex::cachePath(const QByteArray& fingerprint)
+{
+    QString fingerprintHex = QString::fromLatin1(fingerprint.toHex());
+    
+    // Same shard as the video's state groups (first hash byte)
+    return StateStorage::rootPath() + "/keyframes/" + fingerprintHex.mid(16, 2) + "/" + fingerprintHex + ".kfi";
+}
+
+std::shared_ptr<KeyframeIndex> KeyframeIndex::open(const QString& filePath)
+{
+    QByteArray fingerprint = FileFingerprint::instance().fingerprint(filePath);
+    if (fingerprint.isEmpty()) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<KeyframeIndex> index(new KeyframeIndex);
+    index->m_file.setFileName(cachePath(fingerprint));
+    if (!index->m_file.open(QIODevice::ReadOnly) || index->m_file.size() < static_cast<qint64>(sizeof(IndexHeader))) {
+        return nullptr;
+    }
+    
+    qint64 mappedSize = index->m_file.size();
+    const uchar* map = index->m_file.map(0, mappedSize);
+    if (!map) {
+        return nullptr;
+    }
+    
+    // A fingerprint samples the file, the size check catches a cache written by another version
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(map);
+    qint64 expected = static_cast<qint64>(sizeof(IndexHeader)) + static_cast<qint64>(header->count) * sizeof(Entry) +
+                      static_cast<qint64>(header->keyframeCount) * sizeof(quint32);
+    if (memcmp(header->magic, Magic, 4) != 0 || header->version != Version ||
+        header->fileSize != QFileInfo(filePath).size() || mappedSize < expected) {
+        return nullptr;
+    }
+    
+    index->m_entries = reinterpret_cast<const Entry*>(map + sizeof(IndexHeader));
+    index->m_keyframes = reinterpret_cast<const quint32*>(map + sizeof(IndexHeader) + header->count * sizeof(Entry));
+    index->m_count = static_cast<int>(header->count);
+    index->m_keyframeCount = static_cast<int>(header->keyframeCount);
+    index->m_flags = header->flags;
+    return index;
+}
+
+std::shared_ptr<KeyframeIndex> KeyframeIndex::build(const QString& filePath)
+{
+    PERF_TRACE_SCOPE("keyframeIndexBuild");
+    
+    QByteArray fingerprint = FileFingerprint::instance().fingerprint(filePath);
+    QFile file(filePath);
+    if (fingerprint.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    
+    std::vector<Entry> entries;
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    bool matroska = suffix == "mkv" || suffix == "webm";
+    bool parsed = matroska ? parseMatroska(file, entries) : parseMp4(file, entries);
+    if (!parsed || entries.empty()) {
+        qDebug() << "KeyframeIndex: No index to read in" << filePath;
+        return nullptr;
+    }
+    
+    // Reordered frames come in decode order
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.timeUs < b.timeUs;
+    });
+    
+    std::vector<quint32> keyframes;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].flags & KeyframeFlag) {
+            keyframes.push_back(static_cast<quint32>(i));
+        }
+    }
+    
+    IndexHeader header;
+    memcpy(header.magic, Magic, 4);
+    header.version = Version;
+    header.fileSize = file.size();
+    header.count = static_cast<quint32>(entries.size());
+    header.keyframeCount = static_cast<quint32>(keyframes.size());
+    header.flags = matroska ? 0 : AllFramesFlag;
+    header.reserved = 0;
+    
+    QString path = cachePath(fingerprint);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qDebug() << "KeyframeIndex: Failed to write" << path << ":" << out.errorString();
+        return nullptr;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), static_cast<qint64>(entries.size() * sizeof(Entry)));
+    out.write(reinterpret_cast<const char*>(keyframes.data()), static_cast<qint64>(keyframes.size() * sizeof(quint32)));
+    if (!out.commit()) {
+        qDebug() << "KeyframeIndex: Failed to write" << path << ":" << out.errorString();
+        return nullptr;
+    }
+    
+    qDebug() << "KeyframeIndex: Indexed" << filePath << "-" << entries.size() << "entries," << keyframes.size()
+             << "keyframes";
+    return open(filePath);
+}
+
+KeyframeIndex::KeyframeIndex()
+    : m_entries(nullptr)
+    , m_keyframes(nullptr)
+    , m_count(0)
+    , m_keyframeCount(0)
+    , m_flags(0)
+{
+}
+
+KeyframeIndex::~KeyframeIndex()
+{
+}
+
+bool KeyframeIndex::hasAllFrames() const
+{
+    return m_flags & AllFramesFlag;
+}
+
+int KeyframeIndex::keyframeSlotBefore(qint64 timeUs) const
+{
+    // First keyframe after timeUs, the one before it is the answer
+    int low = 0;
+    int high = m_keyframeCount;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (keyframe(middle).timeUs <= timeUs) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low - 1;
+}
+
+qint64 KeyframeIndex::keyframeBefore(qint64 timeMs) const
+{
+    int slot = keyframeSlotBefore(timeMs * 1000);
+    return slot >= 0 ? keyframe(slot).timeUs / 1000 : -1;
+}
+
+qint64 KeyframeIndex::keyframeAfter(qint64 timeMs) const
+{
+    int slot = keyframeSlotBefore(timeMs * 1000);
+    if (slot >= 0 && keyframe(slot).timeUs == timeMs * 1000) {
+        return timeMs;
+    }
+    return slot + 1 < m_keyframeCount ? keyframe(slot + 1).timeUs / 1000 : -1;
+}
+
+qint64 KeyframeIndex::seekCost(qint64 timeMs) const
+{
+    qint64 before = keyframeBefore(timeMs);
+    return before < 0 ? timeMs : timeMs - before;
+}
+
+double KeyframeIndex::averageGopMs() const
+{
+    if (m_keyframeCount < 2) {
+        return 0.0;
+    }
+    return (keyframe(m_keyframeCount - 1).timeUs - keyframe(0).timeUs) / 1000.0 / (m_keyframeCount - 1);
+}
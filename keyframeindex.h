@@ -0,0 +1,78 @@
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <QString>
+#include <QFile>
+#include <memory>
+
+/**
+ * @class KeyframeIndex
+ * @brief Sorted time -> (byte offset, keyframe) table of a video file, memory-mapped
+ *
+ * Built by parsing the container's own index instead of decoding: the sample
+ * tables of MP4/MOV (stts, ctts, stss, stsc, stsz, stco/co64) list every frame
+ * of the first video track, Matroska/WebM Cues list its keyframes. Fragmented
+ * MP4 and files without Cues have no index to read.
+ *
+ * Indexes are cached by content fingerprint in savedstates/keyframes/, one
+ * file each, and mapped when opened, so an open index costs no parse and no
+ * heap. Queries are binary searches. Instances are immutable and thread-safe.
+ */
+class KeyframeIndex
+{
+public:
+    struct Entry {
+        qint64 timeUs;  // Presentation time
+        qint64 offset;  // Of the frame (MP4) or its cluster (Matroska)
+        quint32 flags;
+        quint32 reserved;
+    };
+    
+    static constexpr quint32 KeyframeFlag = 1;
+    
+    // MP4, MOV and Matroska files by extension, local files only
+    static bool isSupported(const QString& filePath);
+    
+    // Cached index of the file's current content, nullptr if none is built (one stat, no parse)
+    static std::shared_ptr<KeyframeIndex> open(const QString& filePath);
+    
+    // Parse the file, cache the index and open it (blocking, any thread);
+    // nullptr if the file has no index to read
+    static std::shared_ptr<KeyframeIndex> build(const QString& filePath);
+    
+    ~KeyframeIndex();
+    
+    int count() const { return m_count; }
+    const Entry& entry(int index) const { return m_entries[index]; }
+    int keyframeCount() const { return m_keyframeCount; }
+    
+    // Every frame is listed (MP4), not only keyframes (Matroska)
+    bool hasAllFrames() const;
+    
+    // Keyframe times in ms, -1 if there is none
+    qint64 keyframeBefore(qint64 timeMs) const;  // At or before
+    qint64 keyframeAfter(qint64 timeMs) const;  // At or after
+    
+    // Media time a precise seek to timeMs decodes before it shows a frame
+    qint64 seekCost(qint64 timeMs) const;
+    
+    double averageGopMs() const;
+
+private:
+    KeyframeIndex();
+    
+    // Position of the last keyframe at or before timeUs among the keyframes, -1 if none
+    int keyframeSlotBefore(qint64 timeUs) const;
+    const Entry& keyframe(int slot) const { return m_entries[m_keyframes[slot]]; }
+    
+    static QString cachePath(const QByteArray& fingerprint);
+    
+    QFile m_file;
+    const Entry* m_entries;
+    const quint32* m_keyframes;  // Entry indexes of the keyframes, in time order
+    int m_count;
+    int m_keyframeCount;
+    quint32 m_flags;
+};
+
+#endif // KEYFRAMEINDEX_H
@@ -0,0 +1,249 @@
+#include "librarybrowserdialog.h"
+#include "libraryscanner.h"
+#include "statestorage.h"
+#include "perftracer.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QDir>
+#include <QFileInfo>
+#include <QPixmap>
+#include <QDebug>
+
+LibraryBrowserDialog::LibraryBrowserDialog(QWidget* parent)
+    : QDialog(parent)
+    , m_scanner(nullptr)
+    , m_tree(nullptr)
+    , m_posterLabel(nullptr)
+    , m_statusLabel(nullptr)
+    , m_addFolderButton(nullptr)
+    , m_rescanButton(nullptr)
+    , m_openButton(nullptr)
+    , m_closeButton(nullptr)
+{
+    setWindowTitle(tr("Library"));
+    resize(900, 600);
+    
+    setupUI();
+    
+    m_library.load();
+    populate();
+    
+    m_scanner = new LibraryScanner(&m_library, this);
+    connect(m_scanner, &LibraryScanner::entryUpdated, this, &LibraryBrowserDialog::onEntryUpdated);
+    connect(m_scanner, &LibraryScanner::progress, this, &LibraryBrowserDialog::onScanProgress);
+    connect(m_scanner, &LibraryScanner::finished, this, &LibraryBrowserDialog::onScanFinished);
+}
+
+LibraryBrowserDialog::~LibraryBrowserDialog()
+{
+    // Files parsed so far are kept, the rest is picked up by the next rescan
+    if (m_scanner->isScanning()) {
+        m_scanner->cancel();
+        m_library.save();
+    }
+    
+    // Joins the scanner threads while the library is still alive
+    delete m_scanner;
+}
+
+void LibraryBrowserDialog::setupUI()
+{
+    QVBoxLayout* mainLayout = new QVBoxLayout(this);
+    
+    QHBoxLayout* contentLayout = new QHBoxLayout();
+    
+    m_tree = new QTreeWidget(this);
+    m_tree->setColumnCount(ColumnCount);
+    m_tree->setHeaderLabels({tr("Name"), tr("Duration"), tr("Resolution"), tr("Codec"),
+                             tr("FPS"), tr("States"), tr("Folder")});
+    m_tree->setRootIsDecorated(false);
+    m_tree->setUniformRowHeights(true);
+    m_tree->setSortingEnabled(true);
+    m_tree->sortByColumn(NameColumn, Qt::AscendingOrder);
+    m_tree->header()->setSectionResizeMode(NameColumn, QHeaderView::Stretch);
+    contentLayout->addWidget(m_tree, 1);
+    
+    m_posterLabel = new QLabel(this);
+    m_posterLabel->setFixedWidth(320);
+    m_posterLabel->setAlignment(Qt::AlignTop | Qt::AlignHCenter);
+    contentLayout->addWidget(m_posterLabel);
+    
+    mainLayout->addLayout(contentLayout);
+    
+    QHBoxLayout* buttonLayout = new QHBoxLayout();
+    
+    m_addFolderButton = new QPushButton(tr("Add Folder..."), this);
+    m_rescanButton = new QPushButton(tr("Rescan"), this);
+    m_statusLabel = new QLabel(this);
+    m_openButton = new QPushButton(tr("Open"), this);
+    m_closeButton = new QPushButton(tr("Close"), this);
+    m_openButton->setDefault(true);
+    
+    buttonLayout->addWidget(m_addFolderButton);
+    buttonLayout->addWidget(m_rescanButton);
+    buttonLayout->addWidget(m_statusLabel, 1);
+    buttonLayout->addWidget(m_openButton);
+    buttonLayout->addWidget(m_closeButton);
+    
+    mainLayout->addLayout(buttonLayout);
+    
+    connect(m_addFolderButton, &QPushButton::clicked, this, &LibraryBrowserDialog::onAddFolderClicked);
+    connect(m_rescanButton, &QPushButton::clicked, this, &LibraryBrowserDialog::onRescanClicked);
+    connect(m_openButton, &QPushButton::clicked, this, &LibraryBrowserDialog::onOpenClicked);
+    connect(m_closeButton, &QPushButton::clicked, this, &QDialog::reject);
+    connect(m_tree, &QTreeWidget::currentItemChanged, this, &LibraryBrowserDialog::onCurrentItemChanged);
+    connect(m_tree, &QTreeWidget::itemDoubleClicked, this, &LibraryBrowserDialog::onOpenClicked);
+}
+
+void LibraryBrowserDialog::populate()
+{
+    PERF_TRACE_SCOPE("libraryPopulate");
+    
+    // Sorting every insert is quadratic, sort once at the end
+    m_tree->setSortingEnabled(false);
+    
+    QList<QTreeWidgetItem*> items;
+    items.reserve(m_library.count());
+    
+    for (const MediaLibrary::Entry& entry : m_library.entries()) {
+        QTreeWidgetItem* item = new QTreeWidgetItem();
+        updateItem(item, entry);
+        m_items.insert(entry.filePath, item);
+        items << item;
+    }
+    
+    m_tree->addTopLevelItems(items);
+    m_tree->setSortingEnabled(true);
+    
+    m_statusLabel->setText(m_library.roots().isEmpty() ? tr("Add a folder to build the library")
+                                                      : tr("%1 files").arg(m_library.count()));
+}
+
+void LibraryBrowserDialog::updateItem(QTreeWidgetItem* item, const MediaLibrary::Entry& entry)
+{
+    QFileInfo fileInfo(entry.filePath);
+    
+    item->setText(NameColumn, fileInfo.fileName());
+    item->setText(DurationColumn, entry.durationMs > 0 ? formatTime(entry.durationMs) : QString());
+    item->setText(ResolutionColumn, entry.videoSize.isEmpty() ? QString()
+                  : QString("%1x%2").arg(entry.videoSize.width()).arg(entry.videoSize.height()));
+    item->setText(CodecColumn, entry.codec);
+    item->setText(FpsColumn, entry.fps > 0.0 ? QString::number(entry.fps, 'f', 2) : QString());
+    item->setText(StatesColumn, StateStorage::instance().hasStates(entry.fingerprint) ? tr("Yes") : QString());
+    item->setText(FolderColumn, QDir::toNativeSeparators(fileInfo.absolutePath()));
+    item->setData(NameColumn, Qt::UserRole, entry.filePath);
+    item->setToolTip(NameColumn, QDir::toNativeSeparators(entry.filePath));
+}
+
+void LibraryBrowserDialog::onAddFolderClicked()
+{
+    QString directoryPath = QFileDialog::getExistingDirectory(this, tr("Add Folder to Library"));
+    if (directoryPath.isEmpty()) {
+        return;
+    }
+    
+    m_library.addRoot(directoryPath);
+    startScan();
+}
+
+void LibraryBrowserDialog::onRescanClicked()
+{
+    startScan();
+}
+
+void LibraryBrowserDialog::startScan()
+{
+    if (m_scanner->isScanning() || m_library.roots().isEmpty()) {
+        return;
+    }
+    
+    m_rescanButton->setEnabled(false);
+    m_addFolderButton->setEnabled(false);
+    m_statusLabel->setText(tr("Looking for changed files..."));
+    
+    m_scanner->scan();
+}
+
+void LibraryBrowserDialog::onOpenClicked()
+{
+    QTreeWidgetItem* item = m_tree->currentItem();
+    if (!item) {
+        return;
+    }
+    
+    m_selectedFile = item->data(NameColumn, Qt::UserRole).toString();
+    accept();
+}
+
+void LibraryBrowserDialog::onCurrentItemChanged(QTreeWidgetItem* current)
+{
+    if (!current) {
+        m_posterLabel->clear();
+        return;
+    }
+    
+    auto it = m_library.entries().constFind(current->data(NameColumn, Qt::UserRole).toString());
+    if (it == m_library.entries().constEnd() || !it->hasPoster) {
+        m_posterLabel->clear();
+        return;
+    }
+    
+    // Loaded on selection only, the list itself never reads posters
+    m_posterLabel->setPixmap(QPixmap(MediaLibrary::posterPath(it->fingerprint)));
+}
+
+void LibraryBrowserDialog::onEntryUpdated(const MediaLibrary::Entry& entry)
+{
+    QTreeWidgetItem* item = m_items.value(entry.filePath);
+    
+    if (!item) {
+        item = new QTreeWidgetItem();
+        updateItem(item, entry);
+        m_items.insert(entry.filePath, item);
+        m_tree->addTopLevelItem(item);
+        return;
+    }
+    
+    updateItem(item, entry);
+    
+    if (item == m_tree->currentItem()) {
+        onCurrentItemChanged(item);
+    }
+}
+
+void LibraryBrowserDialog::onScanProgress(int done, int total)
+{
+    m_statusLabel->setText(tr("Scanning %1 of %2...").arg(done).arg(total));
+}
+
+void LibraryBrowserDialog::onScanFinished(int updated, int removed)
+{
+    // Drop rows of files that are gone
+    for (auto it = m_items.begin(); it != m_items.end();) {
+        if (!m_library.entries().contains(it.key())) {
+            delete it.value();
+            it = m_items.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    m_rescanButton->setEnabled(true);
+    m_addFolderButton->setEnabled(true);
+    m_statusLabel->setText(tr("%1 files (%2 updated, %3 removed)").arg(m_library.count()).arg(updated).arg(removed));
+}
+
+QString LibraryBrowserDialog::formatTime(qint64 milliseconds) const
+{
+    qint64 seconds = milliseconds / 1000;
+    qint64 minutes = seconds / 60;
+    qint64 hours = minutes / 60;
+    
+    if (hours > 0) {
+        return QString("%1:%2:%3").arg(hours).arg(minutes % 60, 2, 10, QChar('0')).arg(seconds % 60, 2, 10, QChar('0'));
+    }
+    
+    return QString("%1:%2").arg(minutes).arg(seconds % 60, 2, 10, QChar('0'));
+}
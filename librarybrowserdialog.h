@@ -0,0 +1,73 @@
+#ifndef LIBRARYBROWSERDIALOG_H
+#define LIBRARYBROWSERDIALOG_H
+
+#include <QDialog>
+#include <QTreeWidget>
+#include <QPushButton>
+#include <QLabel>
+#include <QHash>
+#include "medialibrary.h"
+
+class LibraryScanner;
+
+/**
+ * @class LibraryBrowserDialog
+ * @brief Lists the scanned library with metadata, posters and saved-state markers
+ *
+ * Opens from the index alone, no file is touched until a folder is added or
+ * rescanned. Rescans run in the background and update the list as files are parsed.
+ */
+class LibraryBrowserDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit LibraryBrowserDialog(QWidget* parent = nullptr);
+    ~LibraryBrowserDialog();
+    
+    // File picked with Open or a double-click (empty if none)
+    QString selectedFile() const { return m_selectedFile; }
+
+private slots:
+    void onAddFolderClicked();
+    void onRescanClicked();
+    void onOpenClicked();
+    void onCurrentItemChanged(QTreeWidgetItem* current);
+    void onEntryUpdated(const MediaLibrary::Entry& entry);
+    void onScanProgress(int done, int total);
+    void onScanFinished(int updated, int removed);
+
+private:
+    enum Column {
+        NameColumn,
+        DurationColumn,
+        ResolutionColumn,
+        CodecColumn,
+        FpsColumn,
+        StatesColumn,
+        FolderColumn,
+        ColumnCount
+    };
+    
+    void setupUI();
+    void populate();
+    void updateItem(QTreeWidgetItem* item, const MediaLibrary::Entry& entry);
+    void startScan();
+    QString formatTime(qint64 milliseconds) const;
+    
+    MediaLibrary m_library;
+    LibraryScanner* m_scanner;
+    QHash<QString, QTreeWidgetItem*> m_items;  // File path -> row
+    QString m_selectedFile;
+    
+    // UI components
+    QTreeWidget* m_tree;
+    QLabel* m_posterLabel;
+    QLabel* m_statusLabel;
+    QPushButton* m_addFolderButton;
+    QPushButton* m_rescanButton;
+    QPushButton* m_openButton;
+    QPushButton* m_closeButton;
+};
+
+#endif // LIBRARYBROWSERDIALOG_H
@@ -0,0 +1,353 @@
+#include "libraryscanner.h"
+#include "filefingerprint.h"
+#include "mediainfocache.h"
+#include "perftracer.h"
+#include "vp_vlcplayer.h"
+#include <vlc/vlc.h>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QSemaphore>
+#include <QSet>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+const int ParseTimeoutMs = 5000;
+const int PosterTimeoutMs = 3000;
+const int PosterWidth = 320;
+
+// Frames from vmem; once the poster is taken later frames go to the scratch image
+struct PosterCapture {
+    QImage frame;
+    QImage scratch;
+    std::atomic<bool> captured{false};
+    QSemaphore ready;
+};
+
+void onMediaParsed(const libvlc_event_t*, void* userData)
+{
+    static_cast<QSemaphore*>(userData)->release();
+}
+
+void* lockPosterFrame(void* opaque, void** planes)
+{
+    PosterCapture* capture = static_cast<PosterCapture*>(opaque);
+    planes[0] = capture->captured ? capture->scratch.bits() : capture->frame.bits();
+    return nullptr;
+}
+
+void displayPosterFrame(void* opaque, void*)
+{
+    PosterCapture* capture = static_cast<PosterCapture*>(opaque);
+    if (!capture->captured.exchange(true)) {
+        capture->ready.release();
+    }
+}
+
+} // namespace
+
+LibraryScanner::LibraryScanner(MediaLibrary* library, QObject* parent)
+    : QObject(parent)
+    , m_library(library)
+    , m_scanning(false)
+    , m_cancelled(false)
+    , m_activeWorkers(0)
+    , m_total(0)
+    , m_done(0)
+    , m_removed(0)
+{
+}
+
+LibraryScanner::~LibraryScanner()
+{
+    cancel();
+    
+    if (m_walkThread) {
+        m_walkThread->wait();
+    }
+    
+    for (const QPointer<QThread>& thread : std::as_const(m_workerThreads)) {
+        if (thread) {
+            thread->wait();
+        }
+    }
+}
+
+void LibraryScanner::scan(int workerCount)
+{
+    if (m_scanning) {
+        return;
+    }
+    
+    m_scanning = true;
+    m_cancelled = false;
+    
+    // The walker compares against a snapshot, the library itself stays on this thread
+    QHash<QString, QPair<qint64, qint64>> known;
+    known.reserve(m_library->count());
+    for (const MediaLibrary::Entry& entry : m_library->entries()) {
+        known.insert(entry.filePath, qMakePair(entry.size, entry.modifiedMs));
+    }
+    
+    const QStringList roots = m_library->roots();
+    
+    qDebug() << "LibraryScanner: Scanning" << roots.size() << "folders," << known.size() << "files known";
+    
+    m_walkThread = QThread::create([this, roots, known, workerCount]() {
+        PERF_TRACE_SCOPE("libraryWalk");
+        
+        QStringList changedFiles;
+        QSet<QString> seen;
+        QStringList offlineRoots;
+        
+        for (const QString& root : roots) {
+            // An unmounted drive or a NAS that is offline, its files are not gone
+            if (!QDir(root).exists()) {
+                qDebug() << "LibraryScanner: Folder not available, keeping its entries:" << root;
+                offlineRoots << (root.endsWith('/') ? root : root + '/');
+                continue;
+            }
+            
+            QDirIterator it(root, MediaLibrary::videoFileFilters(), QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext() && !m_cancelled) {
+                QFileInfo fileInfo(it.next());
+                QString filePath = fileInfo.absoluteFilePath();
+                seen.insert(filePath);
+                
+                auto knownIt = known.constFind(filePath);
+                if (knownIt == known.constEnd() || knownIt->first != fileInfo.size() ||
+                    knownIt->second != fileInfo.lastModified().toMSecsSinceEpoch()) {
+                    changedFiles << filePath;
+                }
+            }
+        }
+        
+        // Entries that were not found again are gone, unless their root is offline
+        QStringList removedFiles;
+        if (!m_cancelled) {
+            for (auto it = known.constBegin(); it != known.constEnd(); ++it) {
+                if (seen.contains(it.key())) {
+                    continue;
+                }
+                
+                bool offline = std::any_of(offlineRoots.cbegin(), offlineRoots.cend(), [&it](const QString& root) {
+                    return it.key().startsWith(root);
+                });
+                if (!offline) {
+                    removedFiles << it.key();
+                }
+            }
+        }
+        
+        QMetaObject::invokeMethod(this, [this, changedFiles, removedFiles, workerCount]() {
+            startWorkers(changedFiles, removedFiles, workerCount);
+        }, Qt::QueuedConnection);
+    });
+    
+    m_walkThread->setObjectName("libraryWalk");
+    connect(m_walkThread, &QThread::finished, m_walkThread, &QObject::deleteLater);
+    m_walkThread->start();
+}
+
+void LibraryScanner::cancel()
+{
+    m_cancelled = true;
+    
+    QMutexLocker locker(&m_queueMutex);
+    m_queue.clear();
+}
+
+void LibraryScanner::startWorkers(const QStringList& changedFiles, const QStringList& removedFiles, int workerCount)
+{
+    for (const QString& filePath : removedFiles) {
+        m_library->remove(filePath);
+    }
+    
+    m_removed = removedFiles.size();
+    m_total = changedFiles.size();
+    m_done = 0;
+    
+    qDebug() << "LibraryScanner:" << m_total << "files to parse," << m_removed << "removed";
+    
+    if (changedFiles.isEmpty() || m_cancelled) {
+        finishScan();
+        return;
+    }
+    
+    {
+        QMutexLocker locker(&m_queueMutex);
+        m_queue = changedFiles;
+    }
+    
+    if (workerCount <= 0) {
+        workerCount = QThread::idealThreadCount();
+    }
+    workerCount = qBound(1, workerCount, static_cast<int>(changedFiles.size()));
+    
+    m_workerThreads.clear();
+    m_activeWorkers = workerCount;
+    
+    for (int i = 0; i < workerCount; i++) {
+        QThread* thread = QThread::create([this]() {
+            workerLoop();
+        });
+        
+        thread->setObjectName(QString("libraryScan%1").arg(i));
+        connect(thread, &QThread::finished, this, &LibraryScanner::workerFinished);
+        connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+        m_workerThreads << thread;
+        thread->start();
+    }
+}
+
+void LibraryScanner::workerLoop()
+{
+    QString error;
+    libvlc_instance_t* instance = VP_VLCPlayer::createHeadlessInstance(&error);
+    if (!instance) {
+        qDebug() << "LibraryScanner: Worker has no VLC instance:" << error;
+        return;
+    }
+    
+    while (!m_cancelled) {
+        QString filePath;
+        {
+            QMutexLocker locker(&m_queueMutex);
+            if (m_queue.isEmpty()) {
+                break;
+            }
+            filePath = m_queue.takeFirst();
+        }
+        
+        MediaLibrary::Entry entry = parseFile(instance, filePath);
+        
+        QMetaObject::invokeMethod(this, [this, entry]() {
+            m_library->insert(entry);
+            m_done++;
+            emit entryUpdated(entry);
+            emit progress(m_done, m_total);
+        }, Qt::QueuedConnection);
+    }
+    
+    libvlc_release(instance);
+}
+
+void LibraryScanner::workerFinished()
+{
+    m_activeWorkers--;
+    
+    if (m_activeWorkers == 0) {
+        finishScan();
+    }
+}
+
+void LibraryScanner::finishScan()
+{
+    m_library->save();
+    m_scanning = false;
+    
+    qDebug() << "LibraryScanner: Scan finished," << m_done << "files parsed," << m_removed << "removed";
+    
+    emit finished(m_done, m_removed);
+}
+
+MediaLibrary::Entry LibraryScanner::parseFile(libvlc_instance_t* instance, const QString& filePath)
+{
+    PERF_TRACE_SCOPE("libraryParse");
+    
+    QFileInfo fileInfo(filePath);
+    
+    MediaLibrary::Entry entry;
+    entry.filePath = fileInfo.absoluteFilePath();
+    entry.size = fileInfo.size();
+    entry.modifiedMs = fileInfo.lastModified().toMSecsSinceEpoch();
+    entry.fingerprint = FileFingerprint::instance().fingerprint(entry.filePath);
+    
+    libvlc_media_t* media = libvlc_media_new_path(instance, QDir::toNativeSeparators(entry.filePath).toUtf8().constData());
+    if (!media) {
+        return entry;
+    }
+    
+    // Local parse only, no network lookups for artwork or metadata
+    QSemaphore parsed;
+    libvlc_event_manager_t* events = libvlc_media_event_manager(media);
+    libvlc_event_attach(events, libvlc_MediaParsedChanged, onMediaParsed, &parsed);
+    
+    if (libvlc_media_parse_with_options(media, libvlc_media_parse_local, ParseTimeoutMs) == 0) {
+        parsed.tryAcquire(1, ParseTimeoutMs + 1000);
+    }
+    
+    libvlc_event_detach(events, libvlc_MediaParsedChanged, onMediaParsed, &parsed);
+    
+    if (libvlc_media_get_parsed_status(media) == libvlc_media_parsed_status_done) {
+        MediaInfoCache::Info info = VP_VLCPlayer::parsedMediaInfo(media);
+        entry.durationMs = info.durationMs;
+        entry.videoSize = info.videoSize;
+        entry.codec = info.videoCodec;
+        entry.fps = info.fps;
+        
+        // Opening the file in the player can then skip the parse
+        MediaInfoCache::instance().store(entry.filePath, info);
+    } else {
+        qDebug() << "LibraryScanner: Failed to parse" << entry.filePath;
+    }
+    
+    if (!entry.videoSize.isEmpty() && !entry.fingerprint.isEmpty()) {
+        entry.hasPoster = capturePoster(instance, media, entry);
+    }
+    
+    libvlc_media_release(media);
+    return entry;
+}
+
+bool LibraryScanner::capturePoster(libvlc_instance_t* instance, libvlc_media_t* media, const MediaLibrary::Entry& entry)
+{
+    PERF_TRACE_SCOPE("libraryPoster");
+    
+    QString posterPath = MediaLibrary::posterPath(entry.fingerprint);
+    
+    // Same content scanned at another path
+    if (QFileInfo::exists(posterPath)) {
+        return true;
+    }
+    
+    // Even dimensions keep the chroma conversion happy
+    int width = PosterWidth;
+    int height = qMax(2, static_cast<int>(static_cast<qint64>(PosterWidth) * entry.videoSize.height() / entry.videoSize.width()) & ~1);
+    
+    PosterCapture capture;
+    capture.frame = QImage(width, height, QImage::Format_RGB32);
+    capture.scratch = QImage(width, height, QImage::Format_RGB32);
+    
+    // A tenth in skips black intros and title cards
+    libvlc_media_add_option(media, QString(":start-time=%1").arg(entry.durationMs / 10000.0, 0, 'f', 3).toUtf8().constData());
+    libvlc_media_add_option(media, ":no-audio");
+    
+    libvlc_media_player_t* player = libvlc_media_player_new_from_media(media);
+    if (!player) {
+        return false;
+    }
+    
+    // RV32 is BGRA in memory, the layout of QImage::Format_RGB32
+    libvlc_video_set_callbacks(player, lockPosterFrame, nullptr, displayPosterFrame, &capture);
+    libvlc_video_set_format(player, "RV32", width, height, width * 4);
+    
+    bool captured = libvlc_media_player_play(player) == 0 && capture.ready.tryAcquire(1, PosterTimeoutMs);
+    
+    // Stopping joins the video output, no callback touches the frame after this
+    libvlc_media_player_stop(player);
+    libvlc_media_player_release(player);
+    
+    if (!captured) {
+        qDebug() << "LibraryScanner: No poster frame for" << entry.filePath;
+        return false;
+    }
+    
+    QDir().mkpath(QFileInfo(posterPath).absolutePath());
+    return capture.frame.save(posterPath, "JPG", 85);
+}
@@ -0,0 +1,75 @@
+#ifndef LIBRARYSCANNER_H
+#define LIBRARYSCANNER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QThread>
+#include <atomic>
+#include "medialibrary.h"
+
+struct libvlc_instance_t;
+struct libvlc_media_t;
+
+/**
+ * @class LibraryScanner
+ * @brief Scans folders into a MediaLibrary with a pool of headless libvlc parsers
+ *
+ * A walker thread lists the video files under the roots and queues those the
+ * library has not seen at their current size and modification time. Worker
+ * threads, each with its own libvlc instance, parse the queued files for
+ * duration, resolution, codec and frame rate and grab a poster frame. Results
+ * are applied to the library on the scanner's thread, the index is saved when
+ * the scan finishes.
+ */
+class LibraryScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LibraryScanner(MediaLibrary* library, QObject* parent = nullptr);
+    ~LibraryScanner();
+    
+    // Scan the library's roots, workerCount 0 uses one worker per core
+    void scan(int workerCount = 0);
+    
+    // Stop after the files being parsed, finished() still follows
+    void cancel();
+    
+    bool isScanning() const { return m_scanning; }
+    
+    // Parse one file and save its poster (blocking, any thread)
+    static MediaLibrary::Entry parseFile(libvlc_instance_t* instance, const QString& filePath);
+
+signals:
+    void progress(int done, int total);
+    void entryUpdated(const MediaLibrary::Entry& entry);
+    void finished(int updated, int removed);
+
+private:
+    void startWorkers(const QStringList& changedFiles, const QStringList& removedFiles, int workerCount);
+    void workerLoop();
+    void workerFinished();
+    void finishScan();
+    static bool capturePoster(libvlc_instance_t* instance, libvlc_media_t* media, const MediaLibrary::Entry& entry);
+    
+    MediaLibrary* m_library;
+    bool m_scanning;
+    std::atomic<bool> m_cancelled;
+    QPointer<QThread> m_walkThread;
+    QList<QPointer<QThread>> m_workerThreads;
+    int m_activeWorkers;
+    
+    // Files waiting for a worker
+    QMutex m_queueMutex;
+    QStringList m_queue;
+    
+    int m_total;
+    int m_done;
+    int m_removed;
+};
+
+#endif // LIBRARYSCANNER_H
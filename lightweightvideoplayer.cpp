@@ -1,6 +1,14 @@
 #include "lightweightvideoplayer.h"
 #include "keybindeditordialog.h"
 #include "stateseditordialog.h"
+#include "librarybrowserdialog.h"
+#include "perftracer.h"
+#include "statestorage.h"
+#include "archivereader.h"
+#include "chunkcache.h"
+#include "timeshiftbuffer.h"
+#include "keyframeindex.h"
+#include "vp_vlcplayer.h"
 #include <QGuiApplication>
 #include <QDebug>
 #include <QFileInfo>
@@ -17,6 +25,9 @@
 #include <QTimer>
 #include <QCoreApplication>
 #include <QDir>
+#include <QCollator>
+#include <QInputDialog>
+#include <algorithm>
 
 // Custom clickable slider class for seeking in video
 class LightweightVideoPlayer::ClickableSlider : public QSlider
@@ -97,13 +108,20 @@ private:
 };
 
 LightweightVideoPlayer::LightweightVideoPlayer(QWidget *parent, int initialVolume)
+    : LightweightVideoPlayer(nullptr, parent, initialVolume)
+{
+}
+
+LightweightVideoPlayer::LightweightVideoPlayer(std::unique_ptr<VP_PlayerBackend> backend, QWidget *parent, int initialVolume)
     : QWidget(parent)
+    , m_mediaPlayer(std::move(backend))
     , m_videoWidget(nullptr)
     , m_playButton(nullptr)
     , m_stopButton(nullptr)
     , m_fullScreenButton(nullptr)
     , m_keybindsButton(nullptr)
     , m_editStatesButton(nullptr)
+    , m_libraryButton(nullptr)
     , m_positionSlider(nullptr)
     , m_volumeSlider(nullptr)
     , m_speedSpinBox(nullptr)
@@ -123,11 +141,23 @@ LightweightVideoPlayer::LightweightVideoPlayer(QWidget *parent, int initialVolum
     , m_mouseCheckTimer(nullptr)
     , m_lastMousePos(QPoint(-1, -1))
     , m_messageLabel(nullptr)
+    , m_perfOverlay(nullptr)
+    , m_perfOverlayTimer(nullptr)
+    , m_frameOverlay(nullptr)
+    , m_stateFramesTimer(nullptr)
     , m_currentStateGroup(0)
     , m_loopMode(LoopMode::NoLoop)
     , m_loadPlaybackSpeed(true)
+    , m_snapStatesToKeyframes(false)
     , m_currentLoopStateIndex(-1)
     , m_lastClickedPosition(-1)
+    , m_playWhenReady(false)
+    , m_windowPaintRecorded(false)
+    , m_firstFrameRecorded(false)
+    , m_playlistIndex(-1)
+    , m_autoAdvance(false)
+    , m_resumePosition(-1)
+    , m_resumeSaveTimer(nullptr)
 {
     qDebug() << "LightweightVideoPlayer: Constructor called";
     
@@ -168,6 +198,24 @@ LightweightVideoPlayer::~LightweightVideoPlayer()
         delete m_mouseCheckTimer;
     }
     
+    if (m_resumeSaveTimer) {
+        m_resumeSaveTimer->stop();
+    }
+    
+    // Closing already saved the session, this covers a player destroyed without closing
+    if (!m_isClosing) {
+        saveResumeState();
+    }
+    
+    // The read-ahead thread reports back to this object
+    if (m_prefetchThread) {
+        m_prefetchThread->wait();
+    }
+    
+    if (m_storageThread) {
+        m_storageThread->wait();
+    }
+    
     // Stop media player
     if (m_mediaPlayer) {
         m_mediaPlayer->stop();
@@ -186,16 +234,14 @@ void LightweightVideoPlayer::initializePlayer()
                            tr("Failed to initialize keybind system. Using defaults."));
     }
 
-    // Create VLC player instance
-    m_mediaPlayer = std::make_unique<VP_VLCPlayer>(this);
-
-    if (!m_mediaPlayer->initialize()) {
-        qDebug() << "LightweightVideoPlayer: Failed to initialize VLC player";
-        emit errorOccurred(tr("Failed to initialize video player"));
-        return;
+    // Create VLC player instance unless a backend was supplied
+    if (!m_mediaPlayer) {
+        m_mediaPlayer = std::make_unique<VP_VLCPlayer>(this);
+    } else {
+        m_mediaPlayer->setParent(this);
     }
 
-    // Setup UI
+    // Setup UI first so the window can paint while VLC starts
     setupUI();
 
     // Connect signals
@@ -210,6 +256,24 @@ void LightweightVideoPlayer::initializePlayer()
     m_mouseCheckTimer->setInterval(100);
     connect(m_mouseCheckTimer, &QTimer::timeout, this, &LightweightVideoPlayer::checkMouseMovement);
     
+    // Per-file sessions, flushed every few seconds so a crash loses little
+    m_resumeStore = std::make_unique<ResumeStore>(ResumeStore::defaultPath());
+    m_resumeSaveTimer = new QTimer(this);
+    m_resumeSaveTimer->setInterval(5000);
+    connect(m_resumeSaveTimer, &QTimer::timeout, this, &LightweightVideoPlayer::saveResumeState);
+    m_resumeSaveTimer->start();
+    
+    // Index the saved states and move files of the flat layout into shards off the GUI thread
+    m_storageThread = QThread::create([]() {
+        StateStorage::instance().migrateFlatLayout();
+    });
+    m_storageThread->setObjectName("stateStorage");
+    connect(m_storageThread, &QThread::finished, m_storageThread, &QObject::deleteLater);
+    m_storageThread->start();
+    
+    // Create the VLC instance in the background, a video requested meanwhile is queued
+    m_mediaPlayer->initializeAsync();
+    
     qDebug() << "LightweightVideoPlayer: Initialization complete";
 }
 
@@ -241,6 +305,38 @@ void LightweightVideoPlayer::setupUI()
     m_messageLabel->setVisible(false);
     m_messageLabel->raise();  // Ensure it's on top
     
+    // Create performance overlay (top left, hidden until toggled)
+    m_perfOverlay = new QLabel(this);
+    m_perfOverlay->setStyleSheet(
+        "QLabel {"
+        "    background-color: rgba(0, 0, 0, 160);"
+        "    color: white;"
+        "    font-family: monospace;"
+        "    font-size: 12px;"
+        "    padding: 6px;"
+        "}"
+    );
+    m_perfOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    m_perfOverlay->move(10, 10);
+    m_perfOverlay->setVisible(false);
+    
+    m_perfOverlayTimer = new QTimer(this);
+    m_perfOverlayTimer->setInterval(500);
+    connect(m_perfOverlayTimer, &QTimer::timeout, this, &LightweightVideoPlayer::updatePerfOverlay);
+    
+    m_stateFramesTimer = new QTimer(this);
+    m_stateFramesTimer->setSingleShot(true);
+    m_stateFramesTimer->setInterval(200);
+    connect(m_stateFramesTimer, &QTimer::timeout, this, &LightweightVideoPlayer::updateStateFrames);
+    
+    // Frames stepped back to cover the video, which still shows the frame it paused on
+    m_frameOverlay = new QLabel(this);
+    m_frameOverlay->setAttribute(Qt::WA_NativeWindow);
+    m_frameOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    m_frameOverlay->setStyleSheet("background-color: black;");
+    m_frameOverlay->setAlignment(Qt::AlignCenter);
+    m_frameOverlay->setVisible(false);
+    
     // Create controls
     createControls();
     
@@ -285,6 +381,11 @@ void LightweightVideoPlayer::createControls()
     m_editStatesButton->setToolTip(tr("Edit Playback States"));
     m_editStatesButton->setFocusPolicy(Qt::NoFocus);
     
+    // Library button
+    m_libraryButton = new QPushButton(tr("Library"), this);
+    m_libraryButton->setToolTip(tr("Browse the Media Library"));
+    m_libraryButton->setFocusPolicy(Qt::NoFocus);
+    
     // Position slider
     m_positionSlider = createClickableSlider();
     m_positionSlider->setRange(0, 0);
@@ -301,13 +402,13 @@ void LightweightVideoPlayer::createControls()
     
     // Speed spin box
     m_speedSpinBox = new QDoubleSpinBox(this);
-    m_speedSpinBox->setRange(0.1, 5.0);
+    m_speedSpinBox->setRange(VP_VLCPlayer::MinRate, VP_VLCPlayer::MaxSkimRate);
     m_speedSpinBox->setSingleStep(0.1);
     m_speedSpinBox->setValue(1.0);
     m_speedSpinBox->setSuffix("x");
-    m_speedSpinBox->setDecimals(1);
+    m_speedSpinBox->setDecimals(2);
     m_speedSpinBox->setMaximumWidth(80);
-    m_speedSpinBox->setToolTip(tr("Playback Speed"));
+    m_speedSpinBox->setToolTip(tr("Playback Speed\nAbove 4x: skim through frames without audio\nBelow 0.25x: step frame by frame without audio"));
     m_speedSpinBox->setFocusPolicy(Qt::NoFocus);
     
     // Labels
@@ -332,6 +433,7 @@ void LightweightVideoPlayer::createLayouts()
     m_controlLayout->addWidget(m_fullScreenButton);
     m_controlLayout->addWidget(m_keybindsButton);
     m_controlLayout->addWidget(m_editStatesButton);
+    m_controlLayout->addWidget(m_libraryButton);
     m_controlLayout->addStretch();
     
     // Slider layout (position, volume, and speed)
@@ -397,6 +499,11 @@ void LightweightVideoPlayer::connectSignals()
                 this, &LightweightVideoPlayer::openStatesEditor);
     }
     
+    if (m_libraryButton) {
+        connect(m_libraryButton, &QPushButton::clicked,
+                this, &LightweightVideoPlayer::openLibraryBrowser);
+    }
+    
     // Slider signals
     if (m_positionSlider) {
         connect(m_positionSlider, &QSlider::sliderMoved,
@@ -420,36 +527,70 @@ void LightweightVideoPlayer::connectSignals()
     }
     
     // Media player signals
-    connect(m_mediaPlayer.get(), &VP_VLCPlayer::positionChanged,
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::positionChanged,
             this, &LightweightVideoPlayer::updatePosition);
     
-    connect(m_mediaPlayer.get(), &VP_VLCPlayer::durationChanged,
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::durationChanged,
             this, &LightweightVideoPlayer::updateDuration);
     
-    connect(m_mediaPlayer.get(), &VP_VLCPlayer::stateChanged,
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::seekableRangeChanged,
+            this, &LightweightVideoPlayer::updateSeekableRange);
+    
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::frameOverlayChanged,
+            this, &LightweightVideoPlayer::updateFrameOverlay);
+    
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::stateChanged,
             this, &LightweightVideoPlayer::handlePlaybackStateChanged);
     
-    connect(m_mediaPlayer.get(), &VP_VLCPlayer::errorOccurred,
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::errorOccurred,
             this, &LightweightVideoPlayer::handleError);
     
-    connect(m_mediaPlayer.get(), &VP_VLCPlayer::finished,
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::finished,
             this, &LightweightVideoPlayer::handleVideoFinished);
+    
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::initialized,
+            this, &LightweightVideoPlayer::handlePlayerInitialized);
+    
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::firstFrameRendered,
+            this, &LightweightVideoPlayer::handleFirstFrameRendered);
+    
+    connect(m_mediaPlayer.get(), &VP_PlayerBackend::bufferingProgress,
+            this, &LightweightVideoPlayer::handleBufferingProgress);
+    
+    // Snapped states are recalled elsewhere once the keyframes are known
+    if (auto* vlcPlayer = qobject_cast<VP_VLCPlayer*>(m_mediaPlayer.get())) {
+        connect(vlcPlayer, &VP_VLCPlayer::keyframeIndexChanged, m_stateFramesTimer, qOverload<>(&QTimer::start));
+    }
 }
 
 bool LightweightVideoPlayer::loadVideo(const QString& filePath)
 {
     qDebug() << "LightweightVideoPlayer: Loading video:" << filePath;
     
+    PERF_TRACE_SCOPE("loadVideo");
+    
     QFileInfo fileInfo(filePath);
     
-    if (!fileInfo.exists()) {
+    if (!VP_VLCPlayer::isUrl(filePath) && !ArchiveReader::exists(filePath)) {
         qDebug() << "LightweightVideoPlayer: File does not exist:" << filePath;
         emit errorOccurred(tr("File not found: %1").arg(filePath));
         return false;
     }
     
+    // VLC is still starting, load the file once it is ready
+    if (!m_mediaPlayer->isInitialized()) {
+        qDebug() << "LightweightVideoPlayer: Player not ready yet, queueing:" << filePath;
+        m_pendingVideoPath = filePath;
+        m_playWhenReady = false;
+        setWindowTitle(tr("%1").arg(fileInfo.fileName()));
+        return true;
+    }
+    
+    // Remember where the previous file was left
+    saveResumeState();
+    
     // Stop current playback if any
-    if (m_mediaPlayer->isPlaying()) {
+    if (!m_mediaPlayer->isStopped()) {
         m_mediaPlayer->stop();
     }
     
@@ -463,6 +604,14 @@ bool LightweightVideoPlayer::loadVideo(const QString& filePath)
     // Store the media path
     m_currentVideoPath = filePath;
     
+    // Keep the playlist position in sync when a file is opened directly
+    if (m_playlist.value(m_playlistIndex) != filePath) {
+        m_playlistIndex = m_playlist.indexOf(filePath);
+    }
+    
+    // Restore the last session of this file (also selects its state group) before play()
+    restoreResumeState();
+    
     // Load saved states for current group from file
     loadStateGroupFromFile(m_currentStateGroup);
     
@@ -483,10 +632,170 @@ bool LightweightVideoPlayer::loadVideo(const QString& filePath)
     return true;
 }
 
+QStringList LightweightVideoPlayer::videoFilesInDirectory(const QString& directoryPath)
+{
+    // A folder inside an archive ("videos.zip!/season1", or just "videos.zip!")
+    QString archivePath;
+    QString archiveDirectory;
+    if (ArchiveReader::splitPath(directoryPath + "/", &archivePath, &archiveDirectory)) {
+        archiveDirectory.chop(1);
+        return ArchiveReader::entryPaths(archivePath, MediaLibrary::videoFileFilters(), archiveDirectory, false);
+    }
+    
+    QDir dir(directoryPath);
+    const QFileInfoList entries = dir.entryInfoList(MediaLibrary::videoFileFilters(), QDir::Files);
+    
+    QStringList files;
+    for (const QFileInfo& entry : entries) {
+        files << entry.absoluteFilePath();
+    }
+    
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::sort(files.begin(), files.end(), [&collator](const QString& a, const QString& b) {
+        return collator.compare(a, b) < 0;
+    });
+    
+    return files;
+}
+
+bool LightweightVideoPlayer::openFiles(const QStringList& filePaths)
+{
+    if (filePaths.isEmpty()) {
+        return false;
+    }
+    
+    if (filePaths.size() == 1 && VP_VLCPlayer::isUrl(filePaths.first())) {
+        // A stream has no folder to bring along
+        setPlaylist(filePaths, 0);
+    } else if (filePaths.size() == 1 && ArchiveReader::isArchive(filePaths.first()) && QFileInfo(filePaths.first()).isFile()) {
+        // An archive opens as a playlist of all the videos in it
+        QStringList archiveFiles = ArchiveReader::entryPaths(filePaths.first(), MediaLibrary::videoFileFilters());
+        if (archiveFiles.isEmpty()) {
+            emit errorOccurred(tr("No videos in %1").arg(QFileInfo(filePaths.first()).fileName()));
+            return false;
+        }
+        
+        setPlaylist(archiveFiles, 0);
+    } else if (filePaths.size() == 1) {
+        // A single file brings the rest of its folder along
+        QFileInfo fileInfo(filePaths.first());
+        QStringList folderFiles = videoFilesInDirectory(fileInfo.absolutePath());
+        int index = folderFiles.indexOf(fileInfo.absoluteFilePath());
+        
+        if (index < 0) {
+            folderFiles = QStringList() << fileInfo.absoluteFilePath();
+            index = 0;
+        }
+        
+        setPlaylist(folderFiles, index);
+    } else {
+        QStringList files;
+        for (const QString& filePath : filePaths) {
+            files << (VP_VLCPlayer::isUrl(filePath) ? filePath : QFileInfo(filePath).absoluteFilePath());
+        }
+        setPlaylist(files, 0);
+    }
+    
+    return loadVideo(m_playlist.at(m_playlistIndex));
+}
+
+void LightweightVideoPlayer::setPlaylist(const QStringList& filePaths, int currentIndex)
+{
+    m_playlist = filePaths;
+    m_playlistIndex = (currentIndex >= 0 && currentIndex < m_playlist.size()) ? currentIndex : -1;
+    
+    qDebug() << "LightweightVideoPlayer: Playlist with" << m_playlist.size() << "files, current index" << m_playlistIndex;
+}
+
+bool LightweightVideoPlayer::playNext()
+{
+    if (m_playlistIndex < 0 || m_playlistIndex + 1 >= m_playlist.size()) {
+        showTemporaryMessage(tr("Last file in playlist"));
+        return false;
+    }
+    
+    return playPlaylistIndex(m_playlistIndex + 1);
+}
+
+bool LightweightVideoPlayer::playPrevious()
+{
+    if (m_playlistIndex <= 0) {
+        showTemporaryMessage(tr("First file in playlist"));
+        return false;
+    }
+    
+    return playPlaylistIndex(m_playlistIndex - 1);
+}
+
+bool LightweightVideoPlayer::playPlaylistIndex(int index)
+{
+    PERF_TRACE_SCOPE("playlistSwitch");
+    
+    m_playlistIndex = index;
+    
+    if (!loadVideo(m_playlist.at(index))) {
+        return false;
+    }
+    
+    play();
+    showTemporaryMessage(tr("%1 / %2: %3").arg(index + 1).arg(m_playlist.size()).arg(QFileInfo(m_playlist.at(index)).fileName()));
+    return true;
+}
+
+void LightweightVideoPlayer::prefetchNextFile()
+{
+    if (m_playlistIndex < 0 || m_playlistIndex + 1 >= m_playlist.size()) {
+        return;
+    }
+    
+    const QString nextPath = m_playlist.at(m_playlistIndex + 1);
+    
+    // Open and parse the media so loadMedia() can reuse it
+    m_mediaPlayer->prepareMedia(nextPath);
+    
+    if (m_prefetchThread) {
+        return;
+    }
+    
+    // Read the state group that will be active after switching (fingerprinting the
+    // next file on the way, so its states path is cached by the time it is opened)
+    const int groupIndex = m_currentStateGroup;
+    
+    m_prefetchThread = QThread::create([this, nextPath, groupIndex]() {
+        const QString statesPath = statesFilePath(nextPath, groupIndex);
+        if (statesPath.isEmpty()) {
+            return;
+        }
+        
+        auto data = std::make_shared<StateGroupData>();
+        if (!readStateGroupFile(statesPath, *data)) {
+            return;
+        }
+        
+        QMetaObject::invokeMethod(this, [this, statesPath, data]() {
+            m_prefetchedStatesPath = statesPath;
+            m_prefetchedStates = *data;
+        }, Qt::QueuedConnection);
+    });
+    
+    m_prefetchThread->setObjectName("statePrefetch");
+    connect(m_prefetchThread, &QThread::finished, m_prefetchThread, &QObject::deleteLater);
+    m_prefetchThread->start();
+    
+    qDebug() << "LightweightVideoPlayer: Prefetching next file:" << nextPath;
+}
+
 void LightweightVideoPlayer::play()
 {
     qDebug() << "LightweightVideoPlayer: Play requested";
     
+    if (!m_pendingVideoPath.isEmpty()) {
+        m_playWhenReady = true;
+        return;
+    }
+    
     if (m_currentVideoPath.isEmpty()) {
         qDebug() << "LightweightVideoPlayer: No video loaded";
         emit errorOccurred(tr("No video loaded"));
@@ -555,7 +864,7 @@ void LightweightVideoPlayer::setPosition(qint64 position)
     
     qint64 duration = m_mediaPlayer->duration();
     if (duration > 0) {
-        position = qBound(static_cast<qint64>(0), position, duration);
+        position = qBound(m_mediaPlayer->seekableStart(), position, duration);
     }
     
     m_mediaPlayer->setPosition(position);
@@ -572,7 +881,7 @@ void LightweightVideoPlayer::setPlaybackSpeed(qreal speed, bool showMessage)
 {
     qDebug() << "LightweightVideoPlayer: Setting playback speed to" << speed;
     
-    speed = qBound(0.1, speed, 5.0);
+    speed = qBound(static_cast<qreal>(VP_VLCPlayer::MinRate), speed, static_cast<qreal>(VP_VLCPlayer::MaxSkimRate));
     
     if (m_mediaPlayer) {
         m_mediaPlayer->setPlaybackRate(static_cast<float>(speed));
@@ -586,7 +895,13 @@ void LightweightVideoPlayer::setPlaybackSpeed(qreal speed, bool showMessage)
     
     // Show temporary message if requested (keybind actions only)
     if (showMessage) {
-        showTemporaryMessage(tr("Speed: %1x").arg(speed, 0, 'f', 1));
+        if (speed > VP_VLCPlayer::MaxNativeRate) {
+            showTemporaryMessage(tr("Speed: %1x (skim)").arg(speed, 0, 'f', 1));
+        } else if (speed < VP_VLCPlayer::MinNativeRate) {
+            showTemporaryMessage(tr("Speed: %1x (frame step)").arg(speed, 0, 'f', 2));
+        } else {
+            showTemporaryMessage(tr("Speed: %1x").arg(speed, 0, 'f', 1));
+        }
     }
     
     emit playbackSpeedChanged(speed);
@@ -788,7 +1103,8 @@ void LightweightVideoPlayer::updateDuration(qint64 duration)
     qDebug() << "LightweightVideoPlayer: Duration updated to" << duration << "ms";
     
     if (m_positionSlider) {
-        m_positionSlider->setMaximum(static_cast<int>(duration));
+        qint64 start = m_mediaPlayer ? m_mediaPlayer->seekableStart() : 0;
+        m_positionSlider->setRange(static_cast<int>(start), static_cast<int>(duration));
     }
     if (m_durationLabel) {
         m_durationLabel->setText(formatTime(duration));
@@ -797,13 +1113,123 @@ void LightweightVideoPlayer::updateDuration(qint64 duration)
     emit durationChanged(duration);
 }
 
+void LightweightVideoPlayer::updateSeekableRange(qint64 start, qint64 end)
+{
+    // Timeshift window, moves every second while a live stream plays
+    if (m_positionSlider) {
+        m_positionSlider->setRange(static_cast<int>(start), static_cast<int>(end));
+    }
+    if (m_durationLabel) {
+        m_durationLabel->setText(formatTime(end));
+    }
+}
+
+void LightweightVideoPlayer::updateFrameOverlay(const QImage& frame)
+{
+    if (!m_frameOverlay) {
+        return;
+    }
+    
+    m_frameOverlayImage = frame;
+    if (frame.isNull()) {
+        m_frameOverlay->hide();
+        m_frameOverlay->clear();
+        return;
+    }
+    
+    layoutFrameOverlay();
+    m_frameOverlay->show();
+    m_frameOverlay->raise();
+    
+    // The message and the counters stay readable over it
+    if (m_messageLabel) {
+        m_messageLabel->raise();
+    }
+    if (m_perfOverlay) {
+        m_perfOverlay->raise();
+    }
+}
+
+void LightweightVideoPlayer::layoutFrameOverlay()
+{
+    if (!m_frameOverlay || !m_videoWidget || m_frameOverlayImage.isNull()) {
+        return;
+    }
+    
+    m_frameOverlay->setGeometry(m_videoWidget->geometry());
+    
+    // Fitted like VLC fits the video, so the picture does not jump when the video takes over
+    QPixmap pixmap = QPixmap::fromImage(m_frameOverlayImage.scaled(m_videoWidget->size() * devicePixelRatioF(),
+                                                                   Qt::KeepAspectRatio, Qt::SmoothTransformation));
+    pixmap.setDevicePixelRatio(devicePixelRatioF());
+    m_frameOverlay->setPixmap(pixmap);
+}
+
 void LightweightVideoPlayer::handleError(const QString &errorString)
 {
     qDebug() << "LightweightVideoPlayer: Error occurred:" << errorString;
     emit errorOccurred(errorString);
 }
 
-void LightweightVideoPlayer::handlePlaybackStateChanged(VP_VLCPlayer::PlayerState state)
+void LightweightVideoPlayer::handlePlayerInitialized(bool success)
+{
+    if (!success) {
+        qDebug() << "LightweightVideoPlayer: Failed to initialize VLC player";
+        m_pendingVideoPath.clear();
+        m_playWhenReady = false;
+        emit errorOccurred(tr("Failed to initialize video player"));
+        return;
+    }
+    
+    PerfTracer::instance().recordSpan("timeToPlayerReady", "startup", 0, PerfTracer::now());
+    
+    if (m_pendingVideoPath.isEmpty()) {
+        return;
+    }
+    
+    QString filePath = m_pendingVideoPath;
+    bool playWhenReady = m_playWhenReady;
+    m_pendingVideoPath.clear();
+    m_playWhenReady = false;
+    
+    if (loadVideo(filePath) && playWhenReady) {
+        play();
+    }
+}
+
+void LightweightVideoPlayer::handleFirstFrameRendered()
+{
+    // Only the first frame since process start is part of the startup trace
+    if (!m_firstFrameRecorded) {
+        m_firstFrameRecorded = true;
+        PerfTracer::instance().recordSpan("timeToFirstFrame", "startup", 0, PerfTracer::now());
+    }
+    
+    // The backend reports the real position from now on
+    m_resumePosition = -1;
+    
+    // The current file is playing, read ahead the next one
+    prefetchNextFile();
+}
+
+void LightweightVideoPlayer::handleBufferingProgress(int percent)
+{
+    // Local files fill VLC's small cache before anyone could read the message
+    if (!VP_VLCPlayer::isUrl(m_currentVideoPath)) {
+        return;
+    }
+    
+    if (percent < 100) {
+        showTemporaryMessage(tr("Buffering %1%").arg(percent));
+    } else if (auto* vlcPlayer = qobject_cast<VP_VLCPlayer*>(m_mediaPlayer.get())) {
+        VP_VLCPlayer::StreamMetrics metrics = vlcPlayer->streamMetrics();
+        if (metrics.rebufferCount > 0) {
+            showTemporaryMessage(tr("Buffered (%1 stalls, %2 s)").arg(metrics.rebufferCount).arg(metrics.rebufferMs / 1000.0, 0, 'f', 1));
+        }
+    }
+}
+
+void LightweightVideoPlayer::handlePlaybackStateChanged(VP_PlayerBackend::PlayerState state)
 {
     qDebug() << "LightweightVideoPlayer: Playback state changed to" << static_cast<int>(state);
     
@@ -813,7 +1239,7 @@ void LightweightVideoPlayer::handlePlaybackStateChanged(VP_VLCPlayer::PlayerStat
     }
     
     switch (state) {
-        case VP_VLCPlayer::PlayerState::Playing:
+        case VP_PlayerBackend::PlayerState::Playing:
             m_playButton->setIcon(style()->standardIcon(QStyle::SP_MediaPause));
             m_playButton->setToolTip(tr("Pause"));
             
@@ -823,12 +1249,12 @@ void LightweightVideoPlayer::handlePlaybackStateChanged(VP_VLCPlayer::PlayerStat
             }
             break;
             
-        case VP_VLCPlayer::PlayerState::Paused:
+        case VP_PlayerBackend::PlayerState::Paused:
             m_playButton->setIcon(style()->standardIcon(QStyle::SP_MediaPlay));
             m_playButton->setToolTip(tr("Play"));
             break;
             
-        case VP_VLCPlayer::PlayerState::Stopped:
+        case VP_PlayerBackend::PlayerState::Stopped:
             m_playButton->setIcon(style()->standardIcon(QStyle::SP_MediaPlay));
             m_playButton->setToolTip(tr("Play"));
             m_playbackStartedEmitted = false;
@@ -845,6 +1271,13 @@ void LightweightVideoPlayer::handleVideoFinished()
 {
     qDebug() << "LightweightVideoPlayer: Video finished";
     
+    // Continue with the next file, its media was prepared while this one played
+    if (m_autoAdvance && m_playlistIndex >= 0 && m_playlistIndex + 1 < m_playlist.size()) {
+        emit finished();
+        playNext();
+        return;
+    }
+    
     // Update UI to reflect that we're at the beginning and paused
     if (m_positionSlider) {
         m_positionSlider->setValue(0);
@@ -925,6 +1358,16 @@ void LightweightVideoPlayer::stopCursorTimer()
 }
 
 // Event handlers
+void LightweightVideoPlayer::paintEvent(QPaintEvent *event)
+{
+    if (!m_windowPaintRecorded) {
+        m_windowPaintRecorded = true;
+        PerfTracer::instance().recordSpan("timeToWindow", "startup", 0, PerfTracer::now());
+    }
+    
+    QWidget::paintEvent(event);
+}
+
 void LightweightVideoPlayer::closeEvent(QCloseEvent *event)
 {
     qDebug() << "LightweightVideoPlayer: Close event received";
@@ -932,6 +1375,9 @@ void LightweightVideoPlayer::closeEvent(QCloseEvent *event)
     if (!m_isClosing) {
         m_isClosing = true;
         
+        // Save the session while the position is still known
+        saveResumeState();
+        
         // Stop playback
         if (m_mediaPlayer) {
             m_mediaPlayer->stop();
@@ -1085,6 +1531,16 @@ void LightweightVideoPlayer::keyPressEvent(QKeyEvent *event)
             KeybindManager::Action::ToggleLoadSpeed,
             KeybindManager::Action::CycleLoopMode,
             KeybindManager::Action::ReturnToLastPosition,
+            KeybindManager::Action::NextFile,
+            KeybindManager::Action::PreviousFile,
+            KeybindManager::Action::OpenLibrary,
+            KeybindManager::Action::OpenUrl,
+            KeybindManager::Action::PerfOverlay,
+            KeybindManager::Action::Timeshift,
+            KeybindManager::Action::FrameForward,
+            KeybindManager::Action::FrameBackward,
+            KeybindManager::Action::Reverse,
+            KeybindManager::Action::ToggleKeyframeSnap,
             KeybindManager::Action::StateGroup1,
             KeybindManager::Action::StateGroup2,
             KeybindManager::Action::StateGroup3,
@@ -1134,12 +1590,25 @@ void LightweightVideoPlayer::keyPressEvent(QKeyEvent *event)
                         break;
                         
                     case KeybindManager::Action::SpeedUp:
-                        setPlaybackSpeed(playbackSpeed() + 0.1, true);  // Show message for keybind action
+                        // Skim speeds double, 4x to 32x in three steps
+                        if (playbackSpeed() > VP_VLCPlayer::MaxNativeRate - 0.05) {
+                            setPlaybackSpeed(playbackSpeed() * 2, true);
+                        } else if (playbackSpeed() < VP_VLCPlayer::MinNativeRate - 0.005) {
+                            // Slow motion doubles back up to 0.25x
+                            setPlaybackSpeed(qMin(playbackSpeed() * 2, static_cast<qreal>(VP_VLCPlayer::MinNativeRate)), true);
+                        } else {
+                            setPlaybackSpeed(playbackSpeed() + 0.1, true);  // Show message for keybind action
+                        }
                         handled = true;
                         break;
                         
                     case KeybindManager::Action::SpeedDown:
-                        setPlaybackSpeed(playbackSpeed() - 0.1, true);  // Show message for keybind action
+                        if (playbackSpeed() > VP_VLCPlayer::MaxNativeRate + 0.05 ||
+                            playbackSpeed() < VP_VLCPlayer::MinNativeRate + 0.005) {
+                            setPlaybackSpeed(playbackSpeed() / 2, true);
+                        } else {
+                            setPlaybackSpeed(playbackSpeed() - 0.1, true);  // Show message for keybind action
+                        }
                         handled = true;
                         break;
                         
@@ -1158,6 +1627,56 @@ void LightweightVideoPlayer::keyPressEvent(QKeyEvent *event)
                         handled = true;
                         break;
                         
+                    case KeybindManager::Action::NextFile:
+                        playNext();
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::PreviousFile:
+                        playPrevious();
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::OpenLibrary:
+                        openLibraryBrowser();
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::OpenUrl:
+                        openUrl();
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::PerfOverlay:
+                        togglePerfOverlay();
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::Timeshift:
+                        toggleTimeshift();
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::FrameForward:
+                        m_mediaPlayer->stepFrame(true);
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::FrameBackward:
+                        m_mediaPlayer->stepFrame(false);
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::Reverse:
+                        toggleReverse();
+                        handled = true;
+                        break;
+                    
+                    case KeybindManager::Action::ToggleKeyframeSnap:
+                        toggleKeyframeSnap();
+                        handled = true;
+                        break;
+                    
                     case KeybindManager::Action::StateGroup1:
                         switchStateGroup(0);
                         handled = true;
@@ -1223,6 +1742,11 @@ void LightweightVideoPlayer::mouseMoveEvent(QMouseEvent *event)
 
 bool LightweightVideoPlayer::eventFilter(QObject *watched, QEvent *event)
 {
+    // The frame overlay follows the video through resizes and full screen
+    if (watched == m_videoWidget && (event->type() == QEvent::Resize || event->type() == QEvent::Move)) {
+        layoutFrameOverlay();
+    }
+    
     // Handle double-click on video widget for fullscreen toggle
     if (watched == m_videoWidget && event->type() == QEvent::MouseButtonDblClick) {
         QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
@@ -1256,7 +1780,13 @@ void LightweightVideoPlayer::openKeybindEditor()
         return;
     }
     
+    qint64 traceStart = PerfTracer::now();
     KeybindEditorDialog dialog(m_keybindManager.get(), this);
+    
+    // The first event loop pass inside exec() happens once the dialog is shown
+    QTimer::singleShot(0, &dialog, [traceStart]() {
+        PerfTracer::instance().recordSpan("openKeybindEditor", "ui", traceStart, PerfTracer::now());
+    });
     dialog.exec();
 }
 
@@ -1279,10 +1809,149 @@ void LightweightVideoPlayer::openStatesEditor()
     // The current group in RAM is always up-to-date with any Ctrl+1-9 changes
     // The dialog will load directly from this RAM state
     
+    qint64 traceStart = PerfTracer::now();
     StatesEditorDialog dialog(this, this);
+    
+    // The first event loop pass inside exec() happens once the dialog is shown
+    QTimer::singleShot(0, &dialog, [traceStart]() {
+        PerfTracer::instance().recordSpan("openStatesEditor", "ui", traceStart, PerfTracer::now());
+    });
     dialog.exec();
 }
 
+void LightweightVideoPlayer::openLibraryBrowser()
+{
+    qDebug() << "LightweightVideoPlayer: Opening library browser";
+    
+    qint64 traceStart = PerfTracer::now();
+    LibraryBrowserDialog dialog(this);
+    
+    QTimer::singleShot(0, &dialog, [traceStart]() {
+        PerfTracer::instance().recordSpan("openLibraryBrowser", "ui", traceStart, PerfTracer::now());
+    });
+    
+    if (dialog.exec() == QDialog::Accepted && openFiles({dialog.selectedFile()})) {
+        play();
+    }
+}
+
+void LightweightVideoPlayer::openUrl()
+{
+    bool ok = false;
+    QString url = QInputDialog::getText(this, tr("Open URL"), tr("Stream URL (http, https, rtsp, ...):"),
+                                        QLineEdit::Normal, QString(), &ok).trimmed();
+    
+    if (!ok || url.isEmpty()) {
+        return;
+    }
+    
+    if (!VP_VLCPlayer::isUrl(url)) {
+        showTemporaryMessage(tr("Not a URL: %1").arg(url));
+        return;
+    }
+    
+    if (openFiles({url})) {
+        play();
+    }
+}
+
+void LightweightVideoPlayer::toggleTimeshift()
+{
+    bool enabled = !VP_VLCPlayer::timeshiftEnabled();
+    VP_VLCPlayer::setTimeshiftEnabled(enabled);
+    showTemporaryMessage(enabled ? tr("Timeshift on") : tr("Timeshift off"));
+    
+    // The current stream switches over now, recording starts from the live edge
+    if (VP_VLCPlayer::isUrl(m_currentVideoPath) && TimeshiftBuffer::isSupported(m_currentVideoPath)) {
+        if (loadVideo(m_currentVideoPath)) {
+            play();
+        }
+    }
+}
+
+void LightweightVideoPlayer::toggleReverse()
+{
+    if (!m_mediaPlayer || !m_mediaPlayer->hasMedia()) {
+        return;
+    }
+    
+    bool reverse = !m_mediaPlayer->isReverse();
+    m_mediaPlayer->setReverse(reverse);
+    
+    // Stopped, or a live stream that reopens on every seek
+    if (m_mediaPlayer->isReverse() != reverse) {
+        showTemporaryMessage(tr("Reverse not available"));
+        return;
+    }
+    
+    showTemporaryMessage(reverse ? tr("Reverse") : tr("Forward"));
+}
+
+void LightweightVideoPlayer::togglePerfOverlay()
+{
+    if (!m_perfOverlay) {
+        return;
+    }
+    
+    if (m_perfOverlay->isVisible()) {
+        m_perfOverlayTimer->stop();
+        m_perfOverlay->hide();
+        return;
+    }
+    
+    updatePerfOverlay();
+    m_perfOverlay->show();
+    m_perfOverlay->raise();
+    m_perfOverlayTimer->start();
+}
+
+void LightweightVideoPlayer::updatePerfOverlay()
+{
+    QStringList lines;
+    auto* vlcPlayer = qobject_cast<VP_VLCPlayer*>(m_mediaPlayer.get());
+    
+    if (m_currentVideoPath.isEmpty()) {
+        lines << tr("No media");
+    } else if (VP_VLCPlayer::isUrl(m_currentVideoPath)) {
+        lines << (VP_VLCPlayer::usesChunkCache(m_currentVideoPath) ? tr("I/O: stream, chunk cache") : tr("I/O: stream"));
+    } else if (ArchiveReader::splitPath(m_currentVideoPath, nullptr, nullptr)) {
+        lines << tr("I/O: archive");
+    } else {
+        lines << tr("I/O: %1").arg(VP_VLCPlayer::ioModeName(VP_VLCPlayer::ioModeForFile(m_currentVideoPath)));
+    }
+    
+    if (vlcPlayer) {
+        VP_VLCPlayer::PlaybackStatistics stats;
+        if (vlcPlayer->playbackStatistics(stats)) {
+            lines << tr("Frames: %1 decoded, %2 shown, %3 lost").arg(stats.decodedVideo).arg(stats.displayedPictures).arg(stats.lostPictures);
+        }
+        
+        if (VP_VLCPlayer::isUrl(m_currentVideoPath)) {
+            VP_VLCPlayer::StreamMetrics metrics = vlcPlayer->streamMetrics();
+            lines << tr("Startup: %1 ms, stalls: %2 (%3 ms)").arg(metrics.startupDelayMs).arg(metrics.rebufferCount).arg(metrics.rebufferMs);
+        }
+        
+        if (vlcPlayer->isTimeshifting()) {
+            lines << tr("Timeshift: %1 buffered, %2 behind live").arg(formatTime(vlcPlayer->duration() - vlcPlayer->seekableStart()),
+                                                                     formatTime(vlcPlayer->duration() - vlcPlayer->position()));
+        }
+        
+        if (std::shared_ptr<KeyframeIndex> index = vlcPlayer->keyframeIndex()) {
+            lines << tr("Keyframes: %1, GOP %2 ms, seek here decodes %3 ms").arg(index->keyframeCount())
+                         .arg(qRound(index->averageGopMs())).arg(index->seekCost(vlcPlayer->position()));
+        }
+    }
+    
+    ChunkCache::Counters cache = ChunkCache::instance().counters();
+    quint64 lookups = cache.hits + cache.misses;
+    lines << tr("Chunk cache: %1 hits, %2 misses (%3% hit)").arg(cache.hits).arg(cache.misses)
+                 .arg(lookups > 0 ? 100.0 * cache.hits / lookups : 0.0, 0, 'f', 1);
+    lines << tr("Chunk cache: %1 / %2 MiB").arg(cache.bytes / (1024 * 1024)).arg(cache.budget / (1024 * 1024));
+    
+    m_perfOverlay->setText(lines.join('\n'));
+    m_perfOverlay->adjustSize();
+}
+
 // State access methods for StatesEditorDialog  
 const LightweightVideoPlayer::PlaybackState& LightweightVideoPlayer::getPlaybackState(int stateIndex) const
 {
@@ -1302,6 +1971,7 @@ void LightweightVideoPlayer::setPlaybackState(int stateIndex, const PlaybackStat
     }
     
     m_playbackStates[stateIndex] = state;
+    m_stateFramesTimer->start();
 }
 
 QPixmap LightweightVideoPlayer::captureFrameAtPosition(qint64 position)
@@ -1375,7 +2045,9 @@ void LightweightVideoPlayer::savePlaybackState(int stateIndex)
     m_playbackStates[stateIndex].isValid = true;
     m_playbackStates[stateIndex].endPosition = 0;
     m_playbackStates[stateIndex].hasEndPosition = false;
+    m_playbackStates[stateIndex].keyframeSnap = KeyframeSnap::Default;
     m_playbackStates[stateIndex].previewImage = preview;
+    m_stateFramesTimer->start();
     
     qDebug() << "LightweightVideoPlayer: Saved state" << (stateIndex + 1) 
              << "in group" << (m_currentStateGroup + 1)
@@ -1405,8 +2077,9 @@ void LightweightVideoPlayer::loadPlaybackState(int stateIndex)
     }
     
     const PlaybackState& state = m_playbackStates[stateIndex];
+    qint64 recallAt = recallPosition(state.startPosition, state.keyframeSnap);
     
-    setPosition(state.startPosition);
+    setPosition(recallAt);
     
     // Only change playback speed if the option is enabled
     if (m_loadPlaybackSpeed) {
@@ -1419,6 +2092,9 @@ void LightweightVideoPlayer::loadPlaybackState(int stateIndex)
     qDebug() << "LightweightVideoPlayer: Loaded state" << (stateIndex + 1) 
              << "from group" << (m_currentStateGroup + 1)
              << "- Start Position:" << state.startPosition << "ms";
+    if (recallAt != state.startPosition) {
+        qDebug() << "  Snapped to keyframe at" << recallAt << "ms";
+    }
     if (m_loadPlaybackSpeed) {
         qDebug() << "  Speed:" << state.playbackSpeed << "x";
     }
@@ -1427,6 +2103,23 @@ void LightweightVideoPlayer::loadPlaybackState(int stateIndex)
     // showTemporaryMessage(tr("State %1 Loaded").arg(stateIndex + 1));
 }
 
+void LightweightVideoPlayer::updateStateFrames()
+{
+    auto* vlcPlayer = qobject_cast<VP_VLCPlayer*>(m_mediaPlayer.get());
+    if (!vlcPlayer || !vlcPlayer->hasMedia()) {
+        return;
+    }
+    
+    // Where the states of the current group are recalled, in key order
+    QList<qint64> positions;
+    for (const PlaybackState& state : m_playbackStates) {
+        if (state.isValid) {
+            positions << recallPosition(state.startPosition, state.keyframeSnap);
+        }
+    }
+    vlcPlayer->setStateFramePositions(positions);
+}
+
 void LightweightVideoPlayer::setLoopEndPosition(int stateIndex)
 {
     if (stateIndex < 0 || stateIndex >= 12) {
@@ -1475,6 +2168,7 @@ void LightweightVideoPlayer::deletePlaybackState(int stateIndex)
     
     // Clear the state completely
     m_playbackStates[stateIndex] = PlaybackState();
+    m_stateFramesTimer->start();
     
     qDebug() << "LightweightVideoPlayer: Deleted state" << (stateIndex + 1)
              << "from group" << (m_currentStateGroup + 1);
@@ -1494,6 +2188,33 @@ void LightweightVideoPlayer::toggleLoadPlaybackSpeed()
     showTemporaryMessage(tr("Load Speed: %1").arg(status));
 }
 
+void LightweightVideoPlayer::toggleKeyframeSnap()
+{
+    m_snapStatesToKeyframes = !m_snapStatesToKeyframes;
+    m_stateFramesTimer->start();
+    
+    QString status = m_snapStatesToKeyframes ? tr("ON") : tr("OFF");
+    qDebug() << "LightweightVideoPlayer: Keyframe snap toggled to" << status;
+    
+    showTemporaryMessage(tr("Keyframe Snap: %1").arg(status));
+}
+
+qint64 LightweightVideoPlayer::recallPosition(qint64 startPosition, KeyframeSnap snap) const
+{
+    // A nudge, not a jump: in a file with keyframes far apart the state stays exact
+    const qint64 MaxSnapMs = 3000;
+    
+    bool snapping = snap == KeyframeSnap::Default ? m_snapStatesToKeyframes : snap == KeyframeSnap::On;
+    auto* vlcPlayer = qobject_cast<VP_VLCPlayer*>(m_mediaPlayer.get());
+    std::shared_ptr<KeyframeIndex> index = vlcPlayer ? vlcPlayer->keyframeIndex() : nullptr;
+    if (!snapping || !index) {
+        return startPosition;
+    }
+    
+    qint64 keyframe = index->keyframeBefore(startPosition);
+    return keyframe >= 0 && startPosition - keyframe <= MaxSnapMs ? keyframe : startPosition;
+}
+
 void LightweightVideoPlayer::cycleLoopMode()
 {
     switch (m_loopMode) {
@@ -1527,8 +2248,22 @@ void LightweightVideoPlayer::cycleLoopMode()
             }
             break;
         case LoopMode::LoopAll:
+            // Ping-pong needs the current state to have an end
+            if (m_currentLoopStateIndex >= 0 && m_currentLoopStateIndex < 12 &&
+                m_playbackStates[m_currentLoopStateIndex].isValid &&
+                m_playbackStates[m_currentLoopStateIndex].hasEndPosition) {
+                m_loopMode = LoopMode::LoopPingPong;
+            } else {
+                m_loopMode = LoopMode::NoLoop;
+                m_currentLoopStateIndex = -1;  // Reset tracking
+            }
+            break;
+        case LoopMode::LoopPingPong:
             m_loopMode = LoopMode::NoLoop;
             m_currentLoopStateIndex = -1;  // Reset tracking
+            if (m_mediaPlayer) {
+                m_mediaPlayer->setReverse(false);
+            }
             break;
     }
     
@@ -1567,6 +2302,35 @@ void LightweightVideoPlayer::checkLoopPoint()
     
     qint64 currentPosition = m_mediaPlayer->position();
     const int tolerance = 200;  // 200ms tolerance
+    bool reverse = m_mediaPlayer->isReverse();
+    
+    // Ping-pong turns around at both ends of the state; played backwards, the other
+    // modes loop from its start back to its end
+    if (m_loopMode == LoopMode::LoopPingPong || reverse) {
+        if (m_currentLoopStateIndex < 0 || m_currentLoopStateIndex >= 12) {
+            return;
+        }
+        
+        const PlaybackState& state = m_playbackStates[m_currentLoopStateIndex];
+        if (!state.isValid || !state.hasEndPosition) {
+            return;
+        }
+        
+        if (!reverse && currentPosition >= state.endPosition - tolerance) {
+            qDebug() << "LightweightVideoPlayer: Turning backwards at the end of state" << (m_currentLoopStateIndex + 1);
+            PerfTracer::instance().recordInstant("loopTransition", "loop", m_currentLoopStateIndex);
+            m_mediaPlayer->setReverse(true);
+        } else if (reverse && currentPosition <= state.startPosition + tolerance) {
+            qDebug() << "LightweightVideoPlayer: Loop start reached backwards for state" << (m_currentLoopStateIndex + 1);
+            PerfTracer::instance().recordInstant("loopTransition", "loop", m_currentLoopStateIndex);
+            if (m_loopMode == LoopMode::LoopPingPong) {
+                m_mediaPlayer->setReverse(false);
+            } else {
+                setPosition(state.endPosition);
+            }
+        }
+        return;
+    }
     
     if (m_loopMode == LoopMode::LoopSingle) {
         // Check if current loaded state has reached its end point
@@ -1577,7 +2341,8 @@ void LightweightVideoPlayer::checkLoopPoint()
                 // Check if we've reached or passed the end position
                 if (currentPosition >= state.endPosition - tolerance) {
                     qDebug() << "LightweightVideoPlayer: Loop point reached for state" << (m_currentLoopStateIndex + 1);
-                    setPosition(state.startPosition);
+                    PerfTracer::instance().recordInstant("loopTransition", "loop", m_currentLoopStateIndex);
+                    setPosition(recallPosition(state.startPosition, state.keyframeSnap));
                 }
             }
         }
@@ -1612,6 +2377,7 @@ void LightweightVideoPlayer::checkLoopPoint()
                         m_playbackStates[nextStateIndex].hasEndPosition) {
                         // Found next loopable state
                         qDebug() << "LightweightVideoPlayer: Moving to next loop state" << (nextStateIndex + 1);
+                        PerfTracer::instance().recordInstant("loopTransition", "loop", nextStateIndex);
                         
                         // Temporarily disable loop checking to prevent recursion
                         LoopMode savedMode = m_loopMode;
@@ -1629,6 +2395,7 @@ void LightweightVideoPlayer::checkLoopPoint()
                 for (int i = 0; i < 12; i++) {
                     if (m_playbackStates[i].isValid && m_playbackStates[i].hasEndPosition) {
                         qDebug() << "LightweightVideoPlayer: Looping back to first state" << (i + 1);
+                        PerfTracer::instance().recordInstant("loopTransition", "loop", i);
                         
                         // Temporarily disable loop checking to prevent recursion
                         LoopMode savedMode = m_loopMode;
@@ -1691,6 +2458,8 @@ QString LightweightVideoPlayer::getLoopModeString() const
             return tr("Loop Single");
         case LoopMode::LoopAll:
             return tr("Loop All");
+        case LoopMode::LoopPingPong:
+            return tr("Ping-Pong");
         default:
             return tr("Unknown");
     }
@@ -1703,6 +2472,71 @@ void LightweightVideoPlayer::showTemporaryMessage(const QString& message)
     }
 }
 
+void LightweightVideoPlayer::restoreResumeState()
+{
+    // Positions in a timeshift recording only mean something while it lasts
+    bool timeshifting = VP_VLCPlayer::usesTimeshift(m_currentVideoPath);
+    m_resumeKey = m_resumeStore && !timeshifting ? ResumeStore::keyForFile(m_currentVideoPath) : QByteArray();
+    m_resumePosition = -1;
+    
+    ResumeStore::Entry entry;
+    if (m_resumeKey.isEmpty() || !m_resumeStore->lookup(m_resumeKey, entry)) {
+        return;
+    }
+    
+    PERF_TRACE_SCOPE("restoreResumeState");
+    
+    if (entry.stateGroup >= 0 && entry.stateGroup < 4) {
+        m_currentStateGroup = entry.stateGroup;
+    }
+    
+    if (entry.loopMode >= static_cast<int>(LoopMode::NoLoop) && entry.loopMode <= static_cast<int>(LoopMode::LoopPingPong)) {
+        m_loopMode = static_cast<LoopMode>(entry.loopMode);
+        m_currentLoopStateIndex = (entry.loopStateIndex >= 0 && entry.loopStateIndex < 12) ? entry.loopStateIndex : -1;
+    }
+    
+    setPlaybackSpeed(entry.playbackSpeed);
+    
+    if (entry.volume >= 0) {
+        setVolume(entry.volume);
+    }
+    
+    // The backend opens the file at this position, the first frame is already the resumed one
+    if (entry.position > 0) {
+        m_mediaPlayer->setStartPosition(entry.position);
+        m_resumePosition = entry.position;
+        
+        if (m_positionSlider) {
+            m_positionSlider->setValue(static_cast<int>(entry.position));
+        }
+        if (m_positionLabel) {
+            m_positionLabel->setText(formatTime(entry.position));
+        }
+    }
+    
+    qDebug() << "LightweightVideoPlayer: Resuming at" << entry.position << "ms, group" << (m_currentStateGroup + 1)
+             << "-" << getLoopModeString();
+}
+
+void LightweightVideoPlayer::saveResumeState()
+{
+    if (!m_resumeStore || m_resumeKey.isEmpty() || !m_mediaPlayer || !m_mediaPlayer->hasMedia()) {
+        return;
+    }
+    
+    // Until playback has started the backend reports 0, not the position it will open at
+    ResumeStore::Entry entry;
+    entry.position = m_resumePosition >= 0 ? m_resumePosition : m_mediaPlayer->position();
+    entry.playbackSpeed = m_mediaPlayer->playbackRate();
+    entry.stateGroup = m_currentStateGroup;
+    entry.loopMode = static_cast<int>(m_loopMode);
+    entry.loopStateIndex = m_currentLoopStateIndex;
+    entry.volume = m_mediaPlayer->volume();
+    
+    m_resumeStore->update(m_resumeKey, entry);
+    m_resumeStore->flush();
+}
+
 void LightweightVideoPlayer::switchStateGroup(int groupIndex)
 {
     if (groupIndex < 0 || groupIndex >= 4) {
@@ -1734,28 +2568,75 @@ bool LightweightVideoPlayer::loadStateGroupFromFile(int groupIndex)
         return false;
     }
     
+    PERF_TRACE_SCOPE("loadStateGroupFromFile");
+    
     // Clear current states first
     for (int i = 0; i < 12; i++) {
         m_playbackStates[i] = PlaybackState();
     }
+    m_stateFramesTimer->start();
     
     QString filePath = getStatesFilePath(groupIndex);
-    QFile file(filePath);
+    StateGroupData data;
+    
+    // Use the group read ahead by prefetchNextFile() unless the file changed since
+    if (!m_prefetchedStatesPath.isEmpty() && filePath == m_prefetchedStatesPath &&
+        m_prefetchedStates.lastModified == QFileInfo(filePath).lastModified()) {
+        qDebug() << "LightweightVideoPlayer: Using prefetched states for group" << (groupIndex + 1);
+        data = m_prefetchedStates;
+        m_prefetchedStatesPath.clear();
+        m_prefetchedStates = StateGroupData();
+    } else if (!readStateGroupFile(filePath, data)) {
+        return false;
+    }
     
-    if (!file.exists()) {
+    if (!data.exists) {
         qDebug() << "LightweightVideoPlayer: No state file exists for group" << (groupIndex + 1) << "- group is empty";
         return false;  // No file means empty group
     }
     
+    // Load the states into current group's memory
+    for (int i = 0; i < 12; i++) {
+        const StateGroupData::Entry& entry = data.states[i];
+        
+        m_playbackStates[i].startPosition = entry.startPosition;
+        m_playbackStates[i].endPosition = entry.endPosition;
+        m_playbackStates[i].playbackSpeed = entry.playbackSpeed;
+        m_playbackStates[i].isValid = entry.isValid;
+        m_playbackStates[i].hasEndPosition = entry.hasEndPosition;
+        m_playbackStates[i].keyframeSnap = entry.keyframeSnap;
+        
+        if (!entry.previewImage.isNull()) {
+            m_playbackStates[i].previewImage = QPixmap::fromImage(entry.previewImage);
+        }
+    }
+    
+    qDebug() << "LightweightVideoPlayer: Loaded" << data.statesLoaded << "states from group" << (groupIndex + 1);
+    return true;
+}
+
+// Parse a state group file (no widgets or pixmaps, safe to call from any thread)
+bool LightweightVideoPlayer::readStateGroupFile(const QString& filePath, StateGroupData& data)
+{
+    QFile file(filePath);
+    
+    // No path (media without a fingerprint) reads as an empty group
+    if (filePath.isEmpty() || !file.exists()) {
+        data.exists = false;
+        return true;
+    }
+    
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qDebug() << "LightweightVideoPlayer: Failed to open states file for reading:" << filePath;
         return false;
     }
     
+    data.exists = true;
+    data.lastModified = QFileInfo(filePath).lastModified();
+    
     QTextStream in(&file);
     in.setEncoding(QStringConverter::Utf8);
     
-    int statesLoaded = 0;
     while (!in.atEnd()) {
         QString line = in.readLine().trimmed();
         
@@ -1764,7 +2645,7 @@ bool LightweightVideoPlayer::loadStateGroupFromFile(int groupIndex)
             continue;
         }
         
-        // Parse line: StateIndex,StartPos,EndPos,Speed,Valid,HasEnd,ImageData
+        // Parse line: StateIndex,StartPos,EndPos,Speed,Valid,HasEnd,ImageData[,Snap]
         QStringList parts = line.split(",");
         if (parts.size() < 6) {
             qDebug() << "LightweightVideoPlayer: Invalid line format in states file:" << line;
@@ -1796,61 +2677,41 @@ bool LightweightVideoPlayer::loadStateGroupFromFile(int groupIndex)
             continue;
         }
         
-        bool isValid = (parts[4] == "1");
-        bool hasEnd = (parts[5] == "1");
+        StateGroupData::Entry& entry = data.states[stateIndex];
+        entry.startPosition = startPos;
+        entry.endPosition = endPos;
+        entry.playbackSpeed = speed;
+        entry.isValid = (parts[4] == "1");
+        entry.hasEndPosition = (parts[5] == "1");
         
         // Load preview image if available (v2.0 format)
-        QPixmap previewImage;
         if (parts.size() > 6 && !parts[6].isEmpty()) {
             QByteArray imageData = QByteArray::fromBase64(parts[6].toUtf8());
-            previewImage.loadFromData(imageData, "PNG");
+            entry.previewImage.loadFromData(imageData, "PNG");
         }
         
-        // Load the state into current group's memory
-        m_playbackStates[stateIndex].startPosition = startPos;
-        m_playbackStates[stateIndex].endPosition = endPos;
-        m_playbackStates[stateIndex].playbackSpeed = speed;
-        m_playbackStates[stateIndex].isValid = isValid;
-        m_playbackStates[stateIndex].hasEndPosition = hasEnd;
-        m_playbackStates[stateIndex].previewImage = previewImage;
+        // Keyframe snap (v2.1 format): 0 default, 1 on, 2 off
+        if (parts.size() > 7) {
+            int snap = parts[7].toInt();
+            entry.keyframeSnap = snap == 1 ? KeyframeSnap::On : (snap == 2 ? KeyframeSnap::Off : KeyframeSnap::Default);
+        }
         
-        statesLoaded++;
+        data.statesLoaded++;
     }
     
     file.close();
-    qDebug() << "LightweightVideoPlayer: Loaded" << statesLoaded << "states from group" << (groupIndex + 1);
     return true;
 }
 
-
-
 QString LightweightVideoPlayer::getStatesFilePath(int groupIndex) const
 {
-    if (m_currentVideoPath.isEmpty()) {
-        return QString();
-    }
-    
-    // Get the application directory
-    QString appDir = QCoreApplication::applicationDirPath();
-    
-    // Create savedstates folder path
-    QString statesDir = appDir + "/savedstates";
-    
-    // Create the directory if it doesn't exist
-    QDir dir;
-    if (!dir.exists(statesDir)) {
-        dir.mkpath(statesDir);
-        qDebug() << "LightweightVideoPlayer: Created savedstates directory:" << statesDir;
-    }
-    
-    // Get just the video filename (without path)
-    QFileInfo fileInfo(m_currentVideoPath);
-    QString videoFileName = fileInfo.completeBaseName();
-    
-    // Build the state file path: savedstates/[videoname].statesG[1-4]
-    QString filePath = statesDir + "/" + videoFileName + QString(".statesG%1").arg(groupIndex + 1);
-    
-    return filePath;
+    return statesFilePath(m_currentVideoPath, groupIndex);
+}
+
+QString LightweightVideoPlayer::statesFilePath(const QString& videoPath, int groupIndex)
+{
+    // savedstates/groups/[shard]/[fingerprint].statesG[1-4]
+    return StateStorage::instance().groupFilePath(videoPath, groupIndex);
 }
 
 int LightweightVideoPlayer::findFirstValidLoop() const
@@ -1886,8 +2747,16 @@ void LightweightVideoPlayer::saveStateGroup(int groupIndex)
         return;
     }
     
+    PERF_TRACE_SCOPE("saveStateGroup");
+    
     // Save the current group to file
     QString filePath = getStatesFilePath(groupIndex);
+    if (filePath.isEmpty()) {
+        qDebug() << "LightweightVideoPlayer: No fingerprint for" << m_currentVideoPath << "- cannot save state group";
+        showTemporaryMessage(tr("States can not be saved for this media"));
+        return;
+    }
+    
     QFile file(filePath);
     
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
@@ -1900,8 +2769,8 @@ void LightweightVideoPlayer::saveStateGroup(int groupIndex)
     out.setEncoding(QStringConverter::Utf8);
     
     // Write header
-    out << "# Video Player State Group File v2.0\n";
-    out << "# Format: StateIndex,StartPos,EndPos,Speed,Valid,HasEnd,ImageData\n";
+    out << "# Video Player State Group File v2.1\n";
+    out << "# Format: StateIndex,StartPos,EndPos,Speed,Valid,HasEnd,ImageData,Snap\n";
     out << "\n";
     
     // Write each state for current group
@@ -1926,10 +2795,12 @@ void LightweightVideoPlayer::saveStateGroup(int groupIndex)
             out << base64;
         }
         
+        out << "," << static_cast<int>(state.keyframeSnap);
         out << "\n";
     }
     
     file.close();
+    StateStorage::instance().groupFileSaved(filePath);
     qDebug() << "LightweightVideoPlayer: Saved state group" << (groupIndex + 1) << "to" << filePath;
     showTemporaryMessage(tr("Group %1 Saved").arg(groupIndex + 1));
 }
@@ -1960,6 +2831,7 @@ void LightweightVideoPlayer::deleteStateGroup(int groupIndex)
         for (int i = 0; i < 12; i++) {
             m_playbackStates[i] = PlaybackState();
         }
+        m_stateFramesTimer->start();
     }
     
     // Delete the file from disk if it exists
@@ -1967,8 +2839,9 @@ void LightweightVideoPlayer::deleteStateGroup(int groupIndex)
         QString filePath = getStatesFilePath(groupIndex);
         QFile file(filePath);
         
-        if (file.exists()) {
+        if (!filePath.isEmpty() && file.exists()) {
             if (file.remove()) {
+                StateStorage::instance().groupFileRemoved(filePath);
                 qDebug() << "LightweightVideoPlayer: Deleted state group file:" << filePath;
             } else {
                 qDebug() << "LightweightVideoPlayer: Failed to delete state group file:" << filePath;
@@ -14,10 +14,15 @@
 #include <QMargins>
 #include <QTimer>
 #include <QPointer>
+#include <QThread>
+#include <QImage>
+#include <QDateTime>
+#include <QStringList>
 #include <memory>
 #include "qspinbox.h"
-#include "vp_vlcplayer.h"
+#include "vp_playerbackend.h"
 #include "keybindmanager.h"
+#include "resumestore.h"
 
 // Forward declaration
 class TemporaryMessageLabel;
@@ -34,6 +39,9 @@ class LightweightVideoPlayer : public QWidget
 
 public:
     explicit LightweightVideoPlayer(QWidget *parent = nullptr, int initialVolume = 70);
+    
+    // Use a custom playback backend instead of VLC (e.g. VP_SimulatedPlayer)
+    explicit LightweightVideoPlayer(std::unique_ptr<VP_PlayerBackend> backend, QWidget *parent = nullptr, int initialVolume = 70);
     virtual ~LightweightVideoPlayer();
 
     // Core video control functions
@@ -45,6 +53,20 @@ public:
     void setPosition(qint64 position);
     void setPlaybackSpeed(qreal speed, bool showMessage = false);
     
+    // Playlist: a single file opens its folder, several files are played in the given order
+    bool openFiles(const QStringList& filePaths);
+    void setPlaylist(const QStringList& filePaths, int currentIndex);
+    QStringList playlist() const { return m_playlist; }
+    bool playNext();
+    bool playPrevious();
+    
+    // Start the next file in the playlist as soon as the current one finishes
+    void setAutoAdvance(bool enabled) { m_autoAdvance = enabled; }
+    bool autoAdvance() const { return m_autoAdvance; }
+    
+    // Video files of a folder in natural order (episode 2 before episode 10)
+    static QStringList videoFilesInDirectory(const QString& directoryPath);
+    
     // Fullscreen management
     void toggleFullScreen();
     void enterFullScreen();
@@ -59,6 +81,14 @@ public:
     qreal playbackSpeed() const;
     QString currentVideoPath() const;
     
+    // Recalling a state at the keyframe before its start decodes no frames up to it;
+    // Default follows snapStatesToKeyframes()
+    enum class KeyframeSnap {
+        Default,
+        On,
+        Off
+    };
+    
     // Playback state system (public for StatesEditorDialog)
     struct PlaybackState {
         qint64 startPosition;
@@ -66,12 +96,21 @@ public:
         qreal playbackSpeed;
         bool isValid;
         bool hasEndPosition;
+        KeyframeSnap keyframeSnap;
         QPixmap previewImage;  // 100x75 thumbnail
         
-        PlaybackState() : startPosition(0), endPosition(0), playbackSpeed(1.0), isValid(false), hasEndPosition(false) {}
-        PlaybackState(qint64 start, qreal speed) : startPosition(start), endPosition(0), playbackSpeed(speed), isValid(true), hasEndPosition(false) {}
+        PlaybackState() : startPosition(0), endPosition(0), playbackSpeed(1.0), isValid(false), hasEndPosition(false), keyframeSnap(KeyframeSnap::Default) {}
+        PlaybackState(qint64 start, qreal speed) : startPosition(start), endPosition(0), playbackSpeed(speed), isValid(true), hasEndPosition(false), keyframeSnap(KeyframeSnap::Default) {}
     };
     
+    // Snap states without a setting of their own (default off)
+    void setSnapStatesToKeyframes(bool enabled) { m_snapStatesToKeyframes = enabled; }
+    bool snapStatesToKeyframes() const { return m_snapStatesToKeyframes; }
+    
+    // Position a state starting at startPosition is recalled at: the keyframe before it
+    // when snapping and the current file's keyframe index knows one close enough
+    qint64 recallPosition(qint64 startPosition, KeyframeSnap snap) const;
+    
     // Getters for states editor
     int currentStateGroup() const { return m_currentStateGroup; }
     const PlaybackState& getPlaybackState(int stateIndex) const;
@@ -89,7 +128,7 @@ public:
 
 signals:
     void errorOccurred(const QString& error);
-    void playbackStateChanged(VP_VLCPlayer::PlayerState state);
+    void playbackStateChanged(VP_PlayerBackend::PlayerState state);
     void playbackStarted();
     void finished();
     void positionChanged(qint64 position);
@@ -111,9 +150,14 @@ protected slots:
     // Media player slots
     void updatePosition(qint64 position);
     void updateDuration(qint64 duration);
+    void updateSeekableRange(qint64 start, qint64 end);
+    void updateFrameOverlay(const QImage& frame);
     void handleError(const QString &errorString);
-    void handlePlaybackStateChanged(VP_VLCPlayer::PlayerState state);
+    void handlePlaybackStateChanged(VP_PlayerBackend::PlayerState state);
     void handleVideoFinished();
+    void handlePlayerInitialized(bool success);
+    void handleFirstFrameRendered();
+    void handleBufferingProgress(int percent);
     
     // Cursor management
     void hideCursor();
@@ -123,6 +167,7 @@ protected slots:
 protected:
     // Event handlers
     void closeEvent(QCloseEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
@@ -144,7 +189,7 @@ protected:
     ClickableSlider* createClickableSlider();
     
     // Core media components
-    std::unique_ptr<VP_VLCPlayer> m_mediaPlayer;
+    std::unique_ptr<VP_PlayerBackend> m_mediaPlayer;
     QPointer<QWidget> m_videoWidget;
     
     // Control widgets
@@ -153,6 +198,7 @@ protected:
     QPointer<QPushButton> m_fullScreenButton;
     QPointer<QPushButton> m_keybindsButton;
     QPointer<QPushButton> m_editStatesButton;
+    QPointer<QPushButton> m_libraryButton;
     QPointer<QSlider> m_positionSlider;
     QPointer<QSlider> m_volumeSlider;
     QPointer<QDoubleSpinBox> m_speedSpinBox;
@@ -187,29 +233,92 @@ protected:
     // Temporary message display
     TemporaryMessageLabel* m_messageLabel;
     
+    // I/O and cache counters (F12), refreshed while shown
+    QPointer<QLabel> m_perfOverlay;
+    QTimer* m_perfOverlayTimer;
+    
+    // Buffered frame covering the video after a back step (native, to stack above VLC's window)
+    QPointer<QLabel> m_frameOverlay;
+    QImage m_frameOverlayImage;
+    
+    // Single shot, coalesces state changes (and the editor's group hopping) into one
+    // update of the frames decoded for the states
+    QTimer* m_stateFramesTimer;
+    
     // Loop mode enumeration
     enum class LoopMode {
         NoLoop,
         LoopSingle,
-        LoopAll
+        LoopAll,
+        LoopPingPong  // Forwards to the state's end, backwards to its start
     };
     
     PlaybackState m_playbackStates[12];  // Current group's 12 states for keys 1,2,3,4,5,6,7,8,9,0,-,=
     int m_currentStateGroup;  // Current active state group (0-3)
     LoopMode m_loopMode;
     bool m_loadPlaybackSpeed;
+    bool m_snapStatesToKeyframes;
     int m_currentLoopStateIndex;  // Track which state is currently looping
     qint64 m_lastClickedPosition;  // Last position clicked on slider
     
+    // Startup: a video requested before the backend is ready is loaded once it is
+    QString m_pendingVideoPath;
+    bool m_playWhenReady;
+    bool m_windowPaintRecorded;
+    bool m_firstFrameRecorded;
+    
+    // Playlist and read-ahead of the next file
+    QStringList m_playlist;
+    int m_playlistIndex;
+    bool m_autoAdvance;
+    QPointer<QThread> m_prefetchThread;
+    QPointer<QThread> m_storageThread;  // Saved-state index load and layout migration
+    
+    // A state group as read from disk (QImage so it can be read off the GUI thread)
+    struct StateGroupData {
+        struct Entry {
+            qint64 startPosition = 0;
+            qint64 endPosition = 0;
+            qreal playbackSpeed = 1.0;
+            bool isValid = false;
+            bool hasEndPosition = false;
+            KeyframeSnap keyframeSnap = KeyframeSnap::Default;
+            QImage previewImage;
+        };
+        
+        Entry states[12];
+        bool exists = false;
+        int statesLoaded = 0;
+        QDateTime lastModified;
+    };
+    
+    QString m_prefetchedStatesPath;
+    StateGroupData m_prefetchedStates;
+    
+    // Per-file session (position, speed, group, loop mode, volume), saved periodically
+    std::unique_ptr<ResumeStore> m_resumeStore;
+    QByteArray m_resumeKey;  // Key of the current file in m_resumeStore
+    qint64 m_resumePosition;  // Restored position until the first frame is shown (-1 if none)
+    QTimer* m_resumeSaveTimer;
+
 private:
     void initializePlayer();
     void openKeybindEditor();
     void openStatesEditor();
+    void openLibraryBrowser();
+    void openUrl();
+    void togglePerfOverlay();
+    void toggleTimeshift();
+    void toggleReverse();
+    void layoutFrameOverlay();
+    void updatePerfOverlay();
     void savePlaybackState(int stateIndex);
     void setLoopEndPosition(int stateIndex);
     void loadPlaybackState(int stateIndex);
     void deletePlaybackState(int stateIndex);
+    void updateStateFrames();
     void toggleLoadPlaybackSpeed();
+    void toggleKeyframeSnap();
     void cycleLoopMode();
     void returnToLastPosition();
     void checkLoopPoint();
@@ -218,8 +327,18 @@ private:
     QString getLoopModeString() const;
     void showTemporaryMessage(const QString& message);
     
+    // Session resume
+    void restoreResumeState();
+    void saveResumeState();
+    
+    // Playlist helpers
+    bool playPlaylistIndex(int index);
+    void prefetchNextFile();
+    
     // State group management (private methods)
     QString getStatesFilePath(int groupIndex) const;
+    static QString statesFilePath(const QString& videoPath, int groupIndex);
+    static bool readStateGroupFile(const QString& filePath, StateGroupData& data);
     int findFirstValidLoop() const;
     void deleteStateGroup(int groupIndex);
 };
@@ -1,35 +1,183 @@
 #include <QApplication>
 #include <QFileDialog>
+#include <QCommandLineParser>
 #include <QDebug>
 #include "lightweightvideoplayer.h"
+#include "perftracer.h"
+#include "singleinstance.h"
+#include "mediareader.h"
+#include "vp_vlcplayer.h"
+#include "chunkcache.h"
+#include "timeshiftbuffer.h"
+#include "framestepbuffer.h"
+#include "stateframecache.h"
 
 int main(int argc, char *argv[])
 {
+    // Start the trace clock as early as possible
+    PerfTracer::now();
+    
     QApplication a(argc, argv);
     
+    // Parse command-line options
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QObject::tr("Lightweight Video Player"));
+    parser.addHelpOption();
+    
+    QCommandLineOption traceOption(QStringList() << "trace",
+        QObject::tr("Record player operation spans and write them as trace-event JSON to <file> on exit."),
+        QObject::tr("file"));
+    parser.addOption(traceOption);
+    
+    QCommandLineOption multiInstanceOption(QStringList() << "multi-instance",
+        QObject::tr("Start a separate player instead of handing the files to a running one."));
+    parser.addOption(multiInstanceOption);
+    
+    QCommandLineOption gaplessOption(QStringList() << "gapless",
+        QObject::tr("Continue with the next file of the playlist when a video ends."));
+    parser.addOption(gaplessOption);
+    
+    QCommandLineOption ioOption(QStringList() << "io",
+        QObject::tr("How files are read: vlc (VLC's file access, default), buffered (read-ahead and block cache, for NAS and USB drives), "
+                    "mmap (memory map, for local SSDs) or auto (buffered on network shares, mmap otherwise)."),
+        QObject::tr("mode"), "vlc");
+    parser.addOption(ioOption);
+    
+    QCommandLineOption readAheadOption(QStringList() << "read-ahead",
+        QObject::tr("Read-ahead window of buffered and mmap reads in MiB (default 8)."),
+        QObject::tr("MiB"), "8");
+    parser.addOption(readAheadOption);
+    
+    QCommandLineOption ioCacheOption(QStringList() << "io-cache",
+        QObject::tr("Block cache size of buffered reads in MiB (default 64)."),
+        QObject::tr("MiB"), "64");
+    parser.addOption(ioCacheOption);
+    
+    QCommandLineOption networkCachingOption(QStringList() << "network-caching",
+        QObject::tr("Prebuffer of network streams in milliseconds (default 1000)."),
+        QObject::tr("ms"), "1000");
+    parser.addOption(networkCachingOption);
+    
+    QCommandLineOption streamCacheOption(QStringList() << "stream-cache",
+        QObject::tr("Disk chunk cache of network streams in MiB, 0 disables it (default 2048)."),
+        QObject::tr("MiB"), "2048");
+    parser.addOption(streamCacheOption);
+    
+    QCommandLineOption timeshiftOption(QStringList() << "timeshift",
+        QObject::tr("Record HTTP streams so live streams can be paused and rewound (Ctrl+T toggles it)."));
+    parser.addOption(timeshiftOption);
+    
+    QCommandLineOption timeshiftMinutesOption(QStringList() << "timeshift-minutes",
+        QObject::tr("Minutes kept behind the live edge (default 30)."),
+        QObject::tr("minutes"), "30");
+    parser.addOption(timeshiftMinutesOption);
+    
+    QCommandLineOption timeshiftSizeOption(QStringList() << "timeshift-size",
+        QObject::tr("Size of the timeshift ring file in MiB (default 1024)."),
+        QObject::tr("MiB"), "1024");
+    parser.addOption(timeshiftSizeOption);
+    
+    QCommandLineOption frameBufferOption(QStringList() << "frame-buffer",
+        QObject::tr("Memory for decoded frames when stepping back, in MiB (default 256)."),
+        QObject::tr("MiB"), "256");
+    parser.addOption(frameBufferOption);
+    
+    QCommandLineOption stateFramesOption(QStringList() << "state-frames",
+        QObject::tr("Memory for the frames decoded ahead for saved states, in MiB (default 256, 0 to turn off)."),
+        QObject::tr("MiB"), "256");
+    parser.addOption(stateFramesOption);
+    
+    QCommandLineOption snapStatesOption(QStringList() << "snap-states",
+        QObject::tr("Recall saved states at the keyframe before their start (toggled with K)."));
+    parser.addOption(snapStatesOption);
+    parser.addPositionalArgument("files", QObject::tr("Video files or stream URLs to open. A single file also opens the other videos in its folder."), "[files...]");
+    parser.process(a);
+    
+    QString traceFile = parser.value(traceOption);
+    if (!traceFile.isEmpty()) {
+        PerfTracer::instance().setEnabled(true);
+    }
+    
+    VP_VLCPlayer::IoMode ioMode;
+    if (!VP_VLCPlayer::ioModeFromName(parser.value(ioOption), &ioMode)) {
+        qWarning() << "Unknown --io mode:" << parser.value(ioOption);
+        ioMode = VP_VLCPlayer::IoMode::Vlc;
+    }
+    VP_VLCPlayer::setIoMode(ioMode);
+    
+    // Blocks are 1 MiB, so the sizes are block counts
+    MediaReader::Options ioOptions;
+    ioOptions.readAheadBlocks = parser.value(readAheadOption).toInt();
+    ioOptions.cacheBlocks = parser.value(ioCacheOption).toInt();
+    MediaReader::setOptions(ioOptions);
+    
+    VP_VLCPlayer::setNetworkCaching(parser.value(networkCachingOption).toInt());
+    ChunkCache::instance().setBudget(parser.value(streamCacheOption).toLongLong() * 1024 * 1024);
+    
+    VP_VLCPlayer::setTimeshiftEnabled(parser.isSet(timeshiftOption));
+    TimeshiftBuffer::setWindow(parser.value(timeshiftMinutesOption).toInt());
+    TimeshiftBuffer::setCapacity(parser.value(timeshiftSizeOption).toLongLong() * 1024 * 1024);
+    FrameStepBuffer::setBudget(parser.value(frameBufferOption).toInt());
+    StateFrameCache::setBudget(parser.value(stateFramesOption).toInt());
+    
+    const QStringList positionalArgs = parser.positionalArguments();
+    
+    // Hand the files to a running player, its VLC instance is already warm
+    SingleInstance singleInstance;
+    if (!parser.isSet(multiInstanceOption)) {
+        if (singleInstance.forwardToRunningInstance(positionalArgs)) {
+            return 0;
+        }
+        singleInstance.listen();
+    }
+    
     // Create the video player
     LightweightVideoPlayer player;
+    player.setAutoAdvance(parser.isSet(gaplessOption));
+    player.setSnapStatesToKeyframes(parser.isSet(snapStatesOption));
     player.show();
     
-    QString fileName;
+    // Files from later launches open in this window
+    QObject::connect(&singleInstance, &SingleInstance::filesReceived, &player, [&player](const QStringList& filePaths) {
+        if (player.isMinimized()) {
+            player.showNormal();
+        }
+        player.raise();
+        player.activateWindow();
+        
+        if (player.openFiles(filePaths)) {
+            player.play();
+        }
+    });
+    
+    QStringList fileNames;
     
-    // Check if a file was passed as a command-line argument
-    if (argc > 1) {
-        // File path was provided (e.g., from double-clicking a video file)
-        fileName = QString::fromLocal8Bit(argv[1]);
-        qDebug() << "Opening file from command line:" << fileName;
+    // Check if files were passed as command-line arguments
+    if (!positionalArgs.isEmpty()) {
+        // File paths were provided (e.g., from double-clicking a video file)
+        fileNames = positionalArgs;
+        qDebug() << "Opening files from command line:" << fileNames;
     } else {
         // No file provided, show file dialog
-        fileName = QFileDialog::getOpenFileName(&player,
+        QString fileName = QFileDialog::getOpenFileName(&player,
             QObject::tr("Open Video File"),
             QString(),
-            QObject::tr("Video Files (*.mp4 *.avi *.mkv *.mov *.wmv *.flv *.webm);;All Files (*.*)"));
+            QObject::tr("Video Files (*.mp4 *.avi *.mkv *.mov *.wmv *.flv *.webm);;Archives (*.zip *.tar);;All Files (*.*)"));
+        
+        if (!fileName.isEmpty()) {
+            fileNames << fileName;
+        }
     }
     
-    if (!fileName.isEmpty()) {
-        player.loadVideo(fileName);
+    if (player.openFiles(fileNames)) {
         player.play();
     }
     
-    return a.exec();
+    int result = a.exec();
+    
+    if (!traceFile.isEmpty()) {
+        PerfTracer::instance().writeJson(traceFile);
+    }
+    
+    return result;
 }
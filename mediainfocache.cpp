@@ -0,0 +1,113 @@
+#include "mediainfocache.h"
+#include "perftracer.h"
+#include "statestorage.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDebug>
+
+MediaInfoCache& MediaInfoCache::instance()
+{
+    static MediaInfoCache cache;
+    return cache;
+}
+
+MediaInfoCache::MediaInfoCache()
+    : m_loaded(false)
+{
+}
+
+bool MediaInfoCache::lookup(const QString& filePath, Info& info)
+{
+    // One stat, no read of the file itself
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists()) {
+        return false;
+    }
+    
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    
+    auto it = m_entries.constFind(fileInfo.absoluteFilePath());
+    if (it == m_entries.constEnd() || it->size != fileInfo.size() ||
+        it->modifiedMs != fileInfo.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+    
+    info = it->info;
+    return true;
+}
+
+void MediaInfoCache::store(const QString& filePath, const Info& info)
+{
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists()) {
+        return;
+    }
+    
+    CacheEntry entry;
+    entry.info = info;
+    entry.size = fileInfo.size();
+    entry.modifiedMs = fileInfo.lastModified().toMSecsSinceEpoch();
+    
+    const QString absolutePath = fileInfo.absoluteFilePath();
+    
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    
+    // Verifying an unchanged file must not grow the index
+    auto it = m_entries.constFind(absolutePath);
+    if (it != m_entries.constEnd() && it->size == entry.size && it->modifiedMs == entry.modifiedMs &&
+        it->info == entry.info) {
+        return;
+    }
+    
+    m_entries.insert(absolutePath, entry);
+    m_index.append(encodeRecord(absolutePath, entry), static_cast<int>(m_entries.size()), [this]() {
+        QList<QStringList> records;
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+            records << encodeRecord(it.key(), it.value());
+        }
+        return records;
+    });
+}
+
+void MediaInfoCache::ensureLoaded()
+{
+    if (m_loaded) {
+        return;
+    }
+    
+    m_loaded = true;
+    
+    PERF_TRACE_SCOPE("mediaInfoCacheLoad");
+    
+    // Record: size, mtime, duration, width, height, fps, codec, tracks (separated by '|'), path
+    m_index.load(StateStorage::rootPath() + "/mediainfo.idx", 9, [this](const QStringList& parts) {
+        if (parts.size() < 9 || parts[8].isEmpty()) {
+            return;
+        }
+        
+        CacheEntry entry;
+        entry.size = parts[0].toLongLong();
+        entry.modifiedMs = parts[1].toLongLong();
+        entry.info.durationMs = parts[2].toLongLong();
+        entry.info.videoSize = QSize(parts[3].toInt(), parts[4].toInt());
+        entry.info.fps = parts[5].toDouble();
+        entry.info.videoCodec = parts[6];
+        if (!parts[7].isEmpty()) {
+            entry.info.tracks = parts[7].split('|');
+        }
+        m_entries.insert(parts[8], entry);
+    });
+    
+    qDebug() << "MediaInfoCache: Loaded" << m_entries.size() << "entries";
+}
+
+QStringList MediaInfoCache::encodeRecord(const QString& filePath, const CacheEntry& entry)
+{
+    return QStringList() << QString::number(entry.size) << QString::number(entry.modifiedMs)
+                         << QString::number(entry.info.durationMs)
+                         << QString::number(entry.info.videoSize.width()) << QString::number(entry.info.videoSize.height())
+                         << QString::number(entry.info.fps, 'g', 10) << entry.info.videoCodec
+                         << entry.info.tracks.join('|') << filePath;
+}
@@ -0,0 +1,63 @@
+#ifndef MEDIAINFOCACHE_H
+#define MEDIAINFOCACHE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
+#include <QSize>
+#include "appendlog.h"
+
+/**
+ * @class MediaInfoCache
+ * @brief Remembers what parsing a file found, so reopening it needs no parse up front
+ *
+ * Entries are keyed by absolute path and only match at the size and
+ * modification time they were parsed at. Kept in savedstates/mediainfo.idx,
+ * an append-only text file compacted when mostly stale. All functions are
+ * thread-safe.
+ */
+class MediaInfoCache
+{
+public:
+    struct Info {
+        qint64 durationMs = 0;
+        QSize videoSize;
+        double fps = 0.0;
+        QString videoCodec;  // Codec description of the first video track
+        QStringList tracks;  // "video h264 1920x1080", "audio mp4a eng", ...
+        
+        bool operator==(const Info& other) const
+        {
+            return durationMs == other.durationMs && videoSize == other.videoSize &&
+                   qFuzzyCompare(fps + 1.0, other.fps + 1.0) && videoCodec == other.videoCodec &&
+                   tracks == other.tracks;
+        }
+    };
+    
+    static MediaInfoCache& instance();
+    
+    // False if the file is unknown or changed since it was parsed
+    bool lookup(const QString& filePath, Info& info);
+    
+    void store(const QString& filePath, const Info& info);
+
+private:
+    MediaInfoCache();
+    
+    struct CacheEntry {
+        Info info;
+        qint64 size = 0;
+        qint64 modifiedMs = 0;
+    };
+    
+    void ensureLoaded();
+    static QStringList encodeRecord(const QString& filePath, const CacheEntry& entry);
+    
+    QMutex m_mutex;
+    bool m_loaded;
+    AppendLog m_index;
+    QHash<QString, CacheEntry> m_entries;  // Absolute path -> entry
+};
+
+#endif // MEDIAINFOCACHE_H
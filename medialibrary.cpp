@@ -0,0 +1,138 @@
+#include "medialibrary.h"
+#include "statestorage.h"
+#include "perftracer.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+
+// Serialized size of an entry with empty strings, bounds the count read from the file
+const qint64 MinEntryBytes = 53;
+
+} // namespace
+
+MediaLibrary::MediaLibrary(const QString& indexPath)
+    : m_indexPath(indexPath)
+{
+}
+
+QString MediaLibrary::defaultPath()
+{
+    return StateStorage::rootPath() + "/library.idx";
+}
+
+QString MediaLibrary::posterPath(const QByteArray& fingerprint)
+{
+    QString fingerprintHex = QString::fromLatin1(fingerprint.toHex());
+    
+    // Same shard as the video's state groups (first hash byte)
+    return StateStorage::rootPath() + "/posters/" + fingerprintHex.mid(16, 2) + "/" + fingerprintHex + ".jpg";
+}
+
+QStringList MediaLibrary::videoFileFilters()
+{
+    return {"*.mp4", "*.avi", "*.mkv", "*.mov", "*.wmv", "*.flv", "*.webm"};
+}
+
+bool MediaLibrary::load()
+{
+    QFile file(m_indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    PERF_TRACE_SCOPE("libraryLoad");
+    
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    
+    if (magic != Magic || version != Version) {
+        qDebug() << "MediaLibrary: Ignoring index with unknown format:" << m_indexPath;
+        return false;
+    }
+    
+    qint32 entryCount = 0;
+    in >> m_roots >> entryCount;
+    
+    // A damaged count must not reserve more than the file can hold
+    m_entries.clear();
+    m_entries.reserve(static_cast<qsizetype>(qBound<qint64>(0, entryCount, file.size() / MinEntryBytes)));
+    
+    bool truncated = false;
+    for (qint32 i = 0; i < entryCount; i++) {
+        Entry entry;
+        in >> entry.filePath >> entry.size >> entry.modifiedMs >> entry.fingerprint
+           >> entry.durationMs >> entry.videoSize >> entry.codec >> entry.fps >> entry.hasPoster;
+        
+        // A half-read entry is not kept
+        if (in.status() != QDataStream::Ok || entry.filePath.isEmpty()) {
+            truncated = true;
+            break;
+        }
+        m_entries.insert(entry.filePath, entry);
+    }
+    
+    if (truncated) {
+        qDebug() << "MediaLibrary: Index is truncated, keeping" << m_entries.size() << "entries";
+    }
+    
+    qDebug() << "MediaLibrary: Loaded" << m_entries.size() << "entries in" << m_roots.size() << "folders";
+    return true;
+}
+
+bool MediaLibrary::save() const
+{
+    PERF_TRACE_SCOPE("librarySave");
+    
+    QDir().mkpath(QFileInfo(m_indexPath).absolutePath());
+    
+    QSaveFile file(m_indexPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "MediaLibrary: Failed to write index:" << file.errorString();
+        return false;
+    }
+    
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << Magic << Version << m_roots << static_cast<qint32>(m_entries.size());
+    
+    for (const Entry& entry : m_entries) {
+        out << entry.filePath << entry.size << entry.modifiedMs << entry.fingerprint
+            << entry.durationMs << entry.videoSize << entry.codec << entry.fps << entry.hasPoster;
+    }
+    
+    return file.commit();
+}
+
+void MediaLibrary::addRoot(const QString& directoryPath)
+{
+    QString absolutePath = QDir(directoryPath).absolutePath();
+    
+    if (!m_roots.contains(absolutePath)) {
+        m_roots << absolutePath;
+    }
+}
+
+bool MediaLibrary::isCurrent(const QString& filePath, qint64 size, qint64 modifiedMs) const
+{
+    auto it = m_entries.constFind(filePath);
+    return it != m_entries.constEnd() && it->size == size && it->modifiedMs == modifiedMs;
+}
+
+void MediaLibrary::insert(const Entry& entry)
+{
+    m_entries.insert(entry.filePath, entry);
+}
+
+void MediaLibrary::remove(const QString& filePath)
+{
+    m_entries.remove(filePath);
+}
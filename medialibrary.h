@@ -0,0 +1,71 @@
+#ifndef MEDIALIBRARY_H
+#define MEDIALIBRARY_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QSize>
+
+/**
+ * @class MediaLibrary
+ * @brief Persistent index of scanned video files and their parsed metadata
+ *
+ * Entries are keyed by absolute path and carry the size and modification time
+ * they were scanned at, so a rescan only parses files that changed. The whole
+ * index is one binary file (savedstates/library.idx) read in a single pass;
+ * posters are JPEGs under savedstates/posters/, sharded like the state groups.
+ * Not thread-safe, owned and used by the GUI thread.
+ */
+class MediaLibrary
+{
+public:
+    struct Entry {
+        QString filePath;
+        qint64 size = 0;
+        qint64 modifiedMs = 0;
+        QByteArray fingerprint;
+        qint64 durationMs = 0;
+        QSize videoSize;
+        QString codec;
+        double fps = 0.0;
+        bool hasPoster = false;
+    };
+    
+    explicit MediaLibrary(const QString& indexPath = defaultPath());
+    
+    // savedstates/library.idx next to the executable
+    static QString defaultPath();
+    
+    // Poster image of a fingerprint, whether it exists or not
+    static QString posterPath(const QByteArray& fingerprint);
+    
+    // Name filters of the files the player opens
+    static QStringList videoFileFilters();
+    
+    bool load();
+    bool save() const;
+    
+    // Folders scanned recursively
+    QStringList roots() const { return m_roots; }
+    void addRoot(const QString& directoryPath);
+    
+    const QHash<QString, Entry>& entries() const { return m_entries; }
+    int count() const { return m_entries.size(); }
+    
+    // True if the file was scanned at this size and modification time
+    bool isCurrent(const QString& filePath, qint64 size, qint64 modifiedMs) const;
+    
+    void insert(const Entry& entry);
+    void remove(const QString& filePath);
+
+private:
+    static const quint32 Magic = 0x4d4c4942;  // "MLIB"
+    static const quint32 Version = 1;
+    
+    QString m_indexPath;
+    QStringList m_roots;
+    QHash<QString, Entry> m_entries;  // Absolute path -> entry
+};
+
+#endif // MEDIALIBRARY_H
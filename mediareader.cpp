@@ -0,0 +1,469 @@
+#include "mediareader.h"
+#include "perftracer.h"
+#include <vlc/vlc.h>
+#include <QCache>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QDebug>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+QMutex s_optionsMutex;
+MediaReader::Options s_options;
+
+// Blocks of all readers, keyed by (cache id, block index)
+class BlockCache
+{
+public:
+    static BlockCache& instance()
+    {
+        static BlockCache cache;
+        return cache;
+    }
+    
+    bool find(quint64 cacheId, qint64 index, QByteArray& data)
+    {
+        QMutexLocker locker(&m_mutex);
+        QByteArray* cached = m_blocks.object(qMakePair(cacheId, index));
+        if (!cached) {
+            return false;
+        }
+        
+        data = *cached;  // Implicitly shared, no copy
+        return true;
+    }
+    
+    bool contains(quint64 cacheId, qint64 index)
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_blocks.contains(qMakePair(cacheId, index));
+    }
+    
+    void insert(quint64 cacheId, qint64 index, const QByteArray& data, int maxBlocks)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_blocks.setMaxCost(maxBlocks);
+        m_blocks.insert(qMakePair(cacheId, index), new QByteArray(data), 1);
+    }
+
+private:
+    QMutex m_mutex;
+    QCache<QPair<quint64, qint64>, QByteArray> m_blocks;
+};
+
+// Advice for the kernel's page cache, a no-op where posix_fadvise is missing
+void adviseAccess(const QFile& file, qint64 offset, qint64 length, int advice)
+{
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(file.handle(), offset, length, advice);
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+    Q_UNUSED(advice);
+#endif
+}
+
+#ifdef POSIX_FADV_WILLNEED
+const int AdviseSequential = POSIX_FADV_SEQUENTIAL;
+const int AdviseWillNeed = POSIX_FADV_WILLNEED;
+#else
+const int AdviseSequential = 0;
+const int AdviseWillNeed = 0;
+#endif
+
+#ifdef MADV_WILLNEED
+const int MapSequential = MADV_SEQUENTIAL;
+const int MapWillNeed = MADV_WILLNEED;
+const int MapRandom = MADV_RANDOM;
+#else
+const int MapSequential = 0;
+const int MapWillNeed = 0;
+const int MapRandom = 0;
+#endif
+
+// Reading this far past a backward seek ends a loop, the access is sequential again
+const qint64 LoopEndDistance = 16 * 1024 * 1024;
+
+} // namespace
+
+// A file opened through callbacks, one per path for the lifetime of the process.
+// libvlc may open the media (play, preparse) at any time while it is alive,
+// so the opaque pointer it is handed must never dangle.
+struct MediaReader::Source {
+    QString filePath;
+    qint64 size = -1;
+    qint64 modifiedMs = 0;
+    quint64 cacheId = 0;
+    MediaReader::Mode mode = MediaReader::Mode::Buffered;
+};
+
+struct MediaReaderCallbacks {
+    static QMutex s_sourcesMutex;
+    static QHash<QString, MediaReader::Source*> s_sources;
+    static quint64 s_nextCacheId;
+    
+    static int open(void* opaque, void** data, uint64_t* size)
+    {
+        MediaReader* reader = new MediaReader(static_cast<MediaReader::Source*>(opaque));
+        if (!reader->open()) {
+            delete reader;
+            *data = nullptr;
+            return -1;
+        }
+        
+        *data = reader;
+        *size = static_cast<uint64_t>(reader->size());
+        return 0;
+    }
+    
+    static ssize_t read(void* data, unsigned char* buffer, size_t length)
+    {
+        return static_cast<ssize_t>(static_cast<MediaReader*>(data)->read(reinterpret_cast<char*>(buffer), static_cast<qint64>(length)));
+    }
+    
+    static int seek(void* data, uint64_t offset)
+    {
+        return static_cast<MediaReader*>(data)->seek(static_cast<qint64>(offset)) ? 0 : -1;
+    }
+    
+    static void close(void* data)
+    {
+        delete static_cast<MediaReader*>(data);
+    }
+};
+
+QMutex MediaReaderCallbacks::s_sourcesMutex;
+QHash<QString, MediaReader::Source*> MediaReaderCallbacks::s_sources;
+quint64 MediaReaderCallbacks::s_nextCacheId = 1;
+
+void MediaReader::setOptions(const Options& options)
+{
+    QMutexLocker locker(&s_optionsMutex);
+    s_options = options;
+    
+    // Whole pages, so every read stays aligned
+    s_options.blockSize = qMax<qint64>(4096, (options.blockSize + 4095) & ~qint64(4095));
+    s_options.readAheadBlocks = qMax(0, options.readAheadBlocks);
+    s_options.cacheBlocks = qMax(1, options.cacheBlocks);
+}
+
+MediaReader::Options MediaReader::options()
+{
+    QMutexLocker locker(&s_optionsMutex);
+    return s_options;
+}
+
+libvlc_media_t* MediaReader::createMedia(libvlc_instance_t* instance, const QString& filePath, Mode mode)
+{
+    QString absolutePath = QFileInfo(filePath).absoluteFilePath();
+    
+    Source* source = nullptr;
+    {
+        QMutexLocker locker(&MediaReaderCallbacks::s_sourcesMutex);
+        source = MediaReaderCallbacks::s_sources.value(absolutePath);
+        if (!source) {
+            source = new Source;
+            source->filePath = absolutePath;
+            MediaReaderCallbacks::s_sources.insert(absolutePath, source);
+        }
+        source->mode = mode;
+    }
+    
+    return libvlc_media_new_callbacks(instance, MediaReaderCallbacks::open, MediaReaderCallbacks::read,
+                                      MediaReaderCallbacks::seek, MediaReaderCallbacks::close, source);
+}
+
+MediaReader::MediaReader(Source* source)
+    : m_source(source)
+    , m_options(options())
+    , m_cacheId(0)
+    , m_size(0)
+    , m_position(0)
+    , m_map(nullptr)
+    , m_advisedUntil(0)
+    , m_sequentialSince(-1)
+    , m_readAheadFrom(-1)
+    , m_stopping(false)
+{
+}
+
+MediaReader::~MediaReader()
+{
+    if (m_readAheadThread) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopping = true;
+            m_readAheadWake.wakeAll();
+        }
+        m_readAheadThread->wait();
+    }
+}
+
+bool MediaReader::open()
+{
+    m_file.setFileName(m_source->filePath);
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        qDebug() << "MediaReader: Failed to open" << m_source->filePath << ":" << m_file.errorString();
+        return false;
+    }
+    
+    QFileInfo fileInfo(m_source->filePath);
+    m_size = m_file.size();
+    
+    Mode mode;
+    {
+        QMutexLocker locker(&MediaReaderCallbacks::s_sourcesMutex);
+        mode = m_source->mode;
+    }
+    
+    if (mode == Mode::Mapped && m_size > 0) {
+        m_map = m_file.map(0, m_size);
+        
+        if (m_map) {
+            adviseMapped(0, m_size, MapSequential);
+            qDebug() << "MediaReader: Mapped" << m_source->filePath;
+            return true;
+        }
+        
+        qDebug() << "MediaReader: Failed to map" << m_source->filePath << ":" << m_file.errorString()
+                 << "- falling back to buffered reads";
+    }
+    
+    {
+        // A changed file gets a fresh key space, its old blocks age out of the cache
+        QMutexLocker locker(&MediaReaderCallbacks::s_sourcesMutex);
+        qint64 modifiedMs = fileInfo.lastModified().toMSecsSinceEpoch();
+        if (m_source->cacheId == 0 || m_source->size != m_size || m_source->modifiedMs != modifiedMs) {
+            m_source->size = m_size;
+            m_source->modifiedMs = modifiedMs;
+            m_source->cacheId = MediaReaderCallbacks::s_nextCacheId++;
+        }
+        m_cacheId = m_source->cacheId;
+    }
+    
+    if (m_options.readAheadBlocks > 0) {
+        m_readAheadThread.reset(QThread::create([this]() {
+            readAheadLoop();
+        }));
+        m_readAheadThread->setObjectName("mediaReadAhead");
+        m_readAheadThread->start();
+    }
+    
+    qDebug() << "MediaReader: Opened" << m_source->filePath << "block size" << m_options.blockSize
+             << "read-ahead" << m_options.readAheadBlocks << "blocks";
+    return true;
+}
+
+bool MediaReader::seek(qint64 offset)
+{
+    if (offset < 0 || offset > m_size) {
+        return false;
+    }
+    
+    // Jumping back is a loop (or a state recall), the kernel's read-ahead would be wasted
+    if (m_map && offset < m_position) {
+        if (m_sequentialSince < 0) {
+            adviseMapped(0, m_size, MapRandom);
+        }
+        m_sequentialSince = offset;
+        m_advisedUntil = offset;
+    }
+    
+    m_position = offset;
+    return true;
+}
+
+qint64 MediaReader::read(char* buffer, qint64 length)
+{
+    if (m_position >= m_size || length <= 0) {
+        return 0;
+    }
+    
+    if (m_map) {
+        return readMapped(buffer, length);
+    }
+    
+    qint64 total = 0;
+    
+    while (total < length && m_position < m_size) {
+        qint64 index = m_position / m_options.blockSize;
+        QByteArray data = block(index);
+        
+        qint64 offsetInBlock = m_position - index * m_options.blockSize;
+        qint64 available = data.size() - offsetInBlock;
+        if (available <= 0) {
+            return total > 0 ? total : -1;
+        }
+        
+        qint64 count = qMin(length - total, available);
+        memcpy(buffer + total, data.constData() + offsetInBlock, static_cast<size_t>(count));
+        total += count;
+        m_position += count;
+    }
+    
+    return total;
+}
+
+qint64 MediaReader::readMapped(char* buffer, qint64 length)
+{
+    qint64 count = qMin(length, m_size - m_position);
+    
+    // Played on past the loop region, back to sequential access
+    if (m_sequentialSince >= 0 && m_position - m_sequentialSince > LoopEndDistance) {
+        adviseMapped(0, m_size, MapSequential);
+        m_sequentialSince = -1;
+    }
+    
+    // Request the playback window ahead of the read position, half a window at a time
+    qint64 window = m_options.readAheadBlocks * m_options.blockSize;
+    if (window > 0 && m_position + count > m_advisedUntil - window / 2) {
+        qint64 from = qMax(m_position, m_advisedUntil);
+        qint64 until = qMin(m_size, m_position + count + window);
+        if (until > from) {
+            adviseMapped(from, until - from, MapWillNeed);
+        }
+        m_advisedUntil = until;
+    }
+    
+    // The only copy, from the page cache into VLC's buffer
+    memcpy(buffer, m_map + m_position, static_cast<size_t>(count));
+    m_position += count;
+    return count;
+}
+
+void MediaReader::adviseMapped(qint64 offset, qint64 length, int advice) const
+{
+#ifdef MADV_WILLNEED
+    // madvise wants a page-aligned start
+    static const qint64 pageSize = sysconf(_SC_PAGESIZE);
+    qint64 alignedOffset = offset - offset % pageSize;
+    madvise(const_cast<uchar*>(m_map) + alignedOffset, static_cast<size_t>(length + offset - alignedOffset), advice);
+#else
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+    Q_UNUSED(advice);
+#endif
+}
+
+QByteArray MediaReader::block(qint64 index)
+{
+    QByteArray data;
+    BlockCache& cache = BlockCache::instance();
+    
+    // Point the read-ahead window at the block after this one
+    if (m_readAheadThread) {
+        QMutexLocker locker(&m_mutex);
+        if (m_readAheadFrom != index + 1) {
+            m_readAheadFrom = index + 1;
+            m_readAheadWake.wakeAll();
+        }
+        
+        // Read-ahead is loading it already, wait rather than read it twice
+        while (m_loadingBlocks.contains(index)) {
+            m_blockLoaded.wait(&m_mutex);
+        }
+    }
+    
+    if (cache.find(m_cacheId, index, data)) {
+        return data;
+    }
+    
+    // A failed or short read is returned as is but not cached, the next read retries it
+    data = readBlock(m_file, index);
+    if (data.size() == blockLength(index)) {
+        cache.insert(m_cacheId, index, data, m_options.cacheBlocks);
+    }
+    return data;
+}
+
+qint64 MediaReader::blockLength(qint64 index) const
+{
+    return qMax<qint64>(0, qMin(m_options.blockSize, m_size - index * m_options.blockSize));
+}
+
+QByteArray MediaReader::readBlock(QFile& file, qint64 index) const
+{
+    PERF_TRACE_SCOPE("ioReadBlock");
+    
+    qint64 offset = index * m_options.blockSize;
+    qint64 length = blockLength(index);
+    
+    QByteArray data;
+    if (length <= 0 || !file.seek(offset)) {
+        return data;
+    }
+    
+    data.resize(length);
+    qint64 bytesRead = file.read(data.data(), length);
+    data.resize(qMax<qint64>(0, bytesRead));
+    return data;
+}
+
+void MediaReader::readAheadLoop()
+{
+    // Own handle, reads here never wait on the player's reads
+    QFile file(m_source->filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return;
+    }
+    
+    adviseAccess(file, 0, 0, AdviseSequential);
+    
+    BlockCache& cache = BlockCache::instance();
+    const qint64 blockCount = (m_size + m_options.blockSize - 1) / m_options.blockSize;
+    qint64 advisedFrom = -1;
+    
+    QMutexLocker locker(&m_mutex);
+    
+    while (!m_stopping) {
+        // Next block of the window that is not cached yet
+        qint64 next = -1;
+        if (m_readAheadFrom >= 0) {
+            qint64 windowEnd = qMin(blockCount, m_readAheadFrom + m_options.readAheadBlocks);
+            for (qint64 index = m_readAheadFrom; index < windowEnd; index++) {
+                if (!cache.contains(m_cacheId, index)) {
+                    next = index;
+                    break;
+                }
+            }
+            
+            // Let the kernel start on the whole window at once
+            if (next >= 0 && advisedFrom != m_readAheadFrom) {
+                advisedFrom = m_readAheadFrom;
+                adviseAccess(file, next * m_options.blockSize, (windowEnd - next) * m_options.blockSize, AdviseWillNeed);
+            }
+        }
+        
+        if (next < 0) {
+            m_readAheadWake.wait(&m_mutex);
+            continue;
+        }
+        
+        m_loadingBlocks.insert(next);
+        locker.unlock();
+        
+        QByteArray data = readBlock(file, next);
+        bool complete = data.size() == blockLength(next);
+        if (complete) {
+            cache.insert(m_cacheId, next, data, m_options.cacheBlocks);
+        }
+        
+        locker.relock();
+        m_loadingBlocks.remove(next);
+        m_blockLoaded.wakeAll();
+        
+        // Leave a failed block to the player's read rather than retrying it in a loop
+        if (!complete && !m_stopping) {
+            m_readAheadWake.wait(&m_mutex);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef MEDIAREADER_H
+#define MEDIAREADER_H
+
+#include <QString>
+#include <QFile>
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSet>
+#include <QThread>
+#include <memory>
+
+struct libvlc_instance_t;
+struct libvlc_media_t;
+
+/**
+ * @class MediaReader
+ * @brief File access for libvlc through our own reader, for slow storage (NAS, USB)
+ *
+ * Files are read in large blocks at block-aligned offsets. A read-ahead thread
+ * keeps a window of blocks past the read position loaded, and every block
+ * goes into a process-wide LRU cache, so looping over a segment or seeking
+ * back to a recent position is served from memory. On POSIX systems the
+ * kernel is told about the access pattern with posix_fadvise.
+ *
+ * Mapped mode serves reads straight from a memory map of the file instead,
+ * with no blocks, cache or thread of its own; the page cache is steered with
+ * madvise (sequential and will-need on the playback window, random while
+ * looping). It falls back to the buffered mode if the file can not be mapped.
+ *
+ * One reader exists per open of a media, created and destroyed by libvlc
+ * through the callbacks installed by createMedia().
+ */
+class MediaReader
+{
+public:
+    struct Options {
+        qint64 blockSize = 1024 * 1024;  // Bytes per read, a multiple of 4096
+        int readAheadBlocks = 8;  // Blocks loaded past the read position (0 disables read-ahead)
+        int cacheBlocks = 64;  // Blocks kept in the shared cache
+    };
+    
+    // Applies to readers opened afterwards
+    static void setOptions(const Options& options);
+    static Options options();
+    
+    enum class Mode {
+        Buffered,  // Block cache with read-ahead, for slow or remote storage
+        Mapped  // Memory map, for fast local storage
+    };
+    
+    // Media read through a MediaReader (libvlc_media_new_callbacks)
+    static libvlc_media_t* createMedia(libvlc_instance_t* instance, const QString& filePath, Mode mode);
+    
+    ~MediaReader();
+    
+    qint64 size() const { return m_size; }
+    
+    // Bytes read, 0 at end of file, -1 on error
+    qint64 read(char* buffer, qint64 length);
+    bool seek(qint64 offset);
+
+private:
+    struct Source;
+    friend struct MediaReaderCallbacks;  // libvlc callbacks, defined with libvlc's types
+    
+    explicit MediaReader(Source* source);
+    
+    bool open();
+    qint64 readMapped(char* buffer, qint64 length);
+    void adviseMapped(qint64 offset, qint64 length, int advice) const;
+    QByteArray block(qint64 index);
+    qint64 blockLength(qint64 index) const;
+    QByteArray readBlock(QFile& file, qint64 index) const;
+    void readAheadLoop();
+    
+    Source* m_source;
+    Options m_options;
+    quint64 m_cacheId;  // Cache key space of the file at its current size and modification time
+    QFile m_file;
+    qint64 m_size;
+    qint64 m_position;
+    
+    // Mapped mode
+    const uchar* m_map;  // Whole file, nullptr in buffered mode
+    qint64 m_advisedUntil;  // End of the window last advised will-need
+    qint64 m_sequentialSince;  // Position of the last backward seek (-1 while reading sequentially)
+    
+    // Read-ahead state, guarded by m_mutex
+    QMutex m_mutex;
+    QWaitCondition m_readAheadWake;
+    QWaitCondition m_blockLoaded;
+    QSet<qint64> m_loadingBlocks;  // Blocks being read by the read-ahead thread
+    qint64 m_readAheadFrom;  // First block the read-ahead thread should have loaded
+    bool m_stopping;
+    std::unique_ptr<QThread> m_readAheadThread;
+};
+
+#endif // MEDIAREADER_H
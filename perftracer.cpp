@@ -0,0 +1,156 @@
+#include "perftracer.h"
+#include <QFile>
+#include <QThread>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QDebug>
+
+PerfTracer::PerfTracer()
+    : m_enabled(false)
+    , m_droppedEvents(0)
+{
+    m_clock.start();
+}
+
+PerfTracer& PerfTracer::instance()
+{
+    static PerfTracer tracer;
+    return tracer;
+}
+
+void PerfTracer::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+    qDebug() << "PerfTracer: Tracing" << (enabled ? "enabled" : "disabled");
+}
+
+qint64 PerfTracer::now()
+{
+    return instance().m_clock.nsecsElapsed() / 1000;
+}
+
+void PerfTracer::recordSpan(const char* name, const char* category, qint64 startUs, qint64 endUs, qint64 value)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    
+    append(Event{name, category, startUs, qMax<qint64>(0, endUs - startUs), value});
+}
+
+void PerfTracer::recordInstant(const char* name, const char* category, qint64 value)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    
+    append(Event{name, category, now(), -1, value});
+}
+
+PerfTracer::ThreadBuffer* PerfTracer::currentThreadBuffer()
+{
+    // Registration happens once per thread, every later lookup is lock-free
+    thread_local ThreadBuffer* buffer = nullptr;
+    
+    if (!buffer) {
+        auto newBuffer = std::make_unique<ThreadBuffer>();
+        newBuffer->threadId = reinterpret_cast<quint64>(QThread::currentThreadId());
+        
+        QThread* thread = QThread::currentThread();
+        if (thread && QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+            newBuffer->threadName = "main";
+        } else if (thread && !thread->objectName().isEmpty()) {
+            newBuffer->threadName = thread->objectName();
+        }
+        
+        QMutexLocker locker(&m_registryMutex);
+        if (newBuffer->threadName.isEmpty()) {
+            newBuffer->threadName = QString("thread-%1").arg(m_buffers.size());
+        }
+        buffer = newBuffer.get();
+        m_buffers.push_back(std::move(newBuffer));
+    }
+    
+    return buffer;
+}
+
+void PerfTracer::append(const Event& event)
+{
+    ThreadBuffer* buffer = currentThreadBuffer();
+    
+    int index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= ThreadBuffer::Capacity) {
+        m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    
+    buffer->events[index] = event;
+    
+    // Publish the event to the exporting thread
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+bool PerfTracer::writeJson(const QString& filePath) const
+{
+    QFile file(filePath);
+    
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qDebug() << "PerfTracer: Failed to open trace file for writing:" << filePath;
+        return false;
+    }
+    
+    QTextStream out(&file);
+    out.setEncoding(QStringConverter::Utf8);
+    
+    const qint64 pid = QCoreApplication::applicationPid();
+    int eventCount = 0;
+    bool first = true;
+    
+    out << "{\"traceEvents\":[\n";
+    
+    QMutexLocker locker(&m_registryMutex);
+    
+    for (const auto& buffer : m_buffers) {
+        // Thread name metadata so Perfetto labels the tracks
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"tid\":" << buffer->threadId
+            << ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+        
+        int count = buffer->count.load(std::memory_order_acquire);
+        
+        for (int i = 0; i < count; i++) {
+            const Event& event = buffer->events[i];
+            
+            out << ",\n{\"name\":\"" << event.name << "\""
+                << ",\"cat\":\"" << event.category << "\"";
+            
+            if (event.durationUs >= 0) {
+                out << ",\"ph\":\"X\",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs;
+            } else {
+                out << ",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << event.startUs;
+            }
+            
+            out << ",\"pid\":" << pid << ",\"tid\":" << buffer->threadId;
+            
+            if (event.value >= 0) {
+                out << ",\"args\":{\"value\":" << event.value << "}";
+            }
+            
+            out << "}";
+            eventCount++;
+        }
+    }
+    
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    
+    file.close();
+    
+    qDebug() << "PerfTracer: Wrote" << eventCount << "events to" << filePath
+             << "- dropped:" << m_droppedEvents.load(std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef PERFTRACER_H
+#define PERFTRACER_H
+
+#include <QString>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @class PerfTracer
+ * @brief Records timing spans of player operations for trace-event export
+ *
+ * Each thread writes into its own fixed-size buffer, so recording a span is
+ * a relaxed atomic load plus a single store and never takes a lock. The
+ * collected spans are written as a Chrome trace-event JSON file that can be
+ * opened in Perfetto or chrome://tracing.
+ */
+class PerfTracer
+{
+public:
+    static PerfTracer& instance();
+    
+    // Recording is disabled by default and costs a single flag check
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    
+    // Microseconds since the tracer was created (process start)
+    static qint64 now();
+    
+    // Span and instant recording (name and category must be string literals)
+    void recordSpan(const char* name, const char* category, qint64 startUs, qint64 endUs, qint64 value = -1);
+    void recordInstant(const char* name, const char* category, qint64 value = -1);
+    
+    // Write all recorded events as trace-event JSON
+    bool writeJson(const QString& filePath) const;
+    
+    // RAII helper that records a span for the enclosing scope
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name, const char* category = "player")
+            : m_name(name), m_category(category), m_start(PerfTracer::instance().isEnabled() ? PerfTracer::now() : -1) {}
+        ~Scope()
+        {
+            if (m_start >= 0) {
+                PerfTracer::instance().recordSpan(m_name, m_category, m_start, PerfTracer::now());
+            }
+        }
+        
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    
+    private:
+        const char* m_name;
+        const char* m_category;
+        qint64 m_start;
+    };
+
+private:
+    PerfTracer();
+    
+    struct Event {
+        const char* name;
+        const char* category;
+        qint64 startUs;
+        qint64 durationUs;  // -1 for instant events
+        qint64 value;       // Optional argument, -1 if unused
+    };
+    
+    // Single-producer buffer owned by one thread
+    struct ThreadBuffer {
+        static constexpr int Capacity = 16384;
+        Event events[Capacity];
+        std::atomic<int> count{0};
+        quint64 threadId = 0;
+        QString threadName;
+    };
+    
+    ThreadBuffer* currentThreadBuffer();
+    void append(const Event& event);
+    
+    std::atomic<bool> m_enabled;
+    std::atomic<quint64> m_droppedEvents;
+    QElapsedTimer m_clock;
+    
+    // Buffers outlive their threads so events survive until export
+    mutable QMutex m_registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+};
+
+#define PERF_TRACE_CONCAT_INNER(a, b) a##b
+#define PERF_TRACE_CONCAT(a, b) PERF_TRACE_CONCAT_INNER(a, b)
+#define PERF_TRACE_SCOPE(name) PerfTracer::Scope PERF_TRACE_CONCAT(perfTraceScope_, __LINE__)(name)
+
+#endif // PERFTRACER_H
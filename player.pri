@@ -0,0 +1,24 @@
+# The player widget with its dialogs, keybinds, resume store and library, on top of vlcplayer.pri
+# Everything of the application but main.cpp and the single instance handling
+
+include($$PWD/vlcplayer.pri)
+
+SOURCES += \
+    $$PWD/lightweightvideoplayer.cpp \
+    $$PWD/keybindmanager.cpp \
+    $$PWD/keybindeditordialog.cpp \
+    $$PWD/stateseditordialog.cpp \
+    $$PWD/resumestore.cpp \
+    $$PWD/medialibrary.cpp \
+    $$PWD/libraryscanner.cpp \
+    $$PWD/librarybrowserdialog.cpp
+
+HEADERS += \
+    $$PWD/lightweightvideoplayer.h \
+    $$PWD/keybindmanager.h \
+    $$PWD/keybindeditordialog.h \
+    $$PWD/stateseditordialog.h \
+    $$PWD/resumestore.h \
+    $$PWD/medialibrary.h \
+    $$PWD/libraryscanner.h \
+    $$PWD/librarybrowserdialog.h
@@ -0,0 +1,429 @@
+#include "remotereader.h"
+#include "chunkcache.h"
+#include "perftracer.h"
+#include <vlc/vlc.h>
+#include <QMutex>
+#include <QTcpSocket>
+#include <QDebug>
+#include <cstring>
+
+#ifndef QT_NO_SSL
+#include <QSslSocket>
+#endif
+
+namespace {
+
+const int TimeoutMs = 10000;
+const int MaxRedirects = 5;
+
+// Redirect and error bodies are small, a chunk is the largest body expected
+const qint64 MaxBodySize = ChunkCache::ChunkSize + 64 * 1024;
+
+bool readLine(QTcpSocket& socket, QByteArray& line)
+{
+    while (!socket.canReadLine()) {
+        if (!socket.waitForReadyRead(TimeoutMs)) {
+            return false;
+        }
+    }
+    
+    line = socket.readLine().trimmed();
+    return true;
+}
+
+bool readExactly(QTcpSocket& socket, qint64 length, QByteArray& data)
+{
+    data.reserve(data.size() + length);
+    
+    while (length > 0) {
+        if (socket.bytesAvailable() == 0 && !socket.waitForReadyRead(TimeoutMs)) {
+            return false;
+        }
+        
+        QByteArray part = socket.read(length);
+        data += part;
+        length -= part.size();
+    }
+    
+    return true;
+}
+
+} // namespace
+
+// A URL opened through callbacks, one per URL for the lifetime of the process
+// (libvlc may open the media at any time while it is alive)
+struct RemoteReader::Source {
+    QString url;
+    bool rangesUnsupported = false;  // Set once the server answered a range request with the whole file
+};
+
+struct RemoteReader::Response {
+    int status = 0;
+    QHash<QByteArray, QByteArray> headers;  // Lowercase names
+    QByteArray body;
+};
+
+struct RemoteReaderCallbacks {
+    static QMutex s_sourcesMutex;
+    static QHash<QString, RemoteReader::Source*> s_sources;
+    
+    static int open(void* opaque, void** data, uint64_t* size)
+    {
+        RemoteReader* reader = new RemoteReader(static_cast<RemoteReader::Source*>(opaque));
+        if (!reader->open()) {
+            delete reader;
+            *data = nullptr;
+            return -1;
+        }
+        
+        *data = reader;
+        *size = static_cast<uint64_t>(reader->size());
+        return 0;
+    }
+    
+    static ssize_t read(void* data, unsigned char* buffer, size_t length)
+    {
+        return static_cast<ssize_t>(static_cast<RemoteReader*>(data)->read(reinterpret_cast<char*>(buffer), static_cast<qint64>(length)));
+    }
+    
+    static int seek(void* data, uint64_t offset)
+    {
+        return static_cast<RemoteReader*>(data)->seek(static_cast<qint64>(offset)) ? 0 : -1;
+    }
+    
+    static void close(void* data)
+    {
+        delete static_cast<RemoteReader*>(data);
+    }
+};
+
+QMutex RemoteReaderCallbacks::s_sourcesMutex;
+QHash<QString, RemoteReader::Source*> RemoteReaderCallbacks::s_sources;
+
+bool RemoteReader::isCacheable(const QString& url)
+{
+    QUrl parsed(url);
+    QString scheme = parsed.scheme().toLower();
+
+#ifdef QT_NO_SSL
+    if (scheme != "http") {
+        return false;
+    }
+#else
+    if (scheme != "http" && (scheme != "https" || !QSslSocket::supportsSsl())) {
+        return false;
+    }
+#endif
+    
+    QString path = parsed.path().toLower();
+    if (path.endsWith(".m3u8") || path.endsWith(".m3u")) {
+        return false;
+    }
+    
+    QMutexLocker locker(&RemoteReaderCallbacks::s_sourcesMutex);
+    Source* source = RemoteReaderCallbacks::s_sources.value(url);
+    return !source || !source->rangesUnsupported;
+}
+
+libvlc_media_t* RemoteReader::createMedia(libvlc_instance_t* instance, const QString& url)
+{
+    Source* source = nullptr;
+    {
+        QMutexLocker locker(&RemoteReaderCallbacks::s_sourcesMutex);
+        source = RemoteReaderCallbacks::s_sources.value(url);
+        if (!source) {
+            source = new Source;
+            source->url = url;
+            RemoteReaderCallbacks::s_sources.insert(url, source);
+        }
+    }
+    
+    return libvlc_media_new_callbacks(instance, RemoteReaderCallbacks::open, RemoteReaderCallbacks::read,
+                                      RemoteReaderCallbacks::seek, RemoteReaderCallbacks::close, source);
+}
+
+RemoteReader::RemoteReader(Source* source)
+    : m_source(source)
+    , m_size(0)
+    , m_position(0)
+    , m_chunkIndex(-1)
+{
+}
+
+RemoteReader::~RemoteReader()
+{
+}
+
+bool RemoteReader::open()
+{
+    PERF_TRACE_SCOPE("remoteOpen");
+    
+    m_url = QUrl(m_source->url);
+    
+    // One byte is enough to learn the size and validator, the first chunk may be cached
+    Response response;
+    if (!request(0, 1, response)) {
+        qDebug() << "RemoteReader: Failed to reach" << m_source->url;
+        return false;
+    }
+    
+    QByteArray contentRange = response.headers.value("content-range");
+    int slash = contentRange.lastIndexOf('/');
+    m_size = slash >= 0 ? contentRange.mid(slash + 1).toLongLong() : 0;
+    
+    if (response.status == 200 || (response.status == 206 && m_size <= 0)) {
+        qDebug() << "RemoteReader: Server does not serve ranges of" << m_source->url << "- leaving it to VLC";
+        QMutexLocker locker(&RemoteReaderCallbacks::s_sourcesMutex);
+        m_source->rangesUnsupported = true;
+        return false;
+    }
+    
+    if (response.status != 206) {
+        qDebug() << "RemoteReader: HTTP status" << response.status << "for" << m_source->url;
+        return false;
+    }
+    
+    m_validator = response.headers.value("etag");
+    if (m_validator.isEmpty()) {
+        m_validator = response.headers.value("last-modified");
+    }
+    
+    m_resourceKey = ChunkCache::resourceKey(m_source->url, m_validator, m_size);
+    
+    qDebug() << "RemoteReader: Opened" << m_source->url << "," << m_size << "bytes, validator" << m_validator;
+    return true;
+}
+
+qint64 RemoteReader::read(char* buffer, qint64 length)
+{
+    qint64 total = 0;
+    
+    while (total < length && m_position < m_size) {
+        qint64 index = m_position / ChunkCache::ChunkSize;
+        if (!loadChunk(index)) {
+            return total > 0 ? total : -1;
+        }
+        
+        qint64 offsetInChunk = m_position - index * ChunkCache::ChunkSize;
+        qint64 count = qMin(length - total, m_chunk.size() - offsetInChunk);
+        std::memcpy(buffer + total, m_chunk.constData() + offsetInChunk, static_cast<size_t>(count));
+        
+        total += count;
+        m_position += count;
+    }
+    
+    return total;
+}
+
+bool RemoteReader::seek(qint64 offset)
+{
+    if (offset < 0 || offset > m_size) {
+        return false;
+    }
+    
+    m_position = offset;
+    return true;
+}
+
+bool RemoteReader::loadChunk(qint64 index)
+{
+    if (index == m_chunkIndex) {
+        return true;
+    }
+    
+    QByteArray data;
+    if (!ChunkCache::instance().read(m_resourceKey, index, data)) {
+        PERF_TRACE_SCOPE("remoteChunkFetch");
+        
+        qint64 offset = index * ChunkCache::ChunkSize;
+        qint64 length = qMin(ChunkCache::ChunkSize, m_size - offset);
+        
+        Response response;
+        if (!request(offset, length, response) || response.status != 206 || response.body.size() != length) {
+            qDebug() << "RemoteReader: Failed to fetch chunk" << index << "of" << m_source->url
+                     << "(HTTP status" << response.status << ")";
+            return false;
+        }
+        
+        // Replaced on the server while playing, the cached chunks belong to the old file
+        QByteArray validator = response.headers.value("etag");
+        if (validator.isEmpty()) {
+            validator = response.headers.value("last-modified");
+        }
+        if (validator != m_validator) {
+            qDebug() << "RemoteReader:" << m_source->url << "changed on the server";
+            return false;
+        }
+        
+        data = response.body;
+        ChunkCache::instance().store(m_resourceKey, m_size, index, data);
+    }
+    
+    m_chunkIndex = index;
+    m_chunk = data;
+    return true;
+}
+
+bool RemoteReader::request(qint64 offset, qint64 length, Response& response)
+{
+    for (int redirects = 0; redirects <= MaxRedirects; redirects++) {
+        QByteArray target = m_url.path(QUrl::FullyEncoded).toLatin1();
+        if (target.isEmpty()) {
+            target = "/";
+        }
+        if (m_url.hasQuery()) {
+            target += "?" + m_url.query(QUrl::FullyEncoded).toLatin1();
+        }
+        
+        QByteArray host = m_url.host(QUrl::FullyEncoded).toLatin1();
+        if (m_url.port() != -1) {
+            host += ":" + QByteArray::number(m_url.port());
+        }
+        
+        QByteArray requestData = "GET " + target + " HTTP/1.1\r\n"
+                                 "Host: " + host + "\r\n"
+                                 "Range: bytes=" + QByteArray::number(offset) + "-" + QByteArray::number(offset + length - 1) + "\r\n"
+                                 "Accept-Encoding: identity\r\n"
+                                 "User-Agent: MMSVP\r\n"
+                                 "\r\n";
+        
+        if (!exchange(requestData, response)) {
+            return false;
+        }
+        
+        bool isRedirect = response.status == 301 || response.status == 302 || response.status == 303 ||
+                          response.status == 307 || response.status == 308;
+        if (!isRedirect || !response.headers.contains("location")) {
+            return true;
+        }
+        
+        QUrl next = m_url.resolved(QUrl::fromEncoded(response.headers.value("location")));
+        if (next.scheme() != m_url.scheme() || next.host() != m_url.host() || next.port() != m_url.port()) {
+            m_socket.reset();
+        }
+        m_url = next;
+    }
+    
+    qDebug() << "RemoteReader: Too many redirects for" << m_source->url;
+    return false;
+}
+
+bool RemoteReader::exchange(const QByteArray& requestData, Response& response)
+{
+    // A kept-alive connection the server has closed in the meantime is retried once on a new one
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = m_socket && m_socket->state() == QAbstractSocket::ConnectedState;
+        if (!connectSocket()) {
+            return false;
+        }
+        
+        response = Response();
+        QTcpSocket& socket = *m_socket;
+        
+        bool ok = socket.write(requestData) == requestData.size();
+        while (ok && socket.bytesToWrite() > 0) {
+            ok = socket.waitForBytesWritten(TimeoutMs);
+        }
+        
+        // "HTTP/1.1 206 Partial Content"
+        QByteArray line;
+        ok = ok && readLine(socket, line) && line.startsWith("HTTP/");
+        if (ok) {
+            response.status = line.split(' ').value(1).toInt();
+        }
+        
+        while (ok) {
+            ok = readLine(socket, line);
+            if (!ok || line.isEmpty()) {
+                break;
+            }
+            
+            int colon = line.indexOf(':');
+            if (colon > 0) {
+                response.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+            }
+        }
+        
+        if (!ok) {
+            m_socket.reset();
+            if (reused) {
+                continue;
+            }
+            return false;
+        }
+        
+        // The whole file instead of the range, the caller gives up on it, so do not download it
+        if (response.status == 200) {
+            m_socket.reset();
+            return true;
+        }
+        
+        if (response.headers.value("transfer-encoding").toLower().contains("chunked")) {
+            // Chunked body: <hex size> CRLF data CRLF ... 0 CRLF trailers CRLF
+            for (;;) {
+                ok = readLine(socket, line);
+                qint64 size = ok ? line.split(';').first().toLongLong(&ok, 16) : 0;
+                if (!ok || size == 0) {
+                    break;
+                }
+                
+                ok = response.body.size() + size <= MaxBodySize && readExactly(socket, size, response.body) &&
+                     readLine(socket, line);
+                if (!ok) {
+                    break;
+                }
+            }
+            
+            // Trailer lines up to the empty one
+            while (ok) {
+                ok = readLine(socket, line);
+                if (line.isEmpty()) {
+                    break;
+                }
+            }
+        } else {
+            qint64 length = response.headers.value("content-length", "0").toLongLong();
+            ok = length <= MaxBodySize && readExactly(socket, length, response.body);
+        }
+        
+        if (!ok || response.headers.value("connection").toLower() == "close") {
+            m_socket.reset();
+        }
+        return ok;
+    }
+    
+    return false;
+}
+
+bool RemoteReader::connectSocket()
+{
+    if (m_socket && m_socket->state() == QAbstractSocket::ConnectedState) {
+        return true;
+    }
+    
+    m_socket.reset();
+
+#ifndef QT_NO_SSL
+    if (m_url.scheme().compare("https", Qt::CaseInsensitive) == 0) {
+        QSslSocket* sslSocket = new QSslSocket;
+        m_socket.reset(sslSocket);
+        sslSocket->connectToHostEncrypted(m_url.host(), static_cast<quint16>(m_url.port(443)));
+        if (!sslSocket->waitForEncrypted(TimeoutMs)) {
+            qDebug() << "RemoteReader: TLS connection to" << m_url.host() << "failed:" << sslSocket->errorString();
+            m_socket.reset();
+            return false;
+        }
+        return true;
+    }
+#endif
+    
+    m_socket.reset(new QTcpSocket);
+    m_socket->connectToHost(m_url.host(), static_cast<quint16>(m_url.port(80)));
+    if (!m_socket->waitForConnected(TimeoutMs)) {
+        qDebug() << "RemoteReader: Connection to" << m_url.host() << "failed:" << m_socket->errorString();
+        m_socket.reset();
+        return false;
+    }
+    
+    return true;
+}
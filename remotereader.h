@@ -0,0 +1,79 @@
+#ifndef REMOTEREADER_H
+#define REMOTEREADER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QUrl>
+#include <memory>
+
+class QTcpSocket;
+struct libvlc_instance_t;
+struct libvlc_media_t;
+
+/**
+ * @class RemoteReader
+ * @brief HTTP access for libvlc through the disk chunk cache
+ *
+ * Remote files are fetched in ChunkCache::ChunkSize pieces with HTTP range
+ * requests over one kept-alive connection, and every piece is written to the
+ * ChunkCache. Looping over a segment, seeking back or reopening the file later
+ * reads the chunks from disk instead of downloading them again. The cache is
+ * keyed by the server's ETag (or Last-Modified), so a changed file is fetched
+ * anew.
+ *
+ * A server that ignores range requests can not be read this way; the media
+ * fails to open once and isCacheable() is false for the URL afterwards, so
+ * VP_VLCPlayer falls back to VLC's own HTTP access.
+ *
+ * One reader exists per open of a media, created and destroyed by libvlc
+ * through the callbacks installed by createMedia().
+ */
+class RemoteReader
+{
+public:
+    // http and https files whose server has not turned down range requests
+    // (not HLS playlists, VLC fetches their segments itself)
+    static bool isCacheable(const QString& url);
+    
+    // Media read through a RemoteReader (libvlc_media_new_callbacks)
+    static libvlc_media_t* createMedia(libvlc_instance_t* instance, const QString& url);
+    
+    ~RemoteReader();
+    
+    qint64 size() const { return m_size; }
+    
+    // Bytes read, 0 at end of file, -1 on error
+    qint64 read(char* buffer, qint64 length);
+    bool seek(qint64 offset);
+
+private:
+    struct Source;
+    struct Response;
+    friend struct RemoteReaderCallbacks;  // libvlc callbacks, defined with libvlc's types
+    
+    explicit RemoteReader(Source* source);
+    
+    bool open();
+    bool loadChunk(qint64 index);
+    
+    // One GET of [offset, offset + length), following redirects
+    bool request(qint64 offset, qint64 length, Response& response);
+    bool exchange(const QByteArray& requestData, Response& response);
+    bool connectSocket();
+    
+    Source* m_source;
+    QUrl m_url;  // After redirects
+    QByteArray m_validator;  // ETag or Last-Modified
+    QByteArray m_resourceKey;
+    qint64 m_size;
+    qint64 m_position;
+    
+    // Chunk the last reads were served from
+    qint64 m_chunkIndex;
+    QByteArray m_chunk;
+    
+    std::unique_ptr<QTcpSocket> m_socket;  // Kept alive between range requests
+};
+
+#endif // REMOTEREADER_H
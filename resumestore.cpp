@@ -0,0 +1,241 @@
+#include "resumestore.h"
+#include "perftracer.h"
+#include "filefingerprint.h"
+#include "statestorage.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+// File layout (little endian):
+//   header:  "MMSVPRES" | uint32 version | uint32 record size
+//   record:  key[16] | int64 position | int64 lastUsed | float32 speed |
+//            int16 volume | int8 stateGroup | int8 loopMode | int8 loopStateIndex | reserved[7]
+static const char ResumeMagic[8] = {'M', 'M', 'S', 'V', 'P', 'R', 'E', 'S'};
+static const quint32 ResumeVersion = 1;
+
+ResumeStore::ResumeStore(const QString& filePath)
+    : m_filePath(filePath)
+    , m_needsRewrite(false)
+{
+    load();
+}
+
+QString ResumeStore::defaultPath()
+{
+    QString statesDir = StateStorage::rootPath();
+    QDir().mkpath(statesDir);
+    return statesDir + "/resume.dat";
+}
+
+QByteArray ResumeStore::keyForFile(const QString& videoPath)
+{
+    // Same identity as the saved states, a renamed file keeps its session
+    QByteArray fingerprint = FileFingerprint::instance().fingerprint(videoPath);
+    if (fingerprint.size() == KeySize) {
+        return fingerprint;
+    }
+    
+    QString absolutePath = QFileInfo(videoPath).absoluteFilePath();
+    return QCryptographicHash::hash(absolutePath.toUtf8(), QCryptographicHash::Sha1).left(KeySize);
+}
+
+void ResumeStore::load()
+{
+    PERF_TRACE_SCOPE("resumeStoreLoad");
+    
+    QFile file(m_filePath);
+    if (!file.exists()) {
+        m_needsRewrite = true;
+        return;
+    }
+    
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "ResumeStore: Failed to open" << m_filePath << ":" << file.errorString();
+        m_needsRewrite = true;
+        return;
+    }
+    
+    QByteArray data = file.readAll();
+    file.close();
+    
+    if (data.size() < HeaderSize || std::memcmp(data.constData(), ResumeMagic, sizeof(ResumeMagic)) != 0 ||
+        qFromLittleEndian<quint32>(data.constData() + 8) != ResumeVersion ||
+        qFromLittleEndian<quint32>(data.constData() + 12) != static_cast<quint32>(RecordSize)) {
+        qDebug() << "ResumeStore: Unknown file format, starting empty:" << m_filePath;
+        m_needsRewrite = true;
+        return;
+    }
+    
+    // A partly written last record is ignored
+    int recordCount = (data.size() - HeaderSize) / RecordSize;
+    m_keys.reserve(recordCount);
+    m_entries.reserve(recordCount);
+    
+    for (int i = 0; i < recordCount; i++) {
+        QByteArray key;
+        Entry entry;
+        
+        if (!decodeRecord(data.constData() + HeaderSize + i * RecordSize, key, entry)) {
+            continue;
+        }
+        
+        m_slots.insert(key, m_keys.size());
+        m_keys.append(key);
+        m_entries.append(entry);
+    }
+    
+    // Records were skipped, the slots on disk no longer match
+    if (m_keys.size() != recordCount) {
+        m_needsRewrite = true;
+    }
+    
+    qDebug() << "ResumeStore: Loaded" << m_entries.size() << "records from" << m_filePath;
+}
+
+bool ResumeStore::lookup(const QByteArray& key, Entry& entry) const
+{
+    auto it = m_slots.constFind(key);
+    if (it == m_slots.constEnd()) {
+        return false;
+    }
+    
+    entry = m_entries.at(it.value());
+    return true;
+}
+
+void ResumeStore::update(const QByteArray& key, const Entry& entry)
+{
+    auto it = m_slots.constFind(key);
+    
+    if (it != m_slots.constEnd()) {
+        Entry& existing = m_entries[it.value()];
+        
+        // Nothing to write while paused
+        if (existing.position == entry.position && existing.playbackSpeed == entry.playbackSpeed &&
+            existing.stateGroup == entry.stateGroup && existing.loopMode == entry.loopMode &&
+            existing.loopStateIndex == entry.loopStateIndex && existing.volume == entry.volume) {
+            return;
+        }
+        
+        existing = entry;
+        existing.lastUsed = QDateTime::currentMSecsSinceEpoch();
+        m_dirtySlots.insert(it.value());
+        return;
+    }
+    
+    int slot = m_keys.size();
+    
+    // Full: reuse the record that was used longest ago
+    if (slot >= MaxRecords) {
+        slot = 0;
+        for (int i = 1; i < m_entries.size(); i++) {
+            if (m_entries.at(i).lastUsed < m_entries.at(slot).lastUsed) {
+                slot = i;
+            }
+        }
+        
+        m_slots.remove(m_keys.at(slot));
+        m_keys[slot] = key;
+        m_entries[slot] = entry;
+    } else {
+        m_keys.append(key);
+        m_entries.append(entry);
+    }
+    
+    m_entries[slot].lastUsed = QDateTime::currentMSecsSinceEpoch();
+    m_slots.insert(key, slot);
+    m_dirtySlots.insert(slot);
+}
+
+bool ResumeStore::flush()
+{
+    if (m_dirtySlots.isEmpty() && !m_needsRewrite) {
+        return true;
+    }
+    
+    PERF_TRACE_SCOPE("resumeStoreFlush");
+    
+    if (m_needsRewrite) {
+        QSaveFile file(m_filePath);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qDebug() << "ResumeStore: Failed to create" << m_filePath << ":" << file.errorString();
+            return false;
+        }
+        
+        QByteArray header(HeaderSize, '\0');
+        std::memcpy(header.data(), ResumeMagic, sizeof(ResumeMagic));
+        qToLittleEndian<quint32>(ResumeVersion, header.data() + 8);
+        qToLittleEndian<quint32>(RecordSize, header.data() + 12);
+        
+        QByteArray data = header;
+        data.reserve(HeaderSize + m_keys.size() * RecordSize);
+        for (int i = 0; i < m_keys.size(); i++) {
+            data += encodeRecord(m_keys.at(i), m_entries.at(i));
+        }
+        
+        if (file.write(data) != data.size() || !file.commit()) {
+            qDebug() << "ResumeStore: Failed to write" << m_filePath << ":" << file.errorString();
+            return false;
+        }
+        
+        m_needsRewrite = false;
+        m_dirtySlots.clear();
+        return true;
+    }
+    
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadWrite)) {
+        qDebug() << "ResumeStore: Failed to open" << m_filePath << "for writing:" << file.errorString();
+        return false;
+    }
+    
+    // Records are written in place, new ones extend the file
+    for (int slot : std::as_const(m_dirtySlots)) {
+        if (!file.seek(HeaderSize + static_cast<qint64>(slot) * RecordSize) ||
+            file.write(encodeRecord(m_keys.at(slot), m_entries.at(slot))) != RecordSize) {
+            qDebug() << "ResumeStore: Failed to write record to" << m_filePath << ":" << file.errorString();
+            return false;
+        }
+    }
+    
+    m_dirtySlots.clear();
+    return true;
+}
+
+QByteArray ResumeStore::encodeRecord(const QByteArray& key, const Entry& entry)
+{
+    QByteArray record(RecordSize, '\0');
+    char* data = record.data();
+    
+    std::memcpy(data, key.constData(), qMin<int>(key.size(), KeySize));
+    qToLittleEndian<qint64>(entry.position, data + 16);
+    qToLittleEndian<qint64>(entry.lastUsed, data + 24);
+    qToLittleEndian<float>(entry.playbackSpeed, data + 32);
+    qToLittleEndian<qint16>(static_cast<qint16>(entry.volume), data + 36);
+    data[38] = static_cast<char>(entry.stateGroup);
+    data[39] = static_cast<char>(entry.loopMode);
+    data[40] = static_cast<char>(entry.loopStateIndex);
+    
+    return record;
+}
+
+bool ResumeStore::decodeRecord(const char* data, QByteArray& key, Entry& entry)
+{
+    key = QByteArray(data, KeySize);
+    entry.position = qFromLittleEndian<qint64>(data + 16);
+    entry.lastUsed = qFromLittleEndian<qint64>(data + 24);
+    entry.playbackSpeed = qFromLittleEndian<float>(data + 32);
+    entry.volume = qFromLittleEndian<qint16>(data + 36);
+    entry.stateGroup = static_cast<qint8>(data[38]);
+    entry.loopMode = static_cast<qint8>(data[39]);
+    entry.loopStateIndex = static_cast<qint8>(data[40]);
+    
+    // A record of zeros is a slot that was never completed
+    return entry.lastUsed > 0 && entry.position >= 0;
+}
@@ -0,0 +1,68 @@
+#ifndef RESUMESTORE_H
+#define RESUMESTORE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+/**
+ * @class ResumeStore
+ * @brief Remembers where each video was left (position, speed, group, loop mode, volume)
+ *
+ * All files share one index file of fixed-size records. The file is read once
+ * when the store is opened, after that only changed records are written back
+ * in place, so saving the session every few seconds costs a 48-byte write.
+ */
+class ResumeStore
+{
+public:
+    // Session of a single file
+    struct Entry {
+        qint64 position = 0;
+        float playbackSpeed = 1.0f;
+        int stateGroup = 0;
+        int loopMode = 0;
+        int loopStateIndex = -1;  // State the loop mode is working on
+        int volume = -1;  // -1 keeps the current volume
+        qint64 lastUsed = 0;  // ms since epoch, oldest records are replaced when the store is full
+    };
+    
+    explicit ResumeStore(const QString& filePath);
+    
+    // savedstates/resume.dat next to the executable
+    static QString defaultPath();
+    
+    // Key identifying a video file in the store
+    static QByteArray keyForFile(const QString& videoPath);
+    
+    bool lookup(const QByteArray& key, Entry& entry) const;
+    
+    // Update the in-memory record, flush() writes it
+    void update(const QByteArray& key, const Entry& entry);
+    
+    // Write changed records to disk
+    bool flush();
+    
+    int count() const { return m_entries.size(); }
+
+private:
+    static const int KeySize = 16;
+    static const int HeaderSize = 16;
+    static const int RecordSize = 48;
+    static const int MaxRecords = 10000;
+    
+    void load();
+    static QByteArray encodeRecord(const QByteArray& key, const Entry& entry);
+    static bool decodeRecord(const char* data, QByteArray& key, Entry& entry);
+    
+    QString m_filePath;
+    QVector<QByteArray> m_keys;  // Record slot -> key
+    QVector<Entry> m_entries;  // Record slot -> entry
+    QHash<QByteArray, int> m_slots;  // Key -> record slot
+    QSet<int> m_dirtySlots;
+    bool m_needsRewrite;  // The file is missing or unreadable and must be written from scratch
+};
+
+#endif // RESUMESTORE_H
@@ -0,0 +1,13 @@
+# VP_SimulatedPlayer and its virtual clock, the playback backend of tests and benchmarks
+# Needs neither libvlc nor zlib
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/vp_simulatedplayer.cpp
+
+# Shared by both backends, added once
+HEADERS *= $$PWD/vp_playerbackend.h
+
+HEADERS += \
+    $$PWD/vp_simulatedplayer.h
@@ -0,0 +1,148 @@
+#include "singleinstance.h"
+#include "vp_vlcplayer.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QDebug>
+
+namespace {
+// A second launch must exit quickly, a running instance answers within these limits
+const int ConnectTimeoutMs = 200;
+const int WriteTimeoutMs = 500;
+// Another launch holds the lock only while it connects or starts listening
+const int LaunchLockTimeoutMs = 2000;
+}
+
+SingleInstance::SingleInstance(QObject *parent)
+    : QObject(parent)
+    , m_server(nullptr)
+{
+}
+
+SingleInstance::~SingleInstance()
+{
+    if (m_server) {
+        m_server->close();
+    }
+}
+
+QString SingleInstance::serverName()
+{
+    // One server per user, the home path keeps users on a shared machine apart
+    QByteArray userHash = QCryptographicHash::hash(QDir::homePath().toUtf8(), QCryptographicHash::Sha1).toHex().left(12);
+    return QCoreApplication::applicationName() + "-" + QString::fromLatin1(userHash);
+}
+
+bool SingleInstance::forwardToRunningInstance(const QStringList& filePaths)
+{
+    // A launch racing this one either listens before we connect or waits for us to
+    m_launchLock = std::make_unique<QLockFile>(QDir(QDir::tempPath()).filePath(serverName() + ".lock"));
+    if (!m_launchLock->tryLock(LaunchLockTimeoutMs)) {
+        qDebug() << "SingleInstance: Launch lock not acquired:" << m_launchLock->error();
+        m_launchLock.reset();
+    }
+    
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    
+    if (!socket.waitForConnected(ConnectTimeoutMs)) {
+        return false;
+    }
+    
+    // The running instance has a different working directory (URLs are passed as they are)
+    QStringList absolutePaths;
+    QByteArray message;
+    for (const QString& filePath : filePaths) {
+        absolutePaths << (VP_VLCPlayer::isUrl(filePath) ? filePath : QFileInfo(filePath).absoluteFilePath());
+        message += absolutePaths.last().toUtf8() + '\n';
+    }
+    message += '\n';
+    
+    socket.write(message);
+    
+    // Connected, so the server is alive: it must not be taken for a stale one
+    m_launchLock.reset();
+    
+    if (!socket.waitForBytesWritten(WriteTimeoutMs)) {
+        qDebug() << "SingleInstance: Failed to send file to running instance:" << socket.errorString();
+        return false;
+    }
+    
+    socket.disconnectFromServer();
+    
+    qDebug() << "SingleInstance: Forwarded to running instance:" << absolutePaths;
+    return true;
+}
+
+bool SingleInstance::listen()
+{
+    if (m_server) {
+        return true;
+    }
+    
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    
+    // Whatever happens, later launches may go on once this is decided
+    std::unique_ptr<QLockFile> launchLock = std::move(m_launchLock);
+    
+    if (!m_server->listen(serverName())) {
+        // A crashed instance can leave a stale socket behind. Only under the launch lock is
+        // it known to be stale: forwardToRunningInstance() found nobody answering on it and
+        // no other launch can have started listening since
+        bool stale = launchLock && launchLock->isLocked();
+        if (stale) {
+            qDebug() << "SingleInstance: Removing stale server:" << m_server->errorString();
+            QLocalServer::removeServer(serverName());
+        }
+        
+        if (!stale || !m_server->listen(serverName())) {
+            qDebug() << "SingleInstance: Failed to listen:" << m_server->errorString();
+            delete m_server;
+            m_server = nullptr;
+            return false;
+        }
+    }
+    
+    connect(m_server, &QLocalServer::newConnection, this, &SingleInstance::handleNewConnection);
+    
+    qDebug() << "SingleInstance: Listening as" << m_server->fullServerName();
+    return true;
+}
+
+void SingleInstance::handleNewConnection()
+{
+    while (QLocalSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            processMessage(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            m_pendingFiles.remove(socket);
+            socket->deleteLater();
+        });
+        
+        // The message may already have arrived with the connection
+        processMessage(socket);
+    }
+}
+
+void SingleInstance::processMessage(QLocalSocket* socket)
+{
+    while (socket->canReadLine()) {
+        QString filePath = QString::fromUtf8(socket->readLine()).trimmed();
+        
+        if (!filePath.isEmpty()) {
+            m_pendingFiles[socket] << filePath;
+            continue;
+        }
+        
+        // Empty line ends the message
+        QStringList filePaths = m_pendingFiles.take(socket);
+        qDebug() << "SingleInstance: Received files from new launch:" << filePaths;
+        emit filesReceived(filePaths);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QStringList>
+#include <QHash>
+#include <memory>
+
+class QLocalServer;
+class QLockFile;
+class QLocalSocket;
+
+/**
+ * @class SingleInstance
+ * @brief Hands files over to an already running player
+ * 
+ * A second launch connects to the first one over a QLocalSocket, sends the
+ * files it was given and exits, so the running player can open them on its
+ * already initialized VLC instance. A message is one absolute path per line,
+ * terminated by an empty line.
+ * 
+ * A lock file is held from the forwarding attempt until the server listens,
+ * so of two launches racing each other exactly one becomes the running instance.
+ */
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SingleInstance(QObject *parent = nullptr);
+    ~SingleInstance();
+    
+    // Send filePaths (may be empty) to a running instance, returns false if there is none
+    // (then the launch lock is kept until listen())
+    bool forwardToRunningInstance(const QStringList& filePaths);
+    
+    // Become the running instance and accept files from later launches
+    bool listen();
+
+signals:
+    // A later launch asked to open filePaths (empty if it had no file)
+    void filesReceived(const QStringList& filePaths);
+
+private slots:
+    void handleNewConnection();
+
+private:
+    static QString serverName();
+    void processMessage(QLocalSocket* socket);
+    
+    QLocalServer* m_server;
+    std::unique_ptr<QLockFile> m_launchLock;  // Held between a failed forward and listen()
+    QHash<QLocalSocket*, QStringList> m_pendingFiles;  // Paths of messages not terminated yet
+};
+
+#endif // SINGLEINSTANCE_H
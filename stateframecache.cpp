@@ -0,0 +1,151 @@
+#include "stateframecache.h"
+#include "framestepbuffer.h"
+#include <vlc/vlc.h>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+
+const int DefaultBudgetMegabytes = 256;
+
+} // namespace
+
+int StateFrameCache::s_budgetMegabytes = DefaultBudgetMegabytes;
+
+void StateFrameCache::setBudget(int megabytes)
+{
+    s_budgetMegabytes = qMax(0, megabytes);
+}
+
+int StateFrameCache::budget()
+{
+    return s_budgetMegabytes;
+}
+
+StateFrameCache::StateFrameCache(const QSize& frameSize)
+    : m_frameSize(frameSize)
+    , m_capacity(0)
+    , m_shared(std::make_shared<Shared>())
+{
+    qint64 frameBytes = qMax<qint64>(1, static_cast<qint64>(frameSize.width()) * frameSize.height() * 4);
+    m_capacity = static_cast<int>(s_budgetMegabytes * 1024LL * 1024 / frameBytes);
+    m_shared->frameSize = frameSize;
+    
+    qDebug() << "StateFrameCache: Room for" << m_capacity << "frames of" << m_frameSize;
+}
+
+StateFrameCache::~StateFrameCache()
+{
+    // Not joined: a decode can take seconds and this runs on the GUI thread when the
+    // file changes. The decoder sees the flag after its current frame and finishes,
+    // its owner waits for it before libvlc goes
+    QMutexLocker locker(&m_shared->mutex);
+    m_shared->cancelled = true;
+    
+    for (const auto& pending : m_shared->pending) {
+        libvlc_media_release(pending.second);
+    }
+    m_shared->pending.clear();
+    m_shared->frames.clear();
+}
+
+QThread* StateFrameCache::setPositions(const std::function<libvlc_media_t*()>& createMedia, const QList<qint64>& positions)
+{
+    QMutexLocker locker(&m_shared->mutex);
+    
+    QList<qint64>& wanted = m_shared->positions;
+    std::map<qint64, QImage>& frames = m_shared->frames;
+    std::map<qint64, libvlc_media_t*>& pending = m_shared->pending;
+    
+    wanted.clear();
+    for (qint64 position : positions) {
+        if (wanted.size() < m_capacity && !wanted.contains(position)) {
+            wanted.append(position);
+        }
+    }
+    
+    // What is no longer wanted goes, queued work included
+    for (auto it = frames.begin(); it != frames.end();) {
+        it = wanted.contains(it->first) ? std::next(it) : frames.erase(it);
+    }
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (wanted.contains(it->first)) {
+            ++it;
+        } else {
+            libvlc_media_release(it->second);
+            it = pending.erase(it);
+        }
+    }
+    
+    for (qint64 position : wanted) {
+        if (frames.count(position) || pending.count(position) || position == m_shared->running) {
+            continue;
+        }
+        if (libvlc_media_t* media = createMedia()) {
+            pending[position] = media;
+        }
+    }
+    
+    // A running decoder takes them next
+    if (pending.empty() || m_shared->decoding) {
+        return nullptr;
+    }
+    m_shared->decoding = true;
+    
+    std::shared_ptr<Shared> shared = m_shared;
+    QThread* decoder = QThread::create([shared]() {
+        decodeLoop(shared);
+    });
+    decoder->setObjectName("stateFrameDecoder");
+    QObject::connect(decoder, &QThread::finished, decoder, &QObject::deleteLater);
+    decoder->start();
+    return decoder;
+}
+
+QImage StateFrameCache::frameAt(qint64 position)
+{
+    QMutexLocker locker(&m_shared->mutex);
+    auto it = m_shared->frames.find(position);
+    return it != m_shared->frames.end() ? it->second : QImage();
+}
+
+void StateFrameCache::decodeLoop(const std::shared_ptr<Shared>& shared)
+{
+    for (;;) {
+        qint64 position = -1;
+        libvlc_media_t* media = nullptr;
+        {
+            QMutexLocker locker(&shared->mutex);
+            shared->running = -1;
+            if (shared->cancelled || shared->pending.empty()) {
+                shared->decoding = false;
+                return;
+            }
+            
+            // In the order of the states
+            auto it = shared->pending.begin();
+            for (qint64 wanted : shared->positions) {
+                auto found = shared->pending.find(wanted);
+                if (found != shared->pending.end()) {
+                    it = found;
+                    break;
+                }
+            }
+            
+            position = it->first;
+            media = it->second;
+            shared->pending.erase(it);
+            shared->running = position;
+        }
+        
+        QImage frame = FrameStepBuffer::decodeFrame(media, position, shared->frameSize);
+        
+        // Dropped from the wanted positions (or the cache destroyed) while it was decoded
+        QMutexLocker locker(&shared->mutex);
+        if (frame.isNull()) {
+            qDebug() << "StateFrameCache: No frame shown at" << position << "ms";
+        } else if (!shared->cancelled && shared->positions.contains(position)) {
+            shared->frames[position] = frame;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef STATEFRAMECACHE_H
+#define STATEFRAMECACHE_H
+
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSize>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+
+struct libvlc_media_t;
+class QThread;
+
+/**
+ * @class StateFrameCache
+ * @brief Full-resolution frames at the saved states' positions, decoded ahead
+ *
+ * Recalling a state shows the old picture until VLC has seeked and decoded the
+ * new one. A decoder thread opens each position on a hidden libvlc player
+ * (FrameStepBuffer::decodeFrame) and keeps its frame, so a recall can show it
+ * at once while the real seek completes underneath.
+ *
+ * Positions are decoded in the order given, as many as fit the memory budget;
+ * frames of positions no longer given (another group, a deleted state) are
+ * dropped.
+ *
+ * The decoder thread shares the cache's state and is not joined: destroying the
+ * cache (switching files) only cancels it, a decode under way finishes in the
+ * background and is thrown away. setPositions() hands the thread to the caller,
+ * who waits for it before releasing the libvlc instance.
+ */
+class StateFrameCache
+{
+public:
+    // Memory for the frames of caches created afterwards (default 256, 0 turns the cache off)
+    static void setBudget(int megabytes);
+    static int budget();
+    
+    explicit StateFrameCache(const QSize& frameSize);
+    ~StateFrameCache();
+    
+    QSize frameSize() const { return m_frameSize; }
+    
+    // Keep the frames of these positions, decoding the missing ones in the background
+    // from media made by createMedia (on this thread, one per position). Returns the
+    // decoder thread it started, nullptr if none; the thread deletes itself when finished
+    QThread* setPositions(const std::function<libvlc_media_t*()>& createMedia, const QList<qint64>& positions);
+    
+    // Frame of exactly this position, null if it is not decoded (yet)
+    QImage frameAt(qint64 position);
+
+private:
+    // Everything the decoder thread touches, kept alive by it after the cache is gone
+    struct Shared {
+        QSize frameSize;
+        QMutex mutex;
+        QList<qint64> positions;  // Wanted, at most m_capacity
+        std::map<qint64, QImage> frames;
+        std::map<qint64, libvlc_media_t*> pending;  // Still to decode, by position
+        qint64 running = -1;  // Position being decoded, -1 if none
+        bool decoding = false;  // A decoder thread is running
+        std::atomic<bool> cancelled{false};
+    };
+    
+    static void decodeLoop(const std::shared_ptr<Shared>& shared);
+    
+    QSize m_frameSize;
+    int m_capacity;  // Frames the budget holds
+    std::shared_ptr<Shared> m_shared;
+    
+    static int s_budgetMegabytes;
+};
+
+#endif // STATEFRAMECACHE_H
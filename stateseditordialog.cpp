@@ -165,6 +165,7 @@ void StatesEditorDialog::loadStatesFromPlayer()
         m_tempStates[m_currentGroup][s].playbackSpeed = playerState.playbackSpeed;
         m_tempStates[m_currentGroup][s].isValid = playerState.isValid;
         m_tempStates[m_currentGroup][s].hasEndPosition = playerState.hasEndPosition;
+        m_tempStates[m_currentGroup][s].keyframeSnap = playerState.keyframeSnap;
         m_tempStates[m_currentGroup][s].previewImage = playerState.previewImage;
     }
     
@@ -194,6 +195,7 @@ void StatesEditorDialog::loadGroupFromDisk(int groupIndex)
         m_tempStates[groupIndex][s].playbackSpeed = playerState.playbackSpeed;
         m_tempStates[groupIndex][s].isValid = playerState.isValid;
         m_tempStates[groupIndex][s].hasEndPosition = playerState.hasEndPosition;
+        m_tempStates[groupIndex][s].keyframeSnap = playerState.keyframeSnap;
         m_tempStates[groupIndex][s].previewImage = playerState.previewImage;
     }
     
@@ -225,6 +227,7 @@ bool StatesEditorDialog::compareGroupWithDisk(int groupIndex) const
         
         if (diskState.isValid != tempState.isValid ||
             diskState.hasEndPosition != tempState.hasEndPosition ||
+            diskState.keyframeSnap != tempState.keyframeSnap ||
             diskState.startPosition != tempState.startPosition ||
             diskState.endPosition != tempState.endPosition ||
             !qFuzzyCompare(diskState.playbackSpeed, tempState.playbackSpeed)) {
@@ -283,6 +286,12 @@ void StatesEditorDialog::populateStateList(int groupIndex)
             if (!qFuzzyCompare(state.playbackSpeed, 1.0)) {
                 text += QString(" (%1x)").arg(state.playbackSpeed, 0, 'f', 1);
             }
+            
+            // Recalled earlier, at the keyframe before the start
+            qint64 recallAt = m_player ? m_player->recallPosition(state.startPosition, state.keyframeSnap) : state.startPosition;
+            if (recallAt != state.startPosition) {
+                text += tr(" [keyframe %1 s earlier]").arg((state.startPosition - recallAt) / 1000.0, 0, 'f', 2);
+            }
         }
         
         item->setText(text);
@@ -352,6 +361,7 @@ void StatesEditorDialog::onTabChanged(int index)
                 playerState.playbackSpeed = m_tempStates[m_currentGroup][s].playbackSpeed;
                 playerState.isValid = m_tempStates[m_currentGroup][s].isValid;
                 playerState.hasEndPosition = m_tempStates[m_currentGroup][s].hasEndPosition;
+                playerState.keyframeSnap = m_tempStates[m_currentGroup][s].keyframeSnap;
                 playerState.previewImage = m_tempStates[m_currentGroup][s].previewImage;
                 
                 m_player->setPlaybackState(s, playerState);
@@ -383,6 +393,7 @@ void StatesEditorDialog::onTabChanged(int index)
             playerState.playbackSpeed = m_tempStates[index][s].playbackSpeed;
             playerState.isValid = m_tempStates[index][s].isValid;
             playerState.hasEndPosition = m_tempStates[index][s].hasEndPosition;
+            playerState.keyframeSnap = m_tempStates[index][s].keyframeSnap;
             playerState.previewImage = m_tempStates[index][s].previewImage;
             
             m_player->setPlaybackState(s, playerState);
@@ -490,6 +501,7 @@ void StatesEditorDialog::showEditDialog(int groupIndex, int stateIndex)
     editState.playbackSpeed = state.playbackSpeed;
     editState.isValid = state.isValid;
     editState.hasEndPosition = state.hasEndPosition;
+    editState.keyframeSnap = state.keyframeSnap;
     editState.previewImage = state.previewImage;
     
     StateEditDialog editDialog(editState, stateIndex, maxDuration, this);
@@ -504,6 +516,7 @@ void StatesEditorDialog::showEditDialog(int groupIndex, int stateIndex)
         state.playbackSpeed = editState.playbackSpeed;
         state.isValid = editState.isValid;
         state.hasEndPosition = editState.hasEndPosition;
+        state.keyframeSnap = editState.keyframeSnap;
         state.previewImage = editState.previewImage;
         
         // Update the list display
@@ -611,6 +624,7 @@ void StatesEditorDialog::onSaveClicked()
         playerState.playbackSpeed = m_tempStates[m_currentGroup][s].playbackSpeed;
         playerState.isValid = m_tempStates[m_currentGroup][s].isValid;
         playerState.hasEndPosition = m_tempStates[m_currentGroup][s].hasEndPosition;
+        playerState.keyframeSnap = m_tempStates[m_currentGroup][s].keyframeSnap;
         playerState.previewImage = m_tempStates[m_currentGroup][s].previewImage;
         
         m_player->setPlaybackState(s, playerState);
@@ -715,6 +729,7 @@ void StatesEditorDialog::onCopyToClicked()
         playerState.playbackSpeed = m_tempStates[targetGroup][s].playbackSpeed;
         playerState.isValid = m_tempStates[targetGroup][s].isValid;
         playerState.hasEndPosition = m_tempStates[targetGroup][s].hasEndPosition;
+        playerState.keyframeSnap = m_tempStates[targetGroup][s].keyframeSnap;
         playerState.previewImage = m_tempStates[targetGroup][s].previewImage;
         
         m_player->setPlaybackState(s, playerState);
@@ -734,6 +749,7 @@ void StatesEditorDialog::onCopyToClicked()
         playerState.playbackSpeed = m_tempStates[m_currentGroup][s].playbackSpeed;
         playerState.isValid = m_tempStates[m_currentGroup][s].isValid;
         playerState.hasEndPosition = m_tempStates[m_currentGroup][s].hasEndPosition;
+        playerState.keyframeSnap = m_tempStates[m_currentGroup][s].keyframeSnap;
         playerState.previewImage = m_tempStates[m_currentGroup][s].previewImage;
         
         m_player->setPlaybackState(s, playerState);
@@ -799,6 +815,7 @@ void StatesEditorDialog::onCancelClicked()
                 playerState.playbackSpeed = m_tempStates[m_currentGroup][s].playbackSpeed;
                 playerState.isValid = m_tempStates[m_currentGroup][s].isValid;
                 playerState.hasEndPosition = m_tempStates[m_currentGroup][s].hasEndPosition;
+                playerState.keyframeSnap = m_tempStates[m_currentGroup][s].keyframeSnap;
                 playerState.previewImage = m_tempStates[m_currentGroup][s].previewImage;
                 
                 m_player->setPlaybackState(s, playerState);
@@ -881,6 +898,7 @@ StateEditDialog::StateEditDialog(const EditableState& state,
     , m_maxDuration(maxDuration)
     , m_startTimeEdit(nullptr)
     , m_endTimeEdit(nullptr)
+    , m_keyframeSnapComboBox(nullptr)
     , m_hasEndCheckBox(nullptr)
     , m_warningLabel(nullptr)
     , m_state(state)
@@ -949,6 +967,20 @@ void StateEditDialog::setupUI()
     formLayout->addWidget(speedLabel, 3, 0);
     formLayout->addWidget(m_speedSpinBox, 3, 1);
     
+    // Keyframe snap, in the order of LightweightVideoPlayer::KeyframeSnap
+    QLabel* snapLabel = new QLabel(tr("Keyframe Snap:"), this);
+    m_keyframeSnapComboBox = new QComboBox(this);
+    m_keyframeSnapComboBox->addItems({tr("Default (K)"), tr("On"), tr("Off")});
+    m_keyframeSnapComboBox->setCurrentIndex(static_cast<int>(m_state.keyframeSnap));
+    m_keyframeSnapComboBox->setToolTip(tr("Recall the state at the keyframe before its start (up to 3 s earlier), "
+                                          "which shows without decoding up to the start"));
+    
+    connect(m_keyframeSnapComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &StateEditDialog::onKeyframeSnapChanged);
+    
+    formLayout->addWidget(snapLabel, 4, 0);
+    formLayout->addWidget(m_keyframeSnapComboBox, 4, 1);
+    
     mainLayout->addLayout(formLayout);
     
     // Warning label
@@ -1033,6 +1065,11 @@ void StateEditDialog::onSpeedChanged(double value)
     m_state.playbackSpeed = value;
 }
 
+void StateEditDialog::onKeyframeSnapChanged(int index)
+{
+    m_state.keyframeSnap = static_cast<LightweightVideoPlayer::KeyframeSnap>(index);
+}
+
 void StateEditDialog::updateEndTimeEnabled()
 {
     m_endTimeEdit->setEnabled(m_hasEndCheckBox->isChecked());
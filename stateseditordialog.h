@@ -11,11 +11,10 @@
 #include <QTimeEdit>
 #include <QDoubleSpinBox>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QMap>
 #include <QPixmap>
-
-// Forward declaration
-class LightweightVideoPlayer;
+#include "lightweightvideoplayer.h"
 
 /**
  * @class StatesEditorDialog
@@ -76,9 +75,10 @@ private:
         qreal playbackSpeed;
         bool isValid;
         bool hasEndPosition;
+        LightweightVideoPlayer::KeyframeSnap keyframeSnap;
         QPixmap previewImage;
         
-        TempStateStorage() : startPosition(0), endPosition(0), playbackSpeed(1.0), isValid(false), hasEndPosition(false) {}
+        TempStateStorage() : startPosition(0), endPosition(0), playbackSpeed(1.0), isValid(false), hasEndPosition(false), keyframeSnap(LightweightVideoPlayer::KeyframeSnap::Default) {}
     };
     
     TempStateStorage m_tempStates[4][12];  // 4 groups x 12 states
@@ -105,9 +105,10 @@ public:
         qreal playbackSpeed;
         bool isValid;
         bool hasEndPosition;
+        LightweightVideoPlayer::KeyframeSnap keyframeSnap;
         QPixmap previewImage;
         
-        EditableState() : startPosition(0), endPosition(0), playbackSpeed(1.0), isValid(false), hasEndPosition(false) {}
+        EditableState() : startPosition(0), endPosition(0), playbackSpeed(1.0), isValid(false), hasEndPosition(false), keyframeSnap(LightweightVideoPlayer::KeyframeSnap::Default) {}
     };
     
     explicit StateEditDialog(const EditableState& state, 
@@ -122,6 +123,7 @@ private slots:
     void onEndTimeChanged(const QTime& time);
     void onHasEndChanged(int state);
     void onSpeedChanged(double value);
+    void onKeyframeSnapChanged(int index);
 
 private:
     void setupUI();
@@ -133,6 +135,7 @@ private:
     QTimeEdit* m_startTimeEdit;
     QTimeEdit* m_endTimeEdit;
     QDoubleSpinBox* m_speedSpinBox;
+    QComboBox* m_keyframeSnapComboBox;
     QCheckBox* m_hasEndCheckBox;
     QLabel* m_warningLabel;
     
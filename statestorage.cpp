@@ -0,0 +1,256 @@
+#include "statestorage.h"
+#include "filefingerprint.h"
+#include "perftracer.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+namespace {
+
+const int GroupCount = 4;
+const int FingerprintHexLength = 32;
+
+// Name of a group file: <fingerprint>.statesG<n> (or <video name>.statesG<n> before fingerprints)
+QString groupFileName(const QString& baseName, int groupIndex)
+{
+    return baseName + QString(".statesG%1").arg(groupIndex + 1);
+}
+
+} // namespace
+
+StateStorage& StateStorage::instance()
+{
+    static StateStorage storage;
+    return storage;
+}
+
+StateStorage::StateStorage()
+    : m_loaded(false)
+{
+}
+
+QString StateStorage::s_rootPath;
+
+QString StateStorage::rootPath()
+{
+    if (!s_rootPath.isEmpty()) {
+        return s_rootPath;
+    }
+    return QCoreApplication::applicationDirPath() + "/savedstates";
+}
+
+void StateStorage::setRootPath(const QString& path)
+{
+    s_rootPath = path;
+}
+
+bool StateStorage::isFingerprintFileName(const QString& fileName)
+{
+    // <32 hex digits>.statesG<n>
+    if (fileName.size() != FingerprintHexLength + 9 || !fileName.mid(FingerprintHexLength).startsWith(".statesG")) {
+        return false;
+    }
+    
+    // QByteArray::toHex() writes lowercase digits
+    for (int i = 0; i < FingerprintHexLength; i++) {
+        QChar c = fileName.at(i);
+        if (!(c >= '0' && c <= '9') && !(c >= 'a' && c <= 'f')) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+void StateStorage::ensureLoaded()
+{
+    if (m_loaded) {
+        return;
+    }
+    
+    m_loaded = true;
+    m_rootPath = rootPath();
+    
+    PERF_TRACE_SCOPE("stateStorageLoad");
+    
+    QDir root(m_rootPath);
+    if (!root.exists()) {
+        root.mkpath(".");
+    }
+    
+    const QStringList nameFilters = {"*.statesG*"};
+    
+    const QStringList flatFiles = root.entryList(nameFilters, QDir::Files);
+    for (const QString& fileName : flatFiles) {
+        m_flatFiles.insert(fileName);
+    }
+    
+    QDir groupsDir(m_rootPath + "/groups");
+    const QStringList shards = groupsDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& shard : shards) {
+        m_shards.insert(shard);
+        
+        const QStringList files = QDir(groupsDir.filePath(shard)).entryList(nameFilters, QDir::Files);
+        for (const QString& fileName : files) {
+            m_files.insert(fileName);
+        }
+    }
+    
+    qDebug() << "StateStorage: Indexed" << m_files.size() << "group files in" << m_shards.size() << "shards,"
+             << m_flatFiles.size() << "in the flat layout";
+}
+
+QString StateStorage::shardPath(const QString& fingerprintHex)
+{
+    // The first 16 hex digits are the file size, the shard comes from the hash
+    QString shard = fingerprintHex.mid(16, 2);
+    QString path = m_rootPath + "/groups/" + shard;
+    
+    if (!m_shards.contains(shard)) {
+        QDir().mkpath(path);
+        m_shards.insert(shard);
+    }
+    
+    return path;
+}
+
+bool StateStorage::moveFlatFile(const QString& fileName)
+{
+    QString target = shardPath(fileName.left(FingerprintHexLength)) + "/" + fileName;
+    
+    if (!QFile::rename(m_rootPath + "/" + fileName, target)) {
+        qDebug() << "StateStorage: Failed to move" << fileName << "into its shard";
+        return false;
+    }
+    
+    m_flatFiles.remove(fileName);
+    m_files.insert(fileName);
+    return true;
+}
+
+QString StateStorage::groupFilePath(const QString& videoPath, int groupIndex)
+{
+    if (videoPath.isEmpty()) {
+        return QString();
+    }
+    
+    // Hashing may read the file, do it before taking the lock
+    QByteArray fingerprint = FileFingerprint::instance().fingerprint(videoPath);
+    QString legacyName = groupFileName(QFileInfo(videoPath).completeBaseName(), groupIndex);
+    
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    
+    // A URL or an unreadable file has no identity to keep states under; the name alone
+    // would share them with every other video called the same
+    if (fingerprint.isEmpty()) {
+        return QString();
+    }
+    
+    QString fingerprintHex = QString::fromLatin1(fingerprint.toHex());
+    QString fileName = groupFileName(fingerprintHex, groupIndex);
+    QString filePath = shardPath(fingerprintHex) + "/" + fileName;
+    
+    if (m_files.contains(fileName)) {
+        return filePath;
+    }
+    
+    // Flat layout, move it into the shard now rather than waiting for the migration
+    if (m_flatFiles.contains(fileName)) {
+        return moveFlatFile(fileName) ? filePath : m_rootPath + "/" + fileName;
+    }
+    
+    // States saved before fingerprint keying were named after the video. They go to the
+    // first video of that name looked up and are moved, not copied: a copy would bring
+    // deleted groups back and hand the states to every other video of the same name
+    if (m_flatFiles.contains(legacyName)) {
+        if (QFile::rename(m_rootPath + "/" + legacyName, filePath)) {
+            m_flatFiles.remove(legacyName);
+            m_files.insert(fileName);
+            qDebug() << "StateStorage: Migrated states" << legacyName << "->" << filePath;
+        } else {
+            qDebug() << "StateStorage: Failed to migrate states" << legacyName;
+        }
+    }
+    
+    return filePath;
+}
+
+void StateStorage::groupFileSaved(const QString& filePath)
+{
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    
+    QString fileName = QFileInfo(filePath).fileName();
+    if (isFingerprintFileName(fileName)) {
+        m_files.insert(fileName);
+    } else {
+        m_flatFiles.insert(fileName);
+    }
+}
+
+void StateStorage::groupFileRemoved(const QString& filePath)
+{
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    
+    QString fileName = QFileInfo(filePath).fileName();
+    if (isFingerprintFileName(fileName)) {
+        m_files.remove(fileName);
+    } else {
+        m_flatFiles.remove(fileName);
+    }
+}
+
+bool StateStorage::hasStates(const QByteArray& fingerprint)
+{
+    QString fingerprintHex = QString::fromLatin1(fingerprint.toHex());
+    
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    
+    for (int i = 0; i < GroupCount; i++) {
+        QString fileName = groupFileName(fingerprintHex, i);
+        if (m_files.contains(fileName) || m_flatFiles.contains(fileName)) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void StateStorage::migrateFlatLayout()
+{
+    QStringList pending;
+    
+    {
+        QMutexLocker locker(&m_mutex);
+        ensureLoaded();
+        
+        for (const QString& fileName : std::as_const(m_flatFiles)) {
+            if (isFingerprintFileName(fileName)) {
+                pending << fileName;
+            }
+        }
+    }
+    
+    if (pending.isEmpty()) {
+        return;
+    }
+    
+    PERF_TRACE_SCOPE("stateStorageMigrate");
+    
+    // One file per lock, lookups from the player are never held up for long
+    int moved = 0;
+    for (const QString& fileName : std::as_const(pending)) {
+        QMutexLocker locker(&m_mutex);
+        
+        if (m_flatFiles.contains(fileName) && moveFlatFile(fileName)) {
+            moved++;
+        }
+    }
+    
+    qDebug() << "StateStorage: Moved" << moved << "of" << pending.size() << "flat group files into shards";
+}
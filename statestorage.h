@@ -0,0 +1,65 @@
+#ifndef STATESTORAGE_H
+#define STATESTORAGE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QSet>
+#include <QMutex>
+
+/**
+ * @class StateStorage
+ * @brief Locates state group files in savedstates/, sharded by fingerprint
+ *
+ * Group files live in 256 subdirectories named after the first hash byte of
+ * the video's fingerprint (savedstates/groups/3f/<fingerprint>.statesG1), so no
+ * directory grows past a few hundred files. Which files and shards exist is
+ * read once into memory; a lookup after that touches no directory.
+ *
+ * Files of the earlier flat layout are moved into their shard when they are
+ * first looked up and, in bulk, by migrateFlatLayout() on a background thread.
+ * All functions are thread-safe.
+ */
+class StateStorage
+{
+public:
+    static StateStorage& instance();
+    
+    // Path of a video's state group file, whether it exists or not
+    // (empty if the video has no fingerprint, e.g. a stream or an unreadable file)
+    QString groupFilePath(const QString& videoPath, int groupIndex);
+    
+    // Keep the index current after writing or removing a group file
+    void groupFileSaved(const QString& filePath);
+    void groupFileRemoved(const QString& filePath);
+    
+    // True if any state group file exists for the fingerprint
+    bool hasStates(const QByteArray& fingerprint);
+    
+    // Load the index and move every flat-layout file of a fingerprint into its shard
+    void migrateFlatLayout();
+    
+    // savedstates/ next to the executable, unless moved by setRootPath()
+    static QString rootPath();
+    
+    // Keep all saved data in another directory (set before anything is loaded)
+    static void setRootPath(const QString& path);
+
+private:
+    StateStorage();
+    
+    void ensureLoaded();
+    QString shardPath(const QString& fingerprintHex);
+    bool moveFlatFile(const QString& fileName);
+    static bool isFingerprintFileName(const QString& fileName);
+    
+    QMutex m_mutex;
+    bool m_loaded;
+    QString m_rootPath;
+    QSet<QString> m_shards;  // Shard directories that exist
+    QSet<QString> m_files;  // Group file names in shards
+    QSet<QString> m_flatFiles;  // Group file names still in the flat root
+    
+    static QString s_rootPath;
+};
+
+#endif // STATESTORAGE_H
@@ -0,0 +1,9 @@
+# All unit tests, qmake tests/tests.pro && make check builds and runs them
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_simulatedplayer.pro \
+    tst_playerloops.pro \
+    tst_keyframeindex.pro \
+    tst_archivereader.pro
@@ -0,0 +1,375 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <cstring>
+#include <memory>
+#include <zlib.h>
+#include "archivereader.h"
+
+namespace {
+
+// Large enough for several inflate checkpoints (4 MiB apart at least)
+const int DeflatedSize = 13 * 1024 * 1024 + 321;
+const int StoredSize = 300 * 1024 + 17;
+const qint64 TarBlockSize = 512;
+
+// Text-like bytes that deflate into many blocks
+QByteArray content(int size, quint32 seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    quint32 state = seed;
+    for (int i = 0; i < size; i++) {
+        state = state * 1664525u + 1013904223u;
+        data[i] = static_cast<char>('a' + (state >> 24) % 20);
+    }
+    return data;
+}
+
+QByteArray rawDeflate(const QByteArray& data)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return QByteArray();
+    }
+    
+    QByteArray compressed(static_cast<int>(deflateBound(&stream, static_cast<uLong>(data.size()))), Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    
+    int result = deflate(&stream, Z_FINISH);
+    compressed.resize(static_cast<int>(stream.total_out));
+    deflateEnd(&stream);
+    return result == Z_STREAM_END ? compressed : QByteArray();
+}
+
+void appendLe16(QByteArray& bytes, quint16 value)
+{
+    char field[2];
+    qToLittleEndian(value, field);
+    bytes.append(field, 2);
+}
+
+void appendLe32(QByteArray& bytes, quint32 value)
+{
+    char field[4];
+    qToLittleEndian(value, field);
+    bytes.append(field, 4);
+}
+
+struct ZipEntry {
+    QByteArray name;
+    QByteArray data;
+    bool deflated;
+};
+
+// Local headers and data, then the central directory and its end record
+QByteArray zipArchive(const QList<ZipEntry>& entries)
+{
+    QByteArray archive;
+    QByteArray directory;
+    
+    for (const ZipEntry& entry : entries) {
+        const QByteArray stored = entry.deflated ? rawDeflate(entry.data) : entry.data;
+        const quint32 crc = static_cast<quint32>(crc32(0, reinterpret_cast<const Bytef*>(entry.data.constData()),
+                                                       static_cast<uInt>(entry.data.size())));
+        const quint16 method = entry.deflated ? 8 : 0;
+        const quint32 offset = static_cast<quint32>(archive.size());
+        
+        appendLe32(archive, 0x04034b50);
+        appendLe16(archive, 20);  // Version needed
+        appendLe16(archive, 0x0800);  // UTF-8 name
+        appendLe16(archive, method);
+        appendLe32(archive, 0);  // Time and date
+        appendLe32(archive, crc);
+        appendLe32(archive, static_cast<quint32>(stored.size()));
+        appendLe32(archive, static_cast<quint32>(entry.data.size()));
+        appendLe16(archive, static_cast<quint16>(entry.name.size()));
+        appendLe16(archive, 0);  // Extra field
+        archive += entry.name + stored;
+        
+        appendLe32(directory, 0x02014b50);
+        appendLe16(directory, 20);  // Version made by
+        appendLe16(directory, 20);
+        appendLe16(directory, 0x0800);
+        appendLe16(directory, method);
+        appendLe32(directory, 0);
+        appendLe32(directory, crc);
+        appendLe32(directory, static_cast<quint32>(stored.size()));
+        appendLe32(directory, static_cast<quint32>(entry.data.size()));
+        appendLe16(directory, static_cast<quint16>(entry.name.size()));
+        appendLe16(directory, 0);  // Extra field
+        appendLe16(directory, 0);  // Comment
+        appendLe16(directory, 0);  // Disk
+        appendLe16(directory, 0);  // Internal attributes
+        appendLe32(directory, 0);  // External attributes
+        appendLe32(directory, offset);
+        directory += entry.name;
+    }
+    
+    const quint32 directoryOffset = static_cast<quint32>(archive.size());
+    archive += directory;
+    appendLe32(archive, 0x06054b50);
+    appendLe16(archive, 0);
+    appendLe16(archive, 0);
+    appendLe16(archive, static_cast<quint16>(entries.size()));
+    appendLe16(archive, static_cast<quint16>(entries.size()));
+    appendLe32(archive, static_cast<quint32>(directory.size()));
+    appendLe32(archive, directoryOffset);
+    appendLe16(archive, 0);  // Comment
+    return archive;
+}
+
+QByteArray padded(const QByteArray& data)
+{
+    const qint64 blocks = (data.size() + TarBlockSize - 1) / TarBlockSize;
+    return data + QByteArray(static_cast<int>(blocks * TarBlockSize - data.size()), '\0');
+}
+
+QByteArray tarHeader(const QByteArray& name, qint64 size, char type)
+{
+    QByteArray header(static_cast<int>(TarBlockSize), '\0');
+    auto setField = [&header](int offset, const QByteArray& value) {
+        header.replace(offset, value.size(), value);
+    };
+    
+    setField(0, name.left(100));
+    setField(100, "0000644");
+    setField(108, "0000000");
+    setField(116, "0000000");
+    setField(124, QByteArray::number(size, 8).rightJustified(11, '0'));
+    setField(136, "00000000000");
+    header[156] = type;
+    setField(257, QByteArray("ustar\0", 6));
+    setField(263, "00");
+    
+    // Sum of the header bytes with the checksum field taken as spaces
+    setField(148, "        ");
+    qint64 sum = 0;
+    for (char byte : header) {
+        sum += static_cast<uchar>(byte);
+    }
+    setField(148, QByteArray::number(sum, 8).rightJustified(6, '0') + QByteArray("\0 ", 2));
+    return header;
+}
+
+QByteArray tarEntry(const QByteArray& name, const QByteArray& data)
+{
+    return tarHeader(name, data.size(), '0') + padded(data);
+}
+
+// GNU: a ././@LongLink entry holding the name, then the entry with the name cut short
+QByteArray gnuLongNameEntry(const QByteArray& name, const QByteArray& data)
+{
+    QByteArray longName = name + '\0';
+    return tarHeader("././@LongLink", longName.size(), 'L') + padded(longName) + tarEntry(name.left(100), data);
+}
+
+// pax: an extended header with a "<length> path=<name>\n" record, its length counting its own digits
+QByteArray paxPathEntry(const QByteArray& name, const QByteArray& data)
+{
+    const QByteArray record = " path=" + name + "\n";
+    int length = record.size() + 1;
+    while (QByteArray::number(length).size() + record.size() != length) {
+        length++;
+    }
+    const QByteArray extended = QByteArray::number(length) + record;
+    return tarHeader("PaxHeaders/entry", extended.size(), 'x') + padded(extended) + tarEntry("truncated.mp4", data);
+}
+
+// Reads from the reader's position to the end of the entry in chunks of chunkSize
+QByteArray readAll(ArchiveReader& reader, qint64 chunkSize)
+{
+    QByteArray data;
+    QByteArray buffer(static_cast<int>(chunkSize), Qt::Uninitialized);
+    for (;;) {
+        qint64 bytesRead = reader.read(buffer.data(), chunkSize);
+        if (bytesRead <= 0) {
+            break;
+        }
+        data.append(buffer.constData(), static_cast<int>(bytesRead));
+    }
+    return data;
+}
+
+QByteArray readAt(ArchiveReader& reader, qint64 offset, qint64 length)
+{
+    QByteArray buffer(static_cast<int>(length), Qt::Uninitialized);
+    if (!reader.seek(offset)) {
+        return QByteArray();
+    }
+    
+    // A read may return less than asked; stops at the end of the entry
+    qint64 total = 0;
+    while (total < length) {
+        qint64 bytesRead = reader.read(buffer.data() + total, length - total);
+        if (bytesRead <= 0) {
+            break;
+        }
+        total += bytesRead;
+    }
+    buffer.resize(static_cast<int>(total));
+    return buffer;
+}
+
+} // namespace
+
+/**
+ * Zip and tar entries read through ArchiveReader
+ *
+ * The archives are written to a temporary directory: a zip with a stored and a
+ * deflated entry (zlib, raw deflate as in real zips) and tars whose names only
+ * fit in a GNU long name or a pax header. Reads after seeks are compared with
+ * the bytes the entries were built from.
+ */
+class ArchiveReaderTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void splitPath();
+    void zipDirectory();
+    void storedEntry();
+    void deflatedEntry();
+    void deflatedSeeks_data();
+    void deflatedSeeks();
+    void tarLongNames();
+
+private:
+    std::unique_ptr<QTemporaryDir> m_dataDir;
+    QString m_zipPath;
+    QByteArray m_stored;
+    QByteArray m_deflated;
+};
+
+void ArchiveReaderTest::initTestCase()
+{
+    m_dataDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_dataDir->isValid());
+    
+    m_stored = content(StoredSize, 1);
+    m_deflated = content(DeflatedSize, 2);
+    
+    m_zipPath = m_dataDir->filePath("clips.zip");
+    QFile zip(m_zipPath);
+    QVERIFY(zip.open(QIODevice::WriteOnly));
+    QVERIFY(zip.write(zipArchive({{"clips/stored.mp4", m_stored, false}, {"clips/deflated.mp4", m_deflated, true}})) > 0);
+    zip.close();
+}
+
+void ArchiveReaderTest::splitPath()
+{
+    QString archivePath;
+    QString entryName;
+    QVERIFY(ArchiveReader::splitPath("/videos/a!/b.zip!/c!/d.mp4", &archivePath, &entryName));
+    QCOMPARE(archivePath, QString("/videos/a!/b.zip"));
+    QCOMPARE(entryName, QString("c!/d.mp4"));
+    
+    QVERIFY(!ArchiveReader::splitPath("/videos/a!/b.mp4", nullptr, nullptr));
+}
+
+void ArchiveReaderTest::zipDirectory()
+{
+    QStringList paths = ArchiveReader::entryPaths(m_zipPath, {"*.mp4"});
+    QCOMPARE(paths.size(), 2);
+    QVERIFY(paths.at(0).endsWith("!/clips/deflated.mp4"));
+    QVERIFY(paths.at(1).endsWith("!/clips/stored.mp4"));
+    
+    QVERIFY(ArchiveReader::exists(m_zipPath + "!/clips/stored.mp4"));
+    QVERIFY(!ArchiveReader::exists(m_zipPath + "!/clips/missing.mp4"));
+    
+    ArchiveReader::Entry entry;
+    QVERIFY(ArchiveReader::findEntry(m_zipPath + "!/clips/deflated.mp4", &entry));
+    QVERIFY(entry.deflated);
+    QCOMPARE(entry.size, qint64(DeflatedSize));
+    QVERIFY(entry.compressedSize < entry.size);
+}
+
+void ArchiveReaderTest::storedEntry()
+{
+    std::unique_ptr<ArchiveReader> reader = ArchiveReader::openEntry(m_zipPath + "!/clips/stored.mp4");
+    QVERIFY(reader);
+    QCOMPARE(reader->size(), qint64(StoredSize));
+    QVERIFY(readAll(*reader, 4096) == m_stored);
+    
+    QVERIFY(readAt(*reader, 1000, 5000) == m_stored.mid(1000, 5000));
+    QVERIFY(readAt(*reader, StoredSize - 10, 100) == m_stored.right(10));
+    QVERIFY(!reader->seek(StoredSize + 1));
+}
+
+void ArchiveReaderTest::deflatedEntry()
+{
+    std::unique_ptr<ArchiveReader> reader = ArchiveReader::openEntry(m_zipPath + "!/clips/deflated.mp4");
+    QVERIFY(reader);
+    QCOMPARE(reader->size(), qint64(DeflatedSize));
+    QVERIFY(readAll(*reader, 100000) == m_deflated);
+    
+    // At the end
+    char byte;
+    QCOMPARE(reader->read(&byte, 1), qint64(0));
+}
+
+void ArchiveReaderTest::deflatedSeeks_data()
+{
+    QTest::addColumn<QList<qint64>>("offsets");
+    
+    const qint64 MiB = 1024 * 1024;
+    QTest::newRow("forward") << QList<qint64>{1, 3 * MiB + 5, 6 * MiB + 99, 11 * MiB, DeflatedSize - 100};
+    QTest::newRow("backward") << QList<qint64>{12 * MiB + 1, 9 * MiB + 3, 4 * MiB + 4, 1000, 0};
+    QTest::newRow("around") << QList<qint64>{7 * MiB, 2 * MiB, 7 * MiB + 1, 13 * MiB, 5 * MiB - 1};
+}
+
+void ArchiveReaderTest::deflatedSeeks()
+{
+    QFETCH(QList<qint64>, offsets);
+    
+    // Restarts from the checkpoints another reader and the background indexing left
+    std::unique_ptr<ArchiveReader> reader = ArchiveReader::openEntry(m_zipPath + "!/clips/deflated.mp4");
+    QVERIFY(reader);
+    
+    for (qint64 offset : offsets) {
+        QByteArray expected = m_deflated.mid(static_cast<int>(offset), 70000);
+        QVERIFY2(readAt(*reader, offset, 70000) == expected, qPrintable(QString("at %1").arg(offset)));
+    }
+}
+
+void ArchiveReaderTest::tarLongNames()
+{
+    const QByteArray gnuName = "videos/" + QByteArray(120, 'g') + "/clip.mp4";
+    const QByteArray paxName = "videos/" + QByteArray(150, 'p') + "/clip.mp4";
+    const QByteArray gnuData = content(5000, 3);
+    const QByteArray paxData = content(700, 4);
+    
+    const QString tarPath = m_dataDir->filePath("long.tar");
+    QFile tar(tarPath);
+    QVERIFY(tar.open(QIODevice::WriteOnly));
+    tar.write(tarEntry("short.mp4", content(10, 5)));
+    tar.write(gnuLongNameEntry(gnuName, gnuData));
+    tar.write(paxPathEntry(paxName, paxData));
+    tar.write(QByteArray(static_cast<int>(2 * TarBlockSize), '\0'));
+    tar.close();
+    
+    QCOMPARE(ArchiveReader::entryPaths(tarPath, {"*.mp4"}).size(), 3);
+    QVERIFY(ArchiveReader::exists(tarPath + "!/short.mp4"));
+    QVERIFY(ArchiveReader::exists(tarPath + "!/" + QString::fromUtf8(gnuName)));
+    QVERIFY(ArchiveReader::exists(tarPath + "!/" + QString::fromUtf8(paxName)));
+    
+    // The cut names in the entries' own headers are not used
+    QVERIFY(!ArchiveReader::exists(tarPath + "!/" + QString::fromUtf8(gnuName.left(100))));
+    QVERIFY(!ArchiveReader::exists(tarPath + "!/truncated.mp4"));
+    
+    std::unique_ptr<ArchiveReader> reader = ArchiveReader::openEntry(tarPath + "!/" + QString::fromUtf8(gnuName));
+    QVERIFY(reader);
+    QVERIFY(readAll(*reader, 1024) == gnuData);
+    
+    reader = ArchiveReader::openEntry(tarPath + "!/" + QString::fromUtf8(paxName));
+    QVERIFY(reader);
+    QVERIFY(readAt(*reader, 100, 1000) == paxData.mid(100));
+}
+
+QTEST_MAIN(ArchiveReaderTest)
+#include "tst_archivereader.moc"
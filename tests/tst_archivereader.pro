@@ -0,0 +1,15 @@
+# Unit tests of ArchiveReader on zip and tar archives written to a temporary directory
+# Readers are opened directly, without libvlc media (make check runs it); the reader links
+# with the VLC backend's sources
+
+QT       += core gui widgets network testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_archivereader
+
+SOURCES += \
+    tst_archivereader.cpp
+
+include(../vlcplayer.pri)
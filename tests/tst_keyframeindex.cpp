@@ -0,0 +1,378 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <memory>
+#include "keyframeindex.h"
+#include "statestorage.h"
+
+namespace {
+
+QByteArray be32(quint32 value)
+{
+    QByteArray bytes(4, '\0');
+    qToBigEndian(value, bytes.data());
+    return bytes;
+}
+
+QByteArray be64(quint64 value)
+{
+    QByteArray bytes(8, '\0');
+    qToBigEndian(value, bytes.data());
+    return bytes;
+}
+
+// ---- MP4 ----
+
+QByteArray box(const char* type, const QByteArray& payload)
+{
+    return be32(8 + payload.size()) + QByteArray(type, 4) + payload;
+}
+
+QByteArray fullBox(const char* type, quint8 version, const QByteArray& payload)
+{
+    return box(type, QByteArray(1, static_cast<char>(version)) + QByteArray(3, '\0') + payload);
+}
+
+// Pairs of 32-bit values after an entry count (stts, ctts)
+QByteArray runTable(const char* type, const QList<QPair<quint32, quint32>>& runs)
+{
+    QByteArray payload = be32(runs.size());
+    for (const auto& run : runs) {
+        payload += be32(run.first) + be32(run.second);
+    }
+    return fullBox(type, 0, payload);
+}
+
+// Sample table of a track, the boxes left empty are not written
+struct Mp4Track {
+    quint32 timescale = 1000;
+    QList<QPair<quint32, quint32>> stts;  // Run, delta
+    QList<QPair<quint32, quint32>> ctts;  // Run, offset
+    QList<quint32> sizes;
+    bool fixedSize = false;  // sizes holds one size per sample, written as a single one
+    quint32 samplesPerChunk = 2;
+    QList<quint64> chunkOffsets;
+    bool wideOffsets = false;
+    QList<quint32> syncSamples;  // 1-based
+    bool hasSyncTable = true;
+    qint64 editMediaTime = -2;  // No edit list below -1
+};
+
+QByteArray videoTrak(const Mp4Track& track)
+{
+    QByteArray hdlr = fullBox("hdlr", 0, be32(0) + "vide" + QByteArray(12, '\0') + QByteArray(1, '\0'));
+    QByteArray mdhd = fullBox("mdhd", 0, be32(0) + be32(0) + be32(track.timescale) + be32(0) + be32(0));
+    
+    QByteArray stsz = be32(track.fixedSize ? track.sizes.first() : 0) + be32(track.sizes.size());
+    if (!track.fixedSize) {
+        for (quint32 size : track.sizes) {
+            stsz += be32(size);
+        }
+    }
+    
+    QByteArray chunks = be32(track.chunkOffsets.size());
+    for (quint64 offset : track.chunkOffsets) {
+        chunks += track.wideOffsets ? be64(offset) : be32(static_cast<quint32>(offset));
+    }
+    
+    QByteArray stbl = runTable("stts", track.stts);
+    if (!track.ctts.isEmpty()) {
+        stbl += runTable("ctts", track.ctts);
+    }
+    stbl += fullBox("stsz", 0, stsz);
+    stbl += fullBox("stsc", 0, be32(1) + be32(1) + be32(track.samplesPerChunk) + be32(1));
+    stbl += fullBox(track.wideOffsets ? "co64" : "stco", 0, chunks);
+    if (track.hasSyncTable) {
+        QByteArray sync = be32(track.syncSamples.size());
+        for (quint32 number : track.syncSamples) {
+            sync += be32(number);
+        }
+        stbl += fullBox("stss", 0, sync);
+    }
+    
+    QByteArray trak;
+    if (track.editMediaTime >= -1) {
+        QByteArray edit = be32(1) + be32(1000) + be32(static_cast<quint32>(static_cast<qint32>(track.editMediaTime))) + be32(0x10000);
+        trak += box("edts", fullBox("elst", 0, edit));
+    }
+    trak += box("mdia", hdlr + mdhd + box("minf", box("stbl", stbl)));
+    return box("trak", trak);
+}
+
+// An audio track first, the index takes the first video track; moov after mdat
+QByteArray mp4File(const Mp4Track& track)
+{
+    QByteArray soun = box("trak", box("mdia", fullBox("hdlr", 0, be32(0) + "soun" + QByteArray(13, '\0'))));
+    return box("ftyp", QByteArray("isom") + be32(0x200) + "isom") + box("mdat", QByteArray(64, '\0')) +
+           box("moov", soun + videoTrak(track));
+}
+
+// Four frames in decode order I P B B, chunks of two at 1000 and 5000
+Mp4Track reorderedTrack()
+{
+    Mp4Track track;
+    track.stts = {{4, 40}};
+    track.ctts = {{1, 40}, {1, 120}, {2, 0}};  // Shown as I B B P: 40, 160, 80, 120
+    track.sizes = {100, 200, 300, 400};
+    track.chunkOffsets = {1000, 5000};
+    track.syncSamples = {1};
+    return track;
+}
+
+// ---- Matroska ----
+
+QByteArray ebmlId(quint32 id)
+{
+    QByteArray bytes = be32(id);
+    while (bytes.size() > 1 && bytes[0] == '\0') {
+        bytes.remove(0, 1);
+    }
+    return bytes;
+}
+
+// Sizes are always written in 8 bytes, so an element's length does not depend on its values
+QByteArray element(quint32 id, const QByteArray& payload)
+{
+    QByteArray size = be64(payload.size());
+    size[0] = 0x01;
+    return ebmlId(id) + size + payload;
+}
+
+QByteArray uintElement(quint32 id, quint64 value)
+{
+    return element(id, be64(value));
+}
+
+struct Cue {
+    quint64 time;
+    int cluster;
+    bool audioFirst;  // An audio position listed before the video one
+};
+
+// Audio track 1 and video track 2, two clusters, then the Cues; with a SeekHead pointing
+// at them or without one, so they are only found past the clusters
+QByteArray matroskaFile(const QList<Cue>& cues, bool withSeekHead, qint64* segmentStart, qint64* clusterPositions)
+{
+    QByteArray ebmlHeader = element(0x1A45DFA3, element(0x4282, "matroska"));
+    
+    QByteArray info = element(0x1549A966, uintElement(0x2AD7B1, 1000000));
+    QByteArray tracks = element(0x1654AE6B, element(0xAE, uintElement(0xD7, 1) + uintElement(0x83, 2)) +
+                                            element(0xAE, uintElement(0xD7, 2) + uintElement(0x83, 1)));
+    QByteArray cluster = element(0x1F43B675, QByteArray(100, '\0'));
+    
+    // Positions are relative to the segment payload; the SeekHead's size does not depend on them
+    auto seekHead = [](quint64 cuesPosition) {
+        return element(0x114D9B74, element(0x4DBB, element(0x53AB, QByteArray::fromHex("1C53BB6B")) +
+                                                   uintElement(0x53AC, cuesPosition)));
+    };
+    qint64 headSize = (withSeekHead ? seekHead(0).size() : 0) + info.size() + tracks.size();
+    clusterPositions[0] = headSize;
+    clusterPositions[1] = headSize + cluster.size();
+    
+    QByteArray points;
+    for (const Cue& cue : cues) {
+        QByteArray positions;
+        if (cue.audioFirst) {
+            positions += element(0xB7, uintElement(0xF7, 1) + uintElement(0xF1, 7));
+        }
+        positions += element(0xB7, uintElement(0xF7, 2) + uintElement(0xF1, static_cast<quint64>(clusterPositions[cue.cluster])));
+        points += element(0xBB, uintElement(0xB3, cue.time) + positions);
+    }
+    
+    QByteArray head = (withSeekHead ? seekHead(headSize + 2 * cluster.size()) : QByteArray()) + info + tracks;
+    QByteArray segment = element(0x18538067, head + cluster + cluster + element(0x1C53BB6B, points));
+    *segmentStart = ebmlHeader.size() + 12;
+    return ebmlHeader + segment;
+}
+
+} // namespace
+
+/**
+ * Parsing of MP4 sample tables and Matroska Cues into a KeyframeIndex
+ *
+ * The files are built in memory with just the boxes and elements the parser
+ * reads, written to a temporary directory and indexed like real media.
+ */
+class KeyframeIndexTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void mp4ReorderedFrames();
+    void mp4EditList();
+    void mp4WideChunkOffsets();
+    void mp4WithoutSyncTable();
+    void mp4KeyframeQueries();
+    
+    void matroskaCuesThroughSeekHead();
+    void matroskaCuesAfterClusters();
+
+private:
+    // Writes data to a file of its own and indexes it
+    std::shared_ptr<KeyframeIndex> build(const QString& fileName, const QByteArray& data);
+    
+    std::unique_ptr<QTemporaryDir> m_dataDir;
+};
+
+void KeyframeIndexTest::initTestCase()
+{
+    m_dataDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_dataDir->isValid());
+    
+    // Fingerprints and the index cache go here
+    StateStorage::setRootPath(m_dataDir->filePath("savedstates"));
+}
+
+std::shared_ptr<KeyframeIndex> KeyframeIndexTest::build(const QString& fileName, const QByteArray& data)
+{
+    QString filePath = m_dataDir->filePath(fileName);
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        return nullptr;
+    }
+    file.close();
+    
+    return KeyframeIndex::build(filePath);
+}
+
+void KeyframeIndexTest::mp4ReorderedFrames()
+{
+    std::shared_ptr<KeyframeIndex> index = build("reordered.mp4", mp4File(reorderedTrack()));
+    QVERIFY(index);
+    QVERIFY(index->hasAllFrames());
+    QCOMPARE(index->count(), 4);
+    QCOMPARE(index->keyframeCount(), 1);
+    
+    // Presentation order, each frame keeping its own byte offset
+    const qint64 times[] = {40000, 80000, 120000, 160000};
+    const qint64 offsets[] = {1000, 5000, 5300, 1100};
+    for (int i = 0; i < 4; i++) {
+        QCOMPARE(index->entry(i).timeUs, times[i]);
+        QCOMPARE(index->entry(i).offset, offsets[i]);
+    }
+    QVERIFY(index->entry(0).flags & KeyframeIndex::KeyframeFlag);
+    QVERIFY(!(index->entry(3).flags & KeyframeIndex::KeyframeFlag));
+}
+
+void KeyframeIndexTest::mp4EditList()
+{
+    // The edit starts at the first frame's composition time, so that frame is shown at 0
+    Mp4Track track = reorderedTrack();
+    track.editMediaTime = 40;
+    
+    std::shared_ptr<KeyframeIndex> index = build("editlist.mp4", mp4File(track));
+    QVERIFY(index);
+    
+    const qint64 times[] = {0, 40000, 80000, 120000};
+    for (int i = 0; i < 4; i++) {
+        QCOMPARE(index->entry(i).timeUs, times[i]);
+    }
+    QCOMPARE(index->keyframeBefore(30), qint64(0));
+}
+
+void KeyframeIndexTest::mp4WideChunkOffsets()
+{
+    // Chunks past 4 GiB, with one size for all samples
+    Mp4Track track;
+    track.stts = {{4, 40}};
+    track.sizes = {500, 500, 500, 500};
+    track.fixedSize = true;
+    track.chunkOffsets = {0x100000000ULL + 16, 0x200000000ULL};
+    track.wideOffsets = true;
+    track.syncSamples = {1, 3};
+    
+    std::shared_ptr<KeyframeIndex> index = build("wide.mp4", mp4File(track));
+    QVERIFY(index);
+    QCOMPARE(index->count(), 4);
+    QCOMPARE(index->entry(0).offset, qint64(0x100000000LL + 16));
+    QCOMPARE(index->entry(1).offset, qint64(0x100000000LL + 516));
+    QCOMPARE(index->entry(2).offset, qint64(0x200000000LL));
+    QCOMPARE(index->entry(3).offset, qint64(0x200000000LL + 500));
+    QCOMPARE(index->keyframeCount(), 2);
+    QCOMPARE(index->keyframeBefore(100), qint64(80));
+}
+
+void KeyframeIndexTest::mp4WithoutSyncTable()
+{
+    // No stss: every sample is a keyframe
+    Mp4Track track;
+    track.stts = {{3, 40}};
+    track.sizes = {10, 10, 10};
+    track.samplesPerChunk = 3;
+    track.chunkOffsets = {200};
+    track.hasSyncTable = false;
+    
+    std::shared_ptr<KeyframeIndex> index = build("intra.mp4", mp4File(track));
+    QVERIFY(index);
+    QCOMPARE(index->count(), 3);
+    QCOMPARE(index->keyframeCount(), 3);
+    QCOMPARE(index->keyframeBefore(79), qint64(40));
+    QCOMPARE(index->seekCost(79), qint64(39));
+}
+
+void KeyframeIndexTest::mp4KeyframeQueries()
+{
+    // Keyframes every fourth frame of 40 ms
+    Mp4Track track;
+    track.stts = {{12, 40}};
+    track.sizes = QList<quint32>(12, 100);
+    track.samplesPerChunk = 12;
+    track.chunkOffsets = {100};
+    track.syncSamples = {1, 5, 9};
+    
+    std::shared_ptr<KeyframeIndex> index = build("gop.mp4", mp4File(track));
+    QVERIFY(index);
+    QCOMPARE(index->keyframeCount(), 3);
+    
+    QCOMPARE(index->keyframeBefore(0), qint64(0));
+    QCOMPARE(index->keyframeBefore(159), qint64(0));
+    QCOMPARE(index->keyframeBefore(160), qint64(160));
+    QCOMPARE(index->keyframeAfter(1), qint64(160));
+    QCOMPARE(index->keyframeAfter(320), qint64(320));
+    QCOMPARE(index->keyframeAfter(321), qint64(-1));
+    QCOMPARE(index->seekCost(300), qint64(140));
+    QCOMPARE(index->averageGopMs(), 160.0);
+    
+    // A second open maps the cached index without parsing
+    std::shared_ptr<KeyframeIndex> cached = KeyframeIndex::open(m_dataDir->filePath("gop.mp4"));
+    QVERIFY(cached);
+    QCOMPARE(cached->count(), 12);
+}
+
+void KeyframeIndexTest::matroskaCuesThroughSeekHead()
+{
+    // The audio position listed first in the second cue point is skipped for the video one
+    qint64 segmentStart = 0;
+    qint64 clusters[2];
+    QByteArray data = matroskaFile({{0, 0, false}, {2000, 1, true}}, true, &segmentStart, clusters);
+    
+    std::shared_ptr<KeyframeIndex> index = build("seekhead.mkv", data);
+    QVERIFY(index);
+    QVERIFY(!index->hasAllFrames());
+    QCOMPARE(index->count(), 2);
+    QCOMPARE(index->keyframeCount(), 2);
+    QCOMPARE(index->entry(0).timeUs, qint64(0));
+    QCOMPARE(index->entry(0).offset, segmentStart + clusters[0]);
+    QCOMPARE(index->entry(1).timeUs, qint64(2000000));
+    QCOMPARE(index->entry(1).offset, segmentStart + clusters[1]);
+}
+
+void KeyframeIndexTest::matroskaCuesAfterClusters()
+{
+    qint64 segmentStart = 0;
+    qint64 clusters[2];
+    QByteArray data = matroskaFile({{0, 0, false}, {1500, 1, false}}, false, &segmentStart, clusters);
+    
+    std::shared_ptr<KeyframeIndex> index = build("noseekhead.webm", data);
+    QVERIFY(index);
+    QCOMPARE(index->count(), 2);
+    QCOMPARE(index->entry(1).timeUs, qint64(1500000));
+    QCOMPARE(index->entry(1).offset, segmentStart + clusters[1]);
+    QCOMPARE(index->keyframeBefore(1499), qint64(0));
+    QCOMPARE(index->keyframeAfter(1), qint64(1500));
+}
+
+QTEST_MAIN(KeyframeIndexTest)
+#include "tst_keyframeindex.moc"
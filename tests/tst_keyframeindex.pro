@@ -0,0 +1,15 @@
+# Unit tests of the MP4 and Matroska keyframe index parsers
+# The media files are built in memory and written to a temporary directory (make check runs it);
+# the index links with the VLC backend's sources
+
+QT       += core gui widgets network testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_keyframeindex
+
+SOURCES += \
+    tst_keyframeindex.cpp
+
+include(../vlcplayer.pri)
@@ -0,0 +1,195 @@
+#include <QtTest>
+#include <QKeyEvent>
+#include <QTemporaryDir>
+#include <memory>
+#include "lightweightvideoplayer.h"
+#include "keybindmanager.h"
+#include "vp_simulatedplayer.h"
+#include "statestorage.h"
+
+namespace {
+
+const qint64 Duration = 3600 * 1000;
+
+// Sets the loop mode and presses keys like the user would
+class TestPlayer : public LightweightVideoPlayer
+{
+public:
+    using LightweightVideoPlayer::LightweightVideoPlayer;
+    
+    void setLoopSingle() { m_loopMode = LoopMode::LoopSingle; }
+    void setLoopAll() { m_loopMode = LoopMode::LoopAll; }
+    
+    void pressKey(Qt::Key key)
+    {
+        QKeyEvent event(QEvent::KeyPress, key, Qt::NoModifier);
+        keyPressEvent(&event);
+    }
+};
+
+LightweightVideoPlayer::PlaybackState loopState(qint64 start, qint64 end)
+{
+    LightweightVideoPlayer::PlaybackState state(start, 1.0);
+    state.endPosition = end;
+    state.hasEndPosition = true;
+    return state;
+}
+
+} // namespace
+
+/**
+ * The player's state recalls and loops on VP_SimulatedPlayer and a VP_VirtualClock
+ *
+ * Every case advances the clock by hand and checks the recorded seeks, so the
+ * results are exact and the runs take milliseconds.
+ */
+class PlayerLoopsTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    
+    void recallTiming();
+    void loopSingleTransitions();
+    void loopAllTransitions();
+
+private:
+    std::unique_ptr<QTemporaryDir> m_dataDir;
+    QString m_mediaPath;
+    std::unique_ptr<VP_VirtualClock> m_clock;
+    std::unique_ptr<VP_SimulatedPlayer> m_backend;
+};
+
+void PlayerLoopsTest::initTestCase()
+{
+    m_dataDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_dataDir->isValid());
+    
+    // The player saves states and sessions, keep them out of the build directory
+    StateStorage::setRootPath(m_dataDir->filePath("savedstates"));
+    KeybindManager::setKeybindsFilePath(m_dataDir->filePath("keybinds.txt"));
+    
+    m_mediaPath = m_dataDir->filePath("tst_playerloops.mp4");
+    QFile placeholder(m_mediaPath);
+    QVERIFY(placeholder.open(QIODevice::WriteOnly));
+    placeholder.write(QByteArray(4096, '\0'));
+}
+
+void PlayerLoopsTest::init()
+{
+    m_clock = std::make_unique<VP_VirtualClock>();
+    m_backend = std::make_unique<VP_SimulatedPlayer>(m_clock.get());
+    m_backend->addMedia(m_mediaPath, Duration);
+}
+
+void PlayerLoopsTest::cleanup()
+{
+    m_backend.reset();
+    m_clock.reset();
+}
+
+void PlayerLoopsTest::recallTiming()
+{
+    auto backend = std::move(m_backend);
+    VP_SimulatedPlayer* simulated = backend.get();
+    TestPlayer player(std::move(backend));
+    QVERIFY(player.loadVideo(m_mediaPath));
+    player.setPlaybackState(0, LightweightVideoPlayer::PlaybackState(120000, 1.0));
+    
+    player.play();
+    m_clock->advance(10000);
+    simulated->clearSeekHistory();
+    
+    // Key 1 recalls the first state with one seek, issued at once
+    const qint64 pressedAt = m_clock->now();
+    player.pressKey(Qt::Key_1);
+    
+    QCOMPARE(simulated->seekHistory().size(), 1);
+    QCOMPARE(simulated->seekHistory().first().clockTime, pressedAt);
+    QCOMPARE(simulated->seekHistory().first().targetPosition, qint64(120000));
+    QCOMPARE(player.position(), qint64(120000));
+    
+    // Playing from the state's start once the seek latency has passed
+    m_clock->advance(simulated->simulationSettings().seekLatency);
+    QCOMPARE(simulated->exactPosition(), qint64(120000));
+    m_clock->advance(500);
+    QCOMPARE(simulated->exactPosition(), qint64(120500));
+}
+
+void PlayerLoopsTest::loopSingleTransitions()
+{
+    auto backend = std::move(m_backend);
+    VP_SimulatedPlayer* simulated = backend.get();
+    const VP_SimulatedPlayer::SimulationSettings settings = simulated->simulationSettings();
+    TestPlayer player(std::move(backend));
+    QVERIFY(player.loadVideo(m_mediaPath));
+    player.setPlaybackState(0, loopState(10000, 20000));
+    player.setLoopSingle();
+    
+    player.play();
+    m_clock->advance(settings.startupLatency);
+    player.pressKey(Qt::Key_1);
+    simulated->clearSeekHistory();
+    
+    m_clock->advance(60000);
+    player.pause();
+    
+    // Each pass plays the 10 s loop plus one seek latency, less the end tolerance
+    const QVector<VP_SimulatedPlayer::SeekRecord>& seeks = simulated->seekHistory();
+    QVERIFY(seeks.size() >= 5);
+    
+    for (int i = 0; i < seeks.size(); i++) {
+        const VP_SimulatedPlayer::SeekRecord& seek = seeks[i];
+        QCOMPARE(seek.targetPosition, qint64(10000));
+        
+        // Caught by a position poll after the reported time crossed the tolerance
+        QVERIFY2(seek.fromPosition >= 20000 - 200, qPrintable(QString::number(seek.fromPosition)));
+        QVERIFY2(seek.fromPosition <= 20000 - 200 + settings.timeUpdateInterval + settings.positionPollInterval,
+                 qPrintable(QString::number(seek.fromPosition)));
+        
+        // One jump per pass, never while the previous seek is pending
+        if (i > 0) {
+            QVERIFY(seek.clockTime - seeks[i - 1].clockTime > settings.seekLatency);
+        }
+    }
+}
+
+void PlayerLoopsTest::loopAllTransitions()
+{
+    auto backend = std::move(m_backend);
+    VP_SimulatedPlayer* simulated = backend.get();
+    const VP_SimulatedPlayer::SimulationSettings settings = simulated->simulationSettings();
+    TestPlayer player(std::move(backend));
+    QVERIFY(player.loadVideo(m_mediaPath));
+    player.setPlaybackState(0, loopState(10000, 15000));
+    player.setPlaybackState(1, loopState(300000, 305000));
+    player.setLoopAll();
+    
+    player.play();
+    m_clock->advance(settings.startupLatency);
+    player.pressKey(Qt::Key_1);
+    simulated->clearSeekHistory();
+    
+    m_clock->advance(60000);
+    player.pause();
+    
+    // The states take turns, each jump leaving the end of the other one
+    const QVector<VP_SimulatedPlayer::SeekRecord>& seeks = simulated->seekHistory();
+    QVERIFY(seeks.size() >= 8);
+    
+    for (int i = 0; i < seeks.size(); i++) {
+        const VP_SimulatedPlayer::SeekRecord& seek = seeks[i];
+        const bool toSecond = i % 2 == 0;
+        const qint64 leftEnd = toSecond ? 15000 : 305000;
+        
+        QCOMPARE(seek.targetPosition, toSecond ? qint64(300000) : qint64(10000));
+        QVERIFY(seek.fromPosition >= leftEnd - 200);
+        QVERIFY(seek.fromPosition <= leftEnd - 200 + settings.timeUpdateInterval + settings.positionPollInterval);
+    }
+}
+
+QTEST_MAIN(PlayerLoopsTest)
+#include "tst_playerloops.moc"
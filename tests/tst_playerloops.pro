@@ -0,0 +1,16 @@
+# Unit tests of the player's state recalls and loops on VP_SimulatedPlayer
+# Runs on the virtual clock without media or video output (make check runs it); the player
+# still links VP_VLCPlayer, its default backend
+
+QT       += core gui widgets network testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_playerloops
+
+SOURCES += \
+    tst_playerloops.cpp
+
+include(../player.pri)
+include(../simulatedplayer.pri)
@@ -0,0 +1,228 @@
+#include <QtTest>
+#include <QSignalSpy>
+#include <memory>
+#include "vp_simulatedplayer.h"
+
+namespace {
+
+const qint64 Duration = 3600 * 1000;
+const char* MediaPath = "tst_simulatedplayer.mp4";  // Only a key, the backend reads nothing
+
+} // namespace
+
+/**
+ * Timing of VP_SimulatedPlayer on a VP_VirtualClock
+ *
+ * Every case advances the clock by hand and checks the reported positions and
+ * the recorded seeks, so the results are exact and the runs take milliseconds.
+ * Builds from simulatedplayer.pri alone, without libvlc.
+ */
+class SimulatedPlayerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void clockRunsCallbacksInTimeOrder();
+    void clockCancel();
+    
+    void startupLatency();
+    void timeUpdateSteps_data();
+    void timeUpdateSteps();
+    void seekLatency();
+    void newerSeekReplacesPending();
+    void endReached();
+
+private:
+    // Load the media and play until the first frame is shown
+    void startPlayback();
+    
+    std::unique_ptr<VP_VirtualClock> m_clock;
+    std::unique_ptr<VP_SimulatedPlayer> m_backend;
+};
+
+void SimulatedPlayerTest::init()
+{
+    m_clock = std::make_unique<VP_VirtualClock>();
+    m_backend = std::make_unique<VP_SimulatedPlayer>(m_clock.get());
+    m_backend->addMedia(MediaPath, Duration);
+}
+
+void SimulatedPlayerTest::cleanup()
+{
+    m_backend.reset();
+    m_clock.reset();
+}
+
+void SimulatedPlayerTest::startPlayback()
+{
+    QVERIFY(m_backend->loadMedia(MediaPath));
+    m_backend->play();
+    m_clock->advance(m_backend->simulationSettings().startupLatency);
+    QCOMPARE(m_backend->exactPosition(), qint64(0));
+}
+
+void SimulatedPlayerTest::clockRunsCallbacksInTimeOrder()
+{
+    QList<int> order;
+    m_clock->scheduleAt(30, [&order]() { order << 3; });
+    m_clock->scheduleAt(10, [&order]() { order << 1; });
+    m_clock->scheduleAt(10, [&order]() { order << 2; });
+    
+    // A callback scheduling another one that is already due runs it in the same advance
+    m_clock->scheduleAt(20, [this, &order]() {
+        m_clock->scheduleAt(25, [&order]() { order << 4; });
+    });
+    
+    m_clock->advance(29);
+    QCOMPARE(order, QList<int>({1, 2, 4}));
+    QCOMPARE(m_clock->now(), qint64(29));
+    
+    m_clock->advance(1);
+    QCOMPARE(order, QList<int>({1, 2, 4, 3}));
+    QVERIFY(!m_clock->hasPendingCallbacks());
+}
+
+void SimulatedPlayerTest::clockCancel()
+{
+    bool ran = false;
+    int id = m_clock->scheduleAt(10, [&ran]() { ran = true; });
+    m_clock->cancel(id);
+    m_clock->advance(100);
+    
+    QVERIFY(!ran);
+    QVERIFY(!m_clock->hasPendingCallbacks());
+}
+
+void SimulatedPlayerTest::startupLatency()
+{
+    QSignalSpy firstFrame(m_backend.get(), &VP_PlayerBackend::firstFrameRendered);
+    QVERIFY(m_backend->loadMedia(MediaPath));
+    m_backend->play();
+    
+    // Time does not run until the input is open
+    const qint64 startup = m_backend->simulationSettings().startupLatency;
+    m_clock->advance(startup - 1);
+    QCOMPARE(firstFrame.count(), 0);
+    QCOMPARE(m_backend->exactPosition(), qint64(0));
+    
+    m_clock->advance(1);
+    QCOMPARE(firstFrame.count(), 1);
+    
+    m_clock->advance(1000);
+    QCOMPARE(m_backend->exactPosition(), qint64(1000));
+}
+
+void SimulatedPlayerTest::timeUpdateSteps_data()
+{
+    QTest::addColumn<int>("timeUpdateInterval");
+    QTest::addColumn<float>("rate");
+    
+    QTest::newRow("250ms/1x") << 250 << 1.0f;
+    QTest::newRow("250ms/2x") << 250 << 2.0f;
+    QTest::newRow("50ms/0.5x") << 50 << 0.5f;
+}
+
+void SimulatedPlayerTest::timeUpdateSteps()
+{
+    QFETCH(int, timeUpdateInterval);
+    QFETCH(float, rate);
+    
+    VP_SimulatedPlayer::SimulationSettings settings;
+    settings.timeUpdateInterval = timeUpdateInterval;
+    m_backend->setSimulationSettings(settings);
+    
+    startPlayback();
+    m_backend->setPlaybackRate(rate);
+    
+    // The exact time moves with every millisecond, the reported time in whole steps
+    for (qint64 elapsed = 1; elapsed <= 5000; elapsed++) {
+        m_clock->advance(1);
+        qint64 exact = static_cast<qint64>(elapsed * static_cast<double>(rate));
+        QCOMPARE(m_backend->exactPosition(), exact);
+        QCOMPARE(m_backend->position(), exact - exact % timeUpdateInterval);
+    }
+}
+
+void SimulatedPlayerTest::seekLatency()
+{
+    startPlayback();
+    m_clock->advance(5000);
+    
+    QSignalSpy positions(m_backend.get(), &VP_PlayerBackend::positionChanged);
+    QSignalSpy completed(m_backend.get(), &VP_PlayerBackend::seekCompleted);
+    
+    const qint64 requestedAt = m_clock->now();
+    m_backend->setPosition(60000);
+    
+    // The target is reported at once
+    QVERIFY(!positions.isEmpty());
+    QCOMPARE(positions.first().at(0).toLongLong(), qint64(60000));
+    
+    QCOMPARE(m_backend->seekHistory().size(), 1);
+    const VP_SimulatedPlayer::SeekRecord& seek = m_backend->seekHistory().first();
+    QCOMPARE(seek.clockTime, requestedAt);
+    QCOMPARE(seek.fromPosition, qint64(5000));
+    QCOMPARE(seek.targetPosition, qint64(60000));
+    
+    // The media time holds until the seek completes, then runs from the target
+    const qint64 latency = m_backend->simulationSettings().seekLatency;
+    m_clock->advance(latency - 1);
+    QCOMPARE(completed.count(), 0);
+    QCOMPARE(m_backend->exactPosition(), qint64(5000));
+    QCOMPARE(m_backend->position(), qint64(60000));
+    
+    m_clock->advance(1);
+    QCOMPARE(completed.count(), 1);
+    QCOMPARE(completed.first().at(0).toLongLong(), qint64(60000));
+    QCOMPARE(m_backend->exactPosition(), qint64(60000));
+    
+    m_clock->advance(1000);
+    QCOMPARE(m_backend->exactPosition(), qint64(61000));
+}
+
+void SimulatedPlayerTest::newerSeekReplacesPending()
+{
+    startPlayback();
+    
+    QSignalSpy completed(m_backend.get(), &VP_PlayerBackend::seekCompleted);
+    const qint64 latency = m_backend->simulationSettings().seekLatency;
+    
+    m_backend->setPosition(10000);
+    m_clock->advance(latency / 2);
+    m_backend->setPosition(20000);
+    
+    // The second seek restarts the latency, the first one never lands
+    m_clock->advance(latency - 1);
+    QCOMPARE(completed.count(), 0);
+    m_clock->advance(1);
+    QCOMPARE(completed.count(), 1);
+    QCOMPARE(completed.first().at(0).toLongLong(), qint64(20000));
+    
+    QCOMPARE(m_backend->seekHistory().size(), 2);
+    QCOMPARE(m_backend->seekHistory().at(1).clockTime - m_backend->seekHistory().at(0).clockTime, latency / 2);
+}
+
+void SimulatedPlayerTest::endReached()
+{
+    m_backend->addMedia(MediaPath, 2000);
+    startPlayback();
+    
+    QSignalSpy finished(m_backend.get(), &VP_PlayerBackend::finished);
+    const qint64 poll = m_backend->simulationSettings().positionPollInterval;
+    
+    m_clock->advance(1999);
+    QCOMPARE(finished.count(), 0);
+    QVERIFY(m_backend->isPlaying());
+    
+    // Noticed by the next position poll
+    m_clock->advance(poll);
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(m_backend->isStopped());
+    QCOMPARE(m_backend->position(), qint64(0));
+}
+
+QTEST_MAIN(SimulatedPlayerTest)
+#include "tst_simulatedplayer.moc"
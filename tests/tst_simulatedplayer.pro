@@ -0,0 +1,14 @@
+# Unit tests of VP_SimulatedPlayer and VP_VirtualClock
+# Everything runs on the virtual clock and nothing links libvlc, so no VLC SDK is needed (make check runs it)
+
+QT       += core gui widgets testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_simulatedplayer
+
+SOURCES += \
+    tst_simulatedplayer.cpp
+
+include(../simulatedplayer.pri)
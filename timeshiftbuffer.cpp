@@ -0,0 +1,380 @@
+#include "timeshiftbuffer.h"
+#include "perftracer.h"
+#include <vlc/vlc.h>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QUrl>
+#include <QDebug>
+#include <algorithm>
+
+#ifndef QT_NO_SSL
+#include <QSslSocket>
+#endif
+
+namespace {
+
+const qint64 MinCapacity = 16 * 1024 * 1024;
+const qint64 SampleIntervalMs = 200;  // Resolution of seeks in the window
+const qint64 MaxWriteSize = 1024 * 1024;  // Well below MinCapacity, a write never wraps onto itself
+const int ReconnectDelayMs = 1000;
+
+} // namespace
+
+int TimeshiftBuffer::s_windowMinutes = 30;
+qint64 TimeshiftBuffer::s_capacity = 1024LL * 1024 * 1024;
+
+struct TimeshiftBuffer::Reader {
+    TimeshiftBuffer* buffer = nullptr;
+    QFile file;
+    qint64 position = 0;
+    quint64 generation = 0;
+};
+
+struct TimeshiftBufferCallbacks {
+    static int open(void* opaque, void** data, uint64_t* size)
+    {
+        TimeshiftBuffer::Reader* reader = static_cast<TimeshiftBuffer*>(opaque)->openReader();
+        if (!reader) {
+            *data = nullptr;
+            return -1;
+        }
+        
+        *data = reader;
+        *size = UINT64_MAX;  // Live, no end known
+        return 0;
+    }
+    
+    static ssize_t read(void* data, unsigned char* buffer, size_t length)
+    {
+        TimeshiftBuffer::Reader* reader = static_cast<TimeshiftBuffer::Reader*>(data);
+        return static_cast<ssize_t>(reader->buffer->read(reader, reinterpret_cast<char*>(buffer), static_cast<qint64>(length)));
+    }
+    
+    static void close(void* data)
+    {
+        delete static_cast<TimeshiftBuffer::Reader*>(data);
+    }
+};
+
+void TimeshiftBuffer::setWindow(int minutes)
+{
+    s_windowMinutes = qMax(1, minutes);
+}
+
+int TimeshiftBuffer::window()
+{
+    return s_windowMinutes;
+}
+
+void TimeshiftBuffer::setCapacity(qint64 bytes)
+{
+    s_capacity = qMax(MinCapacity, bytes);
+}
+
+qint64 TimeshiftBuffer::capacity()
+{
+    return s_capacity;
+}
+
+bool TimeshiftBuffer::isSupported(const QString& url)
+{
+    QUrl parsed(url);
+    QString scheme = parsed.scheme().toLower();
+
+#ifdef QT_NO_SSL
+    if (scheme != "http") {
+        return false;
+    }
+#else
+    if (scheme != "http" && (scheme != "https" || !QSslSocket::supportsSsl())) {
+        return false;
+    }
+#endif
+    
+    QString path = parsed.path().toLower();
+    return !path.endsWith(".m3u8") && !path.endsWith(".m3u");
+}
+
+TimeshiftBuffer::TimeshiftBuffer(const QString& url)
+    : m_url(url)
+    , m_capacity(s_capacity)
+    , m_windowMs(s_windowMinutes * 60000LL)
+    , m_written(0)
+    , m_oldest(0)
+    , m_openOffset(0)
+    , m_liveTime(0)
+    , m_generation(0)
+    , m_ended(false)
+{
+}
+
+TimeshiftBuffer::~TimeshiftBuffer()
+{
+    if (m_recorder) {
+        m_recorder->requestInterruption();
+        m_recorder->wait();
+    }
+    
+    interruptReaders();
+    
+    qDebug() << "TimeshiftBuffer: Stopped recording" << m_url << "after" << m_written / (1024 * 1024) << "MiB";
+}
+
+bool TimeshiftBuffer::start()
+{
+    m_file.reset(new QTemporaryFile(QDir::tempPath() + "/mmsvp-timeshift-XXXXXX.buf"));
+    if (!m_file->open()) {
+        qDebug() << "TimeshiftBuffer: Failed to create ring file:" << m_file->errorString();
+        m_file.reset();
+        return false;
+    }
+    
+    m_filePath = m_file->fileName();
+    m_clock.start();
+    
+    m_recorder.reset(QThread::create([this]() {
+        record();
+    }));
+    m_recorder->setObjectName("timeshiftRecorder");
+    m_recorder->start();
+    
+    qDebug() << "TimeshiftBuffer: Recording" << m_url << "into" << m_filePath << "," << m_capacity / (1024 * 1024)
+             << "MiB or" << m_windowMs / 60000 << "minutes";
+    return true;
+}
+
+libvlc_media_t* TimeshiftBuffer::createMedia(libvlc_instance_t* instance)
+{
+    // No seek callback: the stream is not seekable for VLC, a seek reopens it at a new open time
+    return libvlc_media_new_callbacks(instance, TimeshiftBufferCallbacks::open, TimeshiftBufferCallbacks::read,
+                                      nullptr, TimeshiftBufferCallbacks::close, this);
+}
+
+qint64 TimeshiftBuffer::startTime()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_samples.empty() ? m_liveTime : m_samples.front().time;
+}
+
+qint64 TimeshiftBuffer::liveTime()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_liveTime;
+}
+
+qint64 TimeshiftBuffer::setOpenTime(qint64 time)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    if (m_samples.empty()) {
+        m_openOffset = m_written;
+        return m_liveTime;
+    }
+    
+    auto it = std::lower_bound(m_samples.begin(), m_samples.end(), time, [](const Sample& sample, qint64 value) {
+        return sample.time < value;
+    });
+    if (it == m_samples.end()) {
+        --it;
+    }
+    
+    m_openOffset = it->offset;
+    return it->time;
+}
+
+void TimeshiftBuffer::interruptReaders()
+{
+    QMutexLocker locker(&m_mutex);
+    m_generation++;
+    m_dataAvailable.wakeAll();
+}
+
+void TimeshiftBuffer::record()
+{
+    PERF_TRACE_SCOPE("timeshiftRecord");
+    
+    QNetworkAccessManager manager;
+    QThread* thread = QThread::currentThread();
+    
+    while (!thread->isInterruptionRequested()) {
+        QNetworkRequest request{QUrl(m_url)};
+        request.setRawHeader("User-Agent", "MMSVP");
+        QNetworkReply* reply = manager.get(request);
+        
+        QEventLoop loop;
+        QObject::connect(reply, &QNetworkReply::readyRead, &loop, [this, reply]() {
+            append(reply->readAll());
+        });
+        QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+        
+        // The thread has no other way to learn that it should stop
+        QTimer interruptionCheck;
+        QObject::connect(&interruptionCheck, &QTimer::timeout, &loop, [thread, reply]() {
+            if (thread->isInterruptionRequested()) {
+                reply->abort();
+            }
+        });
+        interruptionCheck.start(100);
+        
+        loop.exec();
+        
+        append(reply->readAll());
+        QNetworkReply::NetworkError error = reply->error();
+        QString errorString = reply->errorString();
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        delete reply;
+        
+        if (thread->isInterruptionRequested()) {
+            break;
+        }
+        
+        // A stream with an end (or one the server refuses) is not reconnected
+        if (error == QNetworkReply::NoError || status >= 400) {
+            if (error != QNetworkReply::NoError) {
+                qDebug() << "TimeshiftBuffer: HTTP status" << status << "for" << m_url;
+            }
+            
+            QMutexLocker locker(&m_mutex);
+            m_ended = true;
+            m_dataAvailable.wakeAll();
+            break;
+        }
+        
+        qDebug() << "TimeshiftBuffer: Stream interrupted (" << errorString << "), reconnecting";
+        for (int waited = 0; waited < ReconnectDelayMs && !thread->isInterruptionRequested(); waited += 100) {
+            QThread::msleep(100);
+        }
+    }
+}
+
+void TimeshiftBuffer::append(const QByteArray& data)
+{
+    for (qint64 done = 0; done < data.size(); ) {
+        qint64 length = qMin<qint64>(MaxWriteSize, data.size() - done);
+        qint64 time = m_clock.elapsed();
+        qint64 offset = 0;
+        
+        {
+            QMutexLocker locker(&m_mutex);
+            offset = m_written;
+            
+            if (m_samples.empty() || time - m_samples.back().time >= SampleIntervalMs) {
+                m_samples.push_back({offset, time});
+            }
+            
+            // Readers move past what is overwritten before it is
+            qint64 oldest = offset + length - m_capacity;
+            for (const Sample& sample : m_samples) {
+                if (sample.time > time - m_windowMs) {
+                    break;
+                }
+                oldest = qMax(oldest, sample.offset);
+            }
+            advanceOldest(oldest);
+        }
+        
+        // Up to the end of the file, the rest wraps around to its start
+        qint64 fileOffset = offset % m_capacity;
+        qint64 first = qMin(length, m_capacity - fileOffset);
+        bool ok = m_file->seek(fileOffset) && m_file->write(data.constData() + done, first) == first;
+        if (ok && first < length) {
+            ok = m_file->seek(0) && m_file->write(data.constData() + done + first, length - first) == length - first;
+        }
+        ok = ok && m_file->flush();
+        
+        if (!ok) {
+            qDebug() << "TimeshiftBuffer: Failed to write ring file:" << m_file->errorString();
+        }
+        
+        {
+            QMutexLocker locker(&m_mutex);
+            m_written += length;
+            m_liveTime = time;
+            m_dataAvailable.wakeAll();
+        }
+        
+        done += length;
+    }
+}
+
+void TimeshiftBuffer::advanceOldest(qint64 offset)
+{
+    if (offset <= m_oldest) {
+        return;
+    }
+    
+    m_oldest = offset;
+    
+    while (m_samples.size() > 1 && m_samples[1].offset <= m_oldest) {
+        m_samples.pop_front();
+    }
+    if (!m_samples.empty() && m_samples.front().offset < m_oldest) {
+        m_samples.front().offset = m_oldest;
+    }
+}
+
+TimeshiftBuffer::Reader* TimeshiftBuffer::openReader()
+{
+    Reader* reader = new Reader;
+    reader->file.setFileName(m_filePath);
+    
+    // Unbuffered, the recorder writes through another handle
+    if (!reader->file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        qDebug() << "TimeshiftBuffer: Failed to open ring file:" << reader->file.errorString();
+        delete reader;
+        return nullptr;
+    }
+    
+    QMutexLocker locker(&m_mutex);
+    reader->buffer = this;
+    reader->position = qMax(m_openOffset, m_oldest);
+    reader->generation = m_generation;
+    return reader;
+}
+
+qint64 TimeshiftBuffer::read(Reader* reader, char* buffer, qint64 length)
+{
+    for (;;) {
+        qint64 available = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (reader->generation == m_generation && !m_ended && reader->position >= m_written) {
+                m_dataAvailable.wait(&m_mutex);
+            }
+            
+            if (reader->generation != m_generation) {
+                return 0;
+            }
+            
+            // Fell out of the window while paused, go on with the oldest data kept
+            if (reader->position < m_oldest) {
+                qDebug() << "TimeshiftBuffer: Reader overtaken, skipping" << m_oldest - reader->position << "bytes";
+                reader->position = m_oldest;
+            }
+            
+            available = m_written - reader->position;
+            if (available <= 0) {
+                return 0;
+            }
+        }
+        
+        qint64 fileOffset = reader->position % m_capacity;
+        qint64 count = qMin(qMin(length, available), m_capacity - fileOffset);
+        if (!reader->file.seek(fileOffset) || reader->file.read(buffer, count) != count) {
+            qDebug() << "TimeshiftBuffer: Failed to read ring file:" << reader->file.errorString();
+            return -1;
+        }
+        
+        // Overwritten while it was read, read again from the oldest data
+        QMutexLocker locker(&m_mutex);
+        if (reader->position >= m_oldest) {
+            reader->position += count;
+            return count;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef TIMESHIFTBUFFER_H
+#define TIMESHIFTBUFFER_H
+
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QThread>
+#include <deque>
+#include <memory>
+
+class QTemporaryFile;
+struct libvlc_instance_t;
+struct libvlc_media_t;
+
+/**
+ * @class TimeshiftBuffer
+ * @brief Records a live HTTP stream into an on-disk ring buffer for pause and rewind
+ *
+ * A recorder thread downloads the stream into a temporary file of fixed size,
+ * overwriting the oldest data once the file is full or older than the window.
+ * Playback reads from the file through libvlc's callback media, so memory use
+ * does not grow with the length of the session.
+ *
+ * Times are milliseconds since recording started, taken when the bytes arrived.
+ * The media opens at the data that arrived at setOpenTime(); a seek inside the
+ * window reopens it there. Formats that can be joined mid-stream (MPEG-TS, MP3,
+ * ADTS AAC, as live streams usually are) play from any point in the window.
+ */
+class TimeshiftBuffer
+{
+public:
+    // Limits of buffers started afterwards, whichever is reached first
+    static void setWindow(int minutes);  // Default 30
+    static int window();
+    static void setCapacity(qint64 bytes);  // Size of the ring file, default 1 GiB
+    static qint64 capacity();
+    
+    // http and https streams (not HLS playlists, VLC fetches their segments itself)
+    static bool isSupported(const QString& url);
+    
+    explicit TimeshiftBuffer(const QString& url);
+    ~TimeshiftBuffer();
+    
+    // Create the ring file and start recording
+    bool start();
+    
+    // Media reading the buffer from the open time (libvlc_media_new_callbacks)
+    libvlc_media_t* createMedia(libvlc_instance_t* instance);
+    
+    // Buffered window
+    qint64 startTime();
+    qint64 liveTime();
+    
+    // The next open reads from the data that arrived at time (clamped to the window),
+    // returns the arrival time of that data
+    qint64 setOpenTime(qint64 time);
+    
+    // Make blocked reads return end of stream, before libvlc stops the input reading them
+    void interruptReaders();
+
+private:
+    struct Reader;
+    friend struct TimeshiftBufferCallbacks;  // libvlc callbacks, defined with libvlc's types
+    
+    // Byte offset (counted since recording started) the data of a moment begins at
+    struct Sample {
+        qint64 offset;
+        qint64 time;
+    };
+    
+    void record();
+    void append(const QByteArray& data);
+    void advanceOldest(qint64 offset);
+    
+    Reader* openReader();
+    qint64 read(Reader* reader, char* buffer, qint64 length);
+    
+    QString m_url;
+    QString m_filePath;
+    qint64 m_capacity;
+    qint64 m_windowMs;
+    std::unique_ptr<QTemporaryFile> m_file;  // Written by the recorder thread only
+    std::unique_ptr<QThread> m_recorder;
+    QElapsedTimer m_clock;
+    
+    QMutex m_mutex;
+    QWaitCondition m_dataAvailable;
+    qint64 m_written;  // Bytes recorded
+    qint64 m_oldest;  // First byte still in the file
+    qint64 m_openOffset;
+    qint64 m_liveTime;  // Arrival of the newest data
+    std::deque<Sample> m_samples;  // Oldest first, from m_oldest on
+    quint64 m_generation;  // Bumped by interruptReaders()
+    bool m_ended;  // The server closed a stream that has an end
+    
+    static int s_windowMinutes;
+    static qint64 s_capacity;
+};
+
+#endif // TIMESHIFTBUFFER_H
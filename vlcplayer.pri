@@ -0,0 +1,45 @@
+# VP_VLCPlayer with its file, stream and frame readers and the caches under savedstates/
+# Include this from any .pro file that links VP_VLCPlayer (pulls in libvlc.pri and zlib.pri)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/vp_vlcplayer.cpp \
+    $$PWD/mediainfocache.cpp \
+    $$PWD/appendlog.cpp \
+    $$PWD/mediareader.cpp \
+    $$PWD/archivereader.cpp \
+    $$PWD/chunkcache.cpp \
+    $$PWD/remotereader.cpp \
+    $$PWD/timeshiftbuffer.cpp \
+    $$PWD/framestepbuffer.cpp \
+    $$PWD/keyframeindex.cpp \
+    $$PWD/stateframecache.cpp \
+    $$PWD/filefingerprint.cpp \
+    $$PWD/statestorage.cpp \
+    $$PWD/perftracer.cpp
+
+# Shared by both backends, added once
+HEADERS *= $$PWD/vp_playerbackend.h
+
+HEADERS += \
+    $$PWD/vp_vlcplayer.h \
+    $$PWD/mediainfocache.h \
+    $$PWD/appendlog.h \
+    $$PWD/mediareader.h \
+    $$PWD/archivereader.h \
+    $$PWD/chunkcache.h \
+    $$PWD/remotereader.h \
+    $$PWD/timeshiftbuffer.h \
+    $$PWD/framestepbuffer.h \
+    $$PWD/keyframeindex.h \
+    $$PWD/stateframecache.h \
+    $$PWD/filefingerprint.h \
+    $$PWD/statestorage.h \
+    $$PWD/perftracer.h
+
+# LibVLC configuration
+include($$PWD/libvlc.pri)
+
+# zlib for deflated zip entries
+include($$PWD/zlib.pri)
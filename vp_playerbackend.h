@@ -0,0 +1,153 @@
+#ifndef VP_PLAYERBACKEND_H
+#define VP_PLAYERBACKEND_H
+
+#include <QObject>
+#include <QWidget>
+#include <QString>
+#include <QPixmap>
+#include <QImage>
+#include <QSize>
+
+/**
+ * @class VP_PlayerBackend
+ * @brief Abstract playback backend used by LightweightVideoPlayer
+ *
+ * VP_VLCPlayer implements this on top of libvlc. VP_SimulatedPlayer implements
+ * it on a virtual clock so loop logic, state recall and key handling can run
+ * without real media and faster than real time.
+ */
+class VP_PlayerBackend : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Player state enumeration
+    enum class PlayerState {
+        Stopped,
+        Playing,
+        Paused,
+        Buffering,
+        Error
+    };
+    
+    explicit VP_PlayerBackend(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~VP_PlayerBackend() {}
+    
+    // Initialize the backend
+    virtual bool initialize() = 0;
+    
+    // Initialize without blocking the caller, initialized() is emitted when done
+    // (the default implementation initializes synchronously)
+    virtual void initializeAsync() { emit initialized(initialize()); }
+    virtual bool isInitialized() const = 0;
+    
+    // Media loading
+    virtual bool loadMedia(const QString& filePath) = 0;
+    virtual void unloadMedia() = 0;
+    
+    // Optional: open and parse a file ahead of loadMedia() so switching to it is fast
+    virtual void prepareMedia(const QString& filePath) { Q_UNUSED(filePath) }
+    
+    // Basic playback controls
+    virtual void play() = 0;
+    virtual void pause() = 0;
+    virtual void stop() = 0;
+    virtual void togglePlayPause() = 0;
+    
+    // Position and duration (in milliseconds)
+    virtual qint64 position() const = 0;
+    virtual qint64 duration() const = 0;
+    virtual void setPosition(qint64 position) = 0;
+    virtual void seekRelative(qint64 offset) = 0;
+    
+    // Earliest position setPosition() can reach (above 0 while a live stream is timeshifted)
+    virtual qint64 seekableStart() const { return 0; }
+    
+    // Start the loaded media at position instead of 0 (call between loadMedia() and play(),
+    // playback opens at the position without showing the first frame of the file)
+    virtual void setStartPosition(qint64 position) = 0;
+    
+    // Volume control (0-200, where 100 is normal volume)
+    virtual int volume() const = 0;
+    virtual void setVolume(int volume) = 0;
+    virtual void mute() = 0;
+    virtual void unmute() = 0;
+    virtual bool isMuted() const = 0;
+    
+    // Playback speed (1.0 = normal speed)
+    virtual float playbackRate() const = 0;
+    virtual void setPlaybackRate(float rate) = 0;
+    
+    // State queries
+    virtual PlayerState state() const = 0;
+    virtual bool isPlaying() const = 0;
+    virtual bool isPaused() const = 0;
+    virtual bool isStopped() const = 0;
+    virtual bool hasMedia() const = 0;
+    virtual QString currentMediaPath() const = 0;
+    
+    // Video rendering widget
+    virtual QWidget* videoWidget() const = 0;
+    virtual void setVideoWidget(QWidget* widget) = 0;
+    
+    // Video information
+    virtual QSize videoSize() const = 0;
+    virtual float aspectRatio() const = 0;
+    
+    // Frame capture
+    virtual QPixmap captureFrameAtPosition(qint64 position) = 0;
+    
+    // Play backwards at playbackRate() (backends that can not stay forward)
+    virtual void setReverse(bool reverse) { Q_UNUSED(reverse) }
+    virtual bool isReverse() const { return false; }
+    
+    // Pause and step one frame (the default seeks by a frame at 25 fps)
+    virtual void stepFrame(bool forward)
+    {
+        pause();
+        seekRelative(forward ? 40 : -40);
+    }
+    
+    // Error handling
+    virtual QString lastError() const = 0;
+
+signals:
+    // Initialization finished (after initializeAsync())
+    void initialized(bool success);
+    
+    // State changes
+    void stateChanged(VP_PlayerBackend::PlayerState state);
+    void playing();
+    void paused();
+    void stopped();
+    void finished();  // Media playback reached the end
+    
+    // Position/Duration updates
+    void positionChanged(qint64 position);
+    void durationChanged(qint64 duration);
+    void progressChanged(float progress);  // 0.0 to 1.0
+    void seekableRangeChanged(qint64 start, qint64 end);  // Timeshift window moved
+    
+    // Volume changes
+    void volumeChanged(int volume);
+    void mutedChanged(bool muted);
+    
+    // Media changes
+    void mediaLoaded(const QString& path);
+    void mediaUnloaded();
+    
+    // Buffering
+    void bufferingProgress(int percent);
+    
+    // Rendering milestones
+    void firstFrameRendered();  // First frame after loadMedia
+    void seekCompleted(qint64 position);  // First new frame after setPosition
+    
+    // Buffered frame to show over the video after stepping back, null when the video shows again
+    void frameOverlayChanged(const QImage& frame);
+    
+    // Errors
+    void errorOccurred(const QString& error);
+};
+
+#endif // VP_PLAYERBACKEND_H
@@ -0,0 +1,465 @@
+#include "vp_simulatedplayer.h"
+#include <QDebug>
+#include <QColor>
+#include <QPixmap>
+
+VP_VirtualClock::VP_VirtualClock(QObject *parent)
+    : QObject(parent)
+    , m_now(0)
+    , m_nextId(1)
+{
+}
+
+int VP_VirtualClock::scheduleAt(qint64 timeMs, const std::function<void()>& callback)
+{
+    // Callbacks can not run in the past
+    timeMs = qMax(timeMs, m_now);
+    
+    int id = m_nextId++;
+    m_queue[std::make_pair(timeMs, id)] = callback;
+    m_scheduledTimes.insert(id, timeMs);
+    return id;
+}
+
+void VP_VirtualClock::cancel(int id)
+{
+    auto it = m_scheduledTimes.find(id);
+    if (it == m_scheduledTimes.end()) {
+        return;
+    }
+    
+    m_queue.erase(std::make_pair(it.value(), id));
+    m_scheduledTimes.erase(it);
+}
+
+void VP_VirtualClock::advance(qint64 milliseconds)
+{
+    const qint64 target = m_now + qMax<qint64>(0, milliseconds);
+    
+    // Callbacks may schedule further callbacks, which run in the same pass if they are due
+    while (!m_queue.empty() && m_queue.begin()->first.first <= target) {
+        auto it = m_queue.begin();
+        m_now = it->first.first;
+        std::function<void()> callback = std::move(it->second);
+        m_scheduledTimes.remove(it->first.second);
+        m_queue.erase(it);
+        
+        callback();
+    }
+    
+    m_now = target;
+}
+
+VP_SimulatedPlayer::VP_SimulatedPlayer(VP_VirtualClock* clock, QObject *parent)
+    : VP_PlayerBackend(parent)
+    , m_clock(clock)
+    , m_anchorMediaTime(0)
+    , m_anchorClockTime(0)
+    , m_state(PlayerState::Stopped)
+    , m_duration(0)
+    , m_lastPosition(-1)
+    , m_rate(1.0f)
+    , m_reverse(false)
+    , m_volume(100)
+    , m_isMuted(false)
+    , m_videoWidget(nullptr)
+    , m_awaitingFirstFrame(false)
+    , m_startupEvent(-1)
+    , m_seekEvent(-1)
+    , m_pollEvent(-1)
+    , m_seekTarget(0)
+{
+}
+
+VP_SimulatedPlayer::~VP_SimulatedPlayer()
+{
+    // The clock may outlive the player, it must not call back into it
+    cancelPendingEvents();
+}
+
+void VP_SimulatedPlayer::addMedia(const QString& filePath, qint64 durationMs)
+{
+    m_mediaDurations.insert(filePath, durationMs);
+}
+
+bool VP_SimulatedPlayer::initialize()
+{
+    if (!m_clock) {
+        setLastError("No virtual clock");
+        return false;
+    }
+    
+    return true;
+}
+
+bool VP_SimulatedPlayer::loadMedia(const QString& filePath)
+{
+    if (!m_clock) {
+        setLastError("No virtual clock");
+        return false;
+    }
+    
+    if (filePath.isEmpty()) {
+        setLastError("Empty media path");
+        return false;
+    }
+    
+    cancelPendingEvents();
+    setState(PlayerState::Stopped);
+    
+    m_currentMediaPath = filePath;
+    m_duration = m_mediaDurations.value(filePath, m_settings.defaultDuration);
+    m_anchorMediaTime = 0;
+    m_anchorClockTime = m_clock->now();
+    m_lastPosition = -1;
+    m_awaitingFirstFrame = true;
+    
+    emit durationChanged(m_duration);
+    emit mediaLoaded(filePath);
+    return true;
+}
+
+void VP_SimulatedPlayer::unloadMedia()
+{
+    stop();
+    
+    m_currentMediaPath.clear();
+    m_duration = 0;
+    
+    emit mediaUnloaded();
+}
+
+void VP_SimulatedPlayer::play()
+{
+    if (!hasMedia()) {
+        setLastError("No media loaded");
+        return;
+    }
+    
+    if (m_state == PlayerState::Playing) {
+        return;
+    }
+    
+    rebaseTime();
+    
+    // Starting from stopped opens the input again, resuming from pause does not
+    if (m_state == PlayerState::Stopped && m_startupEvent < 0) {
+        m_startupEvent = m_clock->scheduleAt(m_clock->now() + m_settings.startupLatency, [this]() {
+            m_startupEvent = -1;
+            m_anchorClockTime = m_clock->now();
+            
+            if (m_awaitingFirstFrame) {
+                m_awaitingFirstFrame = false;
+                emit firstFrameRendered();
+            }
+        });
+    }
+    
+    setState(PlayerState::Playing);
+    schedulePoll();
+    emit playing();
+}
+
+void VP_SimulatedPlayer::pause()
+{
+    if (!hasMedia()) {
+        return;
+    }
+    
+    rebaseTime();
+    setState(PlayerState::Paused);
+    
+    if (m_pollEvent >= 0) {
+        m_clock->cancel(m_pollEvent);
+        m_pollEvent = -1;
+    }
+    
+    emit paused();
+}
+
+void VP_SimulatedPlayer::stop()
+{
+    if (!hasMedia()) {
+        return;
+    }
+    
+    cancelPendingEvents();
+    
+    m_anchorMediaTime = 0;
+    m_anchorClockTime = m_clock->now();
+    m_reverse = false;
+    setState(PlayerState::Stopped);
+    m_lastPosition = -1;
+    emit stopped();
+}
+
+void VP_SimulatedPlayer::togglePlayPause()
+{
+    if (isPlaying()) {
+        pause();
+    } else {
+        play();
+    }
+}
+
+bool VP_SimulatedPlayer::isTimeRunning() const
+{
+    return m_state == PlayerState::Playing && m_startupEvent < 0 && m_seekEvent < 0;
+}
+
+qint64 VP_SimulatedPlayer::exactPosition() const
+{
+    if (!isTimeRunning()) {
+        return m_anchorMediaTime;
+    }
+    
+    qint64 elapsed = m_clock->now() - m_anchorClockTime;
+    if (m_reverse) {
+        qint64 mediaTime = m_anchorMediaTime - static_cast<qint64>(elapsed * static_cast<double>(qMin(m_rate, 1.0f)));
+        return qMax<qint64>(0, mediaTime);
+    }
+    
+    qint64 mediaTime = m_anchorMediaTime + static_cast<qint64>(elapsed * static_cast<double>(m_rate));
+    return qMin(mediaTime, m_duration);
+}
+
+qint64 VP_SimulatedPlayer::position() const
+{
+    if (!hasMedia()) {
+        return 0;
+    }
+    
+    // A pending seek reports its target, as positionChanged() did when it was requested
+    if (m_seekEvent >= 0) {
+        return m_seekTarget;
+    }
+    
+    // Like libvlc, the reported time moves in steps after the last discontinuity
+    qint64 advanced = exactPosition() - m_anchorMediaTime;
+    if (m_settings.timeUpdateInterval > 0) {
+        advanced -= advanced % m_settings.timeUpdateInterval;
+    }
+    
+    return m_anchorMediaTime + advanced;
+}
+
+void VP_SimulatedPlayer::rebaseTime()
+{
+    m_anchorMediaTime = exactPosition();
+    m_anchorClockTime = m_clock->now();
+}
+
+void VP_SimulatedPlayer::setPosition(qint64 position)
+{
+    if (!hasMedia()) {
+        return;
+    }
+    
+    position = qBound(static_cast<qint64>(0), position, m_duration);
+    
+    rebaseTime();
+    m_seekHistory.append(SeekRecord{m_clock->now(), m_anchorMediaTime, position});
+    
+    // A newer seek replaces one that has not completed yet
+    if (m_seekEvent >= 0) {
+        m_clock->cancel(m_seekEvent);
+        m_seekEvent = -1;
+    }
+    
+    m_seekTarget = position;
+    
+    if (m_settings.seekLatency > 0) {
+        m_seekEvent = m_clock->scheduleAt(m_clock->now() + m_settings.seekLatency, [this]() {
+            m_seekEvent = -1;
+            completeSeek();
+        });
+    }
+    
+    // The target is reported right away, the media time only follows once the seek completes
+    m_lastPosition = position;
+    emit positionChanged(position);
+    
+    if (m_settings.seekLatency <= 0) {
+        completeSeek();
+    }
+}
+
+void VP_SimulatedPlayer::seekRelative(qint64 offset)
+{
+    setPosition(position() + offset);
+}
+
+void VP_SimulatedPlayer::setStartPosition(qint64 position)
+{
+    // Only a stopped player opens the input again
+    if (!hasMedia() || m_state != PlayerState::Stopped) {
+        return;
+    }
+    
+    m_anchorMediaTime = qBound(static_cast<qint64>(0), position, m_duration);
+    m_anchorClockTime = m_clock->now();
+}
+
+void VP_SimulatedPlayer::setVolume(int volume)
+{
+    m_volume = qBound(0, volume, 200);
+    emit volumeChanged(m_volume);
+}
+
+void VP_SimulatedPlayer::mute()
+{
+    if (m_isMuted) {
+        return;
+    }
+    
+    m_isMuted = true;
+    emit mutedChanged(true);
+}
+
+void VP_SimulatedPlayer::unmute()
+{
+    if (!m_isMuted) {
+        return;
+    }
+    
+    m_isMuted = false;
+    emit mutedChanged(false);
+}
+
+void VP_SimulatedPlayer::setPlaybackRate(float rate)
+{
+    rebaseTime();
+    m_rate = qBound(0.01f, rate, 32.0f);  // Like VP_VLCPlayer, skimming above 4x and stepping below 0.25x
+}
+
+void VP_SimulatedPlayer::setReverse(bool reverse)
+{
+    if (m_state == PlayerState::Stopped && reverse) {
+        return;
+    }
+    
+    rebaseTime();
+    m_reverse = reverse;
+}
+
+QSize VP_SimulatedPlayer::videoSize() const
+{
+    return hasMedia() ? m_settings.videoSize : QSize();
+}
+
+float VP_SimulatedPlayer::aspectRatio() const
+{
+    QSize size = videoSize();
+    if (size.isValid() && size.height() > 0) {
+        return static_cast<float>(size.width()) / static_cast<float>(size.height());
+    }
+    
+    return 0.0f;
+}
+
+QPixmap VP_SimulatedPlayer::captureFrameAtPosition(qint64 position)
+{
+    if (!hasMedia()) {
+        return QPixmap();
+    }
+    
+    // Same size as VP_VLCPlayer's snapshots, colour derived from the position
+    QPixmap pixmap(100, 75);
+    pixmap.fill(QColor::fromHsv(static_cast<int>((position / 1000) % 360), 160, 200));
+    return pixmap;
+}
+
+void VP_SimulatedPlayer::schedulePoll()
+{
+    if (m_pollEvent >= 0) {
+        return;
+    }
+    
+    qint64 interval = qMax<qint64>(1, m_settings.positionPollInterval);
+    
+    m_pollEvent = m_clock->scheduleAt(m_clock->now() + interval, [this]() {
+        m_pollEvent = -1;
+        
+        if (m_state != PlayerState::Playing) {
+            return;
+        }
+        
+        if (isTimeRunning() && exactPosition() >= m_duration) {
+            handleEndReached();
+            return;
+        }
+        
+        if (m_reverse && isTimeRunning() && exactPosition() <= 0) {
+            updatePosition();
+            pause();
+            return;
+        }
+        
+        updatePosition();
+        schedulePoll();
+    });
+}
+
+void VP_SimulatedPlayer::cancelPendingEvents()
+{
+    if (!m_clock) {
+        return;
+    }
+    
+    for (int* event : {&m_startupEvent, &m_seekEvent, &m_pollEvent}) {
+        if (*event >= 0) {
+            m_clock->cancel(*event);
+            *event = -1;
+        }
+    }
+}
+
+void VP_SimulatedPlayer::updatePosition()
+{
+    qint64 currentPos = position();
+    
+    if (currentPos != m_lastPosition) {
+        m_lastPosition = currentPos;
+        emit positionChanged(currentPos);
+        
+        if (m_duration > 0) {
+            emit progressChanged(static_cast<float>(currentPos) / static_cast<float>(m_duration));
+        }
+    }
+}
+
+void VP_SimulatedPlayer::handleEndReached()
+{
+    // Same sequence as VP_VLCPlayer on libvlc_MediaPlayerEndReached
+    cancelPendingEvents();
+    
+    m_anchorMediaTime = 0;
+    m_anchorClockTime = m_clock->now();
+    m_reverse = false;
+    setState(PlayerState::Stopped);
+    m_lastPosition = 0;
+    emit positionChanged(0);
+    emit finished();
+}
+
+void VP_SimulatedPlayer::completeSeek()
+{
+    m_anchorMediaTime = m_seekTarget;
+    m_anchorClockTime = m_clock->now();
+    emit seekCompleted(m_seekTarget);
+}
+
+void VP_SimulatedPlayer::setState(PlayerState state)
+{
+    if (m_state != state) {
+        m_state = state;
+        emit stateChanged(state);
+    }
+}
+
+void VP_SimulatedPlayer::setLastError(const QString& error)
+{
+    m_lastError = error;
+    qDebug() << "VP_SimulatedPlayer: Error:" << error;
+    emit errorOccurred(error);
+}
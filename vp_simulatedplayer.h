@@ -0,0 +1,192 @@
+#ifndef VP_SIMULATEDPLAYER_H
+#define VP_SIMULATEDPLAYER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QHash>
+#include <QSize>
+#include <QVector>
+#include <functional>
+#include <map>
+#include <utility>
+#include "vp_playerbackend.h"
+
+/**
+ * @class VP_VirtualClock
+ * @brief Manually advanced clock that runs scheduled callbacks in time order
+ *
+ * Nothing happens until advance() is called, so a simulation is fully
+ * deterministic and an hour of playback takes as long as its callbacks.
+ */
+class VP_VirtualClock : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VP_VirtualClock(QObject *parent = nullptr);
+    
+    // Current virtual time in milliseconds
+    qint64 now() const { return m_now; }
+    
+    // Run callback once the clock reaches timeMs (returns an id for cancel())
+    int scheduleAt(qint64 timeMs, const std::function<void()>& callback);
+    void cancel(int id);
+    
+    // Move the clock forward, running every callback that becomes due
+    void advance(qint64 milliseconds);
+    
+    bool hasPendingCallbacks() const { return !m_queue.empty(); }
+
+private:
+    qint64 m_now;
+    int m_nextId;
+    
+    // Ordered by (time, id) so callbacks at the same time run in scheduling order
+    std::map<std::pair<qint64, int>, std::function<void()>> m_queue;
+    QHash<int, qint64> m_scheduledTimes;
+};
+
+/**
+ * @class VP_SimulatedPlayer
+ * @brief Playback backend that models VP_VLCPlayer timing on a VP_VirtualClock
+ *
+ * Media is not decoded. Positions advance with the virtual clock and the
+ * playback rate, are reported in steps of the time-update granularity and
+ * polled like VP_VLCPlayer's position timer. Seeks report the target at once
+ * but only take effect after the configured latency.
+ */
+class VP_SimulatedPlayer : public VP_PlayerBackend
+{
+    Q_OBJECT
+
+public:
+    // Timing model, all values in milliseconds
+    struct SimulationSettings {
+        qint64 seekLatency;          // setPosition() to the first frame at the target
+        qint64 startupLatency;       // play() from stopped to the first frame
+        qint64 timeUpdateInterval;   // Granularity of reported media time
+        qint64 positionPollInterval; // Interval of positionChanged updates while playing
+        qint64 defaultDuration;      // Duration of media not registered with addMedia()
+        QSize videoSize;
+        
+        SimulationSettings()
+            : seekLatency(80), startupLatency(150), timeUpdateInterval(250)
+            , positionPollInterval(100), defaultDuration(600000), videoSize(1920, 1080) {}
+    };
+    
+    // A seek request, recorded for loop accuracy analysis
+    struct SeekRecord {
+        qint64 clockTime;       // Virtual time of the request
+        qint64 fromPosition;    // Exact media time when the seek was requested
+        qint64 targetPosition;
+    };
+    
+    explicit VP_SimulatedPlayer(VP_VirtualClock* clock, QObject *parent = nullptr);
+    ~VP_SimulatedPlayer();
+    
+    void setSimulationSettings(const SimulationSettings& settings) { m_settings = settings; }
+    SimulationSettings simulationSettings() const { return m_settings; }
+    
+    // Register a virtual media file with its duration
+    void addMedia(const QString& filePath, qint64 durationMs);
+    
+    // Exact media time, not rounded to the time-update granularity
+    qint64 exactPosition() const;
+    
+    const QVector<SeekRecord>& seekHistory() const { return m_seekHistory; }
+    void clearSeekHistory() { m_seekHistory.clear(); }
+    
+    // VP_PlayerBackend
+    bool initialize() override;
+    bool isInitialized() const override { return !m_clock.isNull(); }
+    
+    bool loadMedia(const QString& filePath) override;
+    void unloadMedia() override;
+    
+    void play() override;
+    void pause() override;
+    void stop() override;
+    void togglePlayPause() override;
+    
+    qint64 position() const override;
+    qint64 duration() const override { return m_duration; }
+    void setPosition(qint64 position) override;
+    void seekRelative(qint64 offset) override;
+    void setStartPosition(qint64 position) override;
+    
+    int volume() const override { return m_volume; }
+    void setVolume(int volume) override;
+    void mute() override;
+    void unmute() override;
+    bool isMuted() const override { return m_isMuted; }
+    
+    float playbackRate() const override { return m_rate; }
+    void setPlaybackRate(float rate) override;
+    
+    // Backwards at up to 1x like VP_VLCPlayer, pausing at the beginning
+    void setReverse(bool reverse) override;
+    bool isReverse() const override { return m_reverse; }
+    
+    PlayerState state() const override { return m_state; }
+    bool isPlaying() const override { return m_state == PlayerState::Playing; }
+    bool isPaused() const override { return m_state == PlayerState::Paused; }
+    bool isStopped() const override { return m_state == PlayerState::Stopped; }
+    bool hasMedia() const override { return !m_currentMediaPath.isEmpty(); }
+    QString currentMediaPath() const override { return m_currentMediaPath; }
+    
+    QWidget* videoWidget() const override { return m_videoWidget; }
+    void setVideoWidget(QWidget* widget) override { m_videoWidget = widget; }
+    
+    QSize videoSize() const override;
+    float aspectRatio() const override;
+    
+    QPixmap captureFrameAtPosition(qint64 position) override;
+    
+    QString lastError() const override { return m_lastError; }
+
+private:
+    // Media time only advances while playing with no pending startup or seek
+    bool isTimeRunning() const;
+    
+    // Fold the elapsed time into the anchor (call before changing anything that affects time)
+    void rebaseTime();
+    
+    void schedulePoll();
+    void cancelPendingEvents();
+    void updatePosition();
+    void handleEndReached();
+    void completeSeek();
+    void setState(PlayerState state);
+    void setLastError(const QString& error);
+    
+    QPointer<VP_VirtualClock> m_clock;
+    SimulationSettings m_settings;
+    QHash<QString, qint64> m_mediaDurations;
+    
+    // Media time is m_anchorMediaTime plus the scaled clock time since m_anchorClockTime
+    qint64 m_anchorMediaTime;
+    qint64 m_anchorClockTime;
+    
+    PlayerState m_state;
+    QString m_currentMediaPath;
+    QString m_lastError;
+    qint64 m_duration;
+    qint64 m_lastPosition;
+    float m_rate;
+    bool m_reverse;
+    int m_volume;
+    bool m_isMuted;
+    QWidget* m_videoWidget;
+    
+    // Pending events on the virtual clock (-1 if none)
+    bool m_awaitingFirstFrame;
+    int m_startupEvent;
+    int m_seekEvent;
+    int m_pollEvent;
+    qint64 m_seekTarget;
+    
+    QVector<SeekRecord> m_seekHistory;
+};
+
+#endif // VP_SIMULATEDPLAYER_H
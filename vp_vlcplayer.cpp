@@ -1,39 +1,103 @@
 #include "vp_vlcplayer.h"
+#include "perftracer.h"
+#include "mediareader.h"
+#include "archivereader.h"
+#include "remotereader.h"
+#include "chunkcache.h"
+#include "timeshiftbuffer.h"
+#include "framestepbuffer.h"
+#include "keyframeindex.h"
+#include "stateframecache.h"
 #include <vlc/vlc.h>
 #include <QDebug>
 #include <QApplication>
 #include <QCoreApplication>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QStorageInfo>
 #include <QTimer>
 #include <QEventLoop>
 #include <QPixmap>
 #include <QBuffer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <vector>
+#include <cmath>
+
+QStringList VP_VLCPlayer::s_extraArguments;
+VP_VLCPlayer::IoMode VP_VLCPlayer::s_ioMode = VP_VLCPlayer::IoMode::Vlc;
+QHash<QString, VP_VLCPlayer::IoMode> VP_VLCPlayer::s_fileIoModes;
+int VP_VLCPlayer::s_networkCaching = 1000;
+bool VP_VLCPlayer::s_timeshiftEnabled = false;
 
 VP_VLCPlayer::VP_VLCPlayer(QObject *parent)
-    : QObject(parent)
+    : VP_PlayerBackend(parent)
     , m_vlcInstance(nullptr)
     , m_mediaPlayer(nullptr)
     , m_currentMedia(nullptr)
     , m_eventManager(nullptr)
+    , m_preparedMedia(nullptr)
+    , m_startPosition(0)
+    , m_hasStartOption(false)
     , m_state(PlayerState::Stopped)
+    , m_currentMediaCached(false)
     , m_isMuted(false)
     , m_savedVolume(100)
+    , m_pendingVolume(-1)
     , m_videoWidget(nullptr)
     , m_positionTimer(new QTimer(this))
     , m_lastPosition(-1)
     , m_duration(-1)
+    , m_timeshiftOpenTime(0)
+    , m_timeshiftRangeStart(-1)
+    , m_timeshiftRangeEnd(-1)
+    , m_pauseAfterSeek(false)
+    , m_interruptingInput(false)
+    , m_virtualRate(0.0f)
+    , m_virtualPosition(0.0)
+    , m_skimTimer(new QTimer(this))
+    , m_skimSeekPending(false)
+    , m_skimSeekStart(0)
+    , m_skimTarget(-1)
+    , m_frameStepTimer(new QTimer(this))
+    , m_frameStepPosition(0.0)
+    , m_overlayTime(-1)
+    , m_overlayBase(0)
+    , m_reverse(false)
+    , m_reversePosition(0.0)
+    , m_reverseTimer(new QTimer(this))
+    , m_stateFrameOverlay(false)
+    , m_stateFrameTarget(-1)
+    , m_stallStart(-1)
     , m_debugMode(true)  // Enable debug output
     , m_isDestroying(false)
+    , m_awaitingFirstFrame(false)
+    , m_seekPending(false)
+    , m_firstFrameTraceStart(0)
+    , m_seekTraceStart(0)
+    , m_asyncInitPending(false)
+    , m_pendingInstance(nullptr)
+    , m_pendingMediaPlayer(nullptr)
 {
     // Setup position update timer
     m_positionTimer->setInterval(100);  // Update every 100ms
     connect(m_positionTimer, &QTimer::timeout, this, &VP_VLCPlayer::updatePosition);
     
-    // Initialize VLC
-    if (!initialize()) {
-        qDebug() << "VP_VLCPlayer: Failed to initialize VLC";
-    }
+    // Skim ticks ask for the next frame as soon as the last one is shown
+    m_skimTimer->setInterval(15);
+    connect(m_skimTimer, &QTimer::timeout, this, &VP_VLCPlayer::skimTick);
+    
+    // Slow motion steps a frame when the clock reaches it, to the millisecond
+    m_frameStepTimer->setSingleShot(true);
+    m_frameStepTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_frameStepTimer, &QTimer::timeout, this, &VP_VLCPlayer::frameStepTick);
+    
+    m_reverseTimer->setSingleShot(true);
+    m_reverseTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_reverseTimer, &QTimer::timeout, this, &VP_VLCPlayer::reverseTick);
+    
+    // VLC is created by initialize() or initializeAsync(), so the owner decides when to pay for it
 }
 
 VP_VLCPlayer::~VP_VLCPlayer()
@@ -43,6 +107,22 @@ VP_VLCPlayer::~VP_VLCPlayer()
     // Set flag to prevent callbacks during destruction
     m_isDestroying = true;
     
+    // A background initialization still owns its results until the thread has finished
+    if (m_initThread) {
+        m_initThread->wait();
+    }
+    if (m_indexThread) {
+        m_indexThread->wait();
+    }
+    if (m_pendingMediaPlayer) {
+        libvlc_media_player_release(m_pendingMediaPlayer);
+        m_pendingMediaPlayer = nullptr;
+    }
+    if (m_pendingInstance) {
+        libvlc_release(m_pendingInstance);
+        m_pendingInstance = nullptr;
+    }
+    
     // Stop position timer first to prevent callbacks during destruction
     if (m_positionTimer) {
         m_positionTimer->stop();
@@ -59,10 +139,16 @@ VP_VLCPlayer::~VP_VLCPlayer()
     }
     
     // Release current media if any
-    if (m_currentMedia) {
-        libvlc_media_release(m_currentMedia);
-        m_currentMedia = nullptr;
+    releaseCurrentMedia();
+    releasePreparedMedia();
+    
+    // Decoders of the dropped caches are cancelled, but still use the instance until they finish
+    for (const QPointer<QThread>& thread : m_decoderThreads) {
+        if (thread) {
+            thread->wait();
+        }
     }
+    m_decoderThreads.clear();
     
     // Release media player
     if (m_mediaPlayer) {
@@ -80,17 +166,156 @@ VP_VLCPlayer::~VP_VLCPlayer()
     m_videoWidget = nullptr;
 }
 
-bool VP_VLCPlayer::initialize()
+void VP_VLCPlayer::setExtraArguments(const QStringList& arguments)
 {
-    qDebug() << "VP_VLCPlayer: Initializing VLC instance";
+    s_extraArguments = arguments;
+}
+
+QStringList VP_VLCPlayer::extraArguments()
+{
+    return s_extraArguments;
+}
+
+void VP_VLCPlayer::setIoMode(IoMode mode)
+{
+    s_ioMode = mode;
+}
+
+VP_VLCPlayer::IoMode VP_VLCPlayer::ioMode()
+{
+    return s_ioMode;
+}
+
+void VP_VLCPlayer::setFileIoMode(const QString& filePath, IoMode mode)
+{
+    s_fileIoModes.insert(QFileInfo(filePath).absoluteFilePath(), mode);
+}
+
+VP_VLCPlayer::IoMode VP_VLCPlayer::ioModeForFile(const QString& filePath)
+{
+    IoMode mode = s_fileIoModes.value(QFileInfo(filePath).absoluteFilePath(), s_ioMode);
+    if (mode != IoMode::Auto) {
+        return mode;
+    }
     
-    // Determine the plugin path
-    QString pluginPath;
+    // Mapping a file on a network share turns every page fault into a round trip
+    static const QStringList networkFileSystems = {
+        "nfs", "nfs4", "cifs", "smbfs", "smb3", "fuse.sshfs", "9p", "afpfs", "webdav"
+    };
+    
+    QStorageInfo storage(filePath);
+    QString fileSystem = QString::fromLatin1(storage.fileSystemType()).toLower();
+    bool isNetwork = networkFileSystems.contains(fileSystem) || filePath.startsWith("//") ||
+                     filePath.startsWith("\\\\");
+    
+    return isNetwork ? IoMode::Buffered : IoMode::Mapped;
+}
+
+QString VP_VLCPlayer::ioModeName(IoMode mode)
+{
+    switch (mode) {
+        case IoMode::Buffered:
+            return "buffered";
+        case IoMode::Mapped:
+            return "mmap";
+        case IoMode::Auto:
+            return "auto";
+        default:
+            return "vlc";
+    }
+}
+
+bool VP_VLCPlayer::ioModeFromName(const QString& name, IoMode* mode)
+{
+    for (IoMode candidate : {IoMode::Vlc, IoMode::Buffered, IoMode::Mapped, IoMode::Auto}) {
+        if (name.compare(ioModeName(candidate), Qt::CaseInsensitive) == 0) {
+            *mode = candidate;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+bool VP_VLCPlayer::isUrl(const QString& path)
+{
+    // A scheme of two letters or more, so "C:/video.mp4" stays a path
+    int separator = path.indexOf("://");
+    if (separator < 2) {
+        return false;
+    }
+    
+    for (int i = 0; i < separator; i++) {
+        QChar c = path.at(i);
+        if (!c.isLetterOrNumber() && c != '+' && c != '-' && c != '.') {
+            return false;
+        }
+    }
+    
+    return !path.startsWith("file://", Qt::CaseInsensitive);
+}
+
+void VP_VLCPlayer::setNetworkCaching(int milliseconds)
+{
+    s_networkCaching = qMax(0, milliseconds);
+}
+
+int VP_VLCPlayer::networkCaching()
+{
+    return s_networkCaching;
+}
+
+bool VP_VLCPlayer::usesChunkCache(const QString& url)
+{
+    return isUrl(url) && ChunkCache::instance().budget() > 0 && RemoteReader::isCacheable(url) && !usesTimeshift(url);
+}
+
+void VP_VLCPlayer::setTimeshiftEnabled(bool enabled)
+{
+    s_timeshiftEnabled = enabled;
+}
+
+bool VP_VLCPlayer::timeshiftEnabled()
+{
+    return s_timeshiftEnabled;
+}
+
+bool VP_VLCPlayer::usesTimeshift(const QString& url)
+{
+    return s_timeshiftEnabled && isUrl(url) && TimeshiftBuffer::isSupported(url);
+}
+
+QString VP_VLCPlayer::pluginPath()
+{
+    static QMutex mutex;
+    static QString cachedPath;
+    static bool resolved = false;
+    
+    QMutexLocker locker(&mutex);
+    
+    if (resolved) {
+        return cachedPath;
+    }
     
     // First, try to find plugins in the application directory
     QString appDir = QCoreApplication::applicationDirPath();
     appDir = QDir::cleanPath(appDir);
     
+    // The path found by an earlier run is kept in a cache file, it only needs a single check
+    QFile cacheFile(appDir + "/vlcpluginpath.txt");
+    if (cacheFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QString path = QString::fromUtf8(cacheFile.readAll()).trimmed();
+        cacheFile.close();
+        
+        if (!path.isEmpty() && QDir(path).exists()) {
+            qDebug() << "VP_VLCPlayer: Using cached plugin path:" << path;
+            cachedPath = path;
+            resolved = true;
+            return cachedPath;
+        }
+    }
+    
+    QString pluginPath;
     QString appPlugins = appDir + "/plugins";
     
     // Check if plugins exist in app directory (for deployed version)
@@ -121,23 +346,35 @@ bool VP_VLCPlayer::initialize()
         }
     }
     
-    // Final validation of plugin path
     if (!pluginPath.isEmpty()) {
-        pluginPath = QDir::cleanPath(pluginPath);
+        pluginPath = QDir::toNativeSeparators(QDir::cleanPath(pluginPath));
         
-        if (!QDir(pluginPath).exists()) {
-            qDebug() << "VP_VLCPlayer: Warning - Plugin path does not exist:" << pluginPath;
-            pluginPath.clear();
+        if (cacheFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            cacheFile.write(pluginPath.toUtf8());
+            cacheFile.close();
         } else {
-            pluginPath = QDir::toNativeSeparators(pluginPath);
+            qDebug() << "VP_VLCPlayer: Could not write plugin path cache:" << cacheFile.fileName();
         }
     }
     
+    cachedPath = pluginPath;
+    resolved = true;
+    return cachedPath;
+}
+
+bool VP_VLCPlayer::createInstance(const QStringList& extraArguments, libvlc_instance_t** instance,
+                                  libvlc_media_player_t** mediaPlayer, QString* error)
+{
+    *instance = nullptr;
+    if (mediaPlayer) {
+        *mediaPlayer = nullptr;
+    }
+    
     // Prepare VLC arguments with the correct plugin path
-    std::string pluginArg = "--plugin-path=" + pluginPath.toStdString();
+    std::string pluginArg = "--plugin-path=" + pluginPath().toStdString();
     
     // VLC command line arguments
-    const char* vlc_args[] = {
+    std::vector<const char*> vlc_args = {
         "--no-xlib",  // Tell VLC not to use Xlib (for Linux compatibility)
         "--quiet",    // Suppress console output
         "--no-video-title-show",  // Don't show media title on video
@@ -152,7 +389,16 @@ bool VP_VLCPlayer::initialize()
         pluginArg.c_str()  // Plugin path
     };
     
-    int vlc_argc = sizeof(vlc_args) / sizeof(vlc_args[0]);
+    // Extra arguments come last so they override the defaults above
+    std::vector<QByteArray> extraArgStorage;
+    for (const QString& arg : extraArguments) {
+        extraArgStorage.push_back(arg.toUtf8());
+    }
+    for (const QByteArray& arg : extraArgStorage) {
+        vlc_args.push_back(arg.constData());
+    }
+    
+    int vlc_argc = static_cast<int>(vlc_args.size());
     
     qDebug() << "VP_VLCPlayer: Initializing with arguments:";
     for (int i = 0; i < vlc_argc; i++) {
@@ -160,31 +406,149 @@ bool VP_VLCPlayer::initialize()
     }
     
     // Create VLC instance
-    m_vlcInstance = libvlc_new(vlc_argc, vlc_args);
+    *instance = libvlc_new(vlc_argc, vlc_args.data());
     
-    if (!m_vlcInstance) {
-        const char* error = libvlc_errmsg();
-        QString errorMsg = error ? QString::fromUtf8(error) : "Unknown error";
-        setLastError(QString("Failed to create VLC instance: %1. Make sure VLC libraries are properly installed.").arg(errorMsg));
+    if (!*instance) {
+        const char* vlcError = libvlc_errmsg();
+        QString errorMsg = vlcError ? QString::fromUtf8(vlcError) : "Unknown error";
+        *error = QString("Failed to create VLC instance: %1. Make sure VLC libraries are properly installed.").arg(errorMsg);
         qDebug() << "VP_VLCPlayer: Failed to create VLC instance. Error:" << errorMsg;
         return false;
     }
     
+    // Instance only
+    if (!mediaPlayer) {
+        return true;
+    }
+    
     // Create media player
-    m_mediaPlayer = libvlc_media_player_new(m_vlcInstance);
+    *mediaPlayer = libvlc_media_player_new(*instance);
     
-    if (!m_mediaPlayer) {
-        setLastError("Failed to create VLC media player.");
+    if (!*mediaPlayer) {
+        *error = "Failed to create VLC media player.";
         qDebug() << "VP_VLCPlayer: Failed to create media player";
-        libvlc_release(m_vlcInstance);
-        m_vlcInstance = nullptr;
+        libvlc_release(*instance);
+        *instance = nullptr;
+        return false;
+    }
+    
+    return true;
+}
+
+libvlc_instance_t* VP_VLCPlayer::createHeadlessInstance(QString* error)
+{
+    libvlc_instance_t* instance = nullptr;
+    QString createError;
+    
+    createInstance(s_extraArguments + QStringList{"--no-audio"}, &instance, nullptr, &createError);
+    
+    if (error) {
+        *error = createError;
+    }
+    
+    return instance;
+}
+
+bool VP_VLCPlayer::initialize()
+{
+    if (isInitialized()) {
+        return true;
+    }
+    
+    // A background initialization is already running, wait for it instead of starting another
+    if (m_asyncInitPending) {
+        finishAsyncInitialization();
+        return isInitialized();
+    }
+    
+    qDebug() << "VP_VLCPlayer: Initializing VLC instance";
+    
+    PERF_TRACE_SCOPE("vlcInitialize");
+    
+    libvlc_instance_t* instance = nullptr;
+    libvlc_media_player_t* mediaPlayer = nullptr;
+    QString error;
+    createInstance(s_extraArguments, &instance, &mediaPlayer, &error);
+    
+    return finishInitialization(instance, mediaPlayer, error);
+}
+
+void VP_VLCPlayer::initializeAsync()
+{
+    if (isInitialized()) {
+        emit initialized(true);
+        return;
+    }
+    
+    if (m_asyncInitPending) {
+        return;
+    }
+    
+    qDebug() << "VP_VLCPlayer: Initializing VLC instance in background";
+    
+    m_asyncInitPending = true;
+    const QStringList extraArgs = s_extraArguments;
+    
+    // The thread only fills the pending members, the destructor waits for it
+    m_initThread = QThread::create([this, extraArgs]() {
+        PERF_TRACE_SCOPE("vlcInitialize");
+        createInstance(extraArgs, &m_pendingInstance, &m_pendingMediaPlayer, &m_pendingError);
+        QMetaObject::invokeMethod(this, [this]() {
+            finishAsyncInitialization();
+        }, Qt::QueuedConnection);
+    });
+    
+    m_initThread->setObjectName("vlcInit");
+    connect(m_initThread, &QThread::finished, m_initThread, &QObject::deleteLater);
+    m_initThread->start();
+}
+
+void VP_VLCPlayer::finishAsyncInitialization()
+{
+    // initialize() may already have taken the result
+    if (!m_asyncInitPending) {
+        return;
+    }
+    
+    if (m_initThread) {
+        m_initThread->wait();
+    }
+    
+    m_asyncInitPending = false;
+    
+    libvlc_instance_t* instance = m_pendingInstance;
+    libvlc_media_player_t* mediaPlayer = m_pendingMediaPlayer;
+    m_pendingInstance = nullptr;
+    m_pendingMediaPlayer = nullptr;
+    
+    finishInitialization(instance, mediaPlayer, m_pendingError);
+}
+
+bool VP_VLCPlayer::finishInitialization(libvlc_instance_t* instance, libvlc_media_player_t* mediaPlayer, const QString& error)
+{
+    if (!instance || !mediaPlayer) {
+        setLastError(error.isEmpty() ? QString("Failed to initialize VLC") : error);
+        emit initialized(false);
         return false;
     }
     
+    m_vlcInstance = instance;
+    m_mediaPlayer = mediaPlayer;
+    
     // Setup event callbacks
     setupEventCallbacks();
     
+    // Apply what was requested while VLC was still starting
+    if (m_videoWidget) {
+        setVideoWidget(m_videoWidget);
+    }
+    if (m_pendingVolume >= 0) {
+        setVolume(m_pendingVolume);
+        m_pendingVolume = -1;
+    }
+    
     qDebug() << "VP_VLCPlayer: VLC initialization successful";
+    emit initialized(true);
     return true;
 }
 
@@ -197,27 +561,47 @@ bool VP_VLCPlayer::loadMedia(const QString& filePath)
     
     qDebug() << "VP_VLCPlayer: Loading media:" << filePath;
     
-    // Check if file exists
-    if (!QFile::exists(filePath)) {
+    // Check if file exists (a stream is only known to be there once VLC opens it)
+    if (!isUrl(filePath) && !ArchiveReader::exists(filePath)) {
         setLastError(QString("File does not exist: %1").arg(filePath));
         qDebug() << "VP_VLCPlayer: File does not exist:" << filePath;
         return false;
     }
     
     // Clean up previous media
-    if (m_currentMedia) {
-        libvlc_media_release(m_currentMedia);
-        m_currentMedia = nullptr;
-    }
+    releaseCurrentMedia();
     
-    // Create new media
-    QString nativePath = QDir::toNativeSeparators(filePath);
+    // A live stream is recorded from now on and played from the recording
+    if (usesTimeshift(filePath)) {
+        m_timeshift.reset(new TimeshiftBuffer(filePath));
+        if (m_timeshift->start()) {
+            m_currentMedia = m_timeshift->createMedia(m_vlcInstance);
+        } else {
+            m_timeshift.reset();
+        }
+        m_timeshiftOpenTime = 0;
+        m_timeshiftRangeStart = -1;
+        m_timeshiftRangeEnd = -1;
+        
+        // Skimming and stepping need seeks and a paused input, a live recording plays natively
+        if (m_virtualRate > 0.0f) {
+            m_skimTimer->stop();
+            m_frameStepTimer->stop();
+            libvlc_media_player_set_rate(m_mediaPlayer, qBound(MinNativeRate, m_virtualRate, MaxNativeRate));
+            m_virtualRate = 0.0f;
+        }
+    } else if (m_preparedMedia && filePath == m_preparedMediaPath) {
+        // Reuse the media prepared for this file, it has already been parsed
+        qDebug() << "VP_VLCPlayer: Using prepared media";
+        m_currentMedia = m_preparedMedia;
+        m_preparedMedia = nullptr;
+        m_preparedMediaPath.clear();
+    } else {
+        m_currentMedia = createMedia(filePath);
+    }
     
-#ifdef _WIN32
-    m_currentMedia = libvlc_media_new_path(m_vlcInstance, nativePath.toUtf8().constData());
-#else
-    m_currentMedia = libvlc_media_new_path(m_vlcInstance, filePath.toUtf8().constData());
-#endif
+    m_startPosition = 0;
+    m_hasStartOption = false;
     
     if (!m_currentMedia) {
         setLastError(QString("Failed to create media from file: %1").arg(filePath));
@@ -228,11 +612,22 @@ bool VP_VLCPlayer::loadMedia(const QString& filePath)
     // Set media to player
     libvlc_media_player_set_media(m_mediaPlayer, m_currentMedia);
     
+    // Time to first frame is measured from here
+    m_firstFrameTraceStart = PerfTracer::now();
+    m_seekPending = false;
+    m_skimSeekPending = false;
+    m_virtualPosition = 0.0;
+    m_awaitingFirstFrame = true;
+    m_streamMetrics = StreamMetrics();
+    m_stallStart = -1;
+    
     // Store the media path
     m_currentMediaPath = filePath;
+    m_currentMediaCached = usesChunkCache(filePath);
     
     // Update media info
     updateMediaInfo();
+    loadKeyframeIndex(filePath);
     
     // Emit signal
     emit mediaLoaded(filePath);
@@ -241,6 +636,198 @@ bool VP_VLCPlayer::loadMedia(const QString& filePath)
     return true;
 }
 
+libvlc_media_t* VP_VLCPlayer::createMedia(const QString& filePath) const
+{
+    if (isUrl(filePath)) {
+        // Through the disk chunk cache where the server serves ranges
+        if (usesChunkCache(filePath)) {
+            return RemoteReader::createMedia(m_vlcInstance, filePath);
+        }
+        
+        libvlc_media_t* media = libvlc_media_new_location(m_vlcInstance, filePath.toUtf8().constData());
+        if (media) {
+            // Per media, so local files keep VLC's small file caching
+            QByteArray caching = QString(":network-caching=%1").arg(s_networkCaching).toUtf8();
+            libvlc_media_add_option(media, caching.constData());
+            libvlc_media_add_option(media, ":http-reconnect");
+        }
+        return media;
+    }
+    
+    // An entry of a zip or tar archive is read straight out of the archive
+    if (ArchiveReader::splitPath(filePath, nullptr, nullptr)) {
+        return ArchiveReader::createMedia(m_vlcInstance, filePath);
+    }
+    
+    switch (ioModeForFile(filePath)) {
+        case IoMode::Buffered:
+            return MediaReader::createMedia(m_vlcInstance, filePath, MediaReader::Mode::Buffered);
+        case IoMode::Mapped:
+            return MediaReader::createMedia(m_vlcInstance, filePath, MediaReader::Mode::Mapped);
+        default:
+            break;
+    }
+    
+    QString nativePath = QDir::toNativeSeparators(filePath);
+    
+#ifdef _WIN32
+    return libvlc_media_new_path(m_vlcInstance, nativePath.toUtf8().constData());
+#else
+    return libvlc_media_new_path(m_vlcInstance, filePath.toUtf8().constData());
+#endif
+}
+
+void VP_VLCPlayer::prepareMedia(const QString& filePath)
+{
+    if (!m_vlcInstance || filePath == m_preparedMediaPath) {
+        return;
+    }
+    
+    releasePreparedMedia();
+    
+    // A timeshift recording starts when the stream is loaded
+    if (filePath.isEmpty() || usesTimeshift(filePath) || (!isUrl(filePath) && !ArchiveReader::exists(filePath))) {
+        return;
+    }
+    
+    PERF_TRACE_SCOPE("prepareMedia");
+    
+    m_preparedMedia = createMedia(filePath);
+    if (!m_preparedMedia) {
+        qDebug() << "VP_VLCPlayer: Failed to prepare media:" << filePath;
+        return;
+    }
+    
+    m_preparedMediaPath = filePath;
+    
+    // Parsing runs on VLC's preparser thread while the current file keeps playing
+    libvlc_media_parse_with_options(m_preparedMedia, isUrl(filePath) ? libvlc_media_parse_network : libvlc_media_parse_local, -1);
+    
+    qDebug() << "VP_VLCPlayer: Preparing media:" << filePath;
+}
+
+void VP_VLCPlayer::releaseCurrentMedia()
+{
+    if (!m_currentMedia) {
+        return;
+    }
+    
+    if (isUrl(m_currentMediaPath)) {
+        qDebug() << "VP_VLCPlayer: Stream session" << m_currentMediaPath << "- startup" << m_streamMetrics.startupDelayMs
+                 << "ms," << m_streamMetrics.rebufferCount << "rebuffers," << m_streamMetrics.rebufferMs << "ms stalled";
+    }
+    
+    // The input reading a timeshift buffer has to be closed before the buffer goes
+    if (m_timeshift && m_mediaPlayer) {
+        m_interruptingInput = true;
+        m_timeshift->interruptReaders();
+        libvlc_media_player_stop(m_mediaPlayer);
+        m_interruptingInput = false;
+    }
+    
+    // A background parse may still be running for it
+    libvlc_event_detach(libvlc_media_event_manager(m_currentMedia), libvlc_MediaParsedChanged,
+                        handleVLCEvent, this);
+    libvlc_media_release(m_currentMedia);
+    m_currentMedia = nullptr;
+    m_timeshift.reset();
+    
+    clearFrameOverlay();
+    m_frameBuffer.reset();
+    m_keyframeIndex.reset();
+    m_stateFrames.reset();
+    m_stateFramePositions.clear();
+}
+
+void VP_VLCPlayer::loadKeyframeIndex(const QString& filePath)
+{
+    if (isUrl(filePath) || ArchiveReader::splitPath(filePath, nullptr, nullptr) || !KeyframeIndex::isSupported(filePath)) {
+        return;
+    }
+    
+    m_keyframeIndex = KeyframeIndex::open(filePath);
+    if (m_keyframeIndex || m_indexThread) {
+        return;  // A running build starts the next one for the file loaded by then
+    }
+    
+    m_indexThread = QThread::create([this, filePath]() {
+        std::shared_ptr<KeyframeIndex> index = KeyframeIndex::build(filePath);
+        QMetaObject::invokeMethod(this, [this, filePath, index]() {
+            // Finished but not deleted yet, the next build may start
+            if (m_indexThread) {
+                m_indexThread->wait();
+                m_indexThread = nullptr;
+            }
+            if (m_isDestroying || m_keyframeIndex) {
+                return;
+            }
+            
+            if (filePath == m_currentMediaPath) {
+                m_keyframeIndex = index;
+                if (index) {
+                    emit keyframeIndexChanged();
+                }
+            } else if (m_currentMedia) {
+                loadKeyframeIndex(m_currentMediaPath);
+            }
+        }, Qt::QueuedConnection);
+    });
+    
+    m_indexThread->setObjectName("keyframeIndex");
+    connect(m_indexThread, &QThread::finished, m_indexThread, &QObject::deleteLater);
+    m_indexThread->start();
+}
+
+void VP_VLCPlayer::setStateFramePositions(const QList<qint64>& positions)
+{
+    m_stateFramePositions = positions;
+    updateStateFrames();
+}
+
+void VP_VLCPlayer::updateStateFrames()
+{
+    // A stream is not downloaded twice, a timeshift recording has no fixed positions
+    if (!m_currentMedia || isUrl(m_currentMediaPath) || m_timeshift || StateFrameCache::budget() == 0) {
+        return;
+    }
+    
+    if (!m_stateFrames) {
+        QSize size = videoSize();
+        if (m_stateFramePositions.isEmpty() || size.isEmpty()) {
+            return;  // Again once the size is known
+        }
+        
+        // Even dimensions keep the chroma conversion happy
+        size = QSize(qMax(2, size.width() & ~1), qMax(2, size.height() & ~1));
+        m_stateFrames.reset(new StateFrameCache(size));
+    }
+    
+    adoptDecoderThread(m_stateFrames->setPositions([this]() {
+        return createMedia(m_currentMediaPath);
+    }, m_stateFramePositions));
+}
+
+void VP_VLCPlayer::adoptDecoderThread(QThread* thread)
+{
+    // Finished threads have deleted themselves
+    for (auto it = m_decoderThreads.begin(); it != m_decoderThreads.end();) {
+        it = it->isNull() ? m_decoderThreads.erase(it) : std::next(it);
+    }
+    
+    if (thread) {
+        m_decoderThreads.append(thread);
+    }
+}
+
+void VP_VLCPlayer::releasePreparedMedia()
+{
+    if (m_preparedMedia) {
+        libvlc_media_release(m_preparedMedia);
+        m_preparedMedia = nullptr;
+    }
+    m_preparedMediaPath.clear();
+}
+
 void VP_VLCPlayer::unloadMedia()
 {
     qDebug() << "VP_VLCPlayer: Unloading media";
@@ -249,10 +836,7 @@ void VP_VLCPlayer::unloadMedia()
     stop();
     
     // Release current media
-    if (m_currentMedia) {
-        libvlc_media_release(m_currentMedia);
-        m_currentMedia = nullptr;
-    }
+    releaseCurrentMedia();
     
     // Clear media from player
     if (m_mediaPlayer) {
@@ -261,6 +845,7 @@ void VP_VLCPlayer::unloadMedia()
     
     m_currentMediaPath.clear();
     m_duration = -1;
+    m_mediaInfo = MediaInfoCache::Info();
     
     emit mediaUnloaded();
 }
@@ -274,6 +859,35 @@ void VP_VLCPlayer::play()
     
     qDebug() << "VP_VLCPlayer: Starting playback";
     
+    // Backwards through the buffer, VLC stays paused on the frame it is at
+    if (m_reverse && m_state == PlayerState::Paused) {
+        setState(PlayerState::Playing);
+        m_reversePosition = position();
+        m_reverseClock.restart();
+        reverseTick();
+        emit playing();
+        return;
+    }
+    
+    // Stepped back into the buffer, VLC goes on from the frame shown
+    if (m_overlayTime >= 0) {
+        qint64 time = m_overlayTime;
+        clearFrameOverlay();
+        setPosition(time);
+    }
+    
+    // Skimming and stepping go on along the clock, VLC itself stays paused
+    if (m_virtualRate > 0.0f && m_state == PlayerState::Paused) {
+        setState(PlayerState::Playing);
+        m_positionTimer->start();
+        startVirtualPlayback();
+        emit playing();
+        return;
+    }
+    
+    bool fromStopped = m_state == PlayerState::Stopped;
+    qint64 startPosition = m_startPosition;
+    
     // If we're at position 0 and stopped (video ended), we need to stop first
     // to ensure VLC properly resets before playing again
     if (m_state == PlayerState::Stopped && m_lastPosition == 0) {
@@ -300,11 +914,29 @@ void VP_VLCPlayer::play()
         setKeyInputEnabled(false);
     }
     
+    // A timeshifted stream opens at a time in its buffer instead, just behind live unless a start was set
+    if (m_timeshift && m_state == PlayerState::Stopped) {
+        qint64 target = m_startPosition > 0 ? m_startPosition : m_timeshift->liveTime() - s_networkCaching;
+        m_timeshiftOpenTime = m_timeshift->setOpenTime(target);
+        m_startPosition = 0;
+    } else if (m_state == PlayerState::Stopped && (m_startPosition > 0 || m_hasStartOption)) {
+        // Media options are read when the input opens. Options can not be removed,
+        // a later play() from stopped overrides an earlier start time with 0.
+        QString option = QString(":start-time=%1").arg(m_startPosition / 1000.0, 0, 'f', 3);
+        libvlc_media_add_option(m_currentMedia, option.toUtf8().constData());
+        m_hasStartOption = true;
+        m_startPosition = 0;
+    }
+    
     int result = libvlc_media_player_play(m_mediaPlayer);
     
     if (result == 0) {
         setState(PlayerState::Playing);
         m_positionTimer->start();
+        if (m_virtualRate > 0.0f && fromStopped) {
+            m_virtualPosition = startPosition;
+            startVirtualPlayback();
+        }
         emit playing();
         qDebug() << "VP_VLCPlayer: Playback started successfully";
     } else {
@@ -321,9 +953,14 @@ void VP_VLCPlayer::pause()
     
     qDebug() << "VP_VLCPlayer: Pausing playback";
     
+    advanceVirtualPosition();
+    
     libvlc_media_player_set_pause(m_mediaPlayer, 1);
     setState(PlayerState::Paused);
     m_positionTimer->stop();
+    m_skimTimer->stop();
+    m_frameStepTimer->stop();
+    m_reverseTimer->stop();
     emit paused();
 }
 
@@ -333,171 +970,647 @@ void VP_VLCPlayer::stop()
         return;
     }
     
-    qDebug() << "VP_VLCPlayer: Stopping playback";
+    qDebug() << "VP_VLCPlayer: Stopping playback";
+    
+    clearFrameOverlay();
+    
+    // The input waits for live data otherwise and stop() would wait for it
+    m_interruptingInput = true;
+    if (m_timeshift) {
+        m_timeshift->interruptReaders();
+    }
+    libvlc_media_player_stop(m_mediaPlayer);
+    m_interruptingInput = false;
+    setState(PlayerState::Stopped);
+    m_positionTimer->stop();
+    m_skimTimer->stop();
+    m_frameStepTimer->stop();
+    m_reverseTimer->stop();
+    m_reverse = false;
+    m_skimSeekPending = false;
+    m_virtualPosition = 0.0;
+    m_lastPosition = -1;
+    emit stopped();
+}
+
+void VP_VLCPlayer::togglePlayPause()
+{
+    if (isPlaying()) {
+        pause();
+    } else {
+        play();
+    }
+}
+
+qint64 VP_VLCPlayer::position() const
+{
+    if (!m_mediaPlayer) {
+        return 0;
+    }
+    
+    if (m_overlayTime >= 0) {
+        return m_overlayTime;
+    }
+    
+    if (m_virtualRate > 0.0f) {
+        return static_cast<qint64>(m_virtualPosition);
+    }
+    
+    // VLC counts from where the recording was opened
+    if (m_timeshift) {
+        qint64 time = m_timeshiftOpenTime + qMax<qint64>(0, libvlc_media_player_get_time(m_mediaPlayer));
+        return qBound(m_timeshift->startTime(), time, m_timeshift->liveTime());
+    }
+    
+    return libvlc_media_player_get_time(m_mediaPlayer);
+}
+
+qint64 VP_VLCPlayer::duration() const
+{
+    if (!m_mediaPlayer) {
+        return 0;
+    }
+    
+    if (m_timeshift) {
+        return m_timeshift->liveTime();
+    }
+    
+    libvlc_time_t dur = libvlc_media_player_get_length(m_mediaPlayer);
+    if (dur == -1) {
+        return m_duration;
+    }
+    
+    return dur;
+}
+
+void VP_VLCPlayer::setPosition(qint64 position)
+{
+    if (!m_mediaPlayer) {
+        return;
+    }
+    
+    if (position < 0) {
+        qDebug() << "VP_VLCPlayer: Invalid negative position, setting to 0";
+        position = 0;
+    }
+    
+    clearFrameOverlay();
+    
+    if (m_timeshift) {
+        reopenTimeshift(position);
+        return;
+    }
+    
+    // A state's frame decoded ahead covers the seek until VLC shows it
+    QImage stateFrame = m_stateFrames ? m_stateFrames->frameAt(position) : QImage();
+    if (!stateFrame.isNull()) {
+        m_stateFrameOverlay = true;
+        m_stateFrameTarget = position;
+        emit frameOverlayChanged(stateFrame);
+    }
+    
+    if (!libvlc_media_player_is_playing(m_mediaPlayer) && m_state != PlayerState::Paused) {
+        qDebug() << "VP_VLCPlayer: Warning - Setting position while not playing or paused";
+    }
+    
+    qDebug() << "VP_VLCPlayer: Setting position to" << position << "ms";
+    if (m_keyframeIndex) {
+        qDebug() << "VP_VLCPlayer: Seek decodes" << m_keyframeIndex->seekCost(position) << "ms from the keyframe at"
+                 << m_keyframeIndex->keyframeBefore(position) << "ms";
+    }
+    
+    // Seek latency is measured until the next time update from VLC
+    m_seekTraceStart = PerfTracer::now();
+    m_seekPending = true;
+    
+    // Skimming or stepping goes on from here, after this frame
+    if (m_virtualRate > 0.0f) {
+        m_virtualPosition = position;
+        m_frameStepPosition = position;
+        m_skimSeekStart = m_seekTraceStart;
+        m_skimTarget = position;
+        m_virtualClock.restart();
+        if (isFrameStepping() && m_state == PlayerState::Playing && !m_reverse) {
+            armFrameStep();
+        }
+    }
+    
+    // Reverse playback goes on backwards from here once the buffer has the frames
+    if (m_reverse) {
+        m_reversePosition = position;
+        m_reverseClock.restart();
+    }
+    
+    libvlc_media_player_set_time(m_mediaPlayer, position);
+    
+    m_lastPosition = position;
+    emit positionChanged(position);
+}
+
+void VP_VLCPlayer::reopenTimeshift(qint64 position)
+{
+    // Stopped, it is where the next play() opens
+    if (m_state == PlayerState::Stopped) {
+        m_startPosition = position;
+        return;
+    }
+    
+    qDebug() << "VP_VLCPlayer: Reopening timeshift buffer at" << position << "ms";
+    
+    m_seekTraceStart = PerfTracer::now();
+    m_seekPending = true;
+    m_pauseAfterSeek = m_state == PlayerState::Paused;
+    
+    // VLC can not seek in a live stream, the input is opened again at the data of that moment
+    m_interruptingInput = true;
+    m_timeshift->interruptReaders();
+    libvlc_media_player_stop(m_mediaPlayer);
+    m_interruptingInput = false;
+    m_timeshiftOpenTime = m_timeshift->setOpenTime(position);
+    libvlc_media_player_play(m_mediaPlayer);
+    
+    m_lastPosition = m_timeshiftOpenTime;
+    emit positionChanged(m_timeshiftOpenTime);
+}
+
+void VP_VLCPlayer::seekRelative(qint64 offset)
+{
+    qint64 newPosition = position() + offset;
+    qint64 mediaDuration = duration();
+    
+    if (newPosition < seekableStart()) {
+        newPosition = seekableStart();
+    } else if (mediaDuration > 0 && newPosition > mediaDuration) {
+        newPosition = mediaDuration;
+    }
+    
+    setPosition(newPosition);
+}
+
+qint64 VP_VLCPlayer::seekableStart() const
+{
+    return m_timeshift ? m_timeshift->startTime() : 0;
+}
+
+void VP_VLCPlayer::setStartPosition(qint64 position)
+{
+    if (!m_currentMedia || m_state != PlayerState::Stopped) {
+        return;
+    }
+    
+    qDebug() << "VP_VLCPlayer: Start position set to" << position << "ms";
+    m_startPosition = qMax(static_cast<qint64>(0), position);
+}
+
+int VP_VLCPlayer::volume() const
+{
+    if (!m_mediaPlayer) {
+        return 0;
+    }
+    
+    return libvlc_audio_get_volume(m_mediaPlayer);
+}
+
+void VP_VLCPlayer::setVolume(int volume)
+{
+    if (volume < 0) volume = 0;
+    if (volume > 200) volume = 200;
+    
+    // Applied once VLC has been initialized
+    if (!m_mediaPlayer) {
+        m_pendingVolume = volume;
+        return;
+    }
+    
+    qDebug() << "VP_VLCPlayer: Setting volume to" << volume << "%";
+    
+    libvlc_audio_set_volume(m_mediaPlayer, volume);
+    
+    if (!m_isMuted) {
+        m_savedVolume = volume;
+    }
+    
+    emit volumeChanged(volume);
+}
+
+void VP_VLCPlayer::mute()
+{
+    if (!m_mediaPlayer || m_isMuted) {
+        return;
+    }
+    
+    qDebug() << "VP_VLCPlayer: Muting audio";
+    
+    m_savedVolume = volume();
+    libvlc_audio_set_mute(m_mediaPlayer, 1);
+    m_isMuted = true;
+    
+    emit mutedChanged(true);
+}
+
+void VP_VLCPlayer::unmute()
+{
+    if (!m_mediaPlayer || !m_isMuted) {
+        return;
+    }
+    
+    qDebug() << "VP_VLCPlayer: Unmuting audio";
+    
+    libvlc_audio_set_mute(m_mediaPlayer, 0);
+    m_isMuted = false;
+    
+    emit mutedChanged(false);
+}
+
+bool VP_VLCPlayer::isMuted() const
+{
+    if (!m_mediaPlayer) {
+        return false;
+    }
+    
+    return libvlc_audio_get_mute(m_mediaPlayer) != 0;
+}
+
+float VP_VLCPlayer::playbackRate() const
+{
+    if (!m_mediaPlayer) {
+        return 1.0f;
+    }
+    
+    if (m_virtualRate > 0.0f) {
+        return m_virtualRate;
+    }
+    
+    return libvlc_media_player_get_rate(m_mediaPlayer);
+}
+
+void VP_VLCPlayer::setPlaybackRate(float rate)
+{
+    if (!m_mediaPlayer) {
+        return;
+    }
+    
+    // A timeshift seek reopens the stream, it plays at native rates only
+    float minRate = m_timeshift ? MinNativeRate : MinRate;
+    float maxRate = m_timeshift ? MaxNativeRate : MaxSkimRate;
+    
+    if (rate < minRate) rate = minRate;
+    if (rate > maxRate) rate = maxRate;
+    
+    if (rate > MaxNativeRate || rate < MinNativeRate) {
+        qDebug() << "VP_VLCPlayer:" << (rate > MaxNativeRate ? "Skimming" : "Frame stepping") << "at" << rate << "x";
+        
+        if (m_virtualRate <= 0.0f) {
+            m_virtualPosition = position();
+            libvlc_media_player_set_rate(m_mediaPlayer, 1.0f);
+        } else {
+            advanceVirtualPosition();
+        }
+        
+        m_virtualRate = rate;
+        if (m_state == PlayerState::Playing && !m_reverse) {
+            startVirtualPlayback();
+        }
+        return;
+    }
+    
+    if (m_virtualRate > 0.0f) {
+        stopVirtualPlayback();
+    }
     
-    libvlc_media_player_stop(m_mediaPlayer);
-    setState(PlayerState::Stopped);
-    m_positionTimer->stop();
-    m_lastPosition = -1;
-    emit stopped();
+    qDebug() << "VP_VLCPlayer: Setting playback rate to" << rate;
+    
+    libvlc_media_player_set_rate(m_mediaPlayer, rate);
 }
 
-void VP_VLCPlayer::togglePlayPause()
+void VP_VLCPlayer::startVirtualPlayback()
 {
-    if (isPlaying()) {
-        pause();
+    libvlc_media_player_set_pause(m_mediaPlayer, 1);
+    m_virtualClock.restart();
+    
+    if (isSkimming()) {
+        m_frameStepTimer->stop();
+        m_skimTarget = -1;
+        m_skimTimer->start();
     } else {
-        play();
+        m_skimTimer->stop();
+        m_frameStepPosition = m_virtualPosition;
+        armFrameStep();
     }
 }
 
-qint64 VP_VLCPlayer::position() const
+void VP_VLCPlayer::stopVirtualPlayback()
 {
-    if (!m_mediaPlayer) {
-        return 0;
+    advanceVirtualPosition();
+    
+    m_skimTimer->stop();
+    m_frameStepTimer->stop();
+    m_virtualRate = 0.0f;
+    m_skimSeekPending = false;
+    
+    // Native playback goes on from the virtual position
+    qint64 position = static_cast<qint64>(m_virtualPosition);
+    if (m_state == PlayerState::Playing || m_state == PlayerState::Paused) {
+        libvlc_media_player_set_time(m_mediaPlayer, position);
+        m_lastPosition = position;
+    }
+    if (m_state == PlayerState::Playing && !m_reverse) {
+        libvlc_media_player_set_pause(m_mediaPlayer, 0);
     }
-    
-    return libvlc_media_player_get_time(m_mediaPlayer);
 }
 
-qint64 VP_VLCPlayer::duration() const
+void VP_VLCPlayer::advanceVirtualPosition()
 {
-    if (!m_mediaPlayer) {
-        return 0;
+    if (m_state == PlayerState::Playing && !m_reverse && m_virtualClock.isValid()) {
+        m_virtualPosition += m_virtualClock.restart() * static_cast<double>(m_virtualRate);
     }
-    
-    libvlc_time_t dur = libvlc_media_player_get_length(m_mediaPlayer);
-    if (dur == -1) {
-        return m_duration;
+}
+
+bool VP_VLCPlayer::virtualPlaybackEnded()
+{
+    qint64 mediaDuration = duration();
+    if (mediaDuration <= 0 || m_virtualPosition < mediaDuration) {
+        return false;
     }
     
-    return dur;
+    m_skimTimer->stop();
+    m_frameStepTimer->stop();
+    libvlc_media_player_stop(m_mediaPlayer);
+    handleEndReached();
+    return true;
 }
 
-void VP_VLCPlayer::setPosition(qint64 position)
+void VP_VLCPlayer::skimTick()
 {
-    if (!m_mediaPlayer) {
+    if (!m_mediaPlayer || !isSkimming()) {
         return;
     }
     
-    if (position < 0) {
-        qDebug() << "VP_VLCPlayer: Invalid negative position, setting to 0";
-        position = 0;
+    advanceVirtualPosition();
+    if (virtualPlaybackEnded()) {
+        return;
     }
     
-    if (!libvlc_media_player_is_playing(m_mediaPlayer) && m_state != PlayerState::Paused) {
-        qDebug() << "VP_VLCPlayer: Warning - Setting position while not playing or paused";
+    // One frame in flight: the next seek waits until the last frame is shown, so the
+    // decoder never queues up work (a frame that never reports back is given up on)
+    const qint64 SkimSeekTimeoutUs = 250000;
+    qint64 now = PerfTracer::now();
+    if ((m_seekPending || m_skimSeekPending) && now - m_skimSeekStart < SkimSeekTimeoutUs) {
+        return;
     }
     
-    qDebug() << "VP_VLCPlayer: Setting position to" << position << "ms";
-    libvlc_media_player_set_time(m_mediaPlayer, position);
+    // With an index only keyframes are shown, they decode without the frames before them.
+    // The next one is sought once the clock has passed the last one shown
+    qint64 target = static_cast<qint64>(m_virtualPosition);
+    if (m_keyframeIndex) {
+        qint64 keyframe = m_keyframeIndex->keyframeAfter(target);
+        if (keyframe < 0) {
+            keyframe = m_keyframeIndex->keyframeBefore(target);  // Past the last keyframe
+        }
+        if (keyframe >= 0) {
+            if (keyframe == m_skimTarget) {
+                return;
+            }
+            target = keyframe;
+        }
+    }
     
-    m_lastPosition = position;
-    emit positionChanged(position);
+    m_skimTarget = target;
+    m_skimSeekPending = true;
+    m_skimSeekStart = now;
+    libvlc_media_player_set_time(m_mediaPlayer, target);
 }
 
-void VP_VLCPlayer::seekRelative(qint64 offset)
+double VP_VLCPlayer::frameIntervalMs() const
 {
-    qint64 newPosition = position() + offset;
-    qint64 mediaDuration = duration();
-    
-    if (newPosition < 0) {
-        newPosition = 0;
-    } else if (mediaDuration > 0 && newPosition > mediaDuration) {
-        newPosition = mediaDuration;
-    }
-    
-    setPosition(newPosition);
+    return 1000.0 / (m_mediaInfo.fps > 0 ? m_mediaInfo.fps : 25.0);
 }
 
-int VP_VLCPlayer::volume() const
+void VP_VLCPlayer::armFrameStep()
 {
-    if (!m_mediaPlayer) {
-        return 0;
+    // Wall time until the clock reaches the next frame
+    double dueMs = (m_frameStepPosition + frameIntervalMs() - m_virtualPosition) / m_virtualRate;
+    m_frameStepTimer->start(qMax(1, static_cast<int>(std::ceil(dueMs))));
+}
+
+void VP_VLCPlayer::frameStepTick()
+{
+    if (!m_mediaPlayer || !isFrameStepping() || m_state != PlayerState::Playing) {
+        return;
     }
     
-    return libvlc_audio_get_volume(m_mediaPlayer);
+    advanceVirtualPosition();
+    if (virtualPlaybackEnded()) {
+        return;
+    }
+    
+    double frameMs = frameIntervalMs();
+    if (m_virtualPosition >= m_frameStepPosition + frameMs) {
+        libvlc_media_player_next_frame(m_mediaPlayer);
+        m_frameStepPosition += frameMs;
+        
+        // More than a frame behind (the timer fired late), the clock sets the pace, not the backlog
+        if (m_virtualPosition - m_frameStepPosition >= frameMs) {
+            m_frameStepPosition = m_virtualPosition;
+        }
+    }
+    
+    armFrameStep();
 }
 
-void VP_VLCPlayer::setVolume(int volume)
+void VP_VLCPlayer::stepFrame(bool forward)
 {
-    if (!m_mediaPlayer) {
+    if (!m_mediaPlayer || !m_currentMedia || m_state == PlayerState::Stopped) {
         return;
     }
     
-    if (volume < 0) volume = 0;
-    if (volume > 200) volume = 200;
+    if (m_state == PlayerState::Playing) {
+        pause();
+    }
     
-    qDebug() << "VP_VLCPlayer: Setting volume to" << volume << "%";
+    double frameMs = frameIntervalMs();
     
-    libvlc_audio_set_volume(m_mediaPlayer, volume);
+    if (forward) {
+        // Back in the buffer, forward steps walk it up to the frame VLC shows
+        if (m_overlayTime >= 0) {
+            qint64 next = m_overlayTime + static_cast<qint64>(frameMs);
+            qint64 frameTime = next;
+            QImage frame = m_frameBuffer ? m_frameBuffer->frameAt(next, &frameTime) : QImage();
+            
+            if (next >= m_overlayBase - frameMs / 2) {
+                clearFrameOverlay();
+                emit positionChanged(position());
+            } else if (!frame.isNull()) {
+                showFrameOverlay(frameTime, frame);
+            } else {
+                setPosition(next);
+            }
+            return;
+        }
+        
+        libvlc_media_player_next_frame(m_mediaPlayer);
+        if (m_virtualRate > 0.0f) {
+            m_virtualPosition += frameMs;
+        }
+        emit positionChanged(position());
+        return;
+    }
     
-    if (!m_isMuted) {
-        m_savedVolume = volume;
+    qint64 previous = position() - static_cast<qint64>(frameMs);
+    if (previous < seekableStart()) {
+        return;
     }
     
-    emit volumeChanged(volume);
+    // A live recording reopens on every seek, it steps back by seeking only
+    if (!m_timeshift && ensureFrameBuffer()) {
+        qint64 frameTime = previous;
+        QImage frame = m_frameBuffer->frameAt(previous, &frameTime);
+        prefetchFrames(frame.isNull() ? previous : frameTime);
+        
+        if (!frame.isNull()) {
+            showFrameOverlay(frameTime, frame);
+            return;
+        }
+    }
+    
+    // Not buffered yet: the slow way, a seek, while the buffer fills
+    setPosition(previous);
 }
 
-void VP_VLCPlayer::mute()
+void VP_VLCPlayer::setReverse(bool reverse)
 {
-    if (!m_mediaPlayer || m_isMuted) {
+    if (reverse == m_reverse || !m_mediaPlayer || !m_currentMedia) {
         return;
     }
     
-    qDebug() << "VP_VLCPlayer: Muting audio";
+    // A live recording reopens on every seek, there is no going back frame by frame
+    if (reverse && (m_timeshift || m_state == PlayerState::Stopped || !ensureFrameBuffer())) {
+        return;
+    }
     
-    m_savedVolume = volume();
-    libvlc_audio_set_mute(m_mediaPlayer, 1);
-    m_isMuted = true;
+    qDebug() << "VP_VLCPlayer: Playing" << (reverse ? "backwards" : "forwards");
     
-    emit mutedChanged(true);
+    // Turned around on the frame shown: forwards play() continues from the buffered frame
+    bool wasPlaying = m_state == PlayerState::Playing;
+    if (wasPlaying) {
+        pause();
+    }
+    
+    m_reverse = reverse;
+    
+    if (wasPlaying) {
+        play();
+    }
 }
 
-void VP_VLCPlayer::unmute()
+void VP_VLCPlayer::reverseTick()
 {
-    if (!m_mediaPlayer || !m_isMuted) {
+    if (!m_reverse || m_state != PlayerState::Playing || !m_frameBuffer) {
         return;
     }
     
-    qDebug() << "VP_VLCPlayer: Unmuting audio";
+    double frameMs = frameIntervalMs();
+    double rate = qBound(static_cast<double>(MinRate), static_cast<double>(playbackRate()), static_cast<double>(MaxReverseRate));
+    m_reversePosition -= m_reverseClock.restart() * rate;
     
-    libvlc_audio_set_mute(m_mediaPlayer, 0);
-    m_isMuted = false;
+    qint64 target = qMax<qint64>(0, static_cast<qint64>(m_reversePosition));
+    qint64 frameTime = target;
+    QImage frame = m_frameBuffer->frameAt(target, &frameTime);
+    prefetchFrames(frame.isNull() ? target : frameTime);
     
-    emit mutedChanged(false);
+    if (frame.isNull()) {
+        // The decoder is behind, hold on the frame shown until it catches up
+        m_reversePosition = position();
+        m_reverseTimer->start(10);
+        return;
+    }
+    
+    if (frameTime != m_overlayTime) {
+        showFrameOverlay(frameTime, frame);
+    }
+    
+    // The beginning, it stays paused on the first frame
+    if (frameTime < frameMs) {
+        pause();
+        return;
+    }
+    
+    // Wall time until the clock reaches the frame before
+    double dueMs = (m_reversePosition - (frameTime - frameMs)) / rate;
+    m_reverseTimer->start(qMax(1, static_cast<int>(std::ceil(dueMs))));
 }
 
-bool VP_VLCPlayer::isMuted() const
+bool VP_VLCPlayer::ensureFrameBuffer()
 {
-    if (!m_mediaPlayer) {
+    if (m_frameBuffer) {
+        return true;
+    }
+    
+    QSize source = videoSize();
+    if (source.isEmpty()) {
         return false;
     }
     
-    return libvlc_audio_get_mute(m_mediaPlayer) != 0;
+    // Frames are only looked at, so the display size is enough (memory is per pixel)
+    QSize size = source;
+    if (m_videoWidget) {
+        QSize display = m_videoWidget->size() * m_videoWidget->devicePixelRatioF();
+        if (!display.isEmpty() && (display.width() < size.width() || display.height() < size.height())) {
+            size = source.scaled(display, Qt::KeepAspectRatio);
+        }
+    }
+    
+    // Even dimensions keep the chroma conversion happy
+    size = QSize(qMax(2, size.width() & ~1), qMax(2, size.height() & ~1));
+    
+    m_frameBuffer.reset(new FrameStepBuffer(frameIntervalMs(), size));
+    return true;
 }
 
-float VP_VLCPlayer::playbackRate() const
+void VP_VLCPlayer::prefetchFrames(qint64 time)
 {
-    if (!m_mediaPlayer) {
-        return 1.0f;
+    double frameMs = frameIntervalMs();
+    qint64 span = static_cast<qint64>(m_frameBuffer->fillFrames() * frameMs);
+    qint64 bufferedFrom = m_frameBuffer->bufferedFrom(time);
+    
+    // Ahead of the user: the span before the buffered frames is decoded once half of them are stepped through
+    if (bufferedFrom >= 0 && time - bufferedFrom >= span / 2) {
+        return;
     }
     
-    return libvlc_media_player_get_rate(m_mediaPlayer);
+    qint64 to = bufferedFrom >= 0 ? bufferedFrom - static_cast<qint64>(frameMs) : time;
+    if (to < 0) {
+        return;
+    }
+    
+    adoptDecoderThread(m_frameBuffer->fill([this]() {
+        return createMedia(m_currentMediaPath);
+    }, qMax<qint64>(0, to - span), to));
 }
 
-void VP_VLCPlayer::setPlaybackRate(float rate)
+void VP_VLCPlayer::showFrameOverlay(qint64 time, const QImage& frame)
 {
-    if (!m_mediaPlayer) {
-        return;
+    if (m_overlayTime < 0) {
+        m_overlayBase = position();
     }
     
-    if (rate < 0.25f) rate = 0.25f;
-    if (rate > 4.0f) rate = 4.0f;
-    
-    qDebug() << "VP_VLCPlayer: Setting playback rate to" << rate;
+    m_overlayTime = time;
+    m_stateFrameOverlay = false;
+    m_stateFrameTarget = -1;
+    emit frameOverlayChanged(frame);
+    emit positionChanged(time);
+}
+
+void VP_VLCPlayer::clearFrameOverlay()
+{
+    if (m_overlayTime < 0 && !m_stateFrameOverlay) {
+        return;
+    }
     
-    libvlc_media_player_set_rate(m_mediaPlayer, rate);
+    m_overlayTime = -1;
+    m_stateFrameOverlay = false;
+    m_stateFrameTarget = -1;
+    emit frameOverlayChanged(QImage());
 }
 
 bool VP_VLCPlayer::isPlaying() const
@@ -575,7 +1688,7 @@ QSize VP_VLCPlayer::videoSize() const
         return QSize(width, height);
     }
     
-    return QSize();
+    return m_mediaInfo.videoSize;
 }
 
 float VP_VLCPlayer::aspectRatio() const
@@ -606,6 +1719,17 @@ void VP_VLCPlayer::updatePosition()
             emit progressChanged(progress);
         }
     }
+    
+    // The window of a timeshifted stream grows with the recording and loses what is overwritten
+    if (m_timeshift) {
+        qint64 start = m_timeshift->startTime();
+        qint64 end = m_timeshift->liveTime();
+        if (qAbs(start - m_timeshiftRangeStart) >= 1000 || qAbs(end - m_timeshiftRangeEnd) >= 1000) {
+            m_timeshiftRangeStart = start;
+            m_timeshiftRangeEnd = end;
+            emit seekableRangeChanged(start, end);
+        }
+    }
 }
 
 void VP_VLCPlayer::setupEventCallbacks()
@@ -625,6 +1749,7 @@ void VP_VLCPlayer::setupEventCallbacks()
     libvlc_event_attach(m_eventManager, libvlc_MediaPlayerEncounteredError, handleVLCEvent, this);
     libvlc_event_attach(m_eventManager, libvlc_MediaPlayerLengthChanged, handleVLCEvent, this);
     libvlc_event_attach(m_eventManager, libvlc_MediaPlayerBuffering, handleVLCEvent, this);
+    libvlc_event_attach(m_eventManager, libvlc_MediaPlayerTimeChanged, handleVLCEvent, this);
     
     qDebug() << "VP_VLCPlayer: Event callbacks setup complete";
 }
@@ -639,6 +1764,7 @@ void VP_VLCPlayer::cleanupEventCallbacks()
     libvlc_event_detach(m_eventManager, libvlc_MediaPlayerEncounteredError, handleVLCEvent, this);
     libvlc_event_detach(m_eventManager, libvlc_MediaPlayerLengthChanged, handleVLCEvent, this);
     libvlc_event_detach(m_eventManager, libvlc_MediaPlayerBuffering, handleVLCEvent, this);
+    libvlc_event_detach(m_eventManager, libvlc_MediaPlayerTimeChanged, handleVLCEvent, this);
 }
 
 void VP_VLCPlayer::handleVLCEvent(const libvlc_event_t* event, void* userData)
@@ -651,21 +1777,31 @@ void VP_VLCPlayer::handleVLCEvent(const libvlc_event_t* event, void* userData)
     
     switch (event->type) {
         case libvlc_MediaPlayerEndReached:
+            // The end of stream interruptReaders() made while stop() closed the input,
+            // the media is reopened or stopped already
+            if (player->m_interruptingInput) {
+                qDebug() << "VP_VLCPlayer: Ignoring end of the interrupted input";
+                break;
+            }
             qDebug() << "VP_VLCPlayer: Media end reached";
             QMetaObject::invokeMethod(player, [player]() {
-                // Stop the player (VLC cleans up when media ends)
-                player->setState(PlayerState::Stopped);
-                player->m_positionTimer->stop();
-                // Reset position to 0 for UI display
-                player->m_lastPosition = 0;
-                emit player->positionChanged(0);
-                emit player->finished();
+                player->handleEndReached();
             }, Qt::QueuedConnection);
             break;
             
         case libvlc_MediaPlayerEncounteredError:
             qDebug() << "VP_VLCPlayer: Playback error encountered";
             QMetaObject::invokeMethod(player, [player]() {
+                // The chunk cache turned the stream down (no range requests), VLC's own access may play it
+                if (player->m_currentMediaCached && !usesChunkCache(player->m_currentMediaPath)) {
+                    QString path = player->m_currentMediaPath;
+                    qDebug() << "VP_VLCPlayer: Retrying" << path << "without the chunk cache";
+                    if (player->loadMedia(path)) {
+                        player->play();
+                    }
+                    return;
+                }
+                
                 player->setState(PlayerState::Error);
                 player->setLastError("Playback error occurred");
                 player->m_positionTimer->stop();
@@ -677,26 +1813,137 @@ void VP_VLCPlayer::handleVLCEvent(const libvlc_event_t* event, void* userData)
                 libvlc_time_t duration = event->u.media_player_length_changed.new_length;
                 qDebug() << "VP_VLCPlayer: Duration changed to" << duration << "ms";
                 QMetaObject::invokeMethod(player, [player, duration]() {
+                    // Of the reopened input, the timeshift window is the length
+                    if (player->m_timeshift) {
+                        return;
+                    }
+                    
                     player->m_duration = duration;
                     emit player->durationChanged(duration);
                 }, Qt::QueuedConnection);
             }
             break;
             
+        case libvlc_MediaParsedChanged:
+            {
+                libvlc_media_t* media = static_cast<libvlc_media_t*>(event->p_obj);
+                QMetaObject::invokeMethod(player, [player, media]() {
+                    // Parsed after the next file was loaded, nothing left to verify
+                    if (media == player->m_currentMedia) {
+                        player->applyParsedMediaInfo();
+                    }
+                }, Qt::QueuedConnection);
+            }
+            break;
+        
         case libvlc_MediaPlayerBuffering:
             {
+                // Read here, the seek may be over by the time the GUI thread sees the event
                 float buffering = event->u.media_player_buffering.new_cache;
-                QMetaObject::invokeMethod(player, [player, buffering]() {
-                    emit player->bufferingProgress(static_cast<int>(buffering));
+                bool seeking = player->m_seekPending;
+                QMetaObject::invokeMethod(player, [player, buffering, seeking]() {
+                    player->updateBuffering(buffering, seeking);
                 }, Qt::QueuedConnection);
             }
             break;
             
+        case libvlc_MediaPlayerTimeChanged:
+            {
+                // The frame of the last skim seek is shown, the next may be asked for
+                player->m_skimSeekPending = false;
+                
+                libvlc_time_t newTime = event->u.media_player_time_changed.new_time;
+                
+                // A state's frame covering a recall goes once VLC is at the recalled position,
+                // not on the first update after the seek (it can still be of the old position)
+                const qint64 StateFrameToleranceMs = 500;
+                qint64 stateFrameTarget = player->m_stateFrameTarget;
+                if (stateFrameTarget >= 0 && qAbs(newTime - stateFrameTarget) <= StateFrameToleranceMs &&
+                    player->m_stateFrameTarget.compare_exchange_strong(stateFrameTarget, -1)) {
+                    QMetaObject::invokeMethod(player, [player]() {
+                        // Not if another recall put up its own frame in the meantime
+                        if (player->m_stateFrameOverlay && player->m_stateFrameTarget < 0) {
+                            player->clearFrameOverlay();
+                        }
+                    }, Qt::QueuedConnection);
+                }
+                
+                // Only the first time update after a load or seek is interesting,
+                // all other updates return here without leaving the VLC thread
+                bool firstFrame = player->m_awaitingFirstFrame.exchange(false);
+                bool seekDone = player->m_seekPending.exchange(false);
+                
+                if (!firstFrame && !seekDone) {
+                    break;
+                }
+                
+                qint64 now = PerfTracer::now();
+                
+                if (firstFrame) {
+                    PerfTracer::instance().recordSpan("firstFrame", "player", player->m_firstFrameTraceStart, now);
+                }
+                if (seekDone) {
+                    PerfTracer::instance().recordSpan("seek", "player", player->m_seekTraceStart, now, newTime);
+                }
+                
+                QMetaObject::invokeMethod(player, [player, firstFrame, seekDone, newTime, now]() {
+                    if (firstFrame) {
+                        player->m_streamMetrics.startupDelayMs = (now - player->m_firstFrameTraceStart) / 1000;
+                        player->updateStateFrames();  // The video size is known now
+                        emit player->firstFrameRendered();
+                    }
+                    if (seekDone) {
+                        emit player->seekCompleted(player->m_timeshift ? player->m_timeshiftOpenTime + newTime : newTime);
+                    }
+                    if (seekDone && player->m_pauseAfterSeek) {
+                        player->m_pauseAfterSeek = false;
+                        player->pause();
+                    }
+                }, Qt::QueuedConnection);
+            }
+            break;
+        
         default:
             break;
     }
 }
 
+void VP_VLCPlayer::handleEndReached()
+{
+    // Stop the player (VLC cleans up when media ends)
+    setState(PlayerState::Stopped);
+    m_positionTimer->stop();
+    m_skimTimer->stop();
+    m_frameStepTimer->stop();
+    m_reverseTimer->stop();
+    m_reverse = false;
+    m_virtualPosition = 0.0;
+    // Reset position to 0 for UI display
+    m_lastPosition = 0;
+    emit positionChanged(0);
+    emit finished();
+}
+
+void VP_VLCPlayer::updateBuffering(float percent, bool seeking)
+{
+    // Buffering before the first frame is the startup delay, after a seek it was asked for
+    bool stalled = percent < 100.0f;
+    bool counts = m_streamMetrics.startupDelayMs >= 0 && !seeking;
+    
+    if (stalled && m_stallStart < 0 && counts) {
+        m_stallStart = PerfTracer::now();
+        m_streamMetrics.rebufferCount++;
+        qDebug() << "VP_VLCPlayer: Rebuffering at" << position() << "ms";
+    } else if (!stalled && m_stallStart >= 0) {
+        qint64 now = PerfTracer::now();
+        PerfTracer::instance().recordSpan("rebuffer", "network", m_stallStart, now);
+        m_streamMetrics.rebufferMs += (now - m_stallStart) / 1000;
+        m_stallStart = -1;
+    }
+    
+    emit bufferingProgress(static_cast<int>(percent));
+}
+
 void VP_VLCPlayer::setState(PlayerState state)
 {
     if (m_state != state) {
@@ -718,21 +1965,149 @@ void VP_VLCPlayer::updateMediaInfo()
         return;
     }
     
-    libvlc_media_parse(m_currentMedia);
+    m_mediaInfo = MediaInfoCache::Info();
+    
+    // Nothing to learn from a live recording, and a parse would open a reader of its own
+    if (m_timeshift) {
+        return;
+    }
+    
+    // A stream is parsed in the background, its duration arrives with the parse or the first frame
+    if (isUrl(m_currentMediaPath)) {
+        if (libvlc_media_get_parsed_status(m_currentMedia) == libvlc_media_parsed_status_done) {
+            applyParsedMediaInfo();
+        } else {
+            libvlc_event_attach(libvlc_media_event_manager(m_currentMedia), libvlc_MediaParsedChanged,
+                                handleVLCEvent, this);
+            libvlc_media_parse_with_options(m_currentMedia, libvlc_media_parse_network, -1);
+        }
+        return;
+    }
+    
+    // Known file: show the cached values now and let VLC confirm them in the background
+    if (MediaInfoCache::instance().lookup(m_currentMediaPath, m_mediaInfo)) {
+        if (m_mediaInfo.durationMs > 0) {
+            m_duration = m_mediaInfo.durationMs;
+            emit durationChanged(m_duration);
+        }
+        
+        if (libvlc_media_get_parsed_status(m_currentMedia) == libvlc_media_parsed_status_done) {
+            applyParsedMediaInfo();
+        } else {
+            libvlc_event_attach(libvlc_media_event_manager(m_currentMedia), libvlc_MediaParsedChanged,
+                                handleVLCEvent, this);
+            libvlc_media_parse_with_options(m_currentMedia, libvlc_media_parse_local, -1);
+        }
+        
+        qDebug() << "VP_VLCPlayer: Media info from cache, duration:" << m_duration << "ms";
+        return;
+    }
+    
+    PERF_TRACE_SCOPE("mediaParse");
     
-    libvlc_time_t dur = libvlc_media_get_duration(m_currentMedia);
-    if (dur > 0) {
-        m_duration = dur;
-        emit durationChanged(dur);
+    // Media from prepareMedia() has usually been parsed by now
+    if (libvlc_media_get_parsed_status(m_currentMedia) != libvlc_media_parsed_status_done) {
+        libvlc_media_parse(m_currentMedia);
     }
     
+    applyParsedMediaInfo();
+    
     qDebug() << "VP_VLCPlayer: Media info updated, duration:" << m_duration << "ms";
 }
 
+void VP_VLCPlayer::applyParsedMediaInfo()
+{
+    if (!m_currentMedia || libvlc_media_get_parsed_status(m_currentMedia) != libvlc_media_parsed_status_done) {
+        return;
+    }
+    
+    MediaInfoCache::Info parsed = parsedMediaInfo(m_currentMedia);
+    
+    if (parsed.durationMs > 0 && parsed.durationMs != m_mediaInfo.durationMs) {
+        // Cache entry was stale (or there was none), correct what was shown
+        m_duration = parsed.durationMs;
+        emit durationChanged(m_duration);
+    }
+    
+    if (m_mediaInfo.durationMs > 0 && !(parsed == m_mediaInfo)) {
+        qDebug() << "VP_VLCPlayer: Parsed media info differs from the cache, updating it";
+    }
+    
+    m_mediaInfo = parsed;
+    MediaInfoCache::instance().store(m_currentMediaPath, parsed);
+    updateStateFrames();
+}
+
+MediaInfoCache::Info VP_VLCPlayer::parsedMediaInfo(libvlc_media_t* media)
+{
+    MediaInfoCache::Info info;
+    info.durationMs = qMax<qint64>(0, libvlc_media_get_duration(media));
+    
+    libvlc_media_track_t** tracks = nullptr;
+    unsigned trackCount = libvlc_media_tracks_get(media, &tracks);
+    
+    for (unsigned i = 0; i < trackCount; i++) {
+        const libvlc_media_track_t* track = tracks[i];
+        
+        // Fourcc as stored by VLC (little-endian, may be padded with spaces)
+        char fourcc[5] = {};
+        for (int b = 0; b < 4; b++) {
+            fourcc[b] = static_cast<char>((track->i_codec >> (8 * b)) & 0xff);
+        }
+        QString codec = QString::fromLatin1(fourcc).trimmed();
+        
+        switch (track->i_type) {
+            case libvlc_track_video:
+                if (info.videoSize.isEmpty()) {
+                    info.videoSize = QSize(track->video->i_width, track->video->i_height);
+                    info.videoCodec = QString::fromUtf8(libvlc_media_get_codec_description(libvlc_track_video, track->i_codec));
+                    if (track->video->i_frame_rate_den > 0) {
+                        info.fps = static_cast<double>(track->video->i_frame_rate_num) / track->video->i_frame_rate_den;
+                    }
+                }
+                info.tracks << QString("video %1 %2x%3").arg(codec).arg(track->video->i_width).arg(track->video->i_height);
+                break;
+            
+            case libvlc_track_audio:
+                info.tracks << QString("audio %1 %2").arg(codec, QString::fromUtf8(track->psz_language)).trimmed();
+                break;
+            
+            case libvlc_track_text:
+                info.tracks << QString("text %1 %2").arg(codec, QString::fromUtf8(track->psz_language)).trimmed();
+                break;
+            
+            default:
+                break;
+        }
+    }
+    
+    libvlc_media_tracks_release(tracks, trackCount);
+    return info;
+}
+
+bool VP_VLCPlayer::playbackStatistics(PlaybackStatistics& stats) const
+{
+    if (!m_currentMedia) {
+        return false;
+    }
+    
+    libvlc_media_stats_t vlcStats;
+    if (!libvlc_media_get_stats(m_currentMedia, &vlcStats)) {
+        return false;
+    }
+    
+    stats.decodedVideo = vlcStats.i_decoded_video;
+    stats.displayedPictures = vlcStats.i_displayed_pictures;
+    stats.lostPictures = vlcStats.i_lost_pictures;
+    return true;
+}
+
 QPixmap VP_VLCPlayer::captureFrameAtPosition(qint64 position)
 {
     qDebug() << "VP_VLCPlayer: Capturing frame at position" << position << "ms";
     
+    PERF_TRACE_SCOPE("captureFrameAtPosition");
+    
     if (!m_mediaPlayer || !m_currentMedia) {
         qDebug() << "VP_VLCPlayer: No media loaded, cannot capture frame";
         return QPixmap();
@@ -5,6 +5,20 @@
 #include <QWidget>
 #include <QString>
 #include <QTimer>
+#include <QStringList>
+#include <QHash>
+#include <QPointer>
+#include <QThread>
+#include <QElapsedTimer>
+#include <atomic>
+#include "vp_playerbackend.h"
+#include "mediainfocache.h"
+#include <memory>
+
+class TimeshiftBuffer;
+class FrameStepBuffer;
+class KeyframeIndex;
+class StateFrameCache;
 
 // Forward declarations for libvlc types
 struct libvlc_instance_t;
@@ -13,102 +27,184 @@ struct libvlc_media_t;
 struct libvlc_event_manager_t;
 struct libvlc_event_t;
 
-class VP_VLCPlayer : public QObject
+class VP_VLCPlayer : public VP_PlayerBackend
 {
     Q_OBJECT
 
 public:
-    // Player state enumeration
-    enum class PlayerState {
-        Stopped,
-        Playing,
-        Paused,
-        Buffering,
-        Error
+    // Decoder statistics for the current media (requires the --stats VLC argument)
+    struct PlaybackStatistics {
+        int decodedVideo;
+        int displayedPictures;
+        int lostPictures;
+        
+        PlaybackStatistics() : decodedVideo(0), displayedPictures(0), lostPictures(0) {}
     };
-
+    
+    // Prebuffering of the current media, reset by loadMedia()
+    struct StreamMetrics {
+        qint64 startupDelayMs;  // loadMedia to first frame, -1 until it is shown
+        int rebufferCount;  // Stalls after the first frame (seeks excluded)
+        qint64 rebufferMs;  // Time spent stalled
+        
+        StreamMetrics() : startupDelayMs(-1), rebufferCount(0), rebufferMs(0) {}
+    };
+    
     // Constructor/Destructor
     explicit VP_VLCPlayer(QObject *parent = nullptr);
     ~VP_VLCPlayer();
+    
+    // Extra libvlc arguments appended to the defaults for instances created afterwards
+    static void setExtraArguments(const QStringList& arguments);
+    static QStringList extraArguments();
+    
+    // How files of media created afterwards are read
+    enum class IoMode {
+        Vlc,  // VLC's own file access
+        Buffered,  // MediaReader with read-ahead and block cache, for slow storage
+        Mapped,  // MediaReader from a memory map, for fast local storage
+        Auto  // Buffered on network file systems, Mapped otherwise
+    };
+    
+    static void setIoMode(IoMode mode);
+    static IoMode ioMode();
+    
+    // Mode for one file, takes precedence over ioMode()
+    static void setFileIoMode(const QString& filePath, IoMode mode);
+    
+    // Mode a file is read with, Auto resolved
+    static IoMode ioModeForFile(const QString& filePath);
+    
+    // "vlc", "buffered", "mmap", "auto"
+    static QString ioModeName(IoMode mode);
+    static bool ioModeFromName(const QString& name, IoMode* mode);
+    
+    // http://, https://, rtsp:// and other locations VLC opens itself (not a file path)
+    static bool isUrl(const QString& path);
+    
+    // Prebuffer of network media created afterwards, in ms (VLC's :network-caching)
+    static void setNetworkCaching(int milliseconds);
+    static int networkCaching();
+    
+    // True if the URL is read through RemoteReader and the disk chunk cache
+    static bool usesChunkCache(const QString& url);
+    
+    // Record http(s) streams loaded afterwards into a TimeshiftBuffer, so a live
+    // stream can be paused and rewound (positions are then ms since loading)
+    static void setTimeshiftEnabled(bool enabled);
+    static bool timeshiftEnabled();
+    static bool usesTimeshift(const QString& url);
+    bool isTimeshifting() const { return m_timeshift != nullptr; }
 
-    // Initialize VLC instance
-    bool initialize();
+    // Initialize VLC instance (blocking; waits for a pending initializeAsync())
+    bool initialize() override;
+    
+    // Create the VLC instance on a background thread, emits initialized() on this thread
+    void initializeAsync() override;
+    bool isInitialized() const override { return m_vlcInstance && m_mediaPlayer; }
+    
+    // Plugin directory, discovered once and cached next to the executable
+    static QString pluginPath();
+    
+    // Instance without a player or audio output, for parsing media off the GUI thread
+    // (caller releases it with libvlc_release; nullptr on failure)
+    static libvlc_instance_t* createHeadlessInstance(QString* error = nullptr);
     
     // Media loading
-    bool loadMedia(const QString& filePath);
-    void unloadMedia();
+    bool loadMedia(const QString& filePath) override;
+    void unloadMedia() override;
+    void prepareMedia(const QString& filePath) override;
     
     // Basic playback controls
-    void play();
-    void pause();
-    void stop();
-    void togglePlayPause();
+    void play() override;
+    void pause() override;
+    void stop() override;
+    void togglePlayPause() override;
     
     // Position and duration (in milliseconds)
-    qint64 position() const;
-    qint64 duration() const;
-    void setPosition(qint64 position);
-    void seekRelative(qint64 offset);  // Seek relative to current position
+    qint64 position() const override;
+    qint64 duration() const override;
+    void setPosition(qint64 position) override;
+    void seekRelative(qint64 offset) override;  // Seek relative to current position
+    qint64 seekableStart() const override;
+    void setStartPosition(qint64 position) override;
     
     // Volume control (0-200, where 100 is normal volume)
-    int volume() const;
-    void setVolume(int volume);
-    void mute();
-    void unmute();
-    bool isMuted() const;
+    int volume() const override;
+    void setVolume(int volume) override;
+    void mute() override;
+    void unmute() override;
+    bool isMuted() const override;
     
     // Playback speed (1.0 = normal speed)
-    float playbackRate() const;
-    void setPlaybackRate(float rate);
+    float playbackRate() const override;
+    void setPlaybackRate(float rate) override;
+    
+    // VLC plays MinNativeRate to MaxNativeRate itself. Above, it falls behind and
+    // drops frames at random, so faster rates skim: VLC stays paused and is seeked
+    // along a virtual clock, one frame at a time. Slower rates step VLC frame by
+    // frame, paced by the clock. Both have no audio and position() follows the clock.
+    static constexpr float MinRate = 0.01f;
+    static constexpr float MinNativeRate = 0.25f;
+    static constexpr float MaxNativeRate = 4.0f;
+    static constexpr float MaxSkimRate = 32.0f;
+    bool isSkimming() const { return m_virtualRate > MaxNativeRate; }
+    bool isFrameStepping() const { return m_virtualRate > 0.0f && m_virtualRate < MinNativeRate; }
     
     // State queries
-    PlayerState state() const { return m_state; }
-    bool isPlaying() const;
-    bool isPaused() const;
-    bool isStopped() const;
-    bool hasMedia() const;
-    QString currentMediaPath() const { return m_currentMediaPath; }
+    PlayerState state() const override { return m_state; }
+    bool isPlaying() const override;
+    bool isPaused() const override;
+    bool isStopped() const override;
+    bool hasMedia() const override;
+    QString currentMediaPath() const override { return m_currentMediaPath; }
     
     // Video rendering widget
-    QWidget* videoWidget() const { return m_videoWidget; }
-    void setVideoWidget(QWidget* widget);
+    QWidget* videoWidget() const override { return m_videoWidget; }
+    void setVideoWidget(QWidget* widget) override;
     
-    // Video information
-    QSize videoSize() const;
-    float aspectRatio() const;
+    // Video information (from the metadata cache until VLC has a video output)
+    QSize videoSize() const override;
+    float aspectRatio() const override;
+    double frameRate() const { return m_mediaInfo.fps; }
+    
+    // Duration, tracks and frame rate of a parsed media
+    static MediaInfoCache::Info parsedMediaInfo(libvlc_media_t* media);
     
     // Frame capture
-    QPixmap captureFrameAtPosition(qint64 position);
+    QPixmap captureFrameAtPosition(qint64 position) override;
+    
+    // Forward steps decode the next frame. Back steps show frames of a FrameStepBuffer
+    // over the video (frameOverlayChanged()) and seek only where it has none yet;
+    // play() continues from the frame shown.
+    void stepFrame(bool forward) override;
+    
+    // Keyframe index of the current local MP4/MKV file, nullptr until it is built
+    // (loadMedia() opens a cached one, or builds it in the background)
+    std::shared_ptr<KeyframeIndex> keyframeIndex() const { return m_keyframeIndex; }
+    
+    // Positions seeks are expected to (the saved states), a full-resolution frame of each
+    // is decoded in the background; a seek to one shows it until VLC has the real frame.
+    // Local files only, reset by loadMedia().
+    void setStateFramePositions(const QList<qint64>& positions);
+    
+    // Reverse playback shows the FrameStepBuffer backwards while VLC stays paused,
+    // the span before the frames left is decoded as they are shown. Rates above
+    // MaxReverseRate play back at it; a stop or the end of the media turns it off.
+    static constexpr float MaxReverseRate = 1.0f;
+    void setReverse(bool reverse) override;
+    bool isReverse() const override { return m_reverse; }
+    
+    // Statistics (returns false if no media is loaded)
+    bool playbackStatistics(PlaybackStatistics& stats) const;
+    StreamMetrics streamMetrics() const { return m_streamMetrics; }
     
     // Error handling
-    QString lastError() const { return m_lastError; }
+    QString lastError() const override { return m_lastError; }
 
 signals:
-    // State changes
-    void stateChanged(VP_VLCPlayer::PlayerState state);
-    void playing();
-    void paused();
-    void stopped();
-    void finished();  // Media playback reached the end
-    
-    // Position/Duration updates
-    void positionChanged(qint64 position);
-    void durationChanged(qint64 duration);
-    void progressChanged(float progress);  // 0.0 to 1.0
-    
-    // Volume changes
-    void volumeChanged(int volume);
-    void mutedChanged(bool muted);
-    
-    // Media changes
-    void mediaLoaded(const QString& path);
-    void mediaUnloaded();
-    
-    // Buffering
-    void bufferingProgress(int percent);
-    
-    // Errors
-    void errorOccurred(const QString& error);
+    // keyframeIndex() was built in the background for the current media
+    void keyframeIndexChanged();
 
 public slots:
     // Enable/disable libvlc mouse/keyboard input (to allow Qt event handling)
@@ -117,6 +213,9 @@ public slots:
     
 private slots:
     void updatePosition();
+    void skimTick();
+    void frameStepTick();
+    void reverseTick();
     
 private:
     // LibVLC callbacks (static methods)
@@ -128,6 +227,32 @@ private:
     void setState(PlayerState state);
     void setLastError(const QString& error);
     void updateMediaInfo();
+    void applyParsedMediaInfo();
+    void updateBuffering(float percent, bool seeking);
+    void releaseCurrentMedia();
+    libvlc_media_t* createMedia(const QString& filePath) const;
+    void reopenTimeshift(qint64 position);
+    void startVirtualPlayback();
+    void stopVirtualPlayback();
+    void advanceVirtualPosition();
+    bool virtualPlaybackEnded();
+    double frameIntervalMs() const;
+    void armFrameStep();
+    bool ensureFrameBuffer();
+    void prefetchFrames(qint64 time);
+    void showFrameOverlay(qint64 time, const QImage& frame);
+    void clearFrameOverlay();
+    void loadKeyframeIndex(const QString& filePath);
+    void updateStateFrames();
+    void adoptDecoderThread(QThread* thread);
+    void handleEndReached();
+    void releasePreparedMedia();
+    
+    // Instance creation (thread-safe, touches no members; mediaPlayer may be null)
+    static bool createInstance(const QStringList& extraArguments, libvlc_instance_t** instance,
+                               libvlc_media_player_t** mediaPlayer, QString* error);
+    bool finishInitialization(libvlc_instance_t* instance, libvlc_media_player_t* mediaPlayer, const QString& error);
+    void finishAsyncInitialization();
     
     // LibVLC instances
     libvlc_instance_t* m_vlcInstance;
@@ -135,12 +260,22 @@ private:
     libvlc_media_t* m_currentMedia;
     libvlc_event_manager_t* m_eventManager;
     
+    // Next file, created and parsed ahead of time by prepareMedia()
+    libvlc_media_t* m_preparedMedia;
+    QString m_preparedMediaPath;
+    
+    // Position for the next play() from stopped, passed to VLC as :start-time
+    qint64 m_startPosition;
+    bool m_hasStartOption;  // The current media carries a :start-time option
+    
     // State tracking
     PlayerState m_state;
     QString m_currentMediaPath;
+    bool m_currentMediaCached;  // Read through the chunk cache
     QString m_lastError;
     bool m_isMuted;
     int m_savedVolume;  // Volume before muting
+    int m_pendingVolume;  // Volume requested before VLC was initialized (-1 if none)
     
     // Video widget
     QWidget* m_videoWidget;
@@ -149,12 +284,80 @@ private:
     QTimer* m_positionTimer;
     qint64 m_lastPosition;
     qint64 m_duration;
+    MediaInfoCache::Info m_mediaInfo;  // Of the current media, cached or parsed
+    
+    // Live stream recording of the current media, nullptr unless timeshifting
+    std::unique_ptr<TimeshiftBuffer> m_timeshift;
+    qint64 m_timeshiftOpenTime;  // Buffer time the media was last opened at
+    qint64 m_timeshiftRangeStart;  // Window last reported by seekableRangeChanged()
+    qint64 m_timeshiftRangeEnd;
+    bool m_pauseAfterSeek;  // A seek that reopened the media while paused
+    std::atomic<bool> m_interruptingInput;  // Its end of stream is ours, not the media's end
+    
+    // Skimming and frame stepping, m_virtualRate is 0 at native rates
+    float m_virtualRate;
+    double m_virtualPosition;  // Advanced by the wall clock (fractions of a ms add up at 0.01x)
+    QElapsedTimer m_virtualClock;
+    QTimer* m_skimTimer;
+    std::atomic<bool> m_skimSeekPending;  // Frame of the last skim seek not shown yet
+    qint64 m_skimSeekStart;
+    qint64 m_skimTarget;  // Position of the last skim seek, -1 if none
+    QTimer* m_frameStepTimer;  // Single shot, armed for the next frame
+    double m_frameStepPosition;  // Position of the frame stepped to last
+    
+    // Decoded frames before the paused position, created by the first back step
+    std::unique_ptr<FrameStepBuffer> m_frameBuffer;
+    qint64 m_overlayTime;  // Buffered frame shown over the video, -1 if none
+    qint64 m_overlayBase;  // Position of the frame VLC shows underneath
+    
+    // Reverse playback along its own clock, held while the buffer has no frame yet
+    bool m_reverse;
+    double m_reversePosition;
+    QElapsedTimer m_reverseClock;
+    QTimer* m_reverseTimer;  // Single shot, armed for the next frame back
+    
+    // Decoders of the frame buffer and the state frames, of dropped ones too (waited for before libvlc is released)
+    QList<QPointer<QThread>> m_decoderThreads;
+    
+    // Keyframe index of the current media, one build at a time in the background
+    std::shared_ptr<KeyframeIndex> m_keyframeIndex;
+    QPointer<QThread> m_indexThread;
+    
+    // Frames of the saved states, created once the video size is known
+    std::unique_ptr<StateFrameCache> m_stateFrames;
+    QList<qint64> m_stateFramePositions;
+    bool m_stateFrameOverlay;  // One of them covers a seek in flight
+    std::atomic<qint64> m_stateFrameTarget;  // Where that seek goes, -1 once VLC has shown it
+    
+    // Prebuffering of the current media
+    StreamMetrics m_streamMetrics;
+    qint64 m_stallStart;  // PerfTracer::now() of the current stall, -1 while not stalled
     
     // Debug mode
     bool m_debugMode;
     
     // Destruction flag
     bool m_isDestroying;
+    
+    // Background initialization (results are written by the thread, taken on this thread)
+    QPointer<QThread> m_initThread;
+    bool m_asyncInitPending;
+    libvlc_instance_t* m_pendingInstance;
+    libvlc_media_player_t* m_pendingMediaPlayer;
+    QString m_pendingError;
+    
+    // Extra libvlc arguments shared by all instances
+    static QStringList s_extraArguments;
+    static IoMode s_ioMode;
+    static QHash<QString, IoMode> s_fileIoModes;  // Absolute path -> mode
+    static int s_networkCaching;
+    static bool s_timeshiftEnabled;
+    
+    // Pending render milestones (checked from the libvlc event thread)
+    std::atomic<bool> m_awaitingFirstFrame;
+    std::atomic<bool> m_seekPending;
+    qint64 m_firstFrameTraceStart;
+    qint64 m_seekTraceStart;
 };
 
 #endif // VP_VLCPLAYER_H
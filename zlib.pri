@@ -0,0 +1,18 @@
+# zlib, inflates deflated entries of zip archives (ArchiveReader)
+# Include this from any .pro file that links VP_VLCPlayer
+
+win32 {
+    ZLIB_PATH = $$PWD/3rdparty/zlib
+
+    !exists($$ZLIB_PATH/lib/zlib.lib) {
+        warning("zlib not found at $$ZLIB_PATH/lib/")
+        warning("Please copy zlib.h, zconf.h and zlib.lib to $$ZLIB_PATH/include/ and $$ZLIB_PATH/lib/")
+    }
+
+    INCLUDEPATH += $$ZLIB_PATH/include
+    LIBS += -L$$ZLIB_PATH/lib -lzlib
+}
+
+unix {
+    LIBS += -lz
+}